@@ -0,0 +1,84 @@
+#include "activity.h"
+
+bool ActivityPolicy::Wake() {
+    if (IsParked() || m_idle || !m_missed) return false;
+    m_missed = false;
+    return true;
+}
+
+bool ActivityPolicy::OnEvent(ActivityEvent ev) {
+    switch (ev) {
+    case ActivityEvent::SessionLocked:
+        m_locked = true;
+        m_missed = true;
+        return false;
+
+    case ActivityEvent::Suspending:
+        m_suspended = true;
+        m_missed = true;
+        return false;
+
+    case ActivityEvent::DisplayOff:
+        m_displayOff = true;
+        m_missed = true;
+        return false;
+
+    // Unlock, resume and display-on all imply someone is at the machine
+    case ActivityEvent::SessionUnlocked:
+        m_locked = false;
+        m_idle = false;
+        return Wake();
+
+    // Windows sends both RESUMEAUTOMATIC and RESUMESUSPEND for one wake;
+    // only the first counts
+    case ActivityEvent::Resumed:
+        if (!m_suspended) return false;
+        m_suspended = false;
+        m_idle = false;
+        m_missed = true;  // Data is stale after any sleep
+        return Wake();
+
+    case ActivityEvent::DisplayOn:
+        m_displayOff = false;
+        m_idle = false;
+        return Wake();
+
+    case ActivityEvent::OnBattery:
+        m_onBattery = true;
+        return false;
+
+    case ActivityEvent::OnAC:
+        m_onBattery = false;
+        return false;
+    }
+    return false;
+}
+
+bool ActivityPolicy::OnIdle(uint32_t idleSec) {
+    bool idle = idleSec >= idleParkSec;
+    if (idle == m_idle) return false;
+
+    m_idle = idle;
+    if (idle) return false;
+    return Wake();
+}
+
+bool ActivityPolicy::OnTick() {
+    if (IsParked() || m_idle) {
+        m_missed = true;
+        return false;
+    }
+    m_missed = false;
+    return true;
+}
+
+uint32_t ActivityPolicy::NextIntervalMs(uint32_t baseMs) const {
+    if (IsParked()) return 0;
+    if (m_idle) return idleProbeMs;
+    return m_onBattery ? baseMs * batteryFactor : baseMs;
+}
+
+uint32_t ActivityPolicy::ToleranceMs(uint32_t intervalMs) const {
+    // Nobody needs sub-second accuracy on a usage poll; let Windows batch us
+    return m_onBattery ? intervalMs / 4 : intervalMs / 10;
+}
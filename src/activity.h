@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+// Things that change whether anyone can actually see the widget
+enum class ActivityEvent {
+    SessionLocked,
+    SessionUnlocked,
+    Suspending,
+    Resumed,
+    DisplayOff,
+    DisplayOn,
+    OnBattery,
+    OnAC
+};
+
+// Decides when polling is worth doing. Platform-neutral: main.cpp translates
+// WTS/power broadcasts into ActivityEvents and feeds idle time from
+// GetLastInputInfo, so the policy can be driven with injected events.
+class ActivityPolicy {
+public:
+    // Returns true if a refresh should run right now (we just became visible
+    // again after missing at least one tick)
+    bool OnEvent(ActivityEvent ev);
+
+    // Feed seconds since last user input; returns true when the user comes
+    // back from an idle park
+    bool OnIdle(uint32_t idleSec);
+
+    // Called when the refresh timer fires; returns true if it should fetch
+    bool OnTick();
+
+    // Locked, asleep or display off - nothing to poll for, wait for an event
+    bool IsParked() const { return m_locked || m_suspended || m_displayOff; }
+    bool IsIdle() const { return m_idle; }
+    bool IsOnBattery() const { return m_onBattery; }
+
+    // Interval for the next timer, 0 means don't arm one at all
+    uint32_t NextIntervalMs(uint32_t baseMs) const;
+
+    // How long a refresh may wait past its due time to share a wakeup
+    uint32_t ToleranceMs(uint32_t intervalMs) const;
+
+    uint32_t idleParkSec = 30 * 60;     // No input this long = nobody is looking
+    uint32_t idleProbeMs = 60 * 1000;   // How often to check for the user coming back
+    uint32_t batteryFactor = 2;         // Stretch intervals on battery
+
+private:
+    bool m_locked = false;
+    bool m_suspended = false;
+    bool m_displayOff = false;
+    bool m_onBattery = false;
+    bool m_idle = false;
+    bool m_missed = false;  // A tick was skipped while parked/idle
+
+    bool Wake();
+};
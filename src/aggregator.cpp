@@ -0,0 +1,586 @@
+#include "aggregator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+namespace {
+
+constexpr uint32_t SNAPSHOT_MAGIC = 0x31535743;     // "CWS1"
+constexpr size_t SNAPSHOT_HEADER = 41;
+
+void PutU16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (i * 8)));
+}
+
+void PutI64(std::vector<uint8_t>& out, int64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back((uint8_t)((uint64_t)v >> (i * 8)));
+}
+
+void PutF32(std::vector<uint8_t>& out, float f) {
+    uint32_t v;
+    memcpy(&v, &f, 4);
+    PutU32(out, v);
+}
+
+uint32_t GetU32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+int64_t GetI64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)p[i] << (i * 8);
+    return (int64_t)v;
+}
+
+float GetF32(const uint8_t* p) {
+    uint32_t v = GetU32(p);
+    float f;
+    memcpy(&f, &v, 4);
+    return f;
+}
+
+void AppendJsonString(std::string& out, const std::string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += (char)c;
+        }
+    }
+    out += '"';
+}
+
+void AppendHtml(std::string& out, const std::string& s) {
+    for (char c : s) {
+        switch (c) {
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '&': out += "&amp;"; break;
+        case '"': out += "&quot;"; break;
+        default: out += c; break;
+        }
+    }
+}
+
+// Members for display: most loaded first
+std::vector<const TeamState::Member*> SortedMembers(const TeamState& state) {
+    std::vector<const TeamState::Member*> out;
+    for (const auto& entry : state.Members()) out.push_back(&entry.second);
+    std::sort(out.begin(), out.end(), [](const TeamState::Member* a, const TeamState::Member* b) {
+        if (a->latest.session != b->latest.session) return a->latest.session > b->latest.session;
+        return a->latest.user < b->latest.user;
+    });
+    return out;
+}
+
+const char* StatusText(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    default: return "Error";
+    }
+}
+
+bool HeaderEquals(const char* begin, const char* end, const char* name) {
+    size_t len = strlen(name);
+    if ((size_t)(end - begin) != len) return false;
+    for (size_t i = 0; i < len; i++) {
+        char c = begin[i];
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        if (c != name[i]) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void EncodeSnapshot(const UsageSnapshot& s, std::vector<uint8_t>& out) {
+    size_t userLen = std::min<size_t>(s.user.size(), 255);
+    size_t hostLen = std::min<size_t>(s.host.size(), 255);
+    PutU32(out, SNAPSHOT_MAGIC);
+    PutU16(out, (uint16_t)(SNAPSHOT_HEADER + userLen + hostLen));
+    out.push_back(s.estimated ? 1 : 0);
+    out.push_back((uint8_t)userLen);
+    out.push_back((uint8_t)hostLen);
+    PutI64(out, s.time);
+    PutF32(out, s.session);
+    PutF32(out, s.period);
+    PutI64(out, s.sessionResetMs);
+    PutI64(out, s.periodResetMs);
+    out.insert(out.end(), s.user.begin(), s.user.begin() + userLen);
+    out.insert(out.end(), s.host.begin(), s.host.begin() + hostLen);
+}
+
+bool DecodeSnapshots(const uint8_t* data, size_t size, std::vector<UsageSnapshot>& out) {
+    size_t pos = 0;
+    while (pos < size) {
+        const uint8_t* p = data + pos;
+        if (size - pos < SNAPSHOT_HEADER || GetU32(p) != SNAPSHOT_MAGIC) return false;
+        size_t length = (size_t)p[4] | (size_t)p[5] << 8;
+        size_t userLen = p[7];
+        size_t hostLen = p[8];
+        if (length < SNAPSHOT_HEADER + userLen + hostLen || length > size - pos) return false;
+
+        UsageSnapshot s;
+        s.estimated = (p[6] & 1) != 0;
+        s.time = GetI64(p + 9);
+        s.session = GetF32(p + 17);
+        s.period = GetF32(p + 21);
+        s.sessionResetMs = GetI64(p + 25);
+        s.periodResetMs = GetI64(p + 33);
+        s.user.assign((const char*)p + SNAPSHOT_HEADER, userLen);
+        s.host.assign((const char*)p + SNAPSHOT_HEADER + userLen, hostLen);
+        if (s.user.empty() || !(s.session >= 0.0f && s.session <= 1000.0f) ||
+            !(s.period >= 0.0f && s.period <= 1000.0f)) {
+            return false;
+        }
+        out.push_back(std::move(s));
+        pos += length;
+    }
+    return true;
+}
+
+size_t TeamState::Ingest(const UsageSnapshot* batch, size_t count, int64_t nowSec) {
+    int64_t hour = nowSec / 3600;
+    HourRollup& slot = m_hours[(size_t)(hour % (int64_t)HOURS)];
+    if (slot.hour != hour) {
+        slot = HourRollup();
+        slot.hour = hour;
+    }
+
+    // Anyone on the LAN can push under any name, so the table is capped
+    std::string key;
+    size_t refused = 0;
+    for (size_t i = 0; i < count; i++) {
+        const UsageSnapshot& s = batch[i];
+        key.assign(s.user);
+        key += '\n';
+        key += s.host;
+
+        auto it = m_members.find(key);
+        if (it == m_members.end()) {
+            if (m_members.size() >= maxMembers) {
+                refused++;
+                continue;
+            }
+            it = m_members.emplace(key, Member()).first;
+        }
+        Member& m = it->second;
+        if (m.pushes != 0 && s.time < m.latest.time) continue;
+        m.latest = s;
+        m.receivedSec = nowSec;
+        m.pushes++;
+
+        slot.pushes++;
+        slot.sessionSum += s.session;
+        slot.sessionMax = std::max(slot.sessionMax, s.session);
+        slot.periodSum += s.period;
+        slot.periodMax = std::max(slot.periodMax, s.period);
+        if (m.lastHour != hour) {
+            m.lastHour = hour;
+            slot.members++;
+        }
+    }
+    return refused;
+}
+
+size_t TeamState::Forget(int64_t nowSec) {
+    size_t forgotten = 0;
+    for (auto it = m_members.begin(); it != m_members.end();) {
+        if (nowSec - it->second.receivedSec > (int64_t)HOURS * 3600) {
+            it = m_members.erase(it);
+            forgotten++;
+        } else {
+            ++it;
+        }
+    }
+    return forgotten;
+}
+
+std::vector<TeamState::HourRollup> TeamState::Hours(int64_t nowSec) const {
+    std::vector<HourRollup> out;
+    int64_t hour = nowSec / 3600;
+    for (int64_t h = hour - (int64_t)HOURS + 1; h <= hour; h++) {
+        const HourRollup& slot = m_hours[(size_t)(((h % (int64_t)HOURS) + (int64_t)HOURS) % (int64_t)HOURS)];
+        if (slot.hour == h && slot.pushes) out.push_back(slot);
+    }
+    return out;
+}
+
+std::string TeamState::ToJson(int64_t nowSec) const {
+    std::string out;
+    char buf[320];
+
+    size_t active = 0;
+    double sessionSum = 0.0, periodSum = 0.0;
+    float sessionMax = 0.0f, periodMax = 0.0f;
+    for (const auto& entry : m_members) {
+        const Member& m = entry.second;
+        if (nowSec - m.receivedSec > staleAfterSec) continue;
+        active++;
+        sessionSum += m.latest.session;
+        periodSum += m.latest.period;
+        sessionMax = std::max(sessionMax, m.latest.session);
+        periodMax = std::max(periodMax, m.latest.period);
+    }
+
+    snprintf(buf, sizeof(buf),
+             "{\"generated\":%lld,\"team\":{\"members\":%zu,\"active\":%zu,\"avgSession\":%.1f,\"maxSession\":%.1f,"
+             "\"avgPeriod\":%.1f,\"maxPeriod\":%.1f},\"members\":[",
+             (long long)nowSec, m_members.size(), active, active ? sessionSum / active : 0.0, sessionMax,
+             active ? periodSum / active : 0.0, periodMax);
+    out += buf;
+
+    bool first = true;
+    for (const Member* m : SortedMembers(*this)) {
+        out += first ? "{\"user\":" : ",{\"user\":";
+        first = false;
+        AppendJsonString(out, m->latest.user);
+        out += ",\"host\":";
+        AppendJsonString(out, m->latest.host);
+        snprintf(buf, sizeof(buf),
+                 ",\"session\":%.1f,\"period\":%.1f,\"sessionResetMs\":%lld,\"periodResetMs\":%lld,"
+                 "\"estimated\":%s,\"updated\":%lld,\"pushes\":%llu,\"stale\":%s}",
+                 m->latest.session, m->latest.period, (long long)m->latest.sessionResetMs,
+                 (long long)m->latest.periodResetMs, m->latest.estimated ? "true" : "false",
+                 (long long)m->receivedSec, (unsigned long long)m->pushes,
+                 nowSec - m->receivedSec > staleAfterSec ? "true" : "false");
+        out += buf;
+    }
+
+    out += "],\"hourly\":[";
+    first = true;
+    for (const HourRollup& h : Hours(nowSec)) {
+        snprintf(buf, sizeof(buf),
+                 "%s{\"start\":%lld,\"pushes\":%u,\"members\":%u,\"avgSession\":%.1f,\"maxSession\":%.1f,"
+                 "\"avgPeriod\":%.1f,\"maxPeriod\":%.1f}",
+                 first ? "" : ",", (long long)(h.hour * 3600), h.pushes, h.members, h.sessionSum / h.pushes,
+                 h.sessionMax, h.periodSum / h.pushes, h.periodMax);
+        out += buf;
+        first = false;
+    }
+    out += "]}\n";
+    return out;
+}
+
+std::string TeamState::ToHtml(int64_t nowSec) const {
+    std::string out =
+        "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><meta http-equiv=\"refresh\" content=\"30\">"
+        "<title>ClaudeWatch team usage</title><style>"
+        "body{font-family:Segoe UI,sans-serif;background:#1e1e1e;color:#ddd;margin:2em}"
+        "table{border-collapse:collapse}td,th{padding:4px 12px;text-align:left}"
+        "tr:nth-child(even){background:#262626}.stale{color:#777}"
+        ".bar{display:inline-block;height:10px;background:#4caf50;vertical-align:middle}"
+        ".warn{background:#ff9800}.crit{background:#f44336}"
+        "</style></head><body><h2>ClaudeWatch team usage</h2>"
+        "<table><tr><th>User</th><th>Host</th><th>5-hour</th><th>Weekly</th><th>Updated</th></tr>";
+
+    char buf[256];
+    for (const Member* m : SortedMembers(*this)) {
+        bool stale = nowSec - m->receivedSec > staleAfterSec;
+        out += stale ? "<tr class=\"stale\"><td>" : "<tr><td>";
+        AppendHtml(out, m->latest.user);
+        out += "</td><td>";
+        AppendHtml(out, m->latest.host);
+        out += "</td>";
+        for (float pct : { m->latest.session, m->latest.period }) {
+            const char* level = pct >= 90.0f ? " crit" : (pct >= 70.0f ? " warn" : "");
+            snprintf(buf, sizeof(buf), "<td><span class=\"bar%s\" style=\"width:%dpx\"></span> %s%.0f%%</td>",
+                     level, (int)std::min(pct, 100.0f), m->latest.estimated ? "~" : "", pct);
+            out += buf;
+        }
+        int64_t ago = nowSec - m->receivedSec;
+        if (ago < 60) snprintf(buf, sizeof(buf), "<td>%llds ago</td></tr>", (long long)ago);
+        else if (ago < 3600) snprintf(buf, sizeof(buf), "<td>%lldm ago</td></tr>", (long long)(ago / 60));
+        else snprintf(buf, sizeof(buf), "<td>%lldh ago</td></tr>", (long long)(ago / 3600));
+        out += buf;
+    }
+    out += "</table><p><a href=\"/api/team\" style=\"color:#8ab4f8\">JSON</a></p></body></html>\n";
+    return out;
+}
+
+AggregatorServer::AggregatorServer() : m_listener(INVALID_SOCKET_HANDLE) {}
+
+AggregatorServer::~AggregatorServer() {
+    for (auto& entry : m_connections) CloseSocket(entry.first);
+    CloseSocket(m_listener);
+}
+
+bool AggregatorServer::Listen(const std::string& hostPort, std::string& error) {
+    std::string host;
+    uint16_t port = 0;
+    if (!ParseHostPort(hostPort, host, port)) {
+        error = "expected host:port, got '" + hostPort + "'";
+        return false;
+    }
+    if (!m_loop.Ok()) {
+        error = "can't create event loop";
+        return false;
+    }
+    m_listener = ListenTcp(host, port, error);
+    if (m_listener == INVALID_SOCKET_HANDLE) return false;
+    m_loop.Add(m_listener, EventLoop::READ, [this](uint32_t) { OnAccept(); });
+    return true;
+}
+
+void AggregatorServer::Run() {
+    int64_t lastSweep = (int64_t)time(nullptr);
+    while (!m_stop.load()) {
+        m_loop.RunOnce(1000);
+        ApplyPending();
+
+        int64_t now = (int64_t)time(nullptr);
+        if (now != lastSweep) {
+            SweepIdle(now);
+            lastSweep = now;
+        }
+    }
+}
+
+void AggregatorServer::Stop() {
+    m_stop.store(true);
+    m_loop.Wake();
+}
+
+void AggregatorServer::OnAccept() {
+    // Drain the backlog; level triggering would bring us back anyway, but
+    // a burst of connects is cheaper in one go
+    for (;;) {
+        SocketHandle s = (SocketHandle)accept(m_listener, nullptr, nullptr);
+        if (s == INVALID_SOCKET_HANDLE) return;
+        if (m_connections.size() >= maxConnections || !SetNonBlocking(s)) {
+            CloseSocket(s);
+            m_stats.rejected++;
+            continue;
+        }
+        SetNoDelay(s);
+
+        std::unique_ptr<Connection> c(new Connection());
+        c->socket = s;
+        c->lastActiveSec = (int64_t)time(nullptr);
+        m_connections[s] = std::move(c);
+        m_loop.Add(s, EventLoop::READ, [this, s](uint32_t events) { OnEvents(s, events); });
+        m_stats.connections++;
+    }
+}
+
+void AggregatorServer::OnEvents(SocketHandle s, uint32_t events) {
+    auto it = m_connections.find(s);
+    if (it == m_connections.end()) return;
+    Connection& c = *it->second;
+
+    if (events & EventLoop::WRITE) {
+        if (!FlushOutput(c)) {
+            Close(s);
+            return;
+        }
+    }
+    if (!(events & EventLoop::READ)) return;
+
+    char buf[16384];
+    for (;;) {
+        int n = (int)recv(s, buf, sizeof(buf), 0);
+        if (n > 0) {
+            c.in.append(buf, (size_t)n);
+            if (n < (int)sizeof(buf)) break;
+            continue;
+        }
+        if (n < 0 && SocketWouldBlock()) break;
+        Close(s);      // Peer closed or failed
+        return;
+    }
+    c.lastActiveSec = (int64_t)time(nullptr);
+
+    if (!ProcessInput(c)) Close(s);
+}
+
+// Handles every complete request in the buffer. False means drop the
+// connection now.
+bool AggregatorServer::ProcessInput(Connection& c) {
+    size_t start = 0;
+    while (!c.closeAfterWrite) {
+        size_t headerEnd = c.in.find("\r\n\r\n", start);
+        if (headerEnd == std::string::npos) {
+            if (c.in.size() - start > 8192) return false;
+            break;
+        }
+
+        const char* head = c.in.data() + start;
+        const char* headLimit = c.in.data() + headerEnd;
+        const char* lineEnd = std::search(head, headLimit + 2, "\r\n", "\r\n" + 2);
+
+        // Request line
+        const char* sp1 = std::find(head, lineEnd, ' ');
+        const char* sp2 = sp1 < lineEnd ? std::find(sp1 + 1, lineEnd, ' ') : lineEnd;
+        if (sp1 >= lineEnd || sp2 >= lineEnd) return false;
+        std::string method(head, sp1);
+        std::string path(sp1 + 1, sp2);
+        bool keepAlive = std::string(sp2 + 1, lineEnd) == "HTTP/1.1";
+
+        // Headers we care about
+        size_t contentLength = 0;
+        for (const char* line = lineEnd + 2; line < headLimit;) {
+            const char* end = std::search(line, headLimit + 2, "\r\n", "\r\n" + 2);
+            const char* colon = std::find(line, end, ':');
+            if (colon < end) {
+                const char* value = colon + 1;
+                while (value < end && *value == ' ') value++;
+                if (HeaderEquals(line, colon, "content-length")) {
+                    contentLength = (size_t)strtoull(std::string(value, end).c_str(), nullptr, 10);
+                } else if (HeaderEquals(line, colon, "connection")) {
+                    std::string v(value, end);
+                    if (HeaderEquals(v.data(), v.data() + v.size(), "close")) keepAlive = false;
+                    if (HeaderEquals(v.data(), v.data() + v.size(), "keep-alive")) keepAlive = true;
+                }
+            }
+            line = end + 2;
+        }
+
+        if (contentLength > maxRequestBytes) {
+            c.closeAfterWrite = true;
+            Respond(c, 413, "text/plain", "Too large\n");
+            break;
+        }
+
+        size_t bodyStart = headerEnd + 4;
+        if (c.in.size() - bodyStart < contentLength) break;     // Body still arriving
+
+        m_stats.requests++;
+        if (!keepAlive) c.closeAfterWrite = true;
+        HandleRequest(c, method, path, c.in.data() + bodyStart, contentLength);
+        start = bodyStart + contentLength;
+    }
+    c.in.erase(0, start);
+    return FlushOutput(c);
+}
+
+void AggregatorServer::HandleRequest(Connection& c, const std::string& method, const std::string& path,
+                                     const char* body, size_t bodySize) {
+    if (path == "/push") {
+        if (method != "POST") {
+            Respond(c, 405, "text/plain", "POST only\n");
+            return;
+        }
+        m_stats.pushes++;
+        size_t before = m_pending.size();
+        if (!DecodeSnapshots((const uint8_t*)body, bodySize, m_pending)) {
+            m_stats.rejected++;
+            Respond(c, 400, "text/plain", "Bad snapshot\n");
+            return;
+        }
+        m_stats.snapshots += m_pending.size() - before;
+        Respond(c, 204, nullptr, std::string());
+        return;
+    }
+
+    if (method != "GET") {
+        Respond(c, 405, "text/plain", "GET only\n");
+        return;
+    }
+
+    // Readers see everything accepted so far
+    ApplyPending();
+    int64_t now = (int64_t)time(nullptr);
+    if (path == "/" || path == "/index.html") {
+        Respond(c, 200, "text/html; charset=utf-8", m_state.ToHtml(now));
+    } else if (path == "/api/team") {
+        Respond(c, 200, "application/json", m_state.ToJson(now));
+    } else if (path == "/api/stats") {
+        Respond(c, 200, "application/json", StatsJson());
+    } else {
+        Respond(c, 404, "text/plain", "Not found\n");
+    }
+}
+
+void AggregatorServer::Respond(Connection& c, int status, const char* contentType, const std::string& body) {
+    char head[256];
+    int n;
+    if (contentType) {
+        n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                     status, StatusText(status), contentType, body.size(),
+                     c.closeAfterWrite ? "Connection: close\r\n" : "");
+    } else {
+        n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\n%s\r\n", status, StatusText(status),
+                     c.closeAfterWrite ? "Connection: close\r\n" : "");
+    }
+    c.out.append(head, (size_t)n);
+    c.out += body;
+}
+
+bool AggregatorServer::FlushOutput(Connection& c) {
+    while (c.outSent < c.out.size()) {
+        int n = (int)send(c.socket, c.out.data() + c.outSent, (int)(c.out.size() - c.outSent), 0);
+        if (n > 0) {
+            c.outSent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && SocketWouldBlock()) {
+            m_loop.Modify(c.socket, EventLoop::READ | EventLoop::WRITE);
+            return true;
+        }
+        return false;
+    }
+    if (!c.out.empty()) {
+        c.out.clear();
+        c.outSent = 0;
+        m_loop.Modify(c.socket, EventLoop::READ);
+    }
+    return !c.closeAfterWrite;
+}
+
+void AggregatorServer::Close(SocketHandle s) {
+    m_loop.Remove(s);
+    m_connections.erase(s);
+    CloseSocket(s);
+}
+
+void AggregatorServer::ApplyPending() {
+    if (m_pending.empty()) return;
+    m_stats.rejected += m_state.Ingest(m_pending.data(), m_pending.size(), (int64_t)time(nullptr));
+    m_pending.clear();
+    m_stats.batches++;
+}
+
+void AggregatorServer::SweepIdle(int64_t nowSec) {
+    std::vector<SocketHandle> idle;
+    for (const auto& entry : m_connections) {
+        if (nowSec - entry.second->lastActiveSec > idleTimeoutSec) idle.push_back(entry.first);
+    }
+    for (SocketHandle s : idle) Close(s);
+
+    m_state.Forget(nowSec);
+}
+
+std::string AggregatorServer::StatsJson() const {
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+             "{\"connections\":%llu,\"open\":%zu,\"requests\":%llu,\"pushes\":%llu,\"snapshots\":%llu,"
+             "\"batches\":%llu,\"rejected\":%llu,\"members\":%zu}\n",
+             (unsigned long long)m_stats.connections, m_connections.size(), (unsigned long long)m_stats.requests,
+             (unsigned long long)m_stats.pushes, (unsigned long long)m_stats.snapshots,
+             (unsigned long long)m_stats.batches, (unsigned long long)m_stats.rejected, m_state.MemberCount());
+    return buf;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "event_loop.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What a widget pushes after each successful poll
+struct UsageSnapshot {
+    std::string user;               // UTF-8, at most 255 bytes
+    std::string host;
+    int64_t time = 0;               // Unix seconds, client clock
+    float session = 0.0f;           // five_hour utilization
+    float period = 0.0f;            // seven_day utilization
+    int64_t sessionResetMs = 0;     // Unix ms, 0 = unknown
+    int64_t periodResetMs = 0;
+    bool estimated = false;
+};
+
+// Wire format: little-endian records, any number back to back in one push.
+//   u32 magic "CWS1", u16 record length, u8 flags, u8 user length,
+//   u8 host length, i64 time, f32 session, f32 period, i64 session reset,
+//   i64 period reset, user bytes, host bytes
+// The length prefix lets newer clients append fields older servers skip.
+void EncodeSnapshot(const UsageSnapshot& snapshot, std::vector<uint8_t>& out);
+
+// Appends every record in data to out; false at the first malformed one
+// (records before it are kept)
+bool DecodeSnapshots(const uint8_t* data, size_t size, std::vector<UsageSnapshot>& out);
+
+// Latest state per member plus team-wide hourly rollups for the last week.
+// Not thread-safe; owned by the server's loop thread.
+class TeamState {
+public:
+    static constexpr size_t HOURS = 168;
+    int64_t staleAfterSec = 30 * 60;    // Members quiet this long don't count as active
+    size_t maxMembers = 10000;          // Pushes from anyone new past this are refused
+
+    struct Member {
+        UsageSnapshot latest;
+        int64_t receivedSec = 0;
+        uint64_t pushes = 0;
+        int64_t lastHour = -1;          // Hour this member was last counted in
+    };
+
+    struct HourRollup {
+        int64_t hour = -1;              // Unix hour index; -1 = empty slot
+        uint32_t pushes = 0;
+        uint32_t members = 0;           // Distinct members that pushed
+        double sessionSum = 0.0;
+        float sessionMax = 0.0f;
+        double periodSum = 0.0;
+        float periodMax = 0.0f;
+    };
+
+    // One pass over a batch, all stamped with the same receive time.
+    // Snapshots older than what a member already reported are dropped.
+    // Returns how many were refused because the member table is full.
+    size_t Ingest(const UsageSnapshot* batch, size_t count, int64_t nowSec);
+
+    // Drops members that haven't pushed within the rollup window; returns
+    // how many
+    size_t Forget(int64_t nowSec);
+
+    size_t MemberCount() const { return m_members.size(); }
+    const std::unordered_map<std::string, Member>& Members() const { return m_members; }
+
+    // Most recent hour last, empty hours left out
+    std::vector<HourRollup> Hours(int64_t nowSec) const;
+
+    std::string ToJson(int64_t nowSec) const;
+    std::string ToHtml(int64_t nowSec) const;
+
+private:
+    std::unordered_map<std::string, Member> m_members;     // Keyed "user\nhost"
+    HourRollup m_hours[HOURS];
+};
+
+// Small HTTP/1.1 service for a LAN: widgets POST snapshots to /push, people
+// read / (HTML), /api/team (JSON) and /api/stats. Keep-alive and pipelining
+// are supported; pushes are decoded as they arrive and applied to the state
+// in one batch per loop iteration, so a burst of pushes costs one pass.
+class AggregatorServer {
+public:
+    size_t maxRequestBytes = 64 * 1024;
+    size_t maxConnections = 8192;
+    int64_t idleTimeoutSec = 60;
+
+    struct Stats {
+        uint64_t connections = 0;       // Accepted, total
+        uint64_t requests = 0;
+        uint64_t pushes = 0;            // POST /push requests
+        uint64_t snapshots = 0;         // Records ingested
+        uint64_t batches = 0;           // Ingest passes
+        uint64_t rejected = 0;          // Bad requests and records, new members past the cap
+    };
+
+    AggregatorServer();
+    ~AggregatorServer();
+
+    // "host:port"; ":port" listens on all interfaces
+    bool Listen(const std::string& hostPort, std::string& error);
+
+    // Serve until Stop()
+    void Run();
+
+    // Any thread (and async-signal-safe on Linux)
+    void Stop();
+
+    const TeamState& State() const { return m_state; }
+    const Stats& GetStats() const { return m_stats; }
+    size_t OpenConnections() const { return m_connections.size(); }
+
+private:
+    struct Connection {
+        SocketHandle socket;
+        std::string in;
+        std::string out;
+        size_t outSent = 0;
+        int64_t lastActiveSec = 0;
+        bool closeAfterWrite = false;
+    };
+
+    void OnAccept();
+    void OnEvents(SocketHandle s, uint32_t events);
+    bool ProcessInput(Connection& c);
+    void HandleRequest(Connection& c, const std::string& method, const std::string& path,
+                       const char* body, size_t bodySize);
+    void Respond(Connection& c, int status, const char* contentType, const std::string& body);
+    bool FlushOutput(Connection& c);
+    void Close(SocketHandle s);
+    void ApplyPending();
+    void SweepIdle(int64_t nowSec);
+    std::string StatsJson() const;
+
+    EventLoop m_loop;
+    SocketHandle m_listener;
+    std::unordered_map<SocketHandle, std::unique_ptr<Connection>> m_connections;
+    std::vector<UsageSnapshot> m_pending;
+    TeamState m_state;
+    Stats m_stats;
+    std::atomic<bool> m_stop{ false };
+};
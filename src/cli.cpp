@@ -0,0 +1,467 @@
+#include "cli.h"
+#include "aggregator.h"
+#include "file_util.h"
+#include "history.h"
+#include "history_query.h"
+#include "simulate.h"
+#include "socket_util.h"
+#include "subscribe.h"
+#include "timeutil.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <signal.h>
+#include <sys/socket.h>
+#endif
+
+namespace {
+
+const char* const HISTORY_USAGE =
+    "usage: claudewatch history [options]\n"
+    "  --from T          Start of range (inclusive)\n"
+    "  --to T            End of range (exclusive)\n"
+    "                    T is YYYY-MM-DD (local midnight), an ISO-8601 time,\n"
+    "                    or an age like 30d / 12h\n"
+    "  --group G         hour (of day) | day | weekday\n"
+    "  --series S        session (5-hour, default) | period (7-day)\n"
+    "  --threshold N     Count climbs to N% or above\n"
+    "  --format F        table (default) | csv | json\n"
+    "  --utc             Group by UTC instead of local time\n"
+    "  --file PATH       History file (default: history.bin in the data folder)\n";
+
+const char* const VALUE_OPTIONS = "--from --to --group --series --threshold --format --file ";
+
+bool ParseTimeArg(const char* text, int64_t nowSec, int32_t utcOffsetSec, int64_t& out) {
+    size_t len = strlen(text);
+    if (len == 0) return false;
+
+    // Age: "30d", "12h"
+    char unit = text[len - 1];
+    if (unit == 'd' || unit == 'h') {
+        char* end = nullptr;
+        long long n = strtoll(text, &end, 10);
+        if (end != text + len - 1 || n < 0) return false;
+        out = nowSec - n * (unit == 'd' ? 86400 : 3600);
+        return true;
+    }
+
+    // Date alone: local midnight
+    if (len == 10) {
+        std::string full = std::string(text) + "T00:00:00Z";
+        int64_t ms;
+        if (!ParseIso8601(full, ms)) return false;
+        out = ms / 1000 - utcOffsetSec;
+        return true;
+    }
+
+    int64_t ms;
+    if (!ParseIso8601(text, len, ms)) return false;
+    out = ms / 1000;
+    return true;
+}
+
+int RunHistory(int argc, char** argv) {
+    HistoryQuery query;
+    HistorySeries series = HistorySeries::Session;
+    QueryFormat format = QueryFormat::Table;
+    std::filesystem::path file;
+    bool utc = false;
+    const char* fromArg = nullptr;
+    const char* toArg = nullptr;
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool takesValue = true;
+
+        if (strcmp(arg, "--utc") == 0) {
+            utc = true;
+            takesValue = false;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            fputs(HISTORY_USAGE, stdout);
+            return 0;
+        } else if (strncmp(arg, "--", 2) != 0 || !strstr(VALUE_OPTIONS, (std::string(arg) + " ").c_str())) {
+            fprintf(stderr, "claudewatch: unknown option '%s'\n%s", arg, HISTORY_USAGE);
+            return 2;
+        } else if (!value) {
+            fprintf(stderr, "claudewatch: %s needs a value\n", arg);
+            return 2;
+        } else if (strcmp(arg, "--from") == 0) {
+            fromArg = value;
+        } else if (strcmp(arg, "--to") == 0) {
+            toArg = value;
+        } else if (strcmp(arg, "--group") == 0) {
+            if (strcmp(value, "hour") == 0) query.group = QueryGroup::Hour;
+            else if (strcmp(value, "day") == 0) query.group = QueryGroup::Day;
+            else if (strcmp(value, "weekday") == 0) query.group = QueryGroup::Weekday;
+            else if (strcmp(value, "none") == 0) query.group = QueryGroup::None;
+            else {
+                fprintf(stderr, "claudewatch: unknown group '%s'\n", value);
+                return 2;
+            }
+        } else if (strcmp(arg, "--series") == 0) {
+            if (strcmp(value, "session") == 0) series = HistorySeries::Session;
+            else if (strcmp(value, "period") == 0) series = HistorySeries::Period;
+            else {
+                fprintf(stderr, "claudewatch: unknown series '%s'\n", value);
+                return 2;
+            }
+        } else if (strcmp(arg, "--threshold") == 0) {
+            char* end = nullptr;
+            query.threshold = strtof(value, &end);
+            if (end == value || *end) {
+                fprintf(stderr, "claudewatch: bad threshold '%s'\n", value);
+                return 2;
+            }
+            query.useThreshold = true;
+        } else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "table") == 0) format = QueryFormat::Table;
+            else if (strcmp(value, "csv") == 0) format = QueryFormat::Csv;
+            else if (strcmp(value, "json") == 0) format = QueryFormat::Json;
+            else {
+                fprintf(stderr, "claudewatch: unknown format '%s'\n", value);
+                return 2;
+            }
+        } else if (strcmp(arg, "--file") == 0) {
+            file = std::filesystem::u8path(value);
+        }
+        if (takesValue) i++;
+    }
+
+    // Boundaries follow the offset in effect now; a DST change inside the
+    // range shifts buckets on the far side of it by an hour
+    time_t now = time(nullptr);
+    query.utcOffsetSec = utc ? 0 : LocalUtcOffset((int64_t)now);
+    if (fromArg && !ParseTimeArg(fromArg, (int64_t)now, query.utcOffsetSec, query.from)) {
+        fprintf(stderr, "claudewatch: bad time '%s'\n", fromArg);
+        return 2;
+    }
+    if (toArg && !ParseTimeArg(toArg, (int64_t)now, query.utcOffsetSec, query.to)) {
+        fprintf(stderr, "claudewatch: bad time '%s'\n", toArg);
+        return 2;
+    }
+
+    if (file.empty()) {
+        std::filesystem::path dir = GetDataDir();
+        if (dir.empty()) {
+            fputs("claudewatch: no data folder; pass --file\n", stderr);
+            return 1;
+        }
+        file = dir / "history.bin";
+    }
+
+    std::vector<uint8_t> data;
+    HistoryStore store;
+    if (!ReadFileBytes(file, data) || !store.Deserialize(data)) {
+        fprintf(stderr, "claudewatch: can't read history from %s\n", file.u8string().c_str());
+        return 1;
+    }
+
+    HistoryTable table = HistoryTable::FromStore(store, series);
+    std::string out = FormatQueryResult(RunHistoryQuery(table, query), query, series, format);
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
+
+const char* const SIMULATE_USAGE =
+    "usage: claudewatch simulate [options]\n"
+    "  --days N          Whole days of synthetic trace (default 90)\n"
+    "  --seed N          Seed for the trace and the injected faults (default 1)\n"
+    "  --file PATH       Replay this history file instead of a synthetic trace\n"
+    "  --policy P        smart | smart:MIN:MAX | fixed:SEC, repeatable\n"
+    "                    (default: smart, smart:60:300, fixed:60, fixed:600)\n"
+    "  --threshold N     Crossing to detect, in % (default 80)\n"
+    "  --offline P       Chance a request times out (0..1)\n"
+    "  --server-error P  Chance a request gets a 5xx\n"
+    "  --auth-error P    Chance a request gets a 401\n"
+    "  --no-org P        Chance an org listing has no org to pick\n"
+    "  --outages N       Network outages per day, with change events\n"
+    "  --outage-minutes N  Length of each outage (default 30)\n"
+    "  --clock-steps N   Wall-clock changes per day: an hour ahead, then back\n"
+    "  --sleeps N        Unannounced hour-long suspends per day\n"
+    "  --latency MS      Per-request latency (default 400)\n"
+    "  --away H-H        Local hours with no user input, e.g. 22-7\n"
+    "  --format F        table (default) | csv | json\n"
+    "  --utc             Lay out the synthetic day in UTC\n";
+
+const char* const SIMULATE_VALUE_OPTIONS =
+    "--days --seed --file --policy --threshold --offline --server-error --auth-error --no-org --outages "
+    "--outage-minutes --clock-steps --sleeps --latency --away --format ";
+
+bool ParseNumberArg(const char* text, double low, double high, double& out) {
+    char* end = nullptr;
+    out = strtod(text, &end);
+    return end != text && !*end && out >= low && out <= high;
+}
+
+int RunSimulate(int argc, char** argv) {
+    std::vector<RefreshPolicy> policies;
+    FaultModel faults;
+    QueryFormat format = QueryFormat::Table;
+    std::filesystem::path file;
+    bool utc = false;
+    int days = 90;
+    double seed = 1, threshold = 80;
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool takesValue = true;
+        double number = 0;
+
+        if (strcmp(arg, "--utc") == 0) {
+            utc = true;
+            takesValue = false;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            fputs(SIMULATE_USAGE, stdout);
+            return 0;
+        } else if (strncmp(arg, "--", 2) != 0 ||
+                   !strstr(SIMULATE_VALUE_OPTIONS, (std::string(arg) + " ").c_str())) {
+            fprintf(stderr, "claudewatch: unknown option '%s'\n%s", arg, SIMULATE_USAGE);
+            return 2;
+        } else if (!value) {
+            fprintf(stderr, "claudewatch: %s needs a value\n", arg);
+            return 2;
+        } else if (strcmp(arg, "--file") == 0) {
+            file = std::filesystem::u8path(value);
+        } else if (strcmp(arg, "--policy") == 0) {
+            RefreshPolicy policy;
+            if (!RefreshPolicy::Parse(value, policy)) {
+                fprintf(stderr, "claudewatch: bad policy '%s'\n", value);
+                return 2;
+            }
+            policies.push_back(policy);
+        } else if (strcmp(arg, "--days") == 0) {
+            // The synthetic trace is built a whole day at a time
+            char* end = nullptr;
+            long n = strtol(value, &end, 10);
+            if (end == value || *end || n < 1 || n > 36500) {
+                fprintf(stderr, "claudewatch: --days needs a whole number from 1 to 36500, not '%s'\n", value);
+                return 2;
+            }
+            days = (int)n;
+        } else if (strcmp(arg, "--away") == 0) {
+            if (sscanf(value, "%d-%d", &faults.awayFrom, &faults.awayTo) != 2 || faults.awayFrom < 0 ||
+                faults.awayFrom > 23 || faults.awayTo < 0 || faults.awayTo > 23) {
+                fprintf(stderr, "claudewatch: bad hours '%s'\n", value);
+                return 2;
+            }
+        } else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "table") == 0) format = QueryFormat::Table;
+            else if (strcmp(value, "csv") == 0) format = QueryFormat::Csv;
+            else if (strcmp(value, "json") == 0) format = QueryFormat::Json;
+            else {
+                fprintf(stderr, "claudewatch: unknown format '%s'\n", value);
+                return 2;
+            }
+        } else {
+            // The rest are plain numbers
+            bool isProbability = strcmp(arg, "--offline") == 0 || strcmp(arg, "--server-error") == 0 ||
+                                 strcmp(arg, "--auth-error") == 0 || strcmp(arg, "--no-org") == 0;
+            if (!ParseNumberArg(value, 0, isProbability ? 1 : 1e9, number)) {
+                fprintf(stderr, "claudewatch: bad value '%s' for %s\n", value, arg);
+                return 2;
+            }
+            if (strcmp(arg, "--seed") == 0) seed = number;
+            else if (strcmp(arg, "--threshold") == 0) threshold = number;
+            else if (strcmp(arg, "--offline") == 0) faults.offline = number;
+            else if (strcmp(arg, "--server-error") == 0) faults.serverError = number;
+            else if (strcmp(arg, "--auth-error") == 0) faults.authError = number;
+            else if (strcmp(arg, "--no-org") == 0) faults.noOrg = number;
+            else if (strcmp(arg, "--outages") == 0) faults.outagesPerDay = number;
+            else if (strcmp(arg, "--outage-minutes") == 0) faults.outageMinutes = (uint32_t)number;
+            else if (strcmp(arg, "--clock-steps") == 0) faults.clockStepsPerDay = number;
+            else if (strcmp(arg, "--sleeps") == 0) faults.sleepsPerDay = number;
+            else if (strcmp(arg, "--latency") == 0) faults.latencyMs = (uint32_t)number;
+        }
+        if (takesValue) i++;
+    }
+
+    if (policies.empty()) {
+        for (const char* name : { "smart", "smart:60:300", "fixed:60", "fixed:600" }) {
+            RefreshPolicy policy;
+            RefreshPolicy::Parse(name, policy);
+            policies.push_back(policy);
+        }
+    }
+    faults.seed = (uint32_t)seed;
+    faults.utcOffsetSec = utc ? 0 : LocalUtcOffset((int64_t)time(nullptr));
+
+    UsageTrace trace;
+    if (file.empty()) {
+        trace = UsageTrace::Synthetic(days, faults.seed, faults.utcOffsetSec);
+    } else {
+        std::vector<uint8_t> data;
+        HistoryStore store;
+        if (!ReadFileBytes(file, data) || !store.Deserialize(data)) {
+            fprintf(stderr, "claudewatch: can't read history from %s\n", file.u8string().c_str());
+            return 1;
+        }
+        trace = UsageTrace::FromHistory(store);
+    }
+    if (trace.points.size() < 2) {
+        fputs("claudewatch: nothing to simulate\n", stderr);
+        return 1;
+    }
+
+    std::vector<SimulationReport> reports;
+    clock_t started = clock();
+    for (const RefreshPolicy& policy : policies) {
+        reports.push_back(RunSimulation(trace, policy, faults, (float)threshold));
+    }
+    double cpuSec = (double)(clock() - started) / CLOCKS_PER_SEC;
+
+    std::string out = FormatSimulationReport(reports, (float)threshold, format);
+    fwrite(out.data(), 1, out.size(), stdout);
+    double simulated = reports[0].days * (double)reports.size();
+    fprintf(stderr, "claudewatch: simulated %.0f days in %.3f s CPU (%.0f days/s)\n", simulated, cpuSec,
+            cpuSec > 0 ? simulated / cpuSec : 0.0);
+    return 0;
+}
+
+const char* const AGGREGATE_USAGE =
+    "usage: claudewatch aggregate [--listen HOST:PORT]\n"
+    "  Collect usage pushed by widgets (Aggregator Url in their config.ini)\n"
+    "  and serve the combined view at / (HTML) and /api/team (JSON).\n"
+    "  --listen          Address to listen on (default :8787, all interfaces)\n";
+
+AggregatorServer* g_server = nullptr;
+
+#ifdef _WIN32
+BOOL WINAPI OnConsoleCtrl(DWORD) {
+    if (g_server) g_server->Stop();
+    return TRUE;
+}
+#else
+void OnSignal(int) {
+    if (g_server) g_server->Stop();
+}
+#endif
+
+int RunAggregate(int argc, char** argv) {
+    std::string listen = ":8787";
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+            listen = argv[++i];
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            fputs(AGGREGATE_USAGE, stdout);
+            return 0;
+        } else {
+            fprintf(stderr, "claudewatch: unknown option '%s'\n%s", argv[i], AGGREGATE_USAGE);
+            return 2;
+        }
+    }
+
+    AggregatorServer server;
+    std::string error;
+    if (!server.Listen(listen, error)) {
+        fprintf(stderr, "claudewatch: %s\n", error.c_str());
+        return 1;
+    }
+
+    g_server = &server;
+#ifdef _WIN32
+    SetConsoleCtrlHandler(OnConsoleCtrl, TRUE);
+#else
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+#endif
+    fprintf(stderr, "claudewatch: aggregating on %s (Ctrl+C to stop)\n", listen.c_str());
+    server.Run();
+    g_server = nullptr;
+
+    const AggregatorServer::Stats& stats = server.GetStats();
+    fprintf(stderr, "claudewatch: %llu pushes, %llu snapshots from %zu members\n",
+            (unsigned long long)stats.pushes, (unsigned long long)stats.snapshots, server.State().MemberCount());
+    return 0;
+}
+
+const char* const SUBSCRIBE_USAGE =
+    "usage: claudewatch subscribe [--socket PATH] [--count N]\n"
+    "  Print live usage from a running widget or claudewatchd, one JSON object\n"
+    "  per line: a snapshot, then a delta whenever something changes and a\n"
+    "  reset when a window rolls over.\n"
+    "  --socket PATH     Socket to read (default: claudewatch.sock in the data folder)\n"
+    "  --count N         Exit after N lines\n";
+
+int RunSubscribe(int argc, char** argv) {
+    std::string path = SubscriptionHub::DefaultPath();
+    long count = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            char* end = nullptr;
+            count = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end || count < 1) {
+                fprintf(stderr, "claudewatch: bad count '%s'\n", argv[i]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            fputs(SUBSCRIBE_USAGE, stdout);
+            return 0;
+        } else {
+            fprintf(stderr, "claudewatch: unknown option '%s'\n%s", argv[i], SUBSCRIBE_USAGE);
+            return 2;
+        }
+    }
+
+    InitSockets();
+    std::string error;
+    SocketHandle s = ConnectUnix(path, error);
+    if (s == INVALID_SOCKET_HANDLE) {
+        fprintf(stderr, "claudewatch: %s\n", error.c_str());
+        return 1;
+    }
+
+    // Pass lines through as they arrive; flushed so pipes see them at once
+    char buf[4096];
+    long lines = 0;
+    for (;;) {
+        int n = (int)recv(s, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        const char* p = buf;
+        const char* end = buf + n;
+        while (p < end) {
+            const char* nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+            const char* stop = nl ? nl + 1 : end;
+            fwrite(p, 1, (size_t)(stop - p), stdout);
+            p = stop;
+            if (nl && count && ++lines >= count) {
+                fflush(stdout);
+                CloseSocket(s);
+                return 0;
+            }
+        }
+        fflush(stdout);
+    }
+    CloseSocket(s);
+    fputs("claudewatch: publisher went away\n", stderr);
+    return 1;
+}
+
+} // namespace
+
+bool IsCliCommand(const char* arg) {
+    return arg && (strcmp(arg, "history") == 0 || strcmp(arg, "simulate") == 0 ||
+                   strcmp(arg, "subscribe") == 0 || strcmp(arg, "aggregate") == 0);
+}
+
+int RunCli(int argc, char** argv) {
+    if (argc < 2 || !IsCliCommand(argv[1])) {
+        fputs("usage: claudewatch history|simulate|subscribe|aggregate [options]    (--help for options)\n", stderr);
+        return 2;
+    }
+    if (strcmp(argv[1], "aggregate") == 0) return RunAggregate(argc, argv);
+    if (strcmp(argv[1], "simulate") == 0) return RunSimulate(argc, argv);
+    if (strcmp(argv[1], "subscribe") == 0) return RunSubscribe(argc, argv);
+    return RunHistory(argc, argv);
+}
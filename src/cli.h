@@ -0,0 +1,18 @@
+#pragma once
+
+// Headless subcommands:
+//   claudewatch history [--from T] [--to T] [--group hour|day|weekday]
+//                       [--series session|period] [--threshold N]
+//                       [--format table|csv|json] [--utc] [--file PATH]
+//   claudewatch simulate [--days N] [--seed N] [--file PATH] [--policy P]...
+//                        [--threshold N] [--offline P] [--server-error P]
+//                        [--auth-error P] [--outages N] [--away H-H]
+//                        [--format table|csv|json] [--utc]
+//   claudewatch subscribe [--socket PATH] [--count N]
+//   claudewatch aggregate [--listen HOST:PORT]
+// argv[0] is the program, argv[1] the subcommand; arguments are UTF-8.
+// Writes to stdout/stderr and returns the process exit code.
+int RunCli(int argc, char** argv);
+
+// Whether argv[1] names a subcommand rather than a GUI option
+bool IsCliCommand(const char* arg);
@@ -0,0 +1,7 @@
+// Entry point for the headless build (non-Windows); the Windows GUI
+// executable dispatches the same subcommands from wWinMain
+#include "cli.h"
+
+int main(int argc, char** argv) {
+    return RunCli(argc, argv);
+}
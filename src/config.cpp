@@ -118,6 +118,7 @@ bool ConfigManager::Load() {
     } else {
         m_config.sessionCookie = ReadString(L"Auth", L"SessionCookie", L"");
     }
+    m_config.organization = ReadString(L"Auth", L"Organization", L"");
 
     // Window
     m_config.posX = ReadInt(L"Window", L"PosX", 100);
@@ -129,9 +130,18 @@ bool ConfigManager::Load() {
     m_config.smartRefresh = ReadInt(L"Refresh", L"SmartRefresh", 1) != 0;
     m_config.minIntervalSec = ReadInt(L"Refresh", L"MinIntervalSec", 60);
     m_config.maxIntervalSec = ReadInt(L"Refresh", L"MaxIntervalSec", 600);
+    m_config.localEstimate = ReadInt(L"Refresh", L"LocalEstimate", 1) != 0;
 
     // Display
     m_config.showResetTime = ReadInt(L"Display", L"ShowResetTime", 1) != 0;
+    m_config.trayMode = ReadInt(L"Display", L"TrayMode", 0) != 0;
+
+    // Aggregator
+    m_config.aggregatorUrl = ReadString(L"Aggregator", L"Url", L"");
+    m_config.aggregatorUser = ReadString(L"Aggregator", L"User", L"");
+
+    // Subscriptions
+    m_config.subscribe = ReadInt(L"Subscribe", L"Enabled", 1) != 0;
 
     return true;
 }
@@ -143,6 +153,7 @@ bool ConfigManager::Save() {
     // Auth - always write encrypted, clear plaintext key
     WriteString(L"Auth", L"SessionCookieEnc", EncryptString(m_config.sessionCookie));
     WriteString(L"Auth", L"SessionCookie", L"");
+    WriteString(L"Auth", L"Organization", m_config.organization);
 
     // Window
     WriteInt(L"Window", L"PosX", m_config.posX);
@@ -154,9 +165,18 @@ bool ConfigManager::Save() {
     WriteInt(L"Refresh", L"SmartRefresh", m_config.smartRefresh ? 1 : 0);
     WriteInt(L"Refresh", L"MinIntervalSec", m_config.minIntervalSec);
     WriteInt(L"Refresh", L"MaxIntervalSec", m_config.maxIntervalSec);
+    WriteInt(L"Refresh", L"LocalEstimate", m_config.localEstimate ? 1 : 0);
 
     // Display
     WriteInt(L"Display", L"ShowResetTime", m_config.showResetTime ? 1 : 0);
+    WriteInt(L"Display", L"TrayMode", m_config.trayMode ? 1 : 0);
+
+    // Aggregator
+    WriteString(L"Aggregator", L"Url", m_config.aggregatorUrl);
+    WriteString(L"Aggregator", L"User", m_config.aggregatorUser);
+
+    // Subscriptions
+    WriteInt(L"Subscribe", L"Enabled", m_config.subscribe ? 1 : 0);
 
     return true;
 }
@@ -6,6 +6,7 @@
 struct Config {
     // Auth
     std::wstring sessionCookie;
+    std::wstring organization;      // Pinned org, uuid or name - empty picks the first with chat access
 
     // Window
     int posX = 100;
@@ -17,9 +18,18 @@ struct Config {
     bool smartRefresh = true;
     int minIntervalSec = 60;
     int maxIntervalSec = 600;
+    bool localEstimate = true;  // Extrapolate between polls from Claude Code session logs
 
     // Display
     bool showResetTime = true;
+    bool trayMode = false;      // Notification-area icon instead of a floating widget
+
+    // Team aggregator (claudewatch aggregate)
+    std::wstring aggregatorUrl;     // e.g. http://teamhost:8787 - empty disables pushes
+    std::wstring aggregatorUser;    // Name shown to the team; defaults to the Windows user
+
+    // Local subscribers (claudewatch subscribe, status bars) over claudewatch.sock
+    bool subscribe = true;
 };
 
 class ConfigManager {
@@ -33,6 +43,7 @@ public:
     const Config& Get() const { return m_config; }
 
     std::wstring GetConfigPath() const { return m_configPath; }
+    std::wstring GetConfigDir() const { return m_configDir; }
 
 private:
     std::wstring m_configPath;
@@ -0,0 +1,534 @@
+// claudewatchd: the widget's fetch -> parse -> schedule core without the
+// widget, for Linux hosts. Polls on the smart-refresh cadence and again once
+// a reset time passes or the clock jumps, appends to history.bin, keeps
+// latest.json current and logs one logfmt line per event to stdout (run it
+// under systemd or similar). Local tools can follow the numbers live on
+// claudewatch.sock in the state directory. While offline, an rtnetlink
+// watcher cuts the retry backoff short when a route comes back.
+//   SIGTERM/SIGINT  stop (an in-flight fetch is cancelled)
+//   SIGHUP          re-read the cookie and poll now
+//   SIGUSR1         write a Chrome trace to the state directory
+#include "aggregator.h"
+#include "file_util.h"
+#include "history.h"
+#include "http_client.h"
+#include "net_watch.h"
+#include "org_directory.h"
+#include "parser.h"
+#include "refresh.h"
+#include "refresh_controller.h"
+#include "scheduler.h"
+#include "subscribe.h"
+#include "event_loop.h"
+#include "text_util.h"
+#include "timeutil.h"
+#include "trace.h"
+#include "workers.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+
+#include <signal.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const USAGE =
+    "usage: claudewatchd [options]\n"
+    "  --cookie-file PATH  sessionKey cookie (default: $CLAUDEWATCH_COOKIE, else\n"
+    "                      the 'cookie' file in the state directory)\n"
+    "  --state-dir DIR     history.bin / latest.json (default ~/.config/claudewatch)\n"
+    "  --api URL           API base (default https://claude.ai)\n"
+    "  --org ORG           Poll this organization (uuid or name) if the account\n"
+    "                      has several (default: the first with chat access)\n"
+    "  --min-interval S    Poll interval when usage is high (default 60)\n"
+    "  --max-interval S    Poll interval when usage is low (default 600)\n"
+    "  --fixed             Always poll at --max-interval\n"
+    "  --push URL          Also push each snapshot to a team aggregator\n"
+    "  --socket PATH       Serve live updates here (default: claudewatch.sock in\n"
+    "                      the state directory)\n"
+    "  --no-socket         Don't serve live updates\n"
+    "  --debug-dump        Keep the last response in debug_response.txt\n"
+    "  --once              Poll once and exit (status 0 on success)\n";
+
+constexpr uint64_t COMPACT_INTERVAL_MS = 15 * 60 * 1000;
+constexpr uint32_t RETRY_BASE_MS = 30 * 1000;
+
+enum : DeadlineScheduler::TaskId {
+    TASK_COMPACT = RefreshController::FIRST_HOST_TASK,
+};
+
+struct DaemonOptions {
+    std::filesystem::path cookieFile;
+    std::filesystem::path stateDir;
+    std::wstring apiBase = DEFAULT_API_BASE;
+    std::string org;
+    uint32_t minIntervalSec = 60;
+    uint32_t maxIntervalSec = 600;
+    bool smart = true;
+    std::string pushUrl;
+    std::string socketPath;
+    bool subscribe = true;
+    bool debugDump = false;
+    bool once = false;
+};
+
+DaemonOptions g_opt;
+EventLoop* g_loop = nullptr;
+volatile sig_atomic_t g_stopSignal = 0;
+volatile sig_atomic_t g_reloadSignal = 0;
+volatile sig_atomic_t g_traceSignal = 0;
+
+// Workers hold their own references; see StartRefresh
+std::shared_ptr<HttpClient> g_http = std::make_shared<HttpClient>();
+WorkerGroup g_workers;          // Cancelled and joined before main() returns
+std::atomic<bool> g_pushing{ false };
+CancelToken g_pushCancel = std::make_shared<std::atomic<bool>>(false);
+DeadlineScheduler g_scheduler;
+RefreshController g_refresh(g_scheduler);   // Polling, org, reconnect and reset deadlines
+HistoryStore g_history;
+std::wstring g_cookie;
+uint32_t g_failures = 0;
+uint32_t g_nextPollMs = 0;      // Interval the last result asked for
+int g_exitCode = 0;
+SubscriptionHub g_hub;
+NetworkWatcher g_netWatcher;
+UsageState g_published;         // Last state handed to g_hub
+
+// Worker -> loop hand-off; a cancelled run can land after its replacement
+std::mutex g_doneLock;
+std::vector<RefreshResult> g_done;
+
+// The controller's clock: counts through suspend, so a deadline that passed
+// while asleep is due at once
+uint64_t NowMs() {
+    return SampleClocks().bootMs;
+}
+
+// "time=2026-03-01T12:00:00Z level=info msg=... key=value ..."
+void Log(const char* level, const char* format, ...) {
+    char stamp[32];
+    time_t now = time(nullptr);
+    tm utc;
+    gmtime_r(&now, &utc);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+    char line[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    printf("time=%s level=%s %s\n", stamp, level, line);
+    fflush(stdout);
+}
+
+// Resident set, from /proc; 0 where that doesn't exist
+long RssKb() {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    long pages = 0, resident = 0;
+    int got = fscanf(f, "%ld %ld", &pages, &resident);
+    fclose(f);
+    return got == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+}
+
+void OnSignal(int sig) {
+    if (sig == SIGHUP) g_reloadSignal = 1;
+    else if (sig == SIGUSR1) g_traceSignal = 1;
+    else g_stopSignal = 1;
+    if (g_loop) g_loop->Wake();     // One write(); async-signal-safe
+}
+
+bool LoadCookie() {
+    std::string cookie;
+    const char* env = getenv("CLAUDEWATCH_COOKIE");
+    if (g_opt.cookieFile.empty() && env && *env) {
+        cookie = env;
+    } else {
+        std::vector<uint8_t> data;
+        std::filesystem::path path = g_opt.cookieFile.empty() ? g_opt.stateDir / "cookie" : g_opt.cookieFile;
+        if (!ReadFileBytes(path, data)) {
+            Log("error", "msg=\"can't read cookie\" path=\"%s\"", path.string().c_str());
+            return false;
+        }
+        cookie.assign(data.begin(), data.end());
+    }
+
+    // Tolerate a pasted "sessionKey=..." and trailing newlines
+    while (!cookie.empty() && (cookie.back() == '\n' || cookie.back() == '\r' || cookie.back() == ' ')) {
+        cookie.pop_back();
+    }
+    if (cookie.compare(0, 11, "sessionKey=") == 0) cookie.erase(0, 11);
+    if (cookie.empty()) {
+        Log("error", "msg=\"empty cookie\"");
+        return false;
+    }
+
+    std::wstring wide = Utf8ToWide(cookie);
+    if (wide != g_cookie) g_refresh.ForgetOrg();
+    g_cookie = wide;
+    return true;
+}
+
+void StartRefresh(const OrgChoice& org, uint64_t generation, const CancelToken& cancel) {
+    std::wstring cookie = g_cookie;
+    std::wstring apiBase = g_opt.apiBase;
+    std::shared_ptr<HttpClient> http = g_http;
+    bool debugDump = g_opt.debugDump;
+    // A parser per run: a cancelled run may still be parsing when the next starts
+    g_workers.Start("Refresh worker", [http, debugDump, cookie, apiBase, org, cancel, generation]() {
+        UsageParser parser;
+        parser.saveDebugDump = debugDump;
+        RefreshResult result = RunRefreshPipeline(*http, parser, cookie, org, cancel, generation, apiBase);
+        {
+            std::lock_guard<std::mutex> lock(g_doneLock);
+            g_done.push_back(std::move(result));
+        }
+        g_loop->Wake();
+    });
+}
+
+void SaveLatest(const UsageData& usage, int64_t now) {
+    char json[512];
+    int n = snprintf(json, sizeof(json),
+                     "{\"time\":%lld,\"org\":\"%s\",\"session\":%.1f,\"period\":%.1f,"
+                     "\"sessionResetMs\":%lld,\"periodResetMs\":%lld}\n",
+                     (long long)now, WideToUtf8(g_refresh.OrgId()).c_str(), usage.sessionPercent, usage.periodPercent,
+                     (long long)usage.sessionResetMs, (long long)usage.periodResetMs);
+    std::vector<uint8_t> data(json, json + (n > 0 && n < (int)sizeof(json) ? n : 0));
+    if (!WriteFileAtomic(g_opt.stateDir / "latest.json", data)) {
+        Log("warn", "msg=\"can't write latest.json\"");
+    }
+}
+
+void PushSnapshot(const UsageData& usage, int64_t now) {
+    UsageSnapshot snapshot;
+    const char* user = getenv("USER");
+    snapshot.user = user && *user ? user : "unknown";     // The aggregator refuses empty names
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    snapshot.host = host;
+    snapshot.time = now;
+    snapshot.session = usage.sessionPercent;
+    snapshot.period = usage.periodPercent;
+    snapshot.sessionResetMs = usage.sessionResetMs;
+    snapshot.periodResetMs = usage.periodResetMs;
+
+    std::vector<uint8_t> bytes;
+    EncodeSnapshot(snapshot, bytes);
+    std::string body(bytes.begin(), bytes.end());
+    std::wstring url = Utf8ToWide(g_opt.pushUrl);
+    while (!url.empty() && url.back() == L'/') url.pop_back();
+    url += L"/push";
+
+    // Off the loop thread; one push in flight at most, a slow aggregator
+    // just misses a sample
+    if (g_pushing.exchange(true)) {
+        Log("warn", "msg=\"aggregator push skipped\" detail=\"previous push still running\"");
+        return;
+    }
+    std::shared_ptr<HttpClient> http = g_http;
+    CancelToken cancel = g_pushCancel;
+    g_workers.Start("Aggregator push", [http, url, body, cancel]() {
+        HttpResponse resp = http->Post(url, body, L"application/octet-stream", cancel.get());
+        if (resp.status != HttpStatus::Success && !cancel->load()) {
+            Log("warn", "msg=\"aggregator push failed\" status=%d", resp.statusCode);
+        }
+        g_pushing = false;
+    });
+}
+
+void SaveOrgs() {
+    if (!WriteFileAtomic(g_opt.stateDir / "orgs.bin", g_refresh.Orgs().Serialize())) {
+        Log("warn", "msg=\"can't write orgs.bin\"");
+    }
+}
+
+// Log and store an accepted result; returns the delay before the next poll
+uint32_t ApplyResult(const RefreshResult& result) {
+    int64_t now = (int64_t)time(nullptr);
+    uint32_t maxMs = g_opt.maxIntervalSec * 1000;
+
+    if (result.orgs.FetchedAt() != 0) {
+        SaveOrgs();
+        Log("info", "msg=\"orgs listed\" count=%zu org=%s", result.orgs.Orgs().size(),
+            WideToUtf8(result.orgId).c_str());
+    }
+
+    switch (result.outcome) {
+    case RefreshOutcome::Success: {
+        g_failures = 0;
+        const UsageData& usage = result.usage;
+        if (!usage.valid) {
+            Log("warn", "msg=\"unrecognized usage response\"");
+            return maxMs;
+        }
+        g_history.Append({ now, usage.sessionPercent, usage.periodPercent });
+        SaveLatest(usage, now);
+        if (!g_opt.pushUrl.empty()) PushSnapshot(usage, now);
+
+        uint32_t next = g_opt.smart
+            ? SmartRefreshIntervalMs(usage.MaxPercent(), g_opt.minIntervalSec * 1000, maxMs)
+            : maxMs;
+        Log("info", "msg=poll outcome=success session=%.1f period=%.1f session_reset_ms=%lld "
+            "period_reset_ms=%lld next_s=%u rss_kb=%ld",
+            usage.sessionPercent, usage.periodPercent, (long long)usage.sessionResetMs,
+            (long long)usage.periodResetMs, next / 1000, RssKb());
+        return next;
+    }
+
+    case RefreshOutcome::AuthError:
+        // Nothing to do until someone updates the cookie (SIGHUP)
+        Log("error", "msg=poll outcome=auth_error detail=\"cookie may be expired\" next_s=%u", maxMs / 1000);
+        return maxMs;
+
+    case RefreshOutcome::NoOrg:
+        Log("error", "msg=poll outcome=no_org next_s=%u", maxMs / 1000);
+        return maxMs;
+
+    default: {
+        // Offline: back off 30s, 1m, 2m ... up to the slow interval
+        uint32_t shift = g_failures < 8 ? g_failures : 8;
+        uint32_t next = RETRY_BASE_MS << shift;
+        if (next > maxMs) next = maxMs;
+        g_failures++;
+        Log("warn", "msg=poll outcome=offline detail=\"%s\" failures=%u next_s=%u",
+            WideToUtf8(result.error).c_str(), g_failures, next / 1000);
+        return next;
+    }
+    }
+}
+
+// Subscribers keep the last numbers through failures, flagged as such
+void PublishResult(const RefreshResult& result) {
+    switch (result.outcome) {
+    case RefreshOutcome::Success:
+        if (!result.usage.valid) return;
+        g_published.valid = true;
+        g_published.offline = false;
+        g_published.session = result.usage.sessionPercent;
+        g_published.period = result.usage.periodPercent;
+        g_published.sessionResetMs = result.usage.sessionResetMs;
+        g_published.periodResetMs = result.usage.periodResetMs;
+        g_published.error.clear();
+        break;
+    case RefreshOutcome::AuthError:
+        g_published.valid = false;
+        g_published.error = "cookie may be expired";
+        break;
+    case RefreshOutcome::NoOrg:
+        g_published.valid = false;
+        g_published.error = "no organization";
+        break;
+    default:
+        g_published.offline = true;
+        break;
+    }
+    g_hub.Publish(g_published);
+}
+
+// The controller has taken the result; the next poll is scheduled after this
+void OnResult(const RefreshResult& result) {
+    g_nextPollMs = ApplyResult(result);
+    PublishResult(result);
+    if (g_opt.once) {
+        g_exitCode = result.outcome == RefreshOutcome::Success && result.usage.valid ? 0 : 1;
+        g_stopSignal = 1;
+    }
+}
+
+// Links, addresses or routes appeared. Ignored unless the last poll failed
+// to reach the API.
+void OnNetworkChanged() {
+    g_refresh.OnNetworkChanged();
+    uint64_t probe = g_refresh.ProbeDeadline();
+    if (probe) Log("info", "msg=\"network changed\" probe_in_ms=%llu", (unsigned long long)(probe - NowMs()));
+}
+
+void SaveHistory() {
+    if (!WriteFileAtomic(g_opt.stateDir / "history.bin", g_history.Serialize())) {
+        Log("warn", "msg=\"can't write history.bin\"");
+    }
+}
+
+void WriteTrace() {
+    char name[64];
+    time_t now = time(nullptr);
+    tm local;
+    localtime_r(&now, &local);
+    strftime(name, sizeof(name), "trace-%Y%m%d-%H%M%S.json", &local);
+    std::filesystem::path path = g_opt.stateDir / name;
+    if (TraceWriteFile(path)) Log("info", "msg=\"trace written\" path=\"%s\"", path.string().c_str());
+    else Log("warn", "msg=\"can't write trace\" path=\"%s\"", path.string().c_str());
+}
+
+bool ParseSeconds(const char* text, uint32_t& out) {
+    char* end = nullptr;
+    unsigned long v = strtoul(text, &end, 10);
+    if (end == text || *end || v == 0 || v > 86400) return false;
+    out = (uint32_t)v;
+    return true;
+}
+
+bool ParseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--fixed") == 0) {
+            g_opt.smart = false;
+            continue;
+        } else if (strcmp(arg, "--debug-dump") == 0) {
+            g_opt.debugDump = true;
+            continue;
+        } else if (strcmp(arg, "--once") == 0) {
+            g_opt.once = true;
+            continue;
+        } else if (strcmp(arg, "--no-socket") == 0) {
+            g_opt.subscribe = false;
+            continue;
+        } else if (!value) {
+            return false;
+        } else if (strcmp(arg, "--cookie-file") == 0) {
+            g_opt.cookieFile = std::filesystem::u8path(value);
+        } else if (strcmp(arg, "--state-dir") == 0) {
+            g_opt.stateDir = std::filesystem::u8path(value);
+        } else if (strcmp(arg, "--api") == 0) {
+            g_opt.apiBase = Utf8ToWide(value);
+            while (!g_opt.apiBase.empty() && g_opt.apiBase.back() == L'/') g_opt.apiBase.pop_back();
+        } else if (strcmp(arg, "--org") == 0) {
+            g_opt.org = value;
+        } else if (strcmp(arg, "--min-interval") == 0) {
+            if (!ParseSeconds(value, g_opt.minIntervalSec)) return false;
+        } else if (strcmp(arg, "--max-interval") == 0) {
+            if (!ParseSeconds(value, g_opt.maxIntervalSec)) return false;
+        } else if (strcmp(arg, "--push") == 0) {
+            g_opt.pushUrl = value;
+        } else if (strcmp(arg, "--socket") == 0) {
+            g_opt.socketPath = value;
+        } else {
+            return false;
+        }
+        i++;
+    }
+    return g_opt.minIntervalSec <= g_opt.maxIntervalSec;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (!ParseArgs(argc, argv)) {
+        fputs(USAGE, stderr);
+        return 2;
+    }
+    if (g_opt.stateDir.empty()) g_opt.stateDir = GetDataDir();
+    if (g_opt.stateDir.empty()) {
+        fputs("claudewatchd: no state directory (set HOME or use --state-dir)\n", stderr);
+        return 2;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(g_opt.stateDir, ec);
+
+    TraceSetThreadName("Poller");
+    if (!LoadCookie()) return 1;
+
+    std::vector<uint8_t> data;
+    if (ReadFileBytes(g_opt.stateDir / "history.bin", data)) g_history.Deserialize(data);
+    if (ReadFileBytes(g_opt.stateDir / "orgs.bin", data)) g_refresh.Orgs().Deserialize(data);
+
+    EventLoop loop;
+    g_loop = &loop;
+    if (!loop.Ok()) {
+        fputs("claudewatchd: can't create event loop\n", stderr);
+        return 1;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = OnSignal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    // Don't let a trace dump or reload fail a fetch in progress
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGHUP, &sa, nullptr);
+    sigaction(SIGUSR1, &sa, nullptr);
+
+    // Live updates are a convenience; polling goes on without them
+    if (g_opt.subscribe && !g_opt.once) {
+        std::string path = g_opt.socketPath.empty() ? (g_opt.stateDir / "claudewatch.sock").u8string()
+                                                    : g_opt.socketPath;
+        std::string error;
+        if (g_hub.Start(path, error)) Log("info", "msg=subscribe path=\"%s\"", path.c_str());
+        else Log("warn", "msg=\"can't serve subscriptions\" detail=\"%s\"", error.c_str());
+    }
+
+    // Only matters while offline, so --once has no use for it
+    if (!g_opt.once && g_netWatcher.Start(OnNetworkChanged)) {
+        loop.Add(g_netWatcher.Fd(), EventLoop::READ, [](uint32_t) { g_netWatcher.Drain(); });
+    }
+
+    Log("info", "msg=start state_dir=\"%s\" api=\"%s\" pid=%d", g_opt.stateDir.string().c_str(),
+        WideToUtf8(g_opt.apiBase).c_str(), (int)getpid());
+
+    // No probe hook: the poll is the reachability probe. It fails at connect
+    // as fast as a bare probe would, and once the network is back it's the
+    // request we wanted anyway. No countdown hook either, so between polls
+    // the only wakeups are reset deadlines and compaction.
+    RefreshHooks& hooks = g_refresh.hooks;
+    hooks.canFetch = []() { return !g_cookie.empty(); };
+    hooks.fetch = StartRefresh;
+    hooks.intervalMs = []() { return g_nextPollMs; };
+    hooks.onResult = OnResult;
+    g_refresh.pin = g_opt.org;
+    g_nextPollMs = g_opt.maxIntervalSec * 1000;
+    g_refresh.Refresh();
+    g_scheduler.Schedule(TASK_COMPACT, NowMs() + COMPACT_INTERVAL_MS, COMPACT_INTERVAL_MS / 3);
+
+    // One wakeup per deadline or signal; nothing runs in between
+    while (!g_stopSignal) {
+        g_refresh.CheckClocks();
+        uint64_t now = NowMs();
+        for (DeadlineScheduler::TaskId task : g_scheduler.PopDue(now)) {
+            if (g_refresh.RunTask(task)) continue;
+            if (task == TASK_COMPACT) {
+                g_history.Compact((int64_t)time(nullptr));
+                SaveHistory();
+                g_scheduler.Schedule(TASK_COMPACT, now + COMPACT_INTERVAL_MS, COMPACT_INTERVAL_MS / 3);
+            }
+        }
+
+        uint64_t wake = g_scheduler.NextWake();
+        now = NowMs();
+        g_loop->RunOnce(wake == 0 ? -1 : wake > now ? (int)(wake - now) : 0);
+
+        std::vector<RefreshResult> done;
+        {
+            std::lock_guard<std::mutex> lock(g_doneLock);
+            done.swap(g_done);
+        }
+        for (const RefreshResult& result : done) g_refresh.ApplyResult(result);
+
+        if (g_reloadSignal) {
+            g_reloadSignal = 0;
+            Log("info", "msg=reload");
+            // On failure keep the old cookie, the run in flight and the schedule
+            if (LoadCookie()) g_refresh.Restart();
+        }
+        if (g_traceSignal) {
+            g_traceSignal = 0;
+            WriteTrace();
+        }
+    }
+
+    g_refresh.Cancel();
+    if (!g_opt.once) g_pushCancel->store(true);     // --once finishes its push
+    g_workers.JoinAll();
+    g_loop = nullptr;
+    g_hub.Stop();
+    SaveHistory();
+    Log("info", "msg=stop");
+    return g_exitCode;
+}
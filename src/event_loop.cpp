@@ -0,0 +1,222 @@
+#include "event_loop.h"
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+// WSAPoll over a flat array rebuilt only when the set changes. The wake
+// channel is a UDP socket bound to loopback that sends itself a datagram.
+struct EventLoop::Impl {
+    struct Entry {
+        uint32_t events;
+        std::shared_ptr<Handler> handler;
+    };
+    std::unordered_map<SocketHandle, Entry> entries;
+    std::vector<WSAPOLLFD> fds;
+    bool dirty = true;
+    SOCKET wake = INVALID_SOCKET;
+    sockaddr_in wakeAddr = {};
+
+    void Rebuild() {
+        fds.clear();
+        fds.push_back({ wake, POLLRDNORM, 0 });
+        for (auto& e : entries) {
+            SHORT ev = 0;
+            if (e.second.events & READ) ev |= POLLRDNORM;
+            if (e.second.events & WRITE) ev |= POLLWRNORM;
+            fds.push_back({ (SOCKET)e.first, ev, 0 });
+        }
+        dirty = false;
+    }
+};
+
+EventLoop::EventLoop() : m_impl(new Impl()) {
+    InitSockets();
+    m_impl->wake = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_impl->wake == INVALID_SOCKET) return;
+    m_impl->wakeAddr.sin_family = AF_INET;
+    m_impl->wakeAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int len = sizeof(m_impl->wakeAddr);
+    if (bind(m_impl->wake, (sockaddr*)&m_impl->wakeAddr, len) != 0 ||
+        getsockname(m_impl->wake, (sockaddr*)&m_impl->wakeAddr, &len) != 0) {
+        closesocket(m_impl->wake);
+        m_impl->wake = INVALID_SOCKET;
+        return;
+    }
+    SetNonBlocking((SocketHandle)m_impl->wake);
+}
+
+EventLoop::~EventLoop() {
+    if (m_impl->wake != INVALID_SOCKET) closesocket(m_impl->wake);
+}
+
+bool EventLoop::Ok() const {
+    return m_impl->wake != INVALID_SOCKET;
+}
+
+bool EventLoop::Add(SocketHandle s, uint32_t events, Handler handler) {
+    m_impl->entries[s] = { events, std::make_shared<Handler>(std::move(handler)) };
+    m_impl->dirty = true;
+    return true;
+}
+
+bool EventLoop::Modify(SocketHandle s, uint32_t events) {
+    auto it = m_impl->entries.find(s);
+    if (it == m_impl->entries.end()) return false;
+    if (it->second.events != events) {
+        it->second.events = events;
+        m_impl->dirty = true;
+    }
+    return true;
+}
+
+void EventLoop::Remove(SocketHandle s) {
+    if (m_impl->entries.erase(s)) m_impl->dirty = true;
+}
+
+int EventLoop::RunOnce(int timeoutMs) {
+    if (m_impl->dirty) m_impl->Rebuild();
+    int ready = WSAPoll(m_impl->fds.data(), (ULONG)m_impl->fds.size(), timeoutMs);
+    if (ready <= 0) return 0;
+
+    // Handlers may change the set; work from a copy of what was polled
+    std::vector<WSAPOLLFD> polled = m_impl->fds;
+    int ran = 0;
+    for (const WSAPOLLFD& p : polled) {
+        if (!p.revents) continue;
+        if (p.fd == m_impl->wake) {
+            char buf[64];
+            while (recv(m_impl->wake, buf, sizeof(buf), 0) > 0) {}
+            continue;
+        }
+        auto it = m_impl->entries.find((SocketHandle)p.fd);
+        if (it == m_impl->entries.end()) continue;
+
+        uint32_t events = 0;
+        if (p.revents & (POLLRDNORM | POLLHUP | POLLERR)) events |= READ;
+        if (p.revents & POLLWRNORM) events |= WRITE;
+        std::shared_ptr<Handler> handler = it->second.handler;
+        (*handler)(events);
+        ran++;
+    }
+    return ran;
+}
+
+void EventLoop::Wake() {
+    char b = 0;
+    sendto(m_impl->wake, &b, 1, 0, (sockaddr*)&m_impl->wakeAddr, sizeof(m_impl->wakeAddr));
+}
+
+#else
+
+struct EventLoop::Impl {
+    int epoll = -1;
+    int wake = -1;      // eventfd
+    std::unordered_map<int, std::shared_ptr<Handler>> handlers;
+    std::vector<epoll_event> ready = std::vector<epoll_event>(256);
+};
+
+static uint32_t ToEpoll(uint32_t events) {
+    return ((events & EventLoop::READ) ? (uint32_t)EPOLLIN : 0) | ((events & EventLoop::WRITE) ? (uint32_t)EPOLLOUT : 0);
+}
+
+EventLoop::EventLoop() : m_impl(new Impl()) {
+    InitSockets();
+    m_impl->epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_impl->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_impl->epoll >= 0 && m_impl->wake >= 0) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = m_impl->wake;
+        epoll_ctl(m_impl->epoll, EPOLL_CTL_ADD, m_impl->wake, &ev);
+    }
+}
+
+EventLoop::~EventLoop() {
+    if (m_impl->wake >= 0) close(m_impl->wake);
+    if (m_impl->epoll >= 0) close(m_impl->epoll);
+}
+
+bool EventLoop::Ok() const {
+    return m_impl->epoll >= 0 && m_impl->wake >= 0;
+}
+
+bool EventLoop::Add(SocketHandle s, uint32_t events, Handler handler) {
+    epoll_event ev = {};
+    ev.events = ToEpoll(events);
+    ev.data.fd = s;
+    if (epoll_ctl(m_impl->epoll, EPOLL_CTL_ADD, s, &ev) != 0) return false;
+    m_impl->handlers[s] = std::make_shared<Handler>(std::move(handler));
+    return true;
+}
+
+bool EventLoop::Modify(SocketHandle s, uint32_t events) {
+    epoll_event ev = {};
+    ev.events = ToEpoll(events);
+    ev.data.fd = s;
+    return epoll_ctl(m_impl->epoll, EPOLL_CTL_MOD, s, &ev) == 0;
+}
+
+void EventLoop::Remove(SocketHandle s) {
+    if (m_impl->handlers.erase(s)) {
+        epoll_ctl(m_impl->epoll, EPOLL_CTL_DEL, s, nullptr);
+    }
+}
+
+int EventLoop::RunOnce(int timeoutMs) {
+    int n = epoll_wait(m_impl->epoll, m_impl->ready.data(), (int)m_impl->ready.size(), timeoutMs);
+    if (n <= 0) return 0;
+
+    int ran = 0;
+    for (int i = 0; i < n; i++) {
+        const epoll_event& ev = m_impl->ready[i];
+        if (ev.data.fd == m_impl->wake) {
+            uint64_t count;
+            while (read(m_impl->wake, &count, sizeof(count)) > 0) {}
+            continue;
+        }
+
+        // Gone if an earlier handler in this batch removed it
+        auto it = m_impl->handlers.find(ev.data.fd);
+        if (it == m_impl->handlers.end()) continue;
+
+        uint32_t events = 0;
+        if (ev.events & (EPOLLIN | EPOLLHUP | EPOLLERR)) events |= READ;
+        if (ev.events & EPOLLOUT) events |= WRITE;
+        std::shared_ptr<Handler> handler = it->second;
+        (*handler)(events);
+        ran++;
+    }
+
+    // A full batch means more may be waiting; take more next time
+    if (n == (int)m_impl->ready.size() && m_impl->ready.size() < 4096) {
+        m_impl->ready.resize(m_impl->ready.size() * 2);
+    }
+    return ran;
+}
+
+void EventLoop::Wake() {
+    uint64_t one = 1;
+    ssize_t written = write(m_impl->wake, &one, sizeof(one));
+    (void)written;
+}
+
+#endif
+
+size_t EventLoop::Count() const {
+#ifdef _WIN32
+    return m_impl->entries.size();
+#else
+    return m_impl->handlers.size();
+#endif
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "socket_util.h"
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+// Readiness-based socket loop: epoll on Linux, WSAPoll on Windows. Single
+// threaded - everything but Wake() must be called from the thread running
+// RunOnce(). Level triggered; errors and hangups are reported as readable
+// so the handler finds out from its next recv().
+class EventLoop {
+public:
+    enum : uint32_t {
+        READ = 1,
+        WRITE = 2,
+    };
+    using Handler = std::function<void(uint32_t events)>;
+
+    EventLoop();
+    ~EventLoop();
+
+    bool Ok() const;
+
+    bool Add(SocketHandle s, uint32_t events, Handler handler);
+    bool Modify(SocketHandle s, uint32_t events);
+    // Safe from inside the socket's own handler
+    void Remove(SocketHandle s);
+    size_t Count() const;
+
+    // Wait up to timeoutMs (-1 = no limit) and dispatch whatever is ready.
+    // Returns the number of handlers run.
+    int RunOnce(int timeoutMs);
+
+    // Any thread: make a blocked RunOnce() return early
+    void Wake();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
@@ -0,0 +1,47 @@
+#include "file_util.h"
+#include <cstdlib>
+#include <fstream>
+#include <system_error>
+
+bool ReadFileBytes(const std::filesystem::path& path, std::vector<uint8_t>& out) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f) return false;
+
+    std::streamoff size = f.tellg();
+    if (size < 0) return false;
+    out.resize((size_t)size);
+    f.seekg(0);
+    return (bool)f.read((char*)out.data(), size);
+}
+
+bool WriteFileAtomic(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f) return false;
+        f.write((const char*)data.data(), (std::streamsize)data.size());
+        if (!f) return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+std::filesystem::path GetDataDir() {
+#ifdef _WIN32
+    const wchar_t* appData = _wgetenv(L"APPDATA");
+    if (appData && *appData) return std::filesystem::path(appData) / L"ClaudeWatch";
+#else
+    const char* config = getenv("XDG_CONFIG_HOME");
+    if (config && *config) return std::filesystem::path(config) / "claudewatch";
+    const char* home = getenv("HOME");
+    if (home && *home) return std::filesystem::path(home) / ".config" / "claudewatch";
+#endif
+    return std::filesystem::path();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+bool ReadFileBytes(const std::filesystem::path& path, std::vector<uint8_t>& out);
+
+// Write to a temp file next to the target and rename it over, so a crash
+// mid-write never leaves a truncated file behind
+bool WriteFileAtomic(const std::filesystem::path& path, const std::vector<uint8_t>& data);
+
+// Where ClaudeWatch keeps its state: %APPDATA%\ClaudeWatch, or
+// $XDG_CONFIG_HOME/claudewatch (~/.config/claudewatch). Empty if unknown.
+std::filesystem::path GetDataDir();
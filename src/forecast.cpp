@@ -0,0 +1,322 @@
+#include "forecast.h"
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+
+namespace {
+
+constexpr uint32_t FORECAST_MAGIC = 0x31465743;     // "CWF1"
+constexpr float RESET_DROP = 5.0f;                  // Same rule as the history store
+
+void PutVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end) return false;
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+void PutF32(std::vector<uint8_t>& out, float f) {
+    uint32_t v;
+    memcpy(&v, &f, 4);
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (i * 8)));
+}
+
+bool GetF32(const uint8_t*& p, const uint8_t* end, float& f) {
+    if (end - p < 4) return false;
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    memcpy(&f, &v, 4);
+    p += 4;
+    return true;
+}
+
+int64_t FloorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+} // namespace
+
+void P2Quantile::Add(float x) {
+    if (m_count < 5) {
+        m_height[m_count++] = x;
+        if (m_count == 5) {
+            std::sort(m_height, m_height + 5);
+            for (uint32_t i = 0; i < 5; i++) m_pos[i] = i + 1;
+        }
+        return;
+    }
+
+    // Cell the value falls in; the extremes just move
+    int k;
+    if (x < m_height[0]) {
+        m_height[0] = x;
+        k = 0;
+    } else if (x >= m_height[4]) {
+        m_height[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= m_height[k + 1]) k++;
+    }
+    for (int i = k + 1; i < 5; i++) m_pos[i]++;
+    m_count++;
+
+    const double increments[5] = { 0.0, m_p / 2, m_p, (1 + m_p) / 2, 1.0 };
+    for (int i = 1; i <= 3; i++) {
+        double desired = 1 + (m_count - 1) * increments[i];
+        double d = desired - m_pos[i];
+        if ((d >= 1 && m_pos[i + 1] - m_pos[i] > 1) || (d <= -1 && m_pos[i] - m_pos[i - 1] > 1)) {
+            int s = d >= 0 ? 1 : -1;
+            double n0 = m_pos[i - 1], n1 = m_pos[i], n2 = m_pos[i + 1];
+            double h0 = m_height[i - 1], h1 = m_height[i], h2 = m_height[i + 1];
+            double parabolic = h1 + s / (n2 - n0) * ((n1 - n0 + s) * (h2 - h1) / (n2 - n1) +
+                                                     (n2 - n1 - s) * (h1 - h0) / (n1 - n0));
+            if (h0 < parabolic && parabolic < h2) {
+                m_height[i] = (float)parabolic;
+            } else {
+                double hs = m_height[i + s];
+                double ns = m_pos[i + s];
+                m_height[i] = (float)(h1 + s * (hs - h1) / (ns - n1));
+            }
+            m_pos[i] = (uint32_t)((int)m_pos[i] + s);
+        }
+    }
+}
+
+float P2Quantile::Value() const {
+    if (m_count == 0) return 0.0f;
+    if (m_count >= 5) return m_height[2];
+
+    // Too few for the markers: nearest rank over what we have
+    float sorted[5];
+    std::copy(m_height, m_height + m_count, sorted);
+    std::sort(sorted, sorted + m_count);
+    size_t rank = (size_t)(m_p * m_count + 0.999999);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void P2Quantile::Serialize(std::vector<uint8_t>& out) const {
+    PutVarint(out, m_count);
+    for (uint32_t i = 0; i < std::min<uint32_t>(m_count, 5); i++) PutF32(out, m_height[i]);
+    // End positions are always 1 and count
+    if (m_count >= 5) {
+        for (int i = 1; i <= 3; i++) PutVarint(out, m_pos[i]);
+    }
+}
+
+bool P2Quantile::Deserialize(const uint8_t*& p, const uint8_t* end) {
+    uint64_t count;
+    if (!GetVarint(p, end, count) || count > UINT32_MAX) return false;
+    m_count = (uint32_t)count;
+    for (uint32_t i = 0; i < std::min<uint32_t>(m_count, 5); i++) {
+        if (!GetF32(p, end, m_height[i])) return false;
+    }
+    if (m_count >= 5) {
+        m_pos[0] = 1;
+        m_pos[4] = m_count;
+        for (int i = 1; i <= 3; i++) {
+            uint64_t v;
+            if (!GetVarint(p, end, v) || v <= m_pos[i - 1] || v >= m_count) return false;
+            m_pos[i] = (uint32_t)v;
+        }
+    }
+    return true;
+}
+
+BurnForecaster::BurnForecaster() {}
+
+size_t BurnForecaster::HourOfWeek(int64_t hour) const {
+    int64_t local = FloorDiv(hour * 3600 + utcOffsetSec, 3600);
+    // 1970-01-01 00:00 was a Thursday: hour 0 is Thursday 00:00, Monday = 0
+    int64_t h = (local + 3 * 24) % (int64_t)HOURS_PER_WEEK;
+    return (size_t)(h < 0 ? h + (int64_t)HOURS_PER_WEEK : h);
+}
+
+float BurnForecaster::Burn(size_t hourOfWeek, int band) const {
+    const P2Quantile& own = m_hours[hourOfWeek].q[band];
+    float burn = own.Count() >= minObservations ? own.Value() : m_all[band].Value();
+    return burn > 0.0f ? burn : 0.0f;
+}
+
+void BurnForecaster::CloseHour() {
+    if (m_openHour >= 0 && m_openCovered >= 1800) {
+        float burn = m_openBurn * 3600.0f / (float)m_openCovered;
+        Sketch& s = m_hours[HourOfWeek(m_openHour)];
+        for (int b = 0; b < 3; b++) {
+            s.q[b].Add(burn);
+            m_all[b].Add(burn);
+        }
+    }
+    m_openHour = -1;
+    m_openBurn = 0.0f;
+    m_openCovered = 0;
+}
+
+void BurnForecaster::Spread(int64_t from, int64_t to, float delta) {
+    float rate = delta / (float)(to - from);
+    int64_t t = from;
+    while (t < to) {
+        int64_t hour = FloorDiv(t, 3600);
+        int64_t end = std::min(to, (hour + 1) * 3600);
+        if (hour != m_openHour) {
+            CloseHour();
+            m_openHour = hour;
+        }
+        m_openBurn += rate * (float)(end - t);
+        m_openCovered += (uint32_t)(end - t);
+        t = end;
+    }
+}
+
+void BurnForecaster::AddSample(int64_t timeSec, float periodPercent) {
+    if (m_lastTime == 0 || timeSec - m_lastTime > maxGapSec) {
+        // Nothing to compare against; an hour left open across a long gap
+        // is as finished as it'll ever be
+        CloseHour();
+    } else if (timeSec > m_lastTime) {
+        float delta = periodPercent - m_lastValue;
+        if (delta < -RESET_DROP) {
+            // The week rolled over somewhere in here; what was used since is unknown
+            CloseHour();
+        } else {
+            Spread(m_lastTime, timeSec, delta > 0.0f ? delta : 0.0f);
+        }
+    } else {
+        return;     // Out of order
+    }
+    m_lastTime = timeSec;
+    m_lastValue = periodPercent;
+}
+
+ExhaustionForecast BurnForecaster::Forecast(int64_t nowSec, float periodPercent, int64_t resetSec) const {
+    ExhaustionForecast f;
+    if (m_all[1].Count() < minObservations) return f;
+    f.valid = true;
+
+    float remaining = 100.0f - periodPercent;
+    if (remaining <= 0.0f) {
+        f.early = f.likely = f.late = nowSec;
+        return f;
+    }
+
+    // Walk hour by hour to the reset, accumulating each scenario's burn
+    int64_t horizon = resetSec > nowSec ? resetSec : nowSec + 7 * 86400;
+    float used[3] = { 0.0f, 0.0f, 0.0f };
+    int64_t* result[3] = { &f.late, &f.likely, &f.early };
+    for (int64_t t = nowSec; t < horizon;) {
+        int64_t hour = FloorDiv(t, 3600);
+        int64_t end = std::min(horizon, (hour + 1) * 3600);
+        size_t how = HourOfWeek(hour);
+        bool pending = false;
+        for (int b = 0; b < 3; b++) {
+            if (*result[b]) continue;
+            float rate = Burn(how, b) / 3600.0f;
+            float add = rate * (float)(end - t);
+            if (used[b] + add >= remaining && rate > 0.0f) {
+                *result[b] = t + (int64_t)((remaining - used[b]) / rate);
+            } else {
+                used[b] += add;
+                pending = true;
+            }
+        }
+        if (!pending) break;
+        t = end;
+    }
+    return f;
+}
+
+std::vector<uint8_t> BurnForecaster::Serialize() const {
+    std::vector<uint8_t> out;
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(FORECAST_MAGIC >> (i * 8)));
+
+    // Where the last sample and the open hour left off
+    PutVarint(out, (uint64_t)m_lastTime);
+    PutF32(out, m_lastValue);
+    PutVarint(out, (uint64_t)(m_openHour + 1));
+    PutF32(out, m_openBurn);
+    PutVarint(out, m_openCovered);
+
+    for (int b = 0; b < 3; b++) m_all[b].Serialize(out);
+    for (const Sketch& s : m_hours) {
+        for (int b = 0; b < 3; b++) s.q[b].Serialize(out);
+    }
+    return out;
+}
+
+bool BurnForecaster::Deserialize(const std::vector<uint8_t>& data) {
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+    if (data.size() < 4) return false;
+    uint32_t magic = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    if (magic != FORECAST_MAGIC) return false;
+    p += 4;
+
+    BurnForecaster loaded;
+    loaded.utcOffsetSec = utcOffsetSec;
+    loaded.minObservations = minObservations;
+    loaded.maxGapSec = maxGapSec;
+
+    uint64_t lastTime, openHour, covered;
+    if (!GetVarint(p, end, lastTime) || !GetF32(p, end, loaded.m_lastValue) ||
+        !GetVarint(p, end, openHour) || !GetF32(p, end, loaded.m_openBurn) ||
+        !GetVarint(p, end, covered) || covered > 3600) {
+        return false;
+    }
+    loaded.m_lastTime = (int64_t)lastTime;
+    loaded.m_openHour = (int64_t)openHour - 1;
+    loaded.m_openCovered = (uint32_t)covered;
+
+    for (int b = 0; b < 3; b++) {
+        if (!loaded.m_all[b].Deserialize(p, end)) return false;
+    }
+    for (Sketch& s : loaded.m_hours) {
+        for (int b = 0; b < 3; b++) {
+            if (!s.q[b].Deserialize(p, end)) return false;
+        }
+    }
+    *this = loaded;
+    return true;
+}
+
+static void FormatLocal(wchar_t* buf, size_t size, int64_t unixSec, int32_t utcOffsetSec) {
+    static const wchar_t* const DAYS[] = { L"Mon", L"Tue", L"Wed", L"Thu", L"Fri", L"Sat", L"Sun" };
+    int64_t local = unixSec + utcOffsetSec;
+    int64_t day = FloorDiv(local, 86400);
+    int64_t sec = local - day * 86400;
+    int weekday = (int)(((day + 3) % 7 + 7) % 7);
+    swprintf(buf, size, L"%ls %02d:%02d", DAYS[weekday], (int)(sec / 3600), (int)(sec % 3600 / 60));
+}
+
+std::wstring FormatForecast(const ExhaustionForecast& f, int32_t utcOffsetSec) {
+    if (!f.valid) return L"";
+
+    wchar_t likely[32], early[32], late[32], buf[128];
+    if (f.likely) {
+        FormatLocal(likely, 32, f.likely, utcOffsetSec);
+        FormatLocal(early, 32, f.early, utcOffsetSec);
+        if (f.late) {
+            FormatLocal(late, 32, f.late, utcOffsetSec);
+            swprintf(buf, 128, L"Weekly limit ~%ls (%ls - %ls)", likely, early, late);
+        } else {
+            swprintf(buf, 128, L"Weekly limit ~%ls (%ls - after reset)", likely, early);
+        }
+    } else if (f.early) {
+        FormatLocal(early, 32, f.early, utcOffsetSec);
+        swprintf(buf, 128, L"Weekly limit should last (heavy use: %ls)", early);
+    } else {
+        swprintf(buf, 128, L"Weekly limit should last until reset");
+    }
+    return buf;
+}
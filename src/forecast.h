@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Running estimate of one quantile in constant memory: the P-squared
+// algorithm (Jain & Chlamtac, 1985). Five markers track the min, max, the
+// target quantile and two midpoints; each observation nudges them with a
+// piecewise-parabolic fit. O(1) per value, no samples kept.
+class P2Quantile {
+public:
+    explicit P2Quantile(double p = 0.5) : m_p(p) {}
+
+    void Add(float x);
+    float Value() const;
+    uint32_t Count() const { return m_count; }
+
+    void Serialize(std::vector<uint8_t>& out) const;
+    bool Deserialize(const uint8_t*& p, const uint8_t* end);
+
+private:
+    double m_p;
+    uint32_t m_count = 0;
+    float m_height[5] = {};
+    uint32_t m_pos[5] = {};     // 1-based marker positions
+};
+
+// When the weekly limit runs out, as three scenarios. Times are Unix
+// seconds; 0 means not before the limit resets (or within a week).
+struct ExhaustionForecast {
+    bool valid = false;         // Enough history to say anything
+    int64_t early = 0;          // Heavy week: 90th-percentile burn every hour
+    int64_t likely = 0;         // Median burn
+    int64_t late = 0;           // Light week: 10th-percentile burn
+};
+
+// Learns how much of the weekly (seven_day) allowance gets used in each hour
+// of the week - Monday 09:00 looks nothing like Saturday 03:00 - and rolls
+// those distributions forward from the current level to forecast
+// exhaustion. Per hour of week it keeps p10/p50/p90 sketches of hourly
+// burn; hours with too little history borrow the all-hours sketch.
+class BurnForecaster {
+public:
+    static constexpr size_t HOURS_PER_WEEK = 168;
+
+    int32_t utcOffsetSec = 0;           // Where local hours fall
+    uint32_t minObservations = 3;       // Before an hour's own sketch is trusted
+    int64_t maxGapSec = 48 * 3600;      // Longer silences teach nothing
+
+    BurnForecaster();
+
+    // Each successful poll, in time order. The change since the previous
+    // sample is spread evenly over the hours in between (a machine that was
+    // off still saw the account's usage when it came back); an hour is
+    // folded into its sketches once it's over and at least half covered.
+    void AddSample(int64_t timeSec, float periodPercent);
+
+    ExhaustionForecast Forecast(int64_t nowSec, float periodPercent, int64_t resetSec) const;
+
+    // Hours of history behind the all-hours sketch
+    uint32_t Observations() const { return m_all[0].Count(); }
+
+    std::vector<uint8_t> Serialize() const;
+    bool Deserialize(const std::vector<uint8_t>& data);
+
+private:
+    struct Sketch {
+        P2Quantile q[3] = { P2Quantile(0.1), P2Quantile(0.5), P2Quantile(0.9) };
+    };
+
+    size_t HourOfWeek(int64_t hour) const;
+    float Burn(size_t hourOfWeek, int band) const;
+    void Spread(int64_t from, int64_t to, float delta);
+    void CloseHour();
+
+    Sketch m_hours[HOURS_PER_WEEK];
+    P2Quantile m_all[3] = { P2Quantile(0.1), P2Quantile(0.5), P2Quantile(0.9) };
+
+    int64_t m_lastTime = 0;
+    float m_lastValue = 0.0f;
+    int64_t m_openHour = -1;        // Unix hour being accumulated
+    float m_openBurn = 0.0f;
+    uint32_t m_openCovered = 0;     // Seconds of it we have data for
+};
+
+// "Weekly limit ~Thu 14:00 (Wed 20:00 - Fri 09:00)", or a note that it
+// should last until reset. Empty when the forecast isn't valid.
+std::wstring FormatForecast(const ExhaustionForecast& forecast, int32_t utcOffsetSec);
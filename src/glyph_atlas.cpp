@@ -0,0 +1,171 @@
+#include "glyph_atlas.h"
+#include <algorithm>
+#include <cmath>
+
+bool GlyphAtlas::Build(const std::wstring& glyphs, const std::vector<std::wstring>& labels,
+                       const RasterizeFn& rasterize, const AdvanceFn& advance) {
+    for (Entry& e : m_glyphs) e = Entry();
+    m_labels.clear();
+    m_kern.assign((size_t)CHAR_COUNT * CHAR_COUNT, 0.0f);
+    m_sheet.clear();
+    m_sheetWidth = 0;
+    m_lineHeight = 0;
+
+    // Rasterize everything first, then pack it into one strip
+    std::vector<GlyphBitmap> bitmaps;
+    std::vector<Entry*> owners;
+    std::wstring alphabet;
+
+    for (wchar_t c : glyphs) {
+        int index = (int)c - FIRST_CHAR;
+        if (index < 0 || index >= CHAR_COUNT || m_glyphs[index].present) continue;
+
+        GlyphBitmap bmp;
+        if (!rasterize(std::wstring(1, c), bmp)) return false;
+        m_glyphs[index].present = true;
+        bitmaps.push_back(std::move(bmp));
+        owners.push_back(&m_glyphs[index]);
+        alphabet += c;
+    }
+
+    m_labels.resize(labels.size());
+    for (size_t i = 0; i < labels.size(); i++) {
+        GlyphBitmap bmp;
+        if (!rasterize(labels[i], bmp)) return false;
+        m_labels[i].text = labels[i];
+        bitmaps.push_back(std::move(bmp));
+        owners.push_back(&m_labels[i].entry);
+    }
+
+    for (const GlyphBitmap& bmp : bitmaps) {
+        m_sheetWidth += bmp.width;
+        m_lineHeight = std::max(m_lineHeight, bmp.height);
+    }
+    if (m_sheetWidth == 0 || m_lineHeight == 0) return false;
+
+    m_sheet.assign((size_t)m_sheetWidth * m_lineHeight, 0);
+    int sheetX = 0;
+    for (size_t i = 0; i < bitmaps.size(); i++) {
+        const GlyphBitmap& bmp = bitmaps[i];
+        for (int row = 0; row < bmp.height; row++) {
+            std::copy(bmp.alpha.begin() + (size_t)row * bmp.width,
+                      bmp.alpha.begin() + (size_t)(row + 1) * bmp.width,
+                      m_sheet.begin() + (size_t)row * m_sheetWidth + sheetX);
+        }
+
+        Entry& e = *owners[i];
+        e.sheetX = sheetX;
+        e.width = bmp.width;
+        e.offsetX = bmp.offsetX;
+        e.advance = bmp.advance;
+        e.present = true;
+        sheetX += bmp.width;
+    }
+
+    // Bake pair kerning: how much "ab" differs from "a" + "b"
+    for (wchar_t a : alphabet) {
+        float advA = m_glyphs[a - FIRST_CHAR].advance;
+        for (wchar_t b : alphabet) {
+            float advB = m_glyphs[b - FIRST_CHAR].advance;
+            std::wstring pair = { a, b };
+            float kern = advance(pair) - advA - advB;
+            if (std::fabs(kern) > 0.01f) {
+                m_kern[(size_t)(a - FIRST_CHAR) * CHAR_COUNT + (b - FIRST_CHAR)] = kern;
+            }
+        }
+    }
+
+    std::sort(m_labels.begin(), m_labels.end(),
+              [](const Label& x, const Label& y) { return x.text.size() > y.text.size(); });
+    return true;
+}
+
+bool GlyphAtlas::Layout(const std::wstring& text, std::vector<Run>& runs, float& width) const {
+    if (!IsBuilt()) return false;
+
+    float pen = 0.0f;
+    int prev = -1;
+    size_t i = 0;
+    while (i < text.size()) {
+        const Label* label = nullptr;
+        for (const Label& l : m_labels) {
+            if (text.compare(i, l.text.size(), l.text) == 0) {
+                label = &l;
+                break;
+            }
+        }
+
+        int index = (int)text[i] - FIRST_CHAR;
+        if (prev >= 0 && index >= 0 && index < CHAR_COUNT) {
+            pen += m_kern[(size_t)prev * CHAR_COUNT + index];
+        }
+
+        if (label) {
+            runs.push_back({ &label->entry, pen });
+            pen += label->entry.advance;
+            i += label->text.size();
+            prev = (int)label->text.back() - FIRST_CHAR;
+            if (prev < 0 || prev >= CHAR_COUNT) prev = -1;
+            continue;
+        }
+
+        if (index < 0 || index >= CHAR_COUNT || !m_glyphs[index].present) return false;
+        runs.push_back({ &m_glyphs[index], pen });
+        pen += m_glyphs[index].advance;
+        prev = index;
+        i++;
+    }
+
+    width = pen;
+    return true;
+}
+
+int GlyphAtlas::Measure(const std::wstring& text) const {
+    std::vector<Run> runs;
+    float width;
+    if (!Layout(text, runs, width)) return -1;
+    return (int)std::ceil(width);
+}
+
+bool GlyphAtlas::Draw(uint32_t* pixels, int stride, int surfaceWidth, int surfaceHeight,
+                      int x, int y, const std::wstring& text, uint32_t color) const {
+    std::vector<Run> runs;
+    float width;
+    if (!Layout(text, runs, width)) return false;
+
+    uint32_t srcR = (color >> 16) & 0xFF;
+    uint32_t srcG = (color >> 8) & 0xFF;
+    uint32_t srcB = color & 0xFF;
+
+    for (const Run& run : runs) {
+        const Entry& e = *run.entry;
+        int left = x + (int)std::lround(run.penX) + e.offsetX;
+
+        for (int row = 0; row < m_lineHeight; row++) {
+            int dy = y + row;
+            if (dy < 0 || dy >= surfaceHeight) continue;
+
+            const uint8_t* src = m_sheet.data() + (size_t)row * m_sheetWidth + e.sheetX;
+            uint32_t* dst = (uint32_t*)((uint8_t*)pixels + (size_t)dy * stride);
+            for (int col = 0; col < e.width; col++) {
+                uint32_t a = src[col];
+                int dx = left + col;
+                if (a == 0 || dx < 0 || dx >= surfaceWidth) continue;
+
+                uint32_t d = dst[dx];
+                uint32_t inv = 255 - a;
+                uint32_t r = (srcR * a + ((d >> 16) & 0xFF) * inv + 127) / 255;
+                uint32_t g = (srcG * a + ((d >> 8) & 0xFF) * inv + 127) / 255;
+                uint32_t b = (srcB * a + (d & 0xFF) * inv + 127) / 255;
+                dst[dx] = 0xFF000000u | (r << 16) | (g << 8) | b;
+            }
+        }
+    }
+    return true;
+}
+
+GlyphAtlas& GlyphAtlasCache::Get(const std::wstring& face, float size, int dpi) {
+    std::unique_ptr<GlyphAtlas>& atlas = m_atlases[Key{ face, size, dpi }];
+    if (!atlas) atlas.reset(new GlyphAtlas());
+    return *atlas;
+}
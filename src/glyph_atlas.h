@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 8-bit coverage for one glyph or one fixed label, as produced by the
+// platform rasterizer (GDI+ on Windows)
+struct GlyphBitmap {
+    int width = 0;
+    int height = 0;
+    int offsetX = 0;        // Bitmap left edge relative to the pen position
+    float advance = 0.0f;   // Pen advance in pixels
+    std::vector<uint8_t> alpha;
+};
+
+// Pre-rasterized text for one (font, size, DPI). Built once: every glyph of
+// the small widget alphabet plus a handful of fixed labels are rendered into
+// a single coverage sheet, and pair kerning is measured up front and baked
+// into a table. Drawing is then table lookups and alpha blits - no layout.
+// Anything outside the alphabet makes Draw() return false so the caller can
+// fall back to full text layout (error messages etc).
+class GlyphAtlas {
+public:
+    typedef std::function<bool(const std::wstring& text, GlyphBitmap& out)> RasterizeFn;
+    typedef std::function<float(const std::wstring& text)> AdvanceFn;
+
+    // Printable ASCII only; labels are matched as whole runs before glyphs
+    bool Build(const std::wstring& glyphs, const std::vector<std::wstring>& labels,
+               const RasterizeFn& rasterize, const AdvanceFn& advance);
+
+    bool IsBuilt() const { return !m_sheet.empty(); }
+    int LineHeight() const { return m_lineHeight; }
+
+    // Pixel width of text, or -1 if it can't be drawn from the atlas
+    int Measure(const std::wstring& text) const;
+
+    // Blend text onto a 32bpp BGRA surface with its top-left at (x, y).
+    // color is 0xRRGGBB. Clipped to the surface.
+    bool Draw(uint32_t* pixels, int stride, int surfaceWidth, int surfaceHeight,
+              int x, int y, const std::wstring& text, uint32_t color) const;
+
+    size_t Bytes() const { return m_sheet.size() + m_kern.size() * sizeof(float); }
+
+private:
+    struct Entry {
+        int sheetX = 0;
+        int width = 0;
+        int offsetX = 0;
+        float advance = 0.0f;
+        bool present = false;
+    };
+
+    struct Label {
+        std::wstring text;
+        Entry entry;
+    };
+
+    static constexpr int FIRST_CHAR = 0x20;
+    static constexpr int CHAR_COUNT = 0x7F - FIRST_CHAR;
+
+    Entry m_glyphs[CHAR_COUNT];
+    std::vector<Label> m_labels;        // Longest first
+    std::vector<float> m_kern;          // CHAR_COUNT x CHAR_COUNT pair adjustments
+    std::vector<uint8_t> m_sheet;       // m_sheetWidth x m_lineHeight coverage
+    int m_sheetWidth = 0;
+    int m_lineHeight = 0;
+
+    // One positioned piece of a laid-out string
+    struct Run {
+        const Entry* entry;
+        float penX;
+    };
+    bool Layout(const std::wstring& text, std::vector<Run>& runs, float& width) const;
+};
+
+// Atlases keyed by (font face, point size, DPI), so a DPI change or a second
+// font builds its own sheet once and reuses it after
+class GlyphAtlasCache {
+public:
+    GlyphAtlas& Get(const std::wstring& face, float size, int dpi);
+    void Clear() { m_atlases.clear(); }
+
+private:
+    struct Key {
+        std::wstring face;
+        float size;
+        int dpi;
+        bool operator<(const Key& o) const {
+            if (face != o.face) return face < o.face;
+            if (size != o.size) return size < o.size;
+            return dpi < o.dpi;
+        }
+    };
+    std::map<Key, std::unique_ptr<GlyphAtlas>> m_atlases;
+};
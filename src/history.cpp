@@ -0,0 +1,601 @@
+#include "history.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t HISTORY_MAGIC = 0x31485743;  // "CWH1"
+constexpr float RESET_DROP = 5.0f;              // A fall this large means the window rolled over
+
+class BitWriter {
+public:
+    void Write(uint64_t value, int bits) {
+        while (bits > 0) {
+            if (m_free == 0) {
+                m_bytes.push_back(0);
+                m_free = 8;
+            }
+            int take = bits < m_free ? bits : m_free;
+            uint8_t chunk = (uint8_t)((value >> (bits - take)) & ((1u << take) - 1));
+            m_bytes.back() |= (uint8_t)(chunk << (m_free - take));
+            m_free -= take;
+            bits -= take;
+        }
+    }
+
+    std::vector<uint8_t>& Bytes() { return m_bytes; }
+
+private:
+    std::vector<uint8_t> m_bytes;
+    int m_free = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : m_data(data), m_bits(size * 8) {}
+
+    uint64_t Read(int bits) {
+        uint64_t value = 0;
+        while (bits > 0) {
+            if (m_pos >= m_bits) {
+                m_overrun = true;
+                return 0;
+            }
+            int avail = 8 - (int)(m_pos & 7);
+            int take = bits < avail ? bits : avail;
+            uint8_t chunk = (uint8_t)((m_data[m_pos >> 3] >> (avail - take)) & ((1u << take) - 1));
+            value = (value << take) | chunk;
+            m_pos += take;
+            bits -= take;
+        }
+        return value;
+    }
+
+    bool Overrun() const { return m_overrun; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_bits;
+    size_t m_pos = 0;
+    bool m_overrun = false;
+};
+
+int LeadingZeros(uint32_t x) {
+    int n = 0;
+    for (uint32_t bit = 0x80000000u; bit && !(x & bit); bit >>= 1) n++;
+    return n;
+}
+
+int TrailingZeros(uint32_t x) {
+    if (!x) return 32;
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
+// Gorilla-style delta-of-delta: regular poll cadence costs one bit per row
+struct TimeEncoder {
+    int64_t prev = 0;
+    int64_t prevDelta = 0;
+    bool first = true;
+
+    void Put(BitWriter& w, int64_t t) {
+        if (first) {
+            w.Write((uint64_t)t, 64);
+            first = false;
+            prev = t;
+            return;
+        }
+        int64_t delta = t - prev;
+        int64_t dod = delta - prevDelta;
+        prev = t;
+        prevDelta = delta;
+
+        if (dod == 0) {
+            w.Write(0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            w.Write(0x2, 2);
+            w.Write((uint64_t)(dod + 63), 7);
+        } else if (dod >= -255 && dod <= 256) {
+            w.Write(0x6, 3);
+            w.Write((uint64_t)(dod + 255), 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            w.Write(0xE, 4);
+            w.Write((uint64_t)(dod + 2047), 12);
+        } else {
+            w.Write(0xF, 4);
+            w.Write((uint64_t)dod, 64);
+        }
+    }
+
+    int64_t Get(BitReader& r) {
+        if (first) {
+            first = false;
+            prev = (int64_t)r.Read(64);
+            return prev;
+        }
+        int64_t dod;
+        if (r.Read(1) == 0) {
+            dod = 0;
+        } else if (r.Read(1) == 0) {
+            dod = (int64_t)r.Read(7) - 63;
+        } else if (r.Read(1) == 0) {
+            dod = (int64_t)r.Read(9) - 255;
+        } else if (r.Read(1) == 0) {
+            dod = (int64_t)r.Read(12) - 2047;
+        } else {
+            dod = (int64_t)r.Read(64);
+        }
+        prevDelta += dod;
+        prev += prevDelta;
+        return prev;
+    }
+};
+
+// Utilization is quantized to 0.01% first, so repeated values XOR to zero
+// and nearby ones share most of their exponent and mantissa bits
+float Quantize(float v) {
+    return std::round(v * 100.0f) / 100.0f;
+}
+
+uint32_t FloatBits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+float BitsFloat(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+struct FloatEncoder {
+    uint32_t prev = 0;
+    int prevLead = -1;
+    int prevTrail = 0;
+    bool first = true;
+
+    void Put(BitWriter& w, float value) {
+        uint32_t bits = FloatBits(Quantize(value));
+        if (first) {
+            w.Write(bits, 32);
+            first = false;
+            prev = bits;
+            return;
+        }
+        uint32_t x = bits ^ prev;
+        prev = bits;
+        if (!x) {
+            w.Write(0, 1);
+            return;
+        }
+        w.Write(1, 1);
+
+        int lead = LeadingZeros(x);
+        int trail = TrailingZeros(x);
+        if (prevLead >= 0 && lead >= prevLead && trail >= prevTrail) {
+            // Fits the previous meaningful-bit window
+            w.Write(0, 1);
+            w.Write(x >> prevTrail, 32 - prevLead - prevTrail);
+        } else {
+            int len = 32 - lead - trail;
+            w.Write(1, 1);
+            w.Write((uint64_t)lead, 5);
+            w.Write((uint64_t)(len - 1), 5);
+            w.Write(x >> trail, len);
+            prevLead = lead;
+            prevTrail = trail;
+        }
+    }
+
+    float Get(BitReader& r) {
+        if (first) {
+            first = false;
+            prev = (uint32_t)r.Read(32);
+            return BitsFloat(prev);
+        }
+        if (r.Read(1) == 0) return BitsFloat(prev);
+
+        uint32_t x;
+        if (r.Read(1) == 0) {
+            x = (uint32_t)r.Read(32 - prevLead - prevTrail) << prevTrail;
+        } else {
+            prevLead = (int)r.Read(5);
+            int len = (int)r.Read(5) + 1;
+            prevTrail = 32 - prevLead - len;
+            if (prevTrail < 0) prevTrail = 0;
+            x = (uint32_t)r.Read(len) << prevTrail;
+        }
+        prev ^= x;
+        return BitsFloat(prev);
+    }
+};
+
+// Small counters: one bit for zero, otherwise a 5-bit width and the value
+void PutUint(BitWriter& w, uint32_t v) {
+    if (!v) {
+        w.Write(0, 1);
+        return;
+    }
+    int n = 32 - LeadingZeros(v);
+    w.Write(1, 1);
+    w.Write((uint64_t)(n - 1), 5);
+    w.Write(v, n);
+}
+
+uint32_t GetUint(BitReader& r) {
+    if (r.Read(1) == 0) return 0;
+    int n = (int)r.Read(5) + 1;
+    return (uint32_t)r.Read(n);
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (i * 8)));
+}
+
+void PutI64(std::vector<uint8_t>& out, int64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back((uint8_t)((uint64_t)v >> (i * 8)));
+}
+
+struct ByteReader {
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+
+    uint32_t U32() {
+        if (pos + 4 > size) {
+            ok = false;
+            return 0;
+        }
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) v |= (uint32_t)data[pos++] << (i * 8);
+        return v;
+    }
+
+    int64_t I64() {
+        if (pos + 8 > size) {
+            ok = false;
+            return 0;
+        }
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) v |= (uint64_t)data[pos++] << (i * 8);
+        return (int64_t)v;
+    }
+
+    const uint8_t* Take(size_t n) {
+        if (pos + n > size) {
+            ok = false;
+            return nullptr;
+        }
+        const uint8_t* p = data + pos;
+        pos += n;
+        return p;
+    }
+};
+
+// Block payload: row count, then each column as [length][bit stream]
+void AppendColumn(std::vector<uint8_t>& out, BitWriter& column) {
+    PutU32(out, (uint32_t)column.Bytes().size());
+    out.insert(out.end(), column.Bytes().begin(), column.Bytes().end());
+}
+
+bool ReadColumns(const HistoryBlock& block, size_t expected, std::vector<BitReader>& columns) {
+    ByteReader in = { block.bytes.data(), block.bytes.size() };
+    if (in.U32() != block.rows) return false;
+    for (size_t i = 0; i < expected; i++) {
+        uint32_t len = in.U32();
+        const uint8_t* p = in.Take(len);
+        if (!in.ok) return false;
+        // Every row costs at least one bit in every column; a larger count
+        // is corruption, not something to allocate for
+        if (block.rows > (uint64_t)len * 8) return false;
+        columns.emplace_back(p, len);
+    }
+    return true;
+}
+
+void PutStats(BitWriter* cols, FloatEncoder* enc, const SeriesStats& s) {
+    enc[0].Put(cols[0], s.min);
+    enc[1].Put(cols[1], s.max);
+    enc[2].Put(cols[2], s.avg);
+    enc[3].Put(cols[3], s.last);
+    PutUint(cols[4], s.resets);
+}
+
+SeriesStats GetStats(BitReader* cols, FloatEncoder* enc) {
+    SeriesStats s;
+    s.min = enc[0].Get(cols[0]);
+    s.max = enc[1].Get(cols[1]);
+    s.avg = enc[2].Get(cols[2]);
+    s.last = enc[3].Get(cols[3]);
+    s.resets = GetUint(cols[4]);
+    return s;
+}
+
+// Fold b (later) into a
+void MergeStats(SeriesStats& a, uint32_t aCount, const SeriesStats& b, uint32_t bCount) {
+    if (b.min < a.min) a.min = b.min;
+    if (b.max > a.max) a.max = b.max;
+    uint32_t total = aCount + bCount;
+    if (total > 0) a.avg = (a.avg * aCount + b.avg * bCount) / total;
+    a.last = b.last;
+    a.resets += b.resets;
+}
+
+void MergeRow(RollupRow& a, const RollupRow& b) {
+    MergeStats(a.session, a.count, b.session, b.count);
+    MergeStats(a.period, a.count, b.period, b.count);
+    a.count += b.count;
+}
+
+void AddSample(SeriesStats& s, uint32_t count, float value, float prev, bool havePrev) {
+    if (count == 0) {
+        s.min = s.max = s.avg = value;
+    } else {
+        if (value < s.min) s.min = value;
+        if (value > s.max) s.max = value;
+        s.avg += (value - s.avg) / (count + 1);
+    }
+    s.last = value;
+    if (havePrev && value + RESET_DROP < prev) s.resets++;
+}
+
+void WriteBlock(std::vector<uint8_t>& out, const HistoryBlock& block) {
+    PutI64(out, block.firstTime);
+    PutI64(out, block.lastTime);
+    PutU32(out, block.rows);
+    PutU32(out, (uint32_t)block.bytes.size());
+    out.insert(out.end(), block.bytes.begin(), block.bytes.end());
+}
+
+bool ReadBlock(ByteReader& in, HistoryBlock& block) {
+    block.firstTime = in.I64();
+    block.lastTime = in.I64();
+    block.rows = in.U32();
+    uint32_t len = in.U32();
+    const uint8_t* p = in.Take(len);
+    if (!in.ok || block.rows > (uint64_t)len * 8) return false;
+    block.bytes.assign(p, p + len);
+    return true;
+}
+
+} // namespace
+
+HistoryBlock HistoryStore::EncodeRows(const RollupRow* rows, size_t count) {
+    BitWriter cols[12];
+    TimeEncoder time;
+    FloatEncoder session[4], period[4];
+
+    for (size_t i = 0; i < count; i++) {
+        time.Put(cols[0], rows[i].start);
+        PutUint(cols[1], rows[i].count);
+        PutStats(cols + 2, session, rows[i].session);
+        PutStats(cols + 7, period, rows[i].period);
+    }
+
+    HistoryBlock block;
+    block.rows = (uint32_t)count;
+    if (count > 0) {
+        block.firstTime = rows[0].start;
+        block.lastTime = rows[count - 1].start;
+    }
+    PutU32(block.bytes, block.rows);
+    for (BitWriter& col : cols) AppendColumn(block.bytes, col);
+    return block;
+}
+
+bool HistoryStore::DecodeRows(const HistoryBlock& block, std::vector<RollupRow>& out) {
+    std::vector<BitReader> cols;
+    if (!ReadColumns(block, 12, cols)) return false;
+
+    TimeEncoder time;
+    FloatEncoder session[4], period[4];
+    for (uint32_t i = 0; i < block.rows; i++) {
+        RollupRow row;
+        row.start = time.Get(cols[0]);
+        row.count = GetUint(cols[1]);
+        row.session = GetStats(&cols[2], session);
+        row.period = GetStats(&cols[7], period);
+        out.push_back(row);
+    }
+    for (const BitReader& col : cols) {
+        if (col.Overrun()) return false;
+    }
+    return true;
+}
+
+HistoryBlock HistoryStore::EncodeSamples(const UsageSample* samples, size_t count) {
+    BitWriter cols[3];
+    TimeEncoder time;
+    FloatEncoder session, period;
+
+    for (size_t i = 0; i < count; i++) {
+        time.Put(cols[0], samples[i].time);
+        session.Put(cols[1], samples[i].session);
+        period.Put(cols[2], samples[i].period);
+    }
+
+    HistoryBlock block;
+    block.rows = (uint32_t)count;
+    if (count > 0) {
+        block.firstTime = samples[0].time;
+        block.lastTime = samples[count - 1].time;
+    }
+    PutU32(block.bytes, block.rows);
+    for (BitWriter& col : cols) AppendColumn(block.bytes, col);
+    return block;
+}
+
+bool HistoryStore::DecodeSamples(const HistoryBlock& block, std::vector<UsageSample>& out) {
+    std::vector<BitReader> cols;
+    if (!ReadColumns(block, 3, cols)) return false;
+
+    TimeEncoder time;
+    FloatEncoder session, period;
+    for (uint32_t i = 0; i < block.rows; i++) {
+        UsageSample s;
+        s.time = time.Get(cols[0]);
+        s.session = session.Get(cols[1]);
+        s.period = period.Get(cols[2]);
+        out.push_back(s);
+    }
+    for (const BitReader& col : cols) {
+        if (col.Overrun()) return false;
+    }
+    return true;
+}
+
+void HistoryStore::Append(const UsageSample& sample) {
+    if (!m_raw.empty() && sample.time <= m_raw.back().time) return;
+    if (m_haveLastRolled && sample.time <= m_lastRolled.time) return;
+    m_raw.push_back(sample);
+}
+
+void HistoryStore::AddRow(Tier& tier, const RollupRow& row) {
+    if (!tier.tail.empty()) {
+        RollupRow& last = tier.tail.back();
+        if (row.start == last.start) {
+            MergeRow(last, row);
+            return;
+        }
+        if (row.start < last.start) return;
+    } else if (!tier.blocks.empty() && row.start <= tier.blocks.back().lastTime) {
+        return;
+    }
+
+    // Seal only once a new row arrives: a day is rolled up an hour at a time,
+    // and the rest of it has to be able to merge into the last row
+    if (tier.tail.size() >= blockRows) Seal(tier);
+    tier.tail.push_back(row);
+}
+
+void HistoryStore::Seal(Tier& tier) {
+    if (tier.tail.empty()) return;
+    tier.blocks.push_back(EncodeRows(tier.tail.data(), tier.tail.size()));
+    tier.tail.clear();
+}
+
+void HistoryStore::Compact(int64_t nowSec) {
+    // Raw -> hourly, whole hours only
+    int64_t hourCutoff = (nowSec - rawWindowSec) / 3600 * 3600;
+    size_t rolled = 0;
+    while (rolled < m_raw.size() && m_raw[rolled].time < hourCutoff) {
+        RollupRow row;
+        row.start = m_raw[rolled].time / 3600 * 3600;
+        while (rolled < m_raw.size() && m_raw[rolled].time < row.start + 3600 &&
+               m_raw[rolled].time < hourCutoff) {
+            const UsageSample& s = m_raw[rolled];
+            AddSample(row.session, row.count, s.session, m_lastRolled.session, m_haveLastRolled);
+            AddSample(row.period, row.count, s.period, m_lastRolled.period, m_haveLastRolled);
+            row.count++;
+            m_lastRolled = s;
+            m_haveLastRolled = true;
+            rolled++;
+        }
+        AddRow(m_hourly, row);
+    }
+    m_raw.erase(m_raw.begin(), m_raw.begin() + rolled);
+
+    // Hourly -> daily, whole UTC days only. Expired rows sit at the front.
+    int64_t dayCutoff = (nowSec - hourlyWindowSec) / 86400 * 86400;
+    std::vector<RollupRow> expired;
+    while (!m_hourly.blocks.empty() && m_hourly.blocks.front().firstTime < dayCutoff) {
+        std::vector<RollupRow> rows;
+        DecodeRows(m_hourly.blocks.front(), rows);
+        m_hourly.blocks.erase(m_hourly.blocks.begin());
+
+        size_t split = 0;
+        while (split < rows.size() && rows[split].start < dayCutoff) split++;
+        expired.insert(expired.end(), rows.begin(), rows.begin() + split);
+        if (split < rows.size()) {
+            m_hourly.blocks.insert(m_hourly.blocks.begin(),
+                                   EncodeRows(rows.data() + split, rows.size() - split));
+            break;
+        }
+    }
+    if (m_hourly.blocks.empty()) {
+        size_t split = 0;
+        while (split < m_hourly.tail.size() && m_hourly.tail[split].start < dayCutoff) split++;
+        expired.insert(expired.end(), m_hourly.tail.begin(), m_hourly.tail.begin() + split);
+        m_hourly.tail.erase(m_hourly.tail.begin(), m_hourly.tail.begin() + split);
+    }
+
+    for (const RollupRow& hour : expired) {
+        RollupRow day = hour;
+        day.start = hour.start / 86400 * 86400;
+        AddRow(m_daily, day);
+    }
+}
+
+std::vector<RollupRow> HistoryStore::Rollups(HistoryTier tier) const {
+    const Tier& t = tier == HistoryTier::Hourly ? m_hourly : m_daily;
+    std::vector<RollupRow> rows;
+    for (const HistoryBlock& block : t.blocks) DecodeRows(block, rows);
+    rows.insert(rows.end(), t.tail.begin(), t.tail.end());
+    return rows;
+}
+
+size_t HistoryStore::CompressedBytes() const {
+    size_t total = 0;
+    for (const HistoryBlock& b : m_hourly.blocks) total += b.bytes.size();
+    for (const HistoryBlock& b : m_daily.blocks) total += b.bytes.size();
+    return total;
+}
+
+// File layout: magic, raw samples block, last rolled sample, then each tier as
+// a block count and blocks. Unsealed tails are written as a final short block.
+std::vector<uint8_t> HistoryStore::Serialize() const {
+    std::vector<uint8_t> out;
+    PutU32(out, HISTORY_MAGIC);
+    WriteBlock(out, EncodeSamples(m_raw.data(), m_raw.size()));
+    PutU32(out, m_haveLastRolled ? 1 : 0);
+    WriteBlock(out, EncodeSamples(&m_lastRolled, 1));
+
+    for (const Tier* tier : { &m_hourly, &m_daily }) {
+        PutU32(out, (uint32_t)(tier->blocks.size() + (tier->tail.empty() ? 0 : 1)));
+        for (const HistoryBlock& block : tier->blocks) WriteBlock(out, block);
+        if (!tier->tail.empty()) {
+            WriteBlock(out, EncodeRows(tier->tail.data(), tier->tail.size()));
+        }
+    }
+    return out;
+}
+
+bool HistoryStore::Deserialize(const std::vector<uint8_t>& data) {
+    ByteReader in = { data.data(), data.size() };
+    if (in.U32() != HISTORY_MAGIC) return false;
+
+    HistoryBlock block;
+    std::vector<UsageSample> raw, lastRolled;
+    if (!ReadBlock(in, block) || !DecodeSamples(block, raw)) return false;
+    bool haveLastRolled = in.U32() != 0;
+    if (!ReadBlock(in, block) || !DecodeSamples(block, lastRolled) || lastRolled.size() != 1) return false;
+
+    Tier tiers[2];
+    for (Tier& tier : tiers) {
+        uint32_t count = in.U32();
+        for (uint32_t i = 0; i < count && in.ok; i++) {
+            if (!ReadBlock(in, block)) return false;
+            tier.blocks.push_back(block);
+        }
+        if (!in.ok) return false;
+
+        // Reopen a short final block so restarts don't leave a trail of tiny ones
+        if (!tier.blocks.empty() && tier.blocks.back().rows < blockRows) {
+            if (!DecodeRows(tier.blocks.back(), tier.tail)) return false;
+            tier.blocks.pop_back();
+        }
+    }
+
+    m_raw = std::move(raw);
+    m_lastRolled = lastRolled[0];
+    m_haveLastRolled = haveLastRolled;
+    m_hourly = std::move(tiers[0]);
+    m_daily = std::move(tiers[1]);
+    return true;
+}
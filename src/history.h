@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// One successful poll
+struct UsageSample {
+    int64_t time = 0;       // Unix seconds
+    float session = 0.0f;   // five_hour utilization, 0-100
+    float period = 0.0f;    // seven_day utilization, 0-100
+};
+
+struct SeriesStats {
+    float min = 0.0f;
+    float max = 0.0f;
+    float avg = 0.0f;
+    float last = 0.0f;
+    uint32_t resets = 0;    // Times utilization fell back (the limit window rolled over)
+};
+
+// Aggregate of all samples in one hour or one (UTC) day
+struct RollupRow {
+    int64_t start = 0;      // Bucket start, Unix seconds
+    uint32_t count = 0;     // Samples aggregated
+    SeriesStats session;
+    SeriesStats period;
+};
+
+enum class HistoryTier {
+    Hourly,
+    Daily
+};
+
+// A sealed run of rows, stored column by column: delta-of-delta timestamps,
+// XOR-encoded quantized floats and variable-width integers, one bit stream
+// per column
+struct HistoryBlock {
+    int64_t firstTime = 0;
+    int64_t lastTime = 0;
+    uint32_t rows = 0;
+    std::vector<uint8_t> bytes;
+};
+
+// Usage history with tiered retention: raw samples for a recent window, then
+// hourly rollups, then daily rollups forever. Compact() moves data down the
+// tiers and is cheap enough to run from a low-priority scheduler task.
+class HistoryStore {
+public:
+    int64_t rawWindowSec = 7 * 86400;
+    int64_t hourlyWindowSec = 400 * 86400;
+    uint32_t blockRows = 256;
+
+    // Samples must arrive in time order; anything older than the newest is dropped
+    void Append(const UsageSample& sample);
+
+    // Roll expired raw samples into hours and expired hours into days
+    void Compact(int64_t nowSec);
+
+    const std::vector<UsageSample>& Raw() const { return m_raw; }
+
+    // Decoded rows of a tier, oldest first
+    std::vector<RollupRow> Rollups(HistoryTier tier) const;
+
+    size_t CompressedBytes() const;
+
+    std::vector<uint8_t> Serialize() const;
+    bool Deserialize(const std::vector<uint8_t>& data);
+
+    static HistoryBlock EncodeRows(const RollupRow* rows, size_t count);
+    static bool DecodeRows(const HistoryBlock& block, std::vector<RollupRow>& out);
+    static HistoryBlock EncodeSamples(const UsageSample* samples, size_t count);
+    static bool DecodeSamples(const HistoryBlock& block, std::vector<UsageSample>& out);
+
+private:
+    struct Tier {
+        std::vector<HistoryBlock> blocks;   // Sealed, oldest first
+        std::vector<RollupRow> tail;        // Newest rows, not sealed yet
+    };
+
+    std::vector<UsageSample> m_raw;
+    UsageSample m_lastRolled;       // Last sample folded into an hour, for reset detection
+    bool m_haveLastRolled = false;
+    Tier m_hourly;
+    Tier m_daily;
+
+    void AddRow(Tier& tier, const RollupRow& row);
+    void Seal(Tier& tier);
+};
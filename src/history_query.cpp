@@ -0,0 +1,335 @@
+#include "history_query.h"
+#include "timeutil.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+namespace {
+
+constexpr size_t LANES = 8;
+
+// p95 comes from a histogram at the API's own resolution (0.1%) rather than
+// sorting every value; 0-120% covers anything the server reports
+constexpr float PCT_STEP = 0.1f;
+constexpr size_t PCT_BINS = 1201;
+
+// Partial aggregate over a contiguous run of rows
+struct SpanAggregate {
+    float min = INFINITY;
+    float max = -INFINITY;
+    double sum = 0.0;       // value * weight
+    double weight = 0.0;
+    uint64_t over = 0;
+};
+
+struct GroupAggregate {
+    SpanAggregate agg;
+    std::vector<double> histogram = std::vector<double>(PCT_BINS);
+    double weight = 0.0;
+};
+
+// Each row lands in its bin with the samples it stands for, so an hourly
+// rollup weighs as much as the hour of polls it replaced
+void AddToHistogram(const float* value, const float* weight, size_t count, GroupAggregate& g) {
+    double* bins = g.histogram.data();
+    for (size_t i = 0; i < count; i++) {
+        float bin = value[i] / PCT_STEP + 0.5f;
+        bin = bin < 0.0f ? 0.0f : (bin > (float)(PCT_BINS - 1) ? (float)(PCT_BINS - 1) : bin);
+        bins[(size_t)bin] += weight[i];
+        g.weight += weight[i];
+    }
+}
+
+// Weighted nearest-rank percentile. The rank is nudged down so float error
+// in p * weight can't push an exact rank past its bin.
+float HistogramPercentile(const GroupAggregate& g, double p) {
+    double rank = p * g.weight * (1.0 - 1e-9);
+    double seen = 0.0;
+    for (size_t i = 0; i < PCT_BINS; i++) {
+        seen += g.histogram[i];
+        if (seen > 0.0 && seen >= rank) return i * PCT_STEP;
+    }
+    return (PCT_BINS - 1) * PCT_STEP;
+}
+
+// A row climbs to the threshold if it reached it and either the row before
+// hadn't or its own minimum was below it (a rollup that dipped and came back)
+inline uint32_t Crossed(float low, float high, float prevHigh, float threshold) {
+    return high >= threshold && (prevHigh < threshold || low < threshold) ? 1u : 0u;
+}
+
+// The hot loop. Fixed-width lane accumulators with no data-dependent
+// branches, so the compiler turns each lane array into a vector register
+// (min/max/fma/compare) without needing -ffast-math to reorder the sums.
+// prevHigh is the high of the row before `begin`, -inf if there is none.
+void AggregateSpan(const ColumnBlock& b, size_t begin, size_t end, float threshold, float prevHigh,
+                   SpanAggregate& out) {
+    if (begin >= end) return;
+    const float* value = b.value.data();
+    const float* low = b.low.data();
+    const float* high = b.high.data();
+    const float* weight = b.weight.data();
+
+    float mn[LANES], mx[LANES], sum[LANES], w[LANES];
+    uint32_t over[LANES];
+    for (size_t k = 0; k < LANES; k++) {
+        mn[k] = INFINITY;
+        mx[k] = -INFINITY;
+        sum[k] = 0.0f;
+        w[k] = 0.0f;
+        over[k] = 0;
+    }
+
+    // The first row compares against prevHigh; the rest against high[i - 1]
+    mn[0] = low[begin];
+    mx[0] = high[begin];
+    sum[0] = value[begin] * weight[begin];
+    w[0] = weight[begin];
+    over[0] = Crossed(low[begin], high[begin], prevHigh, threshold);
+
+    size_t i = begin + 1;
+    for (; i + LANES <= end; i += LANES) {
+        for (size_t k = 0; k < LANES; k++) {
+            float lo = low[i + k];
+            float hi = high[i + k];
+            mn[k] = lo < mn[k] ? lo : mn[k];
+            mx[k] = hi > mx[k] ? hi : mx[k];
+            sum[k] += value[i + k] * weight[i + k];
+            w[k] += weight[i + k];
+            over[k] += Crossed(lo, hi, high[i + k - 1], threshold);
+        }
+    }
+    for (; i < end; i++) {
+        mn[0] = std::min(mn[0], low[i]);
+        mx[0] = std::max(mx[0], high[i]);
+        sum[0] += value[i] * weight[i];
+        w[0] += weight[i];
+        over[0] += Crossed(low[i], high[i], high[i - 1], threshold);
+    }
+
+    for (size_t k = 0; k < LANES; k++) {
+        out.min = std::min(out.min, mn[k]);
+        out.max = std::max(out.max, mx[k]);
+        out.sum += sum[k];
+        out.weight += w[k];
+        out.over += over[k];
+    }
+}
+
+int64_t FloorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+int64_t FloorMod(int64_t a, int64_t b) {
+    return a - FloorDiv(a, b) * b;
+}
+
+const char* const WEEKDAYS[] = { "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+
+std::string GroupLabel(QueryGroup group, int64_t key) {
+    char buf[32];
+    switch (group) {
+    case QueryGroup::Hour:
+        snprintf(buf, sizeof(buf), "%02d:00", (int)key);
+        return buf;
+    case QueryGroup::Weekday:
+        return WEEKDAYS[key];
+    case QueryGroup::Day: {
+        int year, month, day;
+        CivilFromDays(key, year, month, day);
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02d", year, month, day);
+        return buf;
+    }
+    default:
+        return "all";
+    }
+}
+
+const char* GroupName(QueryGroup group) {
+    switch (group) {
+    case QueryGroup::Hour: return "hour";
+    case QueryGroup::Day: return "day";
+    case QueryGroup::Weekday: return "weekday";
+    default: return "none";
+    }
+}
+
+} // namespace
+
+void HistoryTable::Append(int64_t time, float value, float low, float high, float weight) {
+    if (m_blocks.empty() || m_blocks.back().time.size() >= BLOCK_ROWS) {
+        m_blocks.emplace_back();
+        ColumnBlock& b = m_blocks.back();
+        b.time.reserve(BLOCK_ROWS);
+        b.value.reserve(BLOCK_ROWS);
+        b.low.reserve(BLOCK_ROWS);
+        b.high.reserve(BLOCK_ROWS);
+        b.weight.reserve(BLOCK_ROWS);
+    }
+    ColumnBlock& b = m_blocks.back();
+    b.time.push_back(time);
+    b.value.push_back(value);
+    b.low.push_back(low);
+    b.high.push_back(high);
+    b.weight.push_back(weight);
+    m_rows++;
+}
+
+HistoryTable HistoryTable::FromStore(const HistoryStore& store, HistorySeries series) {
+    HistoryTable table;
+    int64_t last = INT64_MIN;
+
+    // Tiers are disjoint in time, oldest data in the coarsest tier
+    for (HistoryTier tier : { HistoryTier::Daily, HistoryTier::Hourly }) {
+        for (const RollupRow& row : store.Rollups(tier)) {
+            if (row.start <= last || row.count == 0) continue;
+            const SeriesStats& s = series == HistorySeries::Session ? row.session : row.period;
+            table.Append(row.start, s.avg, s.min, s.max, (float)row.count);
+            last = row.start;
+        }
+    }
+    for (const UsageSample& sample : store.Raw()) {
+        if (sample.time <= last) continue;
+        float v = series == HistorySeries::Session ? sample.session : sample.period;
+        table.Append(sample.time, v, v, v, 1.0f);
+        last = sample.time;
+    }
+    return table;
+}
+
+std::vector<QueryRow> RunHistoryQuery(const HistoryTable& table, const HistoryQuery& query) {
+    int64_t unit = 0;
+    switch (query.group) {
+    case QueryGroup::Hour: unit = 3600; break;
+    case QueryGroup::Day:
+    case QueryGroup::Weekday: unit = 86400; break;
+    default: break;
+    }
+    float threshold = query.useThreshold ? query.threshold : INFINITY;
+
+    std::map<int64_t, GroupAggregate> groups;
+
+    // High of the last row of the previous block, for crossings at a boundary
+    float lastHigh = -INFINITY;
+    for (const ColumnBlock& b : table.Blocks()) {
+        float before = lastHigh;
+        if (!b.high.empty()) lastHigh = b.high.back();
+        if (b.time.empty() || b.time.back() < query.from || b.time.front() >= query.to) continue;
+        const int64_t* t = b.time.data();
+        size_t n = b.time.size();
+        size_t begin = std::lower_bound(t, t + n, query.from) - t;
+        size_t end = std::lower_bound(t, t + n, query.to) - t;
+
+        // Rows are time ordered, so every hour/day bucket is one contiguous
+        // run; find its end and aggregate the run as a whole
+        size_t i = begin;
+        while (i < end) {
+            size_t j = end;
+            int64_t key = 0;
+            if (unit != 0) {
+                int64_t bucket = FloorDiv(t[i] + query.utcOffsetSec, unit);
+                int64_t boundary = (bucket + 1) * unit - query.utcOffsetSec;
+                j = std::lower_bound(t + i, t + end, boundary) - t;
+                if (query.group == QueryGroup::Hour) key = FloorMod(bucket, 24);
+                else if (query.group == QueryGroup::Weekday) key = FloorMod(bucket + 3, 7);   // 1970-01-01 was a Thursday
+                else key = bucket;
+            }
+
+            GroupAggregate& g = groups[key];
+            AggregateSpan(b, i, j, threshold, i > 0 ? b.high[i - 1] : before, g.agg);
+            AddToHistogram(b.value.data() + i, b.weight.data() + i, j - i, g);
+            i = j;
+        }
+    }
+
+    std::vector<QueryRow> out;
+    out.reserve(groups.size());
+    for (const auto& entry : groups) {
+        const GroupAggregate& g = entry.second;
+        QueryRow row;
+        row.key = entry.first;
+        row.samples = g.agg.weight;
+        row.min = g.agg.min;
+        row.max = g.agg.max;
+        row.avg = g.agg.weight > 0 ? (float)(g.agg.sum / g.agg.weight) : 0.0f;
+        row.over = g.agg.over;
+        row.p95 = HistogramPercentile(g, 0.95);
+        out.push_back(row);
+    }
+    return out;
+}
+
+std::string FormatQueryResult(const std::vector<QueryRow>& rows, const HistoryQuery& query,
+                              HistorySeries series, QueryFormat format) {
+    std::string out;
+    char buf[256];
+    char overName[32];
+    snprintf(overName, sizeof(overName), ">=%g", query.threshold);
+
+    switch (format) {
+    case QueryFormat::Table:
+        snprintf(buf, sizeof(buf), "%-10s %10s %7s %7s %7s %7s", "group", "samples", "min", "max", "avg", "p95");
+        out += buf;
+        if (query.useThreshold) {
+            snprintf(buf, sizeof(buf), " %7s", overName);
+            out += buf;
+        }
+        out += '\n';
+        for (const QueryRow& r : rows) {
+            snprintf(buf, sizeof(buf), "%-10s %10.0f %7.1f %7.1f %7.1f %7.1f", GroupLabel(query.group, r.key).c_str(),
+                     r.samples, r.min, r.max, r.avg, r.p95);
+            out += buf;
+            if (query.useThreshold) {
+                snprintf(buf, sizeof(buf), " %7llu", (unsigned long long)r.over);
+                out += buf;
+            }
+            out += '\n';
+        }
+        break;
+
+    case QueryFormat::Csv:
+        out += "group,samples,min,max,avg,p95";
+        if (query.useThreshold) {
+            snprintf(buf, sizeof(buf), ",over_%g", query.threshold);
+            out += buf;
+        }
+        out += '\n';
+        for (const QueryRow& r : rows) {
+            snprintf(buf, sizeof(buf), "%s,%.0f,%.2f,%.2f,%.2f,%.2f", GroupLabel(query.group, r.key).c_str(),
+                     r.samples, r.min, r.max, r.avg, r.p95);
+            out += buf;
+            if (query.useThreshold) {
+                snprintf(buf, sizeof(buf), ",%llu", (unsigned long long)r.over);
+                out += buf;
+            }
+            out += '\n';
+        }
+        break;
+
+    case QueryFormat::Json:
+        snprintf(buf, sizeof(buf), "{\"series\":\"%s\",\"group\":\"%s\"",
+                 series == HistorySeries::Session ? "session" : "period", GroupName(query.group));
+        out += buf;
+        if (query.useThreshold) {
+            snprintf(buf, sizeof(buf), ",\"threshold\":%g", query.threshold);
+            out += buf;
+        }
+        out += ",\"rows\":[";
+        for (size_t i = 0; i < rows.size(); i++) {
+            const QueryRow& r = rows[i];
+            snprintf(buf, sizeof(buf), "%s{\"group\":\"%s\",\"samples\":%.0f,\"min\":%.2f,\"max\":%.2f,\"avg\":%.2f,\"p95\":%.2f",
+                     i ? "," : "", GroupLabel(query.group, r.key).c_str(), r.samples, r.min, r.max, r.avg, r.p95);
+            out += buf;
+            if (query.useThreshold) {
+                snprintf(buf, sizeof(buf), ",\"over\":%llu", (unsigned long long)r.over);
+                out += buf;
+            }
+            out += '}';
+        }
+        out += "]}\n";
+        break;
+    }
+    return out;
+}
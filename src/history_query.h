@@ -0,0 +1,85 @@
+#pragma once
+
+#include "history.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+enum class HistorySeries {
+    Session,    // five_hour
+    Period,     // seven_day
+};
+
+// One column block of a HistoryTable: up to BLOCK_ROWS rows, time ordered,
+// one contiguous array per field so aggregation loops stream straight
+// through them
+struct ColumnBlock {
+    std::vector<int64_t> time;      // Unix seconds (bucket start for rollups)
+    std::vector<float> value;       // Sample, or rollup average
+    std::vector<float> low;         // Sample, or rollup min
+    std::vector<float> high;        // Sample, or rollup max
+    std::vector<float> weight;      // Samples the row stands for
+};
+
+// A read-only, columnar copy of one series from a HistoryStore: daily
+// rollups, then hourly rollups, then raw samples, with no overlap.
+class HistoryTable {
+public:
+    static constexpr size_t BLOCK_ROWS = 65536;
+
+    static HistoryTable FromStore(const HistoryStore& store, HistorySeries series);
+
+    void Append(int64_t time, float value, float low, float high, float weight);
+
+    const std::vector<ColumnBlock>& Blocks() const { return m_blocks; }
+    size_t Rows() const { return m_rows; }
+
+private:
+    std::vector<ColumnBlock> m_blocks;
+    size_t m_rows = 0;
+};
+
+enum class QueryGroup {
+    None,
+    Hour,       // Hour of day, 0-23
+    Day,        // Calendar day
+    Weekday,    // 0 = Monday
+};
+
+enum class QueryFormat {
+    Table,
+    Csv,
+    Json,
+};
+
+struct HistoryQuery {
+    int64_t from = INT64_MIN;       // Unix seconds, inclusive
+    int64_t to = INT64_MAX;         // Unix seconds, exclusive
+    QueryGroup group = QueryGroup::None;
+    bool useThreshold = false;
+    float threshold = 100.0f;       // For the count-over-threshold column
+    int32_t utcOffsetSec = 0;       // Where hour/day/weekday boundaries fall
+};
+
+struct QueryRow {
+    int64_t key = 0;        // Hour, weekday, days since epoch, or 0
+    double samples = 0;     // Samples covered (rollup rows count for many)
+    float min = 0.0f;
+    float max = 0.0f;
+    float avg = 0.0f;       // Sample-weighted
+    float p95 = 0.0f;       // Sample-weighted over row values (a rollup's average), to 0.1%
+    uint64_t over = 0;      // Climbs to the threshold, see below
+};
+
+// `over` counts distinct upward crossings of the threshold, not rows: a run of
+// rows at or above it counts once. A rollup row counts at most once, when it
+// reached the threshold and either dipped below it or followed a row that
+// hadn't, so older data can undercount repeated hits within an hour or day.
+// The row before `from` decides whether the first row in range is a crossing.
+
+// Groups come back in key order; groups with no rows are left out
+std::vector<QueryRow> RunHistoryQuery(const HistoryTable& table, const HistoryQuery& query);
+
+std::string FormatQueryResult(const std::vector<QueryRow>& rows, const HistoryQuery& query,
+                              HistorySeries series, QueryFormat format);
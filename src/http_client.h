@@ -2,6 +2,8 @@
 
 #include <string>
 #include <functional>
+#include <atomic>
+#include <memory>
 
 enum class HttpStatus {
     Success,
@@ -18,13 +20,42 @@ struct HttpResponse {
     std::wstring error;
 };
 
+// Puts one request on the wire. Fills statusCode and body, or leaves status
+// NetworkError with an error message; HttpClient classifies the status code.
+// Must be safe to call from several threads at once.
+class HttpTransport {
+public:
+    virtual ~HttpTransport() {}
+
+    virtual HttpResponse Send(const wchar_t* verb, const std::wstring& url, const std::wstring& cookie,
+                              const std::string* body, const wchar_t* contentType,
+                              const std::atomic<bool>* cancel) = 0;
+};
+
+#ifdef _WIN32
+std::unique_ptr<HttpTransport> CreateWinHttpTransport();
+#else
+// Plain sockets, with OpenSSL for https:// when built with it
+std::unique_ptr<HttpTransport> CreatePosixHttpTransport();
+#endif
+
 class HttpClient {
 public:
-    HttpClient();
+    HttpClient();   // The platform's transport
+    explicit HttpClient(std::unique_ptr<HttpTransport> transport);
     ~HttpClient();
 
-    HttpResponse Get(const std::wstring& url, const std::wstring& cookie);
+    // Safe to call from several threads at once. If cancel becomes true the
+    // request is abandoned at the next phase boundary or body chunk.
+    HttpResponse Get(const std::wstring& url, const std::wstring& cookie,
+                     const std::atomic<bool>* cancel = nullptr);
+
+    HttpResponse Post(const std::wstring& url, const std::string& body, const wchar_t* contentType,
+                      const std::atomic<bool>* cancel = nullptr);
 
 private:
-    void* m_session; // HINTERNET
+    std::unique_ptr<HttpTransport> m_transport;
+
+    HttpResponse Send(const wchar_t* verb, const std::wstring& url, const std::wstring& cookie,
+                      const std::string* body, const wchar_t* contentType, const std::atomic<bool>* cancel);
 };
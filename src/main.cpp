@@ -3,6 +3,7 @@
 #include <shellapi.h>
 #include <commctrl.h>
 #include <windowsx.h>
+#include <wtsapi32.h>
 #include <string>
 #include <ctime>
 
@@ -11,51 +12,190 @@
 #include "http_client.h"
 #include "parser.h"
 #include "ui.h"
+#include "activity.h"
+#include "net_watch.h"
+#include "scheduler.h"
+#include "history.h"
+#include "file_util.h"
+#include "refresh.h"
+#include "refresh_controller.h"
+#include "sparkline.h"
+#include "tray_icon.h"
+#include "session_logs.h"
+#include "timeutil.h"
+#include "watchdog.h"
+#include "trace.h"
+#include "cli.h"
+#include "aggregator.h"
+#include "forecast.h"
+#include "org_directory.h"
+#include "subscribe.h"
+#include "text_util.h"
+#include "workers.h"
 
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "shlwapi.lib")
+#pragma comment(lib, "wtsapi32.lib")
 
 // Globals
 static HWND g_hwnd = nullptr;
 static WidgetUI g_ui;
-static HttpClient g_http;
-static UsageParser g_parser;
+// Shared with refresh and push workers, which hold their own references
+static std::shared_ptr<HttpClient> g_http = std::make_shared<HttpClient>();
 static UsageData g_usageData;
-static bool g_offline = false;
 static bool g_demoMode = false;
 static wchar_t g_lastUpdate[64] = L"";
-static UINT_PTR g_timerId = 0;
 static bool g_dragging = false;
 static POINT g_dragStart = { 0, 0 };
-
-// Timer IDs
-constexpr UINT_PTR TIMER_REFRESH = 1;
+static HPOWERNOTIFY g_displayNotify = nullptr;
+static HPOWERNOTIFY g_powerSourceNotify = nullptr;
+static NetworkWatcher g_netWatcher;
+static bool g_compacting = false;
+static DeadlineScheduler g_scheduler;
+static RefreshController g_refresh(g_scheduler);   // Polling, org, reconnect and countdown state
+static uint64_t g_armedWake = 0;
+static HistoryStore g_history;
+static BurnForecaster g_forecaster;
+static WorkerGroup g_workers;   // Joined before exit
+static SubscriptionHub g_subscriptions;
+static Sparkline g_sessionTrend(5 * 3600, SPARKLINE_COLUMNS);
+static Sparkline g_periodTrend(7 * 86400, SPARKLINE_COLUMNS);
+static NOTIFYICONDATAW g_trayData = {};
+static bool g_trayAdded = false;
+static HICON g_trayIcon = nullptr;
+static UINT g_taskbarCreatedMsg = 0;
+static SessionLogTailer g_logs;
+static LogWatcher g_logWatcher;
+static UsageEstimator g_estimator;
+static std::atomic<bool> g_pushing{ false };
+static CancelToken g_pushCancel = std::make_shared<std::atomic<bool>>(false);
+static StallMonitor g_stallMonitor;
+static DWORD g_startTick = 0;
+static HWND g_tooltip = nullptr;
+
+// Timer IDs - all timed work goes through g_scheduler on this one timer
+constexpr UINT_PTR TIMER_SCHEDULER = 1;
 constexpr UINT TIMER_INTERVAL_MS = 60000; // Base: 1 minute
 
+// Scheduler tasks, after the ones g_refresh owns
+enum : DeadlineScheduler::TaskId {
+    TASK_SAVECONFIG = RefreshController::FIRST_HOST_TASK,
+    TASK_COMPACT,
+    TASK_LOGSCAN,
+};
+
+constexpr uint64_t COMPACT_INTERVAL_MS = 15 * 60 * 1000;
+
+// Posted by the refresh worker; lParam owns a RefreshResult*
+constexpr UINT WM_APP_REFRESH_DONE = WM_APP + 1;
+// Tray icon callback
+constexpr UINT WM_APP_TRAY = WM_APP + 2;
+constexpr UINT TRAY_ICON_ID = 1;
+// Posted from the transcript watcher thread
+constexpr UINT WM_APP_LOGS_CHANGED = WM_APP + 3;
+// Posted by the stall watchdog; measures message-loop latency
+constexpr UINT WM_APP_PING = WM_APP + 4;
+// Posted by the reconnect probe worker; wParam is 1 if the API host answered
+constexpr UINT WM_APP_PROBE_DONE = WM_APP + 5;
+// Posted by the compaction worker; lParam owns a CompactResult*
+constexpr UINT WM_APP_COMPACT_DONE = WM_APP + 6;
+
+// The compacted copy of g_history, and the newest sample it had. Anything
+// appended after that is carried over when it replaces g_history.
+struct CompactResult {
+    HistoryStore history;
+    int64_t through = 0;
+};
+
 // Forward declarations
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
-void RefreshUsage();
+void InitRefresh();
+bool CanRefresh();
+void StartRefresh(const OrgChoice& org, uint64_t generation, const CancelToken& cancel);
+void ApplyRefreshResult(const RefreshResult& result);
+void ShowCountdown(const ResetDeadline& session, const ResetDeadline& period, const ClockSample& now);
 void ShowContextMenu(HWND hwnd, int x, int y);
 void ShowCookieDialog(HWND hwnd);
+void ShowDiagnostics(HWND hwnd);
+void SaveTrace(HWND hwnd);
 int GetRefreshInterval();
-
-// URLs for Claude.ai API
-const wchar_t* ORGS_URL = L"https://claude.ai/api/organizations";
-static std::wstring g_orgId;
-static std::wstring g_usageUrl;
+void ScheduleConfigSave();
+void ArmSchedulerTimer();
+void RegisterActivityNotifications(HWND hwnd);
+void UnregisterActivityNotifications(HWND hwnd);
+void ProbeApiHost();
+void StartCompaction();
+void ApplyCompaction(CompactResult& result);
+DWORD GetIdleSeconds();
+void LoadHistory();
+void SaveHistory();
+void LoadForecast();
+void SaveForecast();
+void LoadOrgs();
+void SaveOrgs();
+void PinOrganization(const std::wstring& pin);
+std::wstring GetForecastText();
+void StartLogTailing();
+void SaveLogState();
+void ApplyEstimate();
+void PushToAggregator();
+void PublishUsage();
+void SetTrayMode(bool enabled);
+void UpdateTrayIcon();
+
+// Claude.ai API host, for the reconnect probe
+const char* API_HOST = "claude.ai";
+
+// "ClaudeWatch.exe history ..." runs a subcommand against the parent
+// console instead of opening the widget
+static bool RunCliFromGui(int& exitCode) {
+    int argc = 0;
+    LPWSTR* argvW = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argvW) return false;
+
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; i++) args.push_back(WideToUtf8(argvW[i]));
+    LocalFree(argvW);
+    if (args.size() < 2 || !IsCliCommand(args[1].c_str())) return false;
+
+    if (!AttachConsole(ATTACH_PARENT_PROCESS)) AllocConsole();
+    FILE* f;
+    freopen_s(&f, "CONOUT$", "w", stdout);
+    freopen_s(&f, "CONOUT$", "w", stderr);
+
+    std::vector<char*> argv;
+    for (std::string& s : args) argv.push_back(&s[0]);
+    exitCode = RunCli((int)argv.size(), argv.data());
+    fflush(stdout);
+    return true;
+}
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR cmdLine, int) {
+    int exitCode;
+    if (RunCliFromGui(exitCode)) return exitCode;
+
     // Check for demo mode
     if (cmdLine && wcsstr(cmdLine, L"--demo")) {
         g_demoMode = true;
     }
 
+    TraceSetThreadName("UI");
+
+    // NLM network events are delivered to this (STA) thread's message loop
+    CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+
     // Init common controls
-    INITCOMMONCONTROLSEX icc = { sizeof(icc), ICC_STANDARD_CLASSES };
+    INITCOMMONCONTROLSEX icc = { sizeof(icc), ICC_STANDARD_CLASSES | ICC_BAR_CLASSES };
     InitCommonControlsEx(&icc);
 
     // Load config
     GetConfig().Load();
+    InitRefresh();
+    if (!g_demoMode) {
+        LoadHistory();
+        LoadForecast();
+        LoadOrgs();
+    }
 
     // Init UI
     if (!g_ui.Init()) {
@@ -110,34 +250,90 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR cmdLine, int) {
         return 1;
     }
 
+    // Hover tooltip over the whole widget; text is asked for when it shows
+    g_tooltip = CreateWindowExW(WS_EX_TOPMOST, TOOLTIPS_CLASSW, nullptr, WS_POPUP | TTS_ALWAYSTIP | TTS_NOPREFIX,
+                                0, 0, 0, 0, g_hwnd, nullptr, hInstance, nullptr);
+    if (g_tooltip) {
+        TOOLINFOW ti = { sizeof(ti) };
+        ti.uFlags = TTF_IDISHWND | TTF_SUBCLASS;
+        ti.hwnd = g_hwnd;
+        ti.uId = (UINT_PTR)g_hwnd;
+        ti.lpszText = LPSTR_TEXTCALLBACKW;
+        SendMessageW(g_tooltip, TTM_ADDTOOLW, 0, (LPARAM)&ti);
+        SendMessageW(g_tooltip, TTM_SETMAXTIPWIDTH, 0, 400);
+    }
+
     // Set opacity
     SetLayeredWindowAttributes(g_hwnd, 0, (BYTE)(cfg.opacity * 255 / 100), LWA_ALPHA);
 
-    // Show window
-    ShowWindow(g_hwnd, SW_SHOW);
-    UpdateWindow(g_hwnd);
+    // Show window (tray mode starts hidden; clicking the icon shows it)
+    g_taskbarCreatedMsg = RegisterWindowMessageW(L"TaskbarCreated");
+    if (cfg.trayMode) {
+        SetTrayMode(true);
+    } else {
+        ShowWindow(g_hwnd, SW_SHOW);
+        UpdateWindow(g_hwnd);
+    }
 
     // Initial data
     if (g_demoMode) {
         g_usageData = UsageData::TestData();
         wcscpy_s(g_lastUpdate, L"Demo mode");
     } else if (!cfg.sessionCookie.empty()) {
-        RefreshUsage();
+        g_refresh.Refresh();
     }
+    UpdateTrayIcon();
 
     // Start refresh timer
-    g_timerId = SetTimer(g_hwnd, TIMER_REFRESH, GetRefreshInterval(), nullptr);
+    g_scheduler.ResetStats(GetTickCount64());
+    RegisterActivityNotifications(g_hwnd);
+    g_refresh.ScheduleRefresh();
+    g_netWatcher.Start([]() { g_refresh.OnNetworkChanged(); });
+    StartLogTailing();
+
+    // Local subscribers; Windows before 10 1803 has no AF_UNIX and just goes without
+    if (cfg.subscribe) {
+        std::string error;
+        if (g_subscriptions.Start(SubscriptionHub::DefaultPath(), error)) PublishUsage();
+    }
+    if (!g_demoMode) {
+        g_scheduler.Schedule(TASK_COMPACT, GetTickCount64() + COMPACT_INTERVAL_MS, COMPACT_INTERVAL_MS / 3);
+    }
 
-    // Message loop
+    // Message loop, timed per dispatch for the stall watchdog
+    g_startTick = GetTickCount();
+    g_stallMonitor.Start([]() { PostMessageW(g_hwnd, WM_APP_PING, 0, 0); });
     MSG msg;
     while (GetMessage(&msg, nullptr, 0, 0)) {
         TranslateMessage(&msg);
+        g_stallMonitor.BeginDispatch(msg.message);
         DispatchMessage(&msg);
+        g_stallMonitor.EndDispatch();
     }
 
     // Cleanup
-    KillTimer(g_hwnd, TIMER_REFRESH);
+    g_stallMonitor.Stop();
+    g_refresh.Cancel();
+    g_pushCancel->store(true);
+    g_workers.JoinAll();
+    KillTimer(g_hwnd, TIMER_SCHEDULER);
+    if (g_scheduler.IsScheduled(TASK_SAVECONFIG)) {
+        GetConfig().Save();
+    }
+    g_logWatcher.Stop();
+    g_subscriptions.Stop();
+    if (!g_demoMode) {
+        SaveHistory();
+        SaveForecast();
+        SaveLogState();
+    }
+    UnregisterActivityNotifications(g_hwnd);
+    g_netWatcher.Stop();
+    if (g_trayAdded) {
+        Shell_NotifyIconW(NIM_DELETE, &g_trayData);
+    }
     g_ui.Shutdown();
+    CoUninitialize();
 
     return (int)msg.wParam;
 }
@@ -150,111 +346,557 @@ int GetRefreshInterval() {
         return cfg.maxIntervalSec * 1000;
     }
 
-    float usage = g_usageData.MaxPercent();
-    if (usage >= 80.0f) return cfg.minIntervalSec * 1000;  // 1 min
-    if (usage >= 50.0f) return 5 * 60 * 1000;              // 5 min
-    return cfg.maxIntervalSec * 1000;                       // 10 min
+    return (int)SmartRefreshIntervalMs(g_usageData.MaxPercent(), cfg.minIntervalSec * 1000,
+                                       cfg.maxIntervalSec * 1000);
+}
+
+// Point the single OS timer at the scheduler's next wakeup
+void ArmSchedulerTimer() {
+    uint64_t wake = g_scheduler.NextWake();
+    if (wake == g_armedWake) return;
+
+    KillTimer(g_hwnd, TIMER_SCHEDULER);
+    g_armedWake = wake;
+    if (wake == 0) return;
+
+    uint64_t now = GetTickCount64();
+    UINT delay = wake > now ? (UINT)(wake - now) : USER_TIMER_MINIMUM;
+    SetTimer(g_hwnd, TIMER_SCHEDULER, delay, nullptr);
+}
+
+// Window moves and toggles come in bursts; write the INI once they settle
+void ScheduleConfigSave() {
+    g_scheduler.Schedule(TASK_SAVECONFIG, GetTickCount64() + 2000, 3000);
+    ArmSchedulerTimer();
+}
+
+void RunDueTasks() {
+    // WM_TIMER can land a tick before the tick count catches up with the deadline
+    uint64_t now = GetTickCount64();
+    if (now < g_armedWake) now = g_armedWake;
+    g_armedWake = 0;
+    KillTimer(g_hwnd, TIMER_SCHEDULER);
+    g_refresh.CheckClocks();
+
+    for (DeadlineScheduler::TaskId task : g_scheduler.PopDue(now)) {
+        TraceInstant(TraceEvent::TimerFire, (uint32_t)task);
+        if (g_refresh.RunTask(task)) continue;
+        switch (task) {
+        case TASK_SAVECONFIG: {
+            StallScope scope(g_stallMonitor, "ConfigManager::Save");
+            TraceSpan span(TraceEvent::ConfigSave);
+            GetConfig().Save();
+            break;
+        }
+
+        case TASK_COMPACT:
+            // Low priority, wide tolerance - rides along with whatever wakes us
+            StartCompaction();
+            g_scheduler.Schedule(TASK_COMPACT, now + COMPACT_INTERVAL_MS, COMPACT_INTERVAL_MS / 3);
+            break;
+
+        case TASK_LOGSCAN: {
+            StallScope scope(g_stallMonitor, "Session log scan");
+            TraceSpan span(TraceEvent::LogScan);
+            std::vector<std::filesystem::path> changed;
+            if (g_logWatcher.TakeChanged(changed)) {
+                g_logs.Poll(changed, time(nullptr));
+            } else {
+                g_logs.ScanAll(time(nullptr));
+            }
+            span.SetResult((uint32_t)g_logs.FileCount());
+            ApplyEstimate();
+            break;
+        }
+        }
+    }
+    ArmSchedulerTimer();
 }
 
-std::string ExtractOrgId(const std::string& json) {
-    // Look for "uuid" field in organizations response
-    // Format: [{"uuid":"xxxx-xxxx-xxxx",...}]
-    size_t pos = json.find("\"uuid\"");
-    if (pos == std::string::npos) return "";
+DWORD GetIdleSeconds() {
+    LASTINPUTINFO lii = { sizeof(lii) };
+    if (!GetLastInputInfo(&lii)) return 0;
+    return (GetTickCount() - lii.dwTime) / 1000;
+}
 
-    pos = json.find(':', pos);
-    if (pos == std::string::npos) return "";
+void RegisterActivityNotifications(HWND hwnd) {
+    WTSRegisterSessionNotification(hwnd, NOTIFY_FOR_THIS_SESSION);
+    g_displayNotify = RegisterPowerSettingNotification(hwnd, &GUID_CONSOLE_DISPLAY_STATE, DEVICE_NOTIFY_WINDOW_HANDLE);
+    g_powerSourceNotify = RegisterPowerSettingNotification(hwnd, &GUID_ACDC_POWER_SOURCE, DEVICE_NOTIFY_WINDOW_HANDLE);
 
-    pos = json.find('"', pos);
-    if (pos == std::string::npos) return "";
+    SYSTEM_POWER_STATUS sps;
+    if (GetSystemPowerStatus(&sps) && sps.ACLineStatus == 0) {
+        g_refresh.Activity().OnEvent(ActivityEvent::OnBattery);
+    }
+}
 
-    size_t end = json.find('"', pos + 1);
-    if (end == std::string::npos) return "";
+void UnregisterActivityNotifications(HWND hwnd) {
+    WTSUnRegisterSessionNotification(hwnd);
+    if (g_displayNotify) UnregisterPowerSettingNotification(g_displayNotify);
+    if (g_powerSourceNotify) UnregisterPowerSettingNotification(g_powerSourceNotify);
+    g_displayNotify = nullptr;
+    g_powerSourceNotify = nullptr;
+}
 
-    return json.substr(pos + 1, end - pos - 1);
+// Activity events go to g_refresh, which refreshes or parks; the watchdog
+// pauses along with it
+void HandleActivityEvent(ActivityEvent ev) {
+    g_refresh.OnActivityEvent(ev);
+    g_stallMonitor.SetPaused(g_refresh.Activity().IsParked());
 }
 
-std::wstring ToWideString(const std::string& s) {
-    if (s.empty()) return L"";
-    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), nullptr, 0);
-    if (len == 0) return L"";
-    std::wstring w(len, 0);
-    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), &w[0], len);
-    return w;
+std::wstring GetHistoryPath() {
+    std::wstring dir = GetConfig().GetConfigDir();
+    return dir.empty() ? L"" : dir + L"\\history.bin";
 }
 
-void RefreshUsage() {
-    if (g_demoMode) return;
+void LoadHistory() {
+    std::wstring path = GetHistoryPath();
+    std::vector<uint8_t> data;
+    if (!path.empty() && ReadFileBytes(path, data)) {
+        g_history.Deserialize(data);
+    }
 
-    Config& cfg = GetConfig().Get();
-    if (cfg.sessionCookie.empty()) {
-        g_usageData.valid = false;
-        g_usageData.error = L"";
-        InvalidateRect(g_hwnd, nullptr, FALSE);
-        return;
+    // Raw samples cover the full 7-day sparkline window
+    for (const UsageSample& sample : g_history.Raw()) {
+        g_sessionTrend.Add(sample.time, sample.session);
+        g_periodTrend.Add(sample.time, sample.period);
     }
+}
 
-    // Step 1: Get organization ID if we don't have it
-    if (g_orgId.empty()) {
-        HttpResponse orgResp = g_http.Get(ORGS_URL, cfg.sessionCookie);
-        if (orgResp.status == HttpStatus::Success) {
-            std::string orgId = ExtractOrgId(orgResp.body);
-            if (!orgId.empty()) {
-                g_orgId = ToWideString(orgId);
-                g_usageUrl = L"https://claude.ai/api/organizations/" + g_orgId + L"/usage";
-            }
-        } else if (orgResp.status == HttpStatus::AuthError) {
-            g_usageData.valid = false;
-            g_usageData.error = L"Auth expired - update cookie";
-            g_offline = false;
-            InvalidateRect(g_hwnd, nullptr, FALSE);
-            return;
-        } else {
-            g_offline = true;
-            wcscpy_s(g_lastUpdate, L"Offline");
-            InvalidateRect(g_hwnd, nullptr, FALSE);
-            return;
+// Claude Code keeps its transcripts under ~/.claude/projects (or
+// $CLAUDE_CONFIG_DIR/projects)
+std::filesystem::path GetClaudeProjectsDir() {
+    wchar_t buf[MAX_PATH];
+    DWORD len = GetEnvironmentVariableW(L"CLAUDE_CONFIG_DIR", buf, MAX_PATH);
+    if (len > 0 && len < MAX_PATH) {
+        return std::filesystem::path(buf) / L"projects";
+    }
+    len = GetEnvironmentVariableW(L"USERPROFILE", buf, MAX_PATH);
+    if (len > 0 && len < MAX_PATH) {
+        return std::filesystem::path(buf) / L".claude" / L"projects";
+    }
+    return std::filesystem::path();
+}
+
+std::wstring GetLogStatePath() {
+    std::wstring dir = GetConfig().GetConfigDir();
+    return dir.empty() ? L"" : dir + L"\\logs.bin";
+}
+
+void StartLogTailing() {
+    if (g_demoMode || !GetConfig().Get().localEstimate) return;
+
+    std::filesystem::path root = GetClaudeProjectsDir();
+    if (root.empty()) return;
+    g_logs.SetRoot(root);
+
+    std::wstring path = GetLogStatePath();
+    std::vector<uint8_t> data;
+    if (!path.empty() && ReadFileBytes(path, data)) {
+        g_logs.Deserialize(data);
+    }
+
+    // Stat every transcript once; only bytes appended since last run are read
+    StallScope scope(g_stallMonitor, "Session log startup scan");
+    g_logs.ScanAll(time(nullptr));
+    g_logWatcher.Start(root, []() { PostMessageW(g_hwnd, WM_APP_LOGS_CHANGED, 0, 0); });
+}
+
+void SaveLogState() {
+    std::wstring path = GetLogStatePath();
+    if (path.empty() || !g_logs.IsDirty()) return;
+    CreateDirectoryW(GetConfig().GetConfigDir().c_str(), NULL);
+    if (WriteFileAtomic(path, g_logs.Serialize())) {
+        g_logs.MarkClean();
+    }
+}
+
+// Move the displayed numbers by what the local transcripts saw since the last
+// fetch. The next real fetch replaces them and recalibrates.
+void ApplyEstimate() {
+    if (!g_usageData.valid || !g_estimator.IsCalibrated()) return;
+
+    TokenWindows& windows = g_logs.Windows();
+    windows.AdvanceTo(time(nullptr));
+    float session = g_estimator.EstimateSession(windows.Sum5h());
+    float period = g_estimator.EstimatePeriod(windows.Sum7d());
+    if (session == g_usageData.sessionPercent && period == g_usageData.periodPercent) return;
+
+    g_usageData.sessionPercent = session;
+    g_usageData.sessionUsed = (int)(session + 0.5f);
+    g_usageData.periodPercent = period;
+    g_usageData.periodUsed = (int)(period + 0.5f);
+    g_usageData.estimated = true;
+
+    InvalidateRect(g_hwnd, nullptr, FALSE);
+    UpdateTrayIcon();
+    PublishUsage();
+}
+
+void SaveHistory() {
+    std::wstring path = GetHistoryPath();
+    if (path.empty()) return;
+    CreateDirectoryW(GetConfig().GetConfigDir().c_str(), NULL);
+    WriteFileAtomic(path, g_history.Serialize());
+}
+
+std::wstring GetForecastPath() {
+    std::wstring dir = GetConfig().GetConfigDir();
+    return dir.empty() ? L"" : dir + L"\\forecast.bin";
+}
+
+void LoadForecast() {
+    std::wstring path = GetForecastPath();
+    std::vector<uint8_t> data;
+    if (!path.empty() && ReadFileBytes(path, data) && g_forecaster.Deserialize(data)) return;
+
+    // First run with this version: learn what we can from the raw history
+    for (const UsageSample& sample : g_history.Raw()) {
+        g_forecaster.utcOffsetSec = LocalUtcOffset(sample.time);
+        g_forecaster.AddSample(sample.time, sample.period);
+    }
+}
+
+void SaveForecast() {
+    std::wstring path = GetForecastPath();
+    if (path.empty()) return;
+    CreateDirectoryW(GetConfig().GetConfigDir().c_str(), NULL);
+    WriteFileAtomic(path, g_forecaster.Serialize());
+}
+
+// Compaction, serialization and the three writes run on a worker against
+// copies taken here. Transcript state is the exception: the tailer keeps
+// reading, so it's serialized now and marked clean; a failed write is
+// retried once more turns arrive.
+void StartCompaction() {
+    std::wstring dir = GetConfig().GetConfigDir();
+    if (g_compacting || dir.empty()) return;
+    g_compacting = true;
+    CreateDirectoryW(dir.c_str(), NULL);
+
+    CompactResult* result = new CompactResult();
+    result->history = g_history;
+    result->through = g_history.Raw().empty() ? 0 : g_history.Raw().back().time;
+    BurnForecaster forecaster = g_forecaster;
+    std::vector<uint8_t> logs;
+    if (g_logs.IsDirty()) {
+        logs = g_logs.Serialize();
+        g_logs.MarkClean();
+    }
+
+    HWND hwnd = g_hwnd;
+    std::wstring historyPath = GetHistoryPath(), forecastPath = GetForecastPath(), logsPath = GetLogStatePath();
+    g_workers.Start("History compaction", [hwnd, result, forecaster, logs, historyPath, forecastPath, logsPath]() {
+        TraceSpan span(TraceEvent::HistorySave);
+        result->history.Compact(time(nullptr));
+        WriteFileAtomic(historyPath, result->history.Serialize());
+        WriteFileAtomic(forecastPath, forecaster.Serialize());
+        if (!logs.empty()) WriteFileAtomic(logsPath, logs);
+        if (!PostMessageW(hwnd, WM_APP_COMPACT_DONE, 0, (LPARAM)result)) {
+            delete result;
         }
+    });
+}
+
+void ApplyCompaction(CompactResult& result) {
+    g_compacting = false;
+    for (const UsageSample& sample : g_history.Raw()) {
+        if (sample.time > result.through) result.history.Append(sample);
     }
+    g_history = std::move(result.history);
+}
+
+std::wstring GetOrgsPath() {
+    std::wstring dir = GetConfig().GetConfigDir();
+    return dir.empty() ? L"" : dir + L"\\orgs.bin";
+}
+
+void LoadOrgs() {
+    std::wstring path = GetOrgsPath();
+    std::vector<uint8_t> data;
+    if (!path.empty() && ReadFileBytes(path, data)) g_refresh.Orgs().Deserialize(data);
+}
+
+void SaveOrgs() {
+    std::wstring path = GetOrgsPath();
+    if (path.empty()) return;
+    CreateDirectoryW(GetConfig().GetConfigDir().c_str(), NULL);
+    WriteFileAtomic(path, g_refresh.Orgs().Serialize());
+}
+
+// When the weekly limit runs out at the usual pace for each hour of the week
+std::wstring GetForecastText() {
+    if (!g_usageData.valid || g_demoMode) return L"";
+    int64_t now = (int64_t)time(nullptr);
+    int32_t offset = LocalUtcOffset(now);
+    g_forecaster.utcOffsetSec = offset;
+    ExhaustionForecast forecast = g_forecaster.Forecast(now, g_usageData.PeriodPercent(),
+                                                        g_usageData.periodResetMs / 1000);
+    return FormatForecast(forecast, offset);
+}
+
+// Icons are rendered once per (percent, size, color) and kept for the session
+static HICON CreateIconFromImage(const IconImage& img) {
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = img.size;
+    bmi.bmiHeader.biHeight = -img.size;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = nullptr;
+    HDC screen = GetDC(nullptr);
+    HBITMAP color = CreateDIBSection(screen, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    ReleaseDC(nullptr, screen);
+    if (!color) return nullptr;
+    memcpy(bits, img.pixels.data(), img.pixels.size() * sizeof(uint32_t));
+
+    // Alpha comes from the color bitmap; the mask just has to exist
+    HBITMAP mask = CreateBitmap(img.size, img.size, 1, 1, nullptr);
+    ICONINFO ii = {};
+    ii.fIcon = TRUE;
+    ii.hbmColor = color;
+    ii.hbmMask = mask;
+    HICON icon = CreateIconIndirect(&ii);
+
+    DeleteObject(color);
+    DeleteObject(mask);
+    return icon;
+}
 
-    if (g_usageUrl.empty()) {
+// The process doesn't declare DPI awareness (the widget's layout is in fixed
+// pixels), so the small icon size it sees is always 16 and the shell scales
+// the tray icon on high-DPI displays
+static const int TRAY_ICON_PX = 16;
+
+static UsageIconCache g_trayIcons(TRAY_ICON_PX,
+    [](const IconImage& img) { return (void*)CreateIconFromImage(img); },
+    [](void* icon) { DestroyIcon((HICON)icon); });
+
+void UpdateTrayIcon() {
+    if (!g_trayAdded) return;
+
+    int percent = 0;
+    COLORREF c = RGB(120, 120, 125);  // Grey: no data yet / auth problem
+    if (g_usageData.valid) {
+        percent = (int)(g_usageData.SessionPercent() + 0.5f);
+        c = WidgetUI::GetBarColor(g_usageData.SessionPercent());
+    }
+    uint32_t rgb = ((uint32_t)GetRValue(c) << 16) | ((uint32_t)GetGValue(c) << 8) | GetBValue(c);
+    HICON icon = (HICON)g_trayIcons.Get(percent, rgb);
+
+    if (g_usageData.valid) {
+        swprintf_s(g_trayData.szTip, L"Claude usage - 5 Hour %d%%, %s %d%%%s",
+                   percent, g_usageData.periodLabel.c_str(), (int)(g_usageData.PeriodPercent() + 0.5f),
+                   g_usageData.estimated ? L" (estimated)" : L"");
+        std::wstring forecast = GetForecastText();
+        if (!forecast.empty()) {
+            wcsncat_s(g_trayData.szTip, L"\n", _TRUNCATE);
+            wcsncat_s(g_trayData.szTip, forecast.c_str(), _TRUNCATE);
+        }
+    } else {
+        wcsncpy_s(g_trayData.szTip, g_usageData.error.empty() ? L"Claude usage" : g_usageData.error.c_str(),
+                  _TRUNCATE);
+    }
+
+    g_trayIcon = icon;
+    g_trayData.hIcon = icon;
+    g_trayData.uFlags = NIF_ICON | NIF_TIP;
+    Shell_NotifyIconW(NIM_MODIFY, &g_trayData);
+}
+
+static void AddTrayIcon() {
+    g_trayData.cbSize = sizeof(g_trayData);
+    g_trayData.hWnd = g_hwnd;
+    g_trayData.uID = TRAY_ICON_ID;
+    g_trayData.uFlags = NIF_MESSAGE | NIF_TIP | (g_trayIcon ? NIF_ICON : 0);
+    g_trayData.uCallbackMessage = WM_APP_TRAY;
+    g_trayData.hIcon = g_trayIcon;
+    wcscpy_s(g_trayData.szTip, L"Claude usage");
+    g_trayAdded = Shell_NotifyIconW(NIM_ADD, &g_trayData) != FALSE;
+    UpdateTrayIcon();
+}
+
+void SetTrayMode(bool enabled) {
+    if (enabled && !g_trayAdded) {
+        AddTrayIcon();
+        ShowWindow(g_hwnd, SW_HIDE);
+    } else if (!enabled && g_trayAdded) {
+        Shell_NotifyIconW(NIM_DELETE, &g_trayData);
+        g_trayAdded = false;
+        ShowWindow(g_hwnd, SW_SHOW);
+    }
+}
+
+// The refresh glue lives in g_refresh; the window supplies the cookie, the
+// workers, the interval settings and the display
+void InitRefresh() {
+    RefreshHooks& hooks = g_refresh.hooks;
+    hooks.canFetch = CanRefresh;
+    hooks.fetch = StartRefresh;
+    hooks.probe = ProbeApiHost;
+    hooks.intervalMs = []() { return (uint32_t)GetRefreshInterval(); };
+    hooks.idleSeconds = []() { return (uint32_t)GetIdleSeconds(); };
+    hooks.onResult = ApplyRefreshResult;
+    hooks.onCountdown = ShowCountdown;
+    hooks.rearm = ArmSchedulerTimer;
+    g_refresh.pin = WideToUtf8(GetConfig().Get().organization);
+}
+
+// DNS plus a connect per address can take seconds while the network
+// flaps, so the probe runs on a worker and reports back with
+// WM_APP_PROBE_DONE
+void ProbeApiHost() {
+    HWND hwnd = g_hwnd;
+    g_workers.Start("Reconnect probe", [hwnd]() {
+        bool reachable = ProbeReachable(API_HOST, 443, 1500);
+        PostMessageW(hwnd, WM_APP_PROBE_DONE, reachable ? 1 : 0, 0);
+    });
+}
+
+bool CanRefresh() {
+    if (g_demoMode) return false;
+    if (GetConfig().Get().sessionCookie.empty()) {
         g_usageData.valid = false;
-        g_usageData.error = L"Could not get org ID";
+        g_usageData.error = L"";
         InvalidateRect(g_hwnd, nullptr, FALSE);
-        return;
+        return false;
     }
+    return true;
+}
 
-    // Step 2: Fetch usage data
-    HttpResponse resp = g_http.Get(g_usageUrl, cfg.sessionCookie);
+// Start a refresh on a worker thread. The result comes back as
+// WM_APP_REFRESH_DONE.
+void StartRefresh(const OrgChoice& org, uint64_t generation, const CancelToken& cancel) {
+    HWND hwnd = g_hwnd;
+    std::wstring cookie = GetConfig().Get().sessionCookie;
+    std::shared_ptr<HttpClient> http = g_http;
+
+    // Each run parses with its own UsageParser; an invalidated run can still
+    // be finishing while its replacement starts
+    g_workers.Start("Refresh worker", [hwnd, http, cookie, org, cancel, generation]() {
+        UsageParser parser;
+        RefreshResult* result = new RefreshResult(
+            RunRefreshPipeline(*http, parser, cookie, org, cancel, generation));
+        if (!PostMessageW(hwnd, WM_APP_REFRESH_DONE, 0, (LPARAM)result)) {
+            delete result;
+        }
+    });
+}
 
-    if (resp.status == HttpStatus::Success) {
-        g_usageData = g_parser.Parse(resp.body);
-        g_offline = false;
+// Hands the latest poll to the team aggregator, if one is configured. One
+// push in flight at most; a slow aggregator just misses a sample.
+void PushToAggregator() {
+    const Config& cfg = GetConfig().Get();
+    if (g_demoMode || cfg.aggregatorUrl.empty() || g_pushing.exchange(true)) return;
+
+    wchar_t name[256];
+    DWORD len = _countof(name);
+    UsageSnapshot snapshot;
+    if (!cfg.aggregatorUser.empty()) snapshot.user = WideToUtf8(cfg.aggregatorUser);
+    else if (GetUserNameW(name, &len)) snapshot.user = WideToUtf8(name);
+    len = _countof(name);
+    if (GetComputerNameW(name, &len)) snapshot.host = WideToUtf8(name);
+    if (snapshot.user.empty()) snapshot.user = "unknown";
+    snapshot.time = (int64_t)time(nullptr);
+    snapshot.session = g_usageData.sessionPercent;
+    snapshot.period = g_usageData.periodPercent;
+    snapshot.sessionResetMs = g_usageData.sessionResetMs;
+    snapshot.periodResetMs = g_usageData.periodResetMs;
+
+    std::vector<uint8_t> bytes;
+    EncodeSnapshot(snapshot, bytes);
+    std::string body(bytes.begin(), bytes.end());
+    std::wstring url = cfg.aggregatorUrl;
+    while (!url.empty() && url.back() == L'/') url.pop_back();
+    url += L"/push";
+
+    std::shared_ptr<HttpClient> http = g_http;
+    CancelToken cancel = g_pushCancel;
+    g_workers.Start("Aggregator push", [http, url, body, cancel]() {
+        http->Post(url, body, L"application/octet-stream", cancel.get());
+        g_pushing = false;
+    });
+}
+
+// Local subscribers get a delta only if something they can see changed;
+// the diffing and sends happen on the hub's thread
+void PublishUsage() {
+    UsageState state;
+    state.valid = g_usageData.valid;
+    state.offline = g_refresh.Offline();
+    state.estimated = g_usageData.estimated;
+    state.session = g_usageData.sessionPercent;
+    state.period = g_usageData.periodPercent;
+    state.sessionResetMs = g_usageData.sessionResetMs;
+    state.periodResetMs = g_usageData.periodResetMs;
+    state.error = WideToUtf8(g_usageData.error);
+    g_subscriptions.Publish(state);
+}
+
+// g_refresh accepted a result; its org and offline state are already updated
+void ApplyRefreshResult(const RefreshResult& result) {
+    if (result.orgs.FetchedAt() != 0) SaveOrgs();
+
+    switch (result.outcome) {
+    case RefreshOutcome::Success: {
+        g_usageData = result.usage;
+        if (g_usageData.valid) {
+            g_logs.Windows().AdvanceTo(time(nullptr));
+            g_estimator.Calibrate(g_usageData.sessionPercent, g_usageData.periodPercent,
+                                  g_logs.Windows().Sum5h(), g_logs.Windows().Sum7d());
+
+            int64_t now = (int64_t)time(nullptr);
+            g_history.Append({ now, g_usageData.sessionPercent, g_usageData.periodPercent });
+            g_sessionTrend.Add(now, g_usageData.sessionPercent);
+            g_periodTrend.Add(now, g_usageData.periodPercent);
+            g_forecaster.utcOffsetSec = LocalUtcOffset(now);
+            g_forecaster.AddSample(now, g_usageData.periodPercent);
+            PushToAggregator();
+        }
 
         // Update timestamp
         time_t now = time(nullptr);
         tm local;
         localtime_s(&local, &now);
         swprintf_s(g_lastUpdate, L"Updated %02d:%02d", local.tm_hour, local.tm_min);
-    } else if (resp.status == HttpStatus::AuthError) {
+        break;
+    }
+
+    case RefreshOutcome::AuthError:
         g_usageData.valid = false;
         g_usageData.error = L"Auth expired - update cookie";
-        g_offline = false;
-        g_orgId.clear();
-        g_usageUrl.clear();
-    } else {
-        // Network error - keep old data, mark offline
-        g_offline = true;
+        break;
+
+    case RefreshOutcome::NoOrg:
+        g_usageData.valid = false;
+        g_usageData.error = L"Could not get org ID";
+        break;
+
+    default:
+        // Network error - keep old data
         wcscpy_s(g_lastUpdate, L"Offline");
+        break;
     }
 
     InvalidateRect(g_hwnd, nullptr, FALSE);
     UpdateWindow(g_hwnd);
+    UpdateTrayIcon();
+    PublishUsage();
+}
 
-    // Adjust timer based on new usage
-    if (g_timerId) {
-        KillTimer(g_hwnd, TIMER_REFRESH);
-        g_timerId = SetTimer(g_hwnd, TIMER_REFRESH, GetRefreshInterval(), nullptr);
+// Countdown text for whichever deadlines are still set
+void ShowCountdown(const ResetDeadline& session, const ResetDeadline& period, const ClockSample& now) {
+    if (session.IsSet()) g_usageData.sessionResetText = FormatCountdown(session.RemainingMs(now));
+    if (period.IsSet()) g_usageData.periodResetText = FormatCountdown(period.RemainingMs(now));
+
+    std::wstring resetText = !g_usageData.sessionResetText.empty() ? g_usageData.sessionResetText
+                                                                    : g_usageData.periodResetText;
+    if (resetText != g_usageData.resetText) {
+        g_usageData.resetText = resetText;
+        InvalidateRect(g_hwnd, nullptr, FALSE);
     }
 }
 
@@ -263,18 +905,167 @@ void ShowContextMenu(HWND hwnd, int x, int y) {
 
     AppendMenuW(hMenu, MF_STRING, ID_MENU_REFRESH, L"Refresh Now");
     AppendMenuW(hMenu, MF_STRING, ID_MENU_SETCOOKIE, L"Set Cookie...");
-    AppendMenuW(hMenu, MF_SEPARATOR, 0, nullptr);
 
+    // Only worth a submenu once we know the account's orgs
     Config& cfg = GetConfig().Get();
+    if (!g_refresh.Orgs().Empty()) {
+        HMENU hOrgMenu = CreatePopupMenu();
+        const std::vector<OrgEntry>& orgs = g_refresh.Orgs().Orgs();
+        for (size_t i = 0; i < orgs.size() && i <= (size_t)(ID_MENU_ORG_LAST - ID_MENU_ORG_FIRST); i++) {
+            std::wstring label = Utf8ToWide(orgs[i].name.empty() ? orgs[i].uuid : orgs[i].name);
+            for (size_t pos = 0; (pos = label.find(L'&', pos)) != std::wstring::npos; pos += 2) {
+                label.insert(pos, 1, L'&');
+            }
+            bool current = Utf8ToWide(orgs[i].uuid) == g_refresh.OrgId();
+            AppendMenuW(hOrgMenu, MF_STRING | (current ? MF_CHECKED : 0), ID_MENU_ORG_FIRST + i, label.c_str());
+        }
+        AppendMenuW(hOrgMenu, MF_SEPARATOR, 0, nullptr);
+        AppendMenuW(hOrgMenu, MF_STRING | (cfg.organization.empty() ? MF_CHECKED : 0), ID_MENU_ORG_AUTO,
+                    L"Automatic");
+        AppendMenuW(hOrgMenu, MF_STRING, ID_MENU_ORG_RELOAD, L"Reload List");
+        AppendMenuW(hMenu, MF_POPUP, (UINT_PTR)hOrgMenu, L"Organization");
+    }
+    AppendMenuW(hMenu, MF_SEPARATOR, 0, nullptr);
+
     AppendMenuW(hMenu, MF_STRING | (cfg.alwaysOnTop ? MF_CHECKED : 0), ID_MENU_ONTOP, L"Always On Top");
+    AppendMenuW(hMenu, MF_STRING | (cfg.trayMode ? MF_CHECKED : 0), ID_MENU_TRAYMODE, L"Tray Icon Mode");
     AppendMenuW(hMenu, MF_STRING, ID_MENU_OPENSITE, L"Open Claude.ai");
+    AppendMenuW(hMenu, MF_STRING, ID_MENU_DIAGNOSTICS, L"Diagnostics...");
+    AppendMenuW(hMenu, MF_STRING, ID_MENU_SAVETRACE, L"Save Trace");
     AppendMenuW(hMenu, MF_SEPARATOR, 0, nullptr);
     AppendMenuW(hMenu, MF_STRING, ID_MENU_EXIT, L"Exit");
 
+    // Required for the menu to close when clicking elsewhere when opened from the tray
+    SetForegroundWindow(hwnd);
+    g_stallMonitor.BeginModal();
     TrackPopupMenu(hMenu, TPM_RIGHTBUTTON, x, y, 0, hwnd, nullptr);
+    g_stallMonitor.EndModal();
     DestroyMenu(hMenu);
 }
 
+// Usage, estimates and any run in flight belong to the previous org
+void PinOrganization(const std::wstring& pin) {
+    Config& cfg = GetConfig().Get();
+    cfg.organization = pin;
+    GetConfig().Save();
+
+    g_estimator.Reset();
+    g_refresh.pin = WideToUtf8(pin);
+    g_refresh.ForgetOrg();
+    g_refresh.Restart();
+}
+
+// Names for the messages this window actually sees; anything else is hex
+static const wchar_t* MessageName(uint32_t message, wchar_t* buf, size_t len) {
+    switch (message) {
+    case 0: return L"(message loop)";
+    case WM_PAINT: return L"WM_PAINT";
+    case WM_TIMER: return L"WM_TIMER";
+    case WM_COMMAND: return L"WM_COMMAND";
+    case WM_MOUSEMOVE: return L"WM_MOUSEMOVE";
+    case WM_LBUTTONDOWN: return L"WM_LBUTTONDOWN";
+    case WM_LBUTTONUP: return L"WM_LBUTTONUP";
+    case WM_LBUTTONDBLCLK: return L"WM_LBUTTONDBLCLK";
+    case WM_RBUTTONUP: return L"WM_RBUTTONUP";
+    case WM_POWERBROADCAST: return L"WM_POWERBROADCAST";
+    case WM_WTSSESSION_CHANGE: return L"WM_WTSSESSION_CHANGE";
+    case WM_APP_REFRESH_DONE: return L"WM_APP_REFRESH_DONE";
+    case WM_APP_TRAY: return L"WM_APP_TRAY";
+    case WM_APP_LOGS_CHANGED: return L"WM_APP_LOGS_CHANGED";
+    case WM_APP_PING: return L"WM_APP_PING";
+    case WM_APP_PROBE_DONE: return L"WM_APP_PROBE_DONE";
+    case WM_APP_COMPACT_DONE: return L"WM_APP_COMPACT_DONE";
+    }
+    swprintf_s(buf, len, L"0x%04X", message);
+    return buf;
+}
+
+static std::wstring Widen(const char* s) {
+    std::wstring w;
+    for (; s && *s; s++) w += (wchar_t)(unsigned char)*s;
+    return w;
+}
+
+void ShowDiagnostics(HWND hwnd) {
+    wchar_t line[256];
+    wchar_t name[16];
+    std::wstring text;
+
+    DWORD uptimeMin = (GetTickCount() - g_startTick) / 60000;
+    swprintf_s(line, L"Uptime: %luh %02lum\n", uptimeMin / 60, uptimeMin % 60);
+    text += line;
+    swprintf_s(line, L"Timer wakeups: %.1f/hour (%llu tasks run)\n",
+               g_scheduler.WakeupsPerHour(GetTickCount64()), (unsigned long long)g_scheduler.TasksRun());
+    text += line;
+    SubscriptionHub::Stats subs = g_subscriptions.GetStats();
+    swprintf_s(line, L"Subscribers: %llu open, %llu messages, %llu dropped as slow\n",
+               (unsigned long long)subs.open, (unsigned long long)subs.messages, (unsigned long long)subs.dropped);
+    text += line;
+    swprintf_s(line, L"Message loop latency: avg %.1f ms, max %.1f ms over %llu pings\n\n",
+               g_stallMonitor.PingAvgUs() / 1000.0, g_stallMonitor.PingMaxUs() / 1000.0,
+               (unsigned long long)g_stallMonitor.Pings());
+    text += line;
+
+    text += L"Slowest handlers (max / avg):\n";
+    for (const DispatchStats& s : g_stallMonitor.SlowestHandlers(5)) {
+        swprintf_s(line, L"  %s  %.1f / %.2f ms  (x%llu)\n", MessageName(s.message, name, _countof(name)),
+                   s.maxNs / 1e6, s.totalNs / 1e6 / s.count, (unsigned long long)s.count);
+        text += line;
+    }
+    if (g_stallMonitor.UntrackedDispatches()) {
+        swprintf_s(line, L"  (%llu dispatches of other messages not tracked)\n",
+                   (unsigned long long)g_stallMonitor.UntrackedDispatches());
+        text += line;
+    }
+
+    std::vector<StallRecord> stalls = g_stallMonitor.Stalls();
+    swprintf_s(line, L"\nStalls over %u ms: %llu", g_stallMonitor.stallThresholdMs,
+               (unsigned long long)g_stallMonitor.StallCount());
+    text += line;
+    text += stalls.size() > 10 ? L" (latest 10)\n" : L"\n";
+    for (size_t i = stalls.size() > 10 ? stalls.size() - 10 : 0; i < stalls.size(); i++) {
+        const StallRecord& r = stalls[i];
+        time_t when = (time_t)r.wallSec;
+        tm local;
+        localtime_s(&local, &when);
+        swprintf_s(line, L"  %02d:%02d:%02d  %u ms  %s  %s\n", local.tm_hour, local.tm_min, local.tm_sec,
+                   r.durationMs, MessageName(r.message, name, _countof(name)),
+                   r.label ? Widen(r.label).c_str() : L"");
+        text += line;
+    }
+
+    g_stallMonitor.BeginModal();
+    MessageBoxW(hwnd, text.c_str(), L"ClaudeWatch Diagnostics", MB_OK | MB_ICONINFORMATION);
+    g_stallMonitor.EndModal();
+}
+
+void SaveTrace(HWND hwnd) {
+    time_t now = time(nullptr);
+    tm local;
+    localtime_s(&local, &now);
+    wchar_t name[64];
+    swprintf_s(name, L"\\trace-%04d%02d%02d-%02d%02d%02d.json", local.tm_year + 1900, local.tm_mon + 1,
+               local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec);
+
+    std::wstring dir = GetConfig().GetConfigDir();
+    CreateDirectoryW(dir.c_str(), NULL);
+    std::wstring path = dir + name;
+
+    std::wstring msg;
+    UINT icon;
+    if (TraceWriteFile(path)) {
+        msg = L"Trace saved to:\n" + path + L"\n\nOpen it in chrome://tracing or ui.perfetto.dev.";
+        icon = MB_ICONINFORMATION;
+    } else {
+        msg = L"Could not write " + path;
+        icon = MB_ICONERROR;
+    }
+
+    g_stallMonitor.BeginModal();
+    MessageBoxW(hwnd, msg.c_str(), L"ClaudeWatch Trace", MB_OK | icon);
+    g_stallMonitor.EndModal();
+}
+
 void ShowCookieDialog(HWND hwnd) {
     // Simple input dialog using MessageBox + clipboard approach
     // For a real implementation, create a proper dialog
@@ -291,7 +1082,9 @@ void ShowCookieDialog(HWND hwnd) {
     msg += cfg.sessionCookie.empty() ? L"not set" : L"set";
     msg += L".\n\nThe cookie will be read from your clipboard automatically.";
 
+    g_stallMonitor.BeginModal();
     int result = MessageBoxW(hwnd, msg.c_str(), L"Set Cookie", MB_OKCANCEL | MB_ICONINFORMATION);
+    g_stallMonitor.EndModal();
 
     if (result == IDOK) {
         // Get from clipboard
@@ -310,11 +1103,12 @@ void ShowCookieDialog(HWND hwnd) {
                     }
                     GlobalUnlock(hData);
 
-                    g_orgId.clear();
-                    g_usageUrl.clear();
-                    g_offline = false;
+                    // Anything in flight was for the old cookie, and the
+                    // learned tokens-to-percent rate may be another account's
+                    g_estimator.Reset();
                     GetConfig().Save();
-                    RefreshUsage();
+                    g_refresh.ForgetOrg();
+                    g_refresh.Restart();
                 }
             }
             CloseClipboard();
@@ -323,6 +1117,15 @@ void ShowCookieDialog(HWND hwnd) {
 }
 
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    // Explorer restarted - the notification area forgot our icon
+    if (msg == g_taskbarCreatedMsg && g_taskbarCreatedMsg != 0) {
+        if (g_trayAdded) {
+            g_trayAdded = false;
+            AddTrayIcon();
+        }
+        return 0;
+    }
+
     switch (msg) {
     case WM_PAINT: {
         PAINTSTRUCT ps;
@@ -331,11 +1134,26 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         // Double buffer
         RECT rc;
         GetClientRect(hwnd, &rc);
+        // Top-down 32bpp DIB so the UI can blit atlas text straight into it
         HDC memDC = CreateCompatibleDC(hdc);
-        HBITMAP memBmp = CreateCompatibleBitmap(hdc, rc.right, rc.bottom);
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+        bmi.bmiHeader.biWidth = rc.right;
+        bmi.bmiHeader.biHeight = -rc.bottom;
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        void* bits = nullptr;
+        HBITMAP memBmp = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
         HBITMAP oldBmp = (HBITMAP)SelectObject(memDC, memBmp);
 
-        g_ui.Render(memDC, rc.right, rc.bottom, g_usageData, g_offline, g_lastUpdate);
+        time_t now = time(nullptr);
+        g_sessionTrend.AdvanceTo(now);
+        g_periodTrend.AdvanceTo(now);
+        StallScope scope(g_stallMonitor, "WidgetUI::Render");
+        TraceSpan span(TraceEvent::Paint);
+        g_ui.Render(memDC, rc.right, rc.bottom, g_usageData, g_refresh.Offline(), g_lastUpdate,
+                    g_demoMode ? nullptr : &g_sessionTrend, g_demoMode ? nullptr : &g_periodTrend);
 
         BitBlt(hdc, 0, 0, rc.right, rc.bottom, memDC, 0, 0, SRCCOPY);
 
@@ -347,12 +1165,87 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         return 0;
     }
 
+    case WM_APP_REFRESH_DONE: {
+        std::unique_ptr<RefreshResult> result((RefreshResult*)lParam);
+        StallScope scope(g_stallMonitor, "ApplyRefreshResult");
+        g_refresh.ApplyResult(*result);
+        return 0;
+    }
+
+    case WM_APP_PING:
+        g_stallMonitor.OnPing();
+        return 0;
+
+    case WM_APP_PROBE_DONE:
+        g_refresh.ApplyProbeResult(wParam != 0);
+        return 0;
+
+    case WM_APP_COMPACT_DONE: {
+        std::unique_ptr<CompactResult> result((CompactResult*)lParam);
+        ApplyCompaction(*result);
+        return 0;
+    }
+
+    case WM_APP_LOGS_CHANGED:
+        // Transcripts are appended to in bursts while a turn streams in
+        if (!g_scheduler.IsScheduled(TASK_LOGSCAN)) {
+            g_scheduler.Schedule(TASK_LOGSCAN, GetTickCount64() + 1000, 2000);
+            ArmSchedulerTimer();
+        }
+        return 0;
+
+    case WM_APP_TRAY:
+        if (LOWORD(lParam) == WM_LBUTTONUP) {
+            // Click toggles the full widget
+            if (IsWindowVisible(hwnd)) {
+                ShowWindow(hwnd, SW_HIDE);
+            } else {
+                ShowWindow(hwnd, SW_SHOW);
+                SetForegroundWindow(hwnd);
+            }
+        } else if (LOWORD(lParam) == WM_RBUTTONUP) {
+            POINT pt;
+            GetCursorPos(&pt);
+            ShowContextMenu(hwnd, pt.x, pt.y);
+        }
+        return 0;
+
     case WM_TIMER:
-        if (wParam == TIMER_REFRESH) {
-            RefreshUsage();
+        if (wParam == TIMER_SCHEDULER) {
+            RunDueTasks();
         }
         return 0;
 
+    case WM_TIMECHANGE:
+        g_refresh.CheckClocks();
+        ArmSchedulerTimer();
+        return 0;
+
+    case WM_WTSSESSION_CHANGE:
+        if (wParam == WTS_SESSION_LOCK) {
+            HandleActivityEvent(ActivityEvent::SessionLocked);
+        } else if (wParam == WTS_SESSION_UNLOCK) {
+            HandleActivityEvent(ActivityEvent::SessionUnlocked);
+        }
+        return 0;
+
+    case WM_POWERBROADCAST:
+        if (wParam == PBT_APMSUSPEND) {
+            HandleActivityEvent(ActivityEvent::Suspending);
+        } else if (wParam == PBT_APMRESUMEAUTOMATIC || wParam == PBT_APMRESUMESUSPEND) {
+            HandleActivityEvent(ActivityEvent::Resumed);
+        } else if (wParam == PBT_POWERSETTINGCHANGE) {
+            POWERBROADCAST_SETTING* pbs = (POWERBROADCAST_SETTING*)lParam;
+            DWORD value = pbs->DataLength >= sizeof(DWORD) ? *(DWORD*)pbs->Data : 0;
+            if (IsEqualGUID(pbs->PowerSetting, GUID_CONSOLE_DISPLAY_STATE)) {
+                // 0 = off, 1 = on, 2 = dimmed (still visible)
+                HandleActivityEvent(value == 0 ? ActivityEvent::DisplayOff : ActivityEvent::DisplayOn);
+            } else if (IsEqualGUID(pbs->PowerSetting, GUID_ACDC_POWER_SOURCE)) {
+                HandleActivityEvent(value == 0 ? ActivityEvent::OnAC : ActivityEvent::OnBattery);
+            }
+        }
+        return TRUE;
+
     case WM_LBUTTONDOWN:
         g_dragging = true;
         g_dragStart.x = GET_X_LPARAM(lParam);
@@ -400,7 +1293,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             Config& cfg = GetConfig().Get();
             cfg.posX = rc.left;
             cfg.posY = rc.top;
-            GetConfig().Save();
+            ScheduleConfigSave();
         }
         return 0;
 
@@ -419,7 +1312,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_COMMAND:
         switch (LOWORD(wParam)) {
         case ID_MENU_REFRESH:
-            RefreshUsage();
+            g_refresh.Refresh();
             break;
 
         case ID_MENU_SETCOOKIE:
@@ -431,7 +1324,23 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             cfg.alwaysOnTop = !cfg.alwaysOnTop;
             SetWindowPos(hwnd, cfg.alwaysOnTop ? HWND_TOPMOST : HWND_NOTOPMOST,
                          0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
-            GetConfig().Save();
+            ScheduleConfigSave();
+            break;
+        }
+
+        case ID_MENU_DIAGNOSTICS:
+            ShowDiagnostics(hwnd);
+            break;
+
+        case ID_MENU_SAVETRACE:
+            SaveTrace(hwnd);
+            break;
+
+        case ID_MENU_TRAYMODE: {
+            Config& cfg = GetConfig().Get();
+            cfg.trayMode = !cfg.trayMode;
+            SetTrayMode(cfg.trayMode);
+            ScheduleConfigSave();
             break;
         }
 
@@ -442,9 +1351,36 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         case ID_MENU_EXIT:
             DestroyWindow(hwnd);
             break;
+
+        case ID_MENU_ORG_AUTO:
+            PinOrganization(L"");
+            break;
+
+        case ID_MENU_ORG_RELOAD:
+            g_refresh.ReloadOrgs();
+            break;
+
+        default:
+            if (LOWORD(wParam) >= ID_MENU_ORG_FIRST && LOWORD(wParam) <= ID_MENU_ORG_LAST) {
+                size_t index = LOWORD(wParam) - ID_MENU_ORG_FIRST;
+                const std::vector<OrgEntry>& orgs = g_refresh.Orgs().Orgs();
+                if (index < orgs.size()) PinOrganization(Utf8ToWide(orgs[index].uuid));
+            }
+            break;
         }
         return 0;
 
+    case WM_NOTIFY:
+        if (((LPNMHDR)lParam)->code == TTN_GETDISPINFOW && ((LPNMHDR)lParam)->hwndFrom == g_tooltip) {
+            // Recomputed on every show; it's a few hundred float adds
+            static std::wstring text;
+            text = GetForecastText();
+            NMTTDISPINFOW* info = (NMTTDISPINFOW*)lParam;
+            info->lpszText = const_cast<wchar_t*>(text.c_str());
+            return 0;
+        }
+        break;
+
     case WM_DESTROY:
         PostQuitMessage(0);
         return 0;
@@ -0,0 +1,288 @@
+#include "net_watch.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <ocidl.h>
+#include <netlistmgr.h>
+
+#pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "ole32.lib")
+
+typedef SOCKET socket_t;
+#define CloseSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define CloseSocket close
+#endif
+
+#include <cstdio>
+
+void ReconnectTracker::OnNetworkChanged(uint64_t nowMs, bool offline) {
+    if (!offline) return;
+
+    // Every new change restarts the debounce window and the retry budget
+    m_deadline = nowMs + debounceMs;
+    m_retries = 0;
+}
+
+bool ReconnectTracker::OnProbeResult(uint64_t nowMs, bool reachable) {
+    if (reachable) {
+        m_deadline = 0;
+        m_retries = 0;
+        return true;
+    }
+
+    // Route came back before DNS/VPN did - back off and try again a few times
+    if (m_retries >= maxRetries) {
+        m_deadline = 0;
+        return false;
+    }
+    m_deadline = nowMs + ((uint64_t)retryMs << m_retries);
+    m_retries++;
+    return false;
+}
+
+void ReconnectTracker::Cancel() {
+    m_deadline = 0;
+    m_retries = 0;
+}
+
+static bool SetNonBlocking(socket_t s) {
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(s, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+static bool ConnectInProgress() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS;
+#endif
+}
+
+bool ProbeReachable(const char* host, uint16_t port, int timeoutMs) {
+#ifdef _WIN32
+    static bool wsaReady = [] {
+        WSADATA wsa;
+        return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+    }();
+    if (!wsaReady) return false;
+#endif
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char portStr[8];
+    snprintf(portStr, sizeof(portStr), "%u", (unsigned)port);
+
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host, portStr, &hints, &res) != 0) return false;
+
+    bool reachable = false;
+    for (addrinfo* ai = res; ai && !reachable; ai = ai->ai_next) {
+        socket_t s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s == INVALID_SOCKET) continue;
+
+        if (SetNonBlocking(s)) {
+            if (connect(s, ai->ai_addr, (int)ai->ai_addrlen) == 0) {
+                reachable = true;
+            } else if (ConnectInProgress()) {
+                // Winsock reports a refused connect only through the except
+                // set; without it every refusal would wait out the timeout
+                fd_set wfds, efds;
+                FD_ZERO(&wfds);
+                FD_ZERO(&efds);
+                FD_SET(s, &wfds);
+                FD_SET(s, &efds);
+                timeval tv = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+                if (select((int)s + 1, nullptr, &wfds, &efds, &tv) > 0 && !FD_ISSET(s, &efds)) {
+                    int err = 0;
+                    socklen_t len = sizeof(err);
+                    getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+                    reachable = (err == 0);
+                }
+            }
+        }
+        CloseSocket(s);
+    }
+
+    freeaddrinfo(res);
+    return reachable;
+}
+
+#ifdef _WIN32
+
+// COM sink for NLM connectivity events
+class NlmEventSink : public INetworkListManagerEvents {
+public:
+    explicit NlmEventSink(std::function<void()>* onChange) : m_onChange(onChange) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override {
+        if (riid == IID_IUnknown || riid == IID_INetworkListManagerEvents) {
+            *ppv = static_cast<INetworkListManagerEvents*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override { return InterlockedIncrement(&m_refs); }
+
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG refs = InterlockedDecrement(&m_refs);
+        if (refs == 0) delete this;
+        return refs;
+    }
+
+    HRESULT STDMETHODCALLTYPE ConnectivityChanged(NLM_CONNECTIVITY connectivity) override {
+        // Corporate VPNs often only report local connectivity - let the probe decide
+        if (connectivity != NLM_CONNECTIVITY_DISCONNECTED && *m_onChange) {
+            (*m_onChange)();
+        }
+        return S_OK;
+    }
+
+private:
+    LONG m_refs = 1;
+    std::function<void()>* m_onChange;
+};
+
+struct NetworkWatcher::Impl {
+    INetworkListManager* nlm = nullptr;
+    IConnectionPoint* point = nullptr;
+    NlmEventSink* sink = nullptr;
+    DWORD cookie = 0;
+};
+
+NetworkWatcher::NetworkWatcher() : m_impl(new Impl) {}
+
+NetworkWatcher::~NetworkWatcher() {
+    Stop();
+    delete m_impl;
+}
+
+bool NetworkWatcher::Start(std::function<void()> onChange) {
+    Stop();
+    m_onChange = std::move(onChange);
+
+    if (FAILED(CoCreateInstance(CLSID_NetworkListManager, nullptr, CLSCTX_ALL,
+                                IID_INetworkListManager, (void**)&m_impl->nlm))) {
+        return false;
+    }
+
+    IConnectionPointContainer* container = nullptr;
+    if (FAILED(m_impl->nlm->QueryInterface(IID_IConnectionPointContainer, (void**)&container))) {
+        Stop();
+        return false;
+    }
+    HRESULT hr = container->FindConnectionPoint(IID_INetworkListManagerEvents, &m_impl->point);
+    container->Release();
+    if (FAILED(hr)) {
+        Stop();
+        return false;
+    }
+
+    m_impl->sink = new NlmEventSink(&m_onChange);
+    if (FAILED(m_impl->point->Advise(m_impl->sink, &m_impl->cookie))) {
+        m_impl->cookie = 0;
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void NetworkWatcher::Stop() {
+    if (m_impl->point) {
+        if (m_impl->cookie) m_impl->point->Unadvise(m_impl->cookie);
+        m_impl->point->Release();
+    }
+    if (m_impl->sink) m_impl->sink->Release();
+    if (m_impl->nlm) m_impl->nlm->Release();
+    *m_impl = Impl();
+}
+
+#else
+
+struct NetworkWatcher::Impl {
+    int fd = -1;
+};
+
+NetworkWatcher::NetworkWatcher() : m_impl(new Impl) {}
+
+NetworkWatcher::~NetworkWatcher() {
+    Stop();
+    delete m_impl;
+}
+
+bool NetworkWatcher::Start(std::function<void()> onChange) {
+    Stop();
+    m_onChange = std::move(onChange);
+
+    m_impl->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_impl->fd < 0) return false;
+
+    sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                     RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (bind(m_impl->fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void NetworkWatcher::Stop() {
+    if (m_impl->fd >= 0) close(m_impl->fd);
+    m_impl->fd = -1;
+}
+
+int NetworkWatcher::Fd() const {
+    return m_impl->fd;
+}
+
+void NetworkWatcher::Drain() {
+    if (m_impl->fd < 0) return;
+
+    // Only appearances matter: a link coming up, an address or a route being added
+    bool changed = false;
+    char buf[8192];
+    for (;;) {
+        ssize_t n = recv(m_impl->fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n <= 0) break;
+
+        int len = (int)n;
+        for (nlmsghdr* nh = (nlmsghdr*)buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type == RTM_NEWLINK) {
+                ifinfomsg* ifi = (ifinfomsg*)NLMSG_DATA(nh);
+                if (ifi->ifi_flags & IFF_RUNNING) changed = true;
+            } else if (nh->nlmsg_type == RTM_NEWADDR || nh->nlmsg_type == RTM_NEWROUTE) {
+                changed = true;
+            }
+        }
+    }
+
+    if (changed && m_onChange) m_onChange();
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Turns a burst of network-change notifications into one reachability probe,
+// and a successful probe into one refresh. Platform-neutral and clock-free:
+// callers pass a monotonic millisecond timestamp.
+class ReconnectTracker {
+public:
+    uint32_t debounceMs = 2000;   // Let DHCP/VPN settle before probing
+    uint32_t retryMs = 5000;      // First retry after a failed probe, doubles
+    int maxRetries = 5;
+
+    // A network change was observed. Only arms a probe while we're offline -
+    // a roam between two working networks doesn't need a fetch.
+    void OnNetworkChanged(uint64_t nowMs, bool offline);
+
+    bool ProbeDue(uint64_t nowMs) const { return m_deadline != 0 && nowMs >= m_deadline; }
+
+    // Time of the pending probe, 0 if none
+    uint64_t Deadline() const { return m_deadline; }
+
+    // Returns true if the API host is reachable again and we should refresh
+    bool OnProbeResult(uint64_t nowMs, bool reachable);
+
+    // A regular refresh succeeded, nothing left to recover from
+    void Cancel();
+
+private:
+    uint64_t m_deadline = 0;
+    int m_retries = 0;
+};
+
+// Cheap "can we reach the API at all" check: resolve + TCP connect, no TLS,
+// no HTTP. Much cheaper than letting the org+usage requests time out.
+bool ProbeReachable(const char* host, uint16_t port, int timeoutMs);
+
+// OS network-change notifications. On Windows this is an NLM
+// INetworkListManagerEvents sink; events arrive through the message loop of
+// the STA thread that called Start(), so onChange runs on the UI thread.
+// On Linux it's an rtnetlink socket: poll Fd() and call Drain(), which
+// invokes onChange when links, addresses or routes appear.
+class NetworkWatcher {
+public:
+    NetworkWatcher();
+    ~NetworkWatcher();
+
+    bool Start(std::function<void()> onChange);
+    void Stop();
+
+#ifndef _WIN32
+    int Fd() const;
+    void Drain();
+#endif
+
+private:
+    struct Impl;
+    Impl* m_impl;
+    std::function<void()> m_onChange;
+};
@@ -0,0 +1,377 @@
+#include "org_directory.h"
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t ORGS_MAGIC = 0x314f5743;     // "CWO1"
+constexpr size_t MAX_DEPTH = 256;
+
+void PutVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end) return false;
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+void PutString(std::vector<uint8_t>& out, const std::string& s) {
+    PutVarint(out, s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+bool GetString(const uint8_t*& p, const uint8_t* end, std::string& s) {
+    uint64_t len;
+    if (!GetVarint(p, end, len) || len > (uint64_t)(end - p)) return false;
+    s.assign((const char*)p, (size_t)len);
+    p += len;
+    return true;
+}
+
+void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xc0 | cp >> 6);
+        out += (char)(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += (char)(0xe0 | cp >> 12);
+        out += (char)(0x80 | (cp >> 6 & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else {
+        out += (char)(0xf0 | cp >> 18);
+        out += (char)(0x80 | (cp >> 12 & 0x3f));
+        out += (char)(0x80 | (cp >> 6 & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+}
+
+// Just enough JSON to walk a document without building it. Containers we
+// don't care about are skipped by bracket counting; strings, which are most
+// of the bytes in a big listing, are skipped with memchr.
+class JsonScanner {
+public:
+    JsonScanner(const char* p, const char* end) : m_p(p), m_end(end) {}
+
+    bool Ok() const { return m_ok; }
+
+    // Next significant character, or 0 at the end
+    char Peek() {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) m_p++;
+        return m_p < m_end ? *m_p : 0;
+    }
+
+    bool Consume(char c) {
+        if (Peek() != c) return false;
+        m_p++;
+        return true;
+    }
+
+    // A string's raw bytes (escapes left in), positioned just past it
+    bool RawString(const char*& begin, size_t& len) {
+        if (!Consume('"')) return Fail();
+        begin = m_p;
+        for (;;) {
+            const char* q = (const char*)memchr(m_p, '"', (size_t)(m_end - m_p));
+            if (!q) return Fail();
+            m_p = q + 1;
+
+            // Escaped if preceded by an odd run of backslashes
+            size_t slashes = 0;
+            while (q - slashes > begin && q[-1 - (ptrdiff_t)slashes] == '\\') slashes++;
+            if (slashes % 2 == 0) {
+                len = (size_t)(q - begin);
+                return true;
+            }
+        }
+    }
+
+    bool String(std::string& out) {
+        const char* begin;
+        size_t len;
+        if (!RawString(begin, len)) return false;
+        Unescape(begin, len, out);
+        return true;
+    }
+
+    bool SkipValue() {
+        char c = Peek();
+        if (c == '"') {
+            const char* begin;
+            size_t len;
+            return RawString(begin, len);
+        }
+        if (c != '{' && c != '[') {
+            // Number, true, false, null
+            while (m_p < m_end && *m_p != ',' && *m_p != '}' && *m_p != ']' && *m_p != ' ' &&
+                   *m_p != '\n' && *m_p != '\r' && *m_p != '\t') {
+                m_p++;
+            }
+            return c != 0 || Fail();
+        }
+
+        size_t depth = 0;
+        while (m_p < m_end) {
+            switch (*m_p) {
+            case '"': {
+                const char* begin;
+                size_t len;
+                if (!RawString(begin, len)) return false;
+                continue;
+            }
+            case '{':
+            case '[':
+                if (++depth > MAX_DEPTH) return Fail();
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0) {
+                    m_p++;
+                    return true;
+                }
+                break;
+            }
+            m_p++;
+        }
+        return Fail();
+    }
+
+private:
+    const char* m_p;
+    const char* m_end;
+    bool m_ok = true;
+
+    bool Fail() {
+        m_ok = false;
+        m_p = m_end;
+        return false;
+    }
+
+    static uint32_t Hex4(const char* p) {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = p[i];
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= (uint32_t)(c - '0');
+            else if (c >= 'a' && c <= 'f') v |= (uint32_t)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') v |= (uint32_t)(c - 'A' + 10);
+            else return 0xfffd;
+        }
+        return v;
+    }
+
+    static void Unescape(const char* p, size_t len, std::string& out) {
+        out.clear();
+        const char* end = p + len;
+        while (p < end) {
+            const char* slash = (const char*)memchr(p, '\\', (size_t)(end - p));
+            if (!slash) {
+                out.append(p, end);
+                return;
+            }
+            out.append(p, slash);
+            p = slash + 1;
+            if (p >= end) return;
+            char c = *p++;
+            switch (c) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (end - p < 4) return;
+                uint32_t cp = Hex4(p);
+                p += 4;
+                if (cp >= 0xd800 && cp < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    uint32_t low = Hex4(p + 2);
+                    if (low >= 0xdc00 && low < 0xe000) {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                        p += 6;
+                    }
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default: out += c; break;     // \" \\ \/
+            }
+        }
+    }
+};
+
+bool KeyIs(const char* key, size_t len, const char* want) {
+    return strlen(want) == len && memcmp(key, want, len) == 0;
+}
+
+// {"uuid": ..., "name": ..., "capabilities": [...], "billing_type": ..., <anything else>}
+bool ParseOrg(JsonScanner& json, OrgEntry& org) {
+    if (!json.Consume('{')) return false;
+    if (json.Consume('}')) return true;
+    do {
+        const char* key;
+        size_t len;
+        if (!json.RawString(key, len) || !json.Consume(':')) return false;
+
+        bool isString = json.Peek() == '"';
+        if (isString && KeyIs(key, len, "uuid")) {
+            if (!json.String(org.uuid)) return false;
+        } else if (isString && KeyIs(key, len, "name")) {
+            if (!json.String(org.name)) return false;
+        } else if (isString && KeyIs(key, len, "billing_type")) {
+            if (!json.String(org.billingType)) return false;
+        } else if (json.Peek() == '[' && KeyIs(key, len, "capabilities")) {
+            json.Consume('[');
+            if (!json.Consume(']')) {
+                do {
+                    std::string capability;
+                    if (json.Peek() == '"') {
+                        if (!json.String(capability)) return false;
+                        org.capabilities.push_back(std::move(capability));
+                    } else if (!json.SkipValue()) {
+                        return false;
+                    }
+                } while (json.Consume(','));
+                if (!json.Consume(']')) return false;
+            }
+        } else if (!json.SkipValue()) {
+            return false;
+        }
+    } while (json.Consume(','));
+    return json.Consume('}');
+}
+
+bool EqualsNoCase(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+        if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+        if (x != y) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool OrgEntry::Has(const std::string& capability) const {
+    for (const std::string& c : capabilities) {
+        if (c == capability) return true;
+    }
+    return false;
+}
+
+bool OrgDirectory::Parse(const std::string& json, int64_t nowSec) {
+    JsonScanner scan(json.data(), json.data() + json.size());
+    std::vector<OrgEntry> orgs;
+    if (!scan.Consume('[')) return false;
+    if (!scan.Consume(']')) {
+        do {
+            if (scan.Peek() == '{') {
+                OrgEntry org;
+                if (!ParseOrg(scan, org)) return false;
+                if (!org.uuid.empty()) orgs.push_back(std::move(org));
+            } else if (!scan.SkipValue()) {
+                return false;
+            }
+        } while (scan.Consume(','));
+        if (!scan.Consume(']')) return false;
+    }
+    if (!scan.Ok()) return false;
+
+    m_orgs = std::move(orgs);
+    m_fetchedAt = nowSec;
+    return true;
+}
+
+bool OrgDirectory::IsFresh(int64_t nowSec, int64_t ttlSec) const {
+    return m_fetchedAt != 0 && nowSec >= m_fetchedAt && nowSec - m_fetchedAt < ttlSec;
+}
+
+const OrgEntry* OrgDirectory::FindByUuid(const std::string& uuid) const {
+    for (const OrgEntry& org : m_orgs) {
+        if (EqualsNoCase(org.uuid, uuid)) return &org;
+    }
+    return nullptr;
+}
+
+const OrgEntry* OrgDirectory::FindByName(const std::string& name) const {
+    for (const OrgEntry& org : m_orgs) {
+        if (EqualsNoCase(org.name, name)) return &org;
+    }
+    return nullptr;
+}
+
+const OrgEntry* OrgDirectory::FindByCapability(const std::string& capability) const {
+    for (const OrgEntry& org : m_orgs) {
+        if (org.Has(capability)) return &org;
+    }
+    return nullptr;
+}
+
+const OrgEntry* OrgDirectory::Select(const std::string& pin) const {
+    if (!pin.empty()) {
+        const OrgEntry* org = FindByUuid(pin);
+        if (!org) org = FindByName(pin);
+        if (org) return org;
+    }
+    const OrgEntry* chat = FindByCapability("chat");
+    if (chat) return chat;
+    return m_orgs.empty() ? nullptr : &m_orgs.front();
+}
+
+std::vector<uint8_t> OrgDirectory::Serialize() const {
+    std::vector<uint8_t> out;
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(ORGS_MAGIC >> (i * 8)));
+    PutVarint(out, (uint64_t)m_fetchedAt);
+    PutVarint(out, m_orgs.size());
+    for (const OrgEntry& org : m_orgs) {
+        PutString(out, org.uuid);
+        PutString(out, org.name);
+        PutString(out, org.billingType);
+        PutVarint(out, org.capabilities.size());
+        for (const std::string& c : org.capabilities) PutString(out, c);
+    }
+    return out;
+}
+
+bool OrgDirectory::Deserialize(const std::vector<uint8_t>& data) {
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+    if (data.size() < 4) return false;
+    uint32_t magic = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    if (magic != ORGS_MAGIC) return false;
+    p += 4;
+
+    uint64_t fetchedAt, count;
+    if (!GetVarint(p, end, fetchedAt) || !GetVarint(p, end, count) || count > (uint64_t)(end - p)) {
+        return false;
+    }
+    std::vector<OrgEntry> orgs((size_t)count);
+    for (OrgEntry& org : orgs) {
+        uint64_t capabilities;
+        if (!GetString(p, end, org.uuid) || !GetString(p, end, org.name) ||
+            !GetString(p, end, org.billingType) || !GetVarint(p, end, capabilities) ||
+            capabilities > (uint64_t)(end - p)) {
+            return false;
+        }
+        org.capabilities.resize((size_t)capabilities);
+        for (std::string& c : org.capabilities) {
+            if (!GetString(p, end, c)) return false;
+        }
+    }
+
+    m_orgs = std::move(orgs);
+    m_fetchedAt = (int64_t)fetchedAt;
+    return true;
+}
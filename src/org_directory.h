@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One organization the session cookie can see. Strings are UTF-8.
+struct OrgEntry {
+    std::string uuid;
+    std::string name;
+    std::string billingType;                // "stripe_subscription", "api_evaluation" ...
+    std::vector<std::string> capabilities;  // "chat", "claude_pro", "api" ...
+
+    bool Has(const std::string& capability) const;
+};
+
+// The /api/organizations listing, boiled down to what picking an org needs.
+// Parse() makes one pass over the body and only looks at the members of the
+// top-level array's objects; nested members, projects and settings are
+// skipped as opaque values (strings by memchr), so their uuids can't be
+// mistaken for an org's and a multi-megabyte listing stays cheap.
+class OrgDirectory {
+public:
+    static constexpr int64_t DEFAULT_TTL_SEC = 24 * 3600;
+
+    // False if the body isn't a JSON array; orgs without a uuid are dropped
+    bool Parse(const std::string& json, int64_t nowSec);
+
+    const std::vector<OrgEntry>& Orgs() const { return m_orgs; }
+    bool Empty() const { return m_orgs.empty(); }
+
+    // When the listing was downloaded (Unix seconds), 0 if never or expired
+    int64_t FetchedAt() const { return m_fetchedAt; }
+    bool IsFresh(int64_t nowSec, int64_t ttlSec = DEFAULT_TTL_SEC) const;
+
+    // Keep the entries (for menus) but make the next lookup re-list
+    void Expire() { m_fetchedAt = 0; }
+
+    const OrgEntry* FindByUuid(const std::string& uuid) const;
+    const OrgEntry* FindByName(const std::string& name) const;    // ASCII case-insensitive
+    const OrgEntry* FindByCapability(const std::string& capability) const;
+
+    // The pinned org (uuid or name) if it's listed; otherwise the first one
+    // with the "chat" capability, which is what has usage limits; otherwise
+    // the first. nullptr if the directory is empty.
+    const OrgEntry* Select(const std::string& pin) const;
+
+    std::vector<uint8_t> Serialize() const;
+    bool Deserialize(const std::vector<uint8_t>& data);
+
+private:
+    std::vector<OrgEntry> m_orgs;
+    int64_t m_fetchedAt = 0;
+};
@@ -1,18 +1,7 @@
 #include "parser.h"
-#include <fstream>
-#include <shlobj.h>
-#include <ctime>
-#include <iomanip>
-#include <sstream>
-
-std::wstring UsageParser::ToWide(const std::string& s) {
-    if (s.empty()) return L"";
-    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), nullptr, 0);
-    if (len == 0) return L"";
-    std::wstring w(len, 0);
-    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), &w[0], len);
-    return w;
-}
+#include "file_util.h"
+#include "timeutil.h"
+#include <mutex>
 
 std::string UsageParser::GetJsonValue(const std::string& json, const std::string& key) {
     std::string search = "\"" + key + "\"";
@@ -87,72 +76,32 @@ std::string UsageParser::GetNestedBlock(const std::string& json, const std::stri
     return "";
 }
 
-std::wstring UsageParser::FormatResetTime(const std::string& isoTime) {
-    if (isoTime.empty()) return L"";
-
-    // Parse ISO 8601: "2026-02-04T21:00:00.490897+00:00"
-    int year, month, day, hour, min, sec;
-    if (sscanf_s(isoTime.c_str(), "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &min, &sec) < 6) {
+std::wstring UsageParser::FormatResetTime(const std::string& isoTime, int64_t& resetMs) {
+    // "2026-02-04T21:00:00.490897+00:00"
+    if (!ParseIso8601(isoTime, resetMs)) {
+        resetMs = 0;
         return L"";
     }
-
-    // Convert to time_t (UTC)
-    tm utcTm = {};
-    utcTm.tm_year = year - 1900;
-    utcTm.tm_mon = month - 1;
-    utcTm.tm_mday = day;
-    utcTm.tm_hour = hour;
-    utcTm.tm_min = min;
-    utcTm.tm_sec = sec;
-    time_t resetTime = _mkgmtime(&utcTm);
-
-    // Get current time
-    time_t now = time(nullptr);
-    double diffSec = difftime(resetTime, now);
-
-    if (diffSec <= 0) {
-        return L"Resetting...";
-    }
-
-    int totalMin = (int)(diffSec / 60);
-    int hours = totalMin / 60;
-    int mins = totalMin % 60;
-
-    if (hours >= 24) {
-        int days = hours / 24;
-        hours = hours % 24;
-        wchar_t buf[64];
-        swprintf_s(buf, L"Resets in %dd %dh", days, hours);
-        return buf;
-    } else if (hours > 0) {
-        wchar_t buf[64];
-        swprintf_s(buf, L"Resets in %dh %dm", hours, mins);
-        return buf;
-    } else {
-        wchar_t buf[64];
-        swprintf_s(buf, L"Resets in %dm", mins);
-        return buf;
-    }
+    return FormatCountdown(resetMs - SampleClocks().wallMs);
 }
 
 void UsageParser::SaveDebugDump(const std::string& body) {
-    wchar_t appData[MAX_PATH];
-    if (FAILED(SHGetFolderPathW(NULL, CSIDL_APPDATA, NULL, 0, appData))) return;
-
-    std::wstring dir = std::wstring(appData) + L"\\ClaudeWatch";
-    CreateDirectoryW(dir.c_str(), NULL);
-
-    std::wstring path = dir + L"\\debug_response.txt";
-    std::ofstream f(path, std::ios::binary);
-    if (f) {
-        f.write(body.c_str(), body.size());
-    }
+    std::filesystem::path dir = GetDataDir();
+    if (dir.empty()) return;
+
+    // Overlapping runs (one cancelled, one current) take turns; the file is
+    // always one whole body
+    static std::mutex dumpLock;
+    std::lock_guard<std::mutex> guard(dumpLock);
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    WriteFileAtomic(dir / "debug_response.txt", std::vector<uint8_t>(body.begin(), body.end()));
 }
 
 UsageData UsageParser::Parse(const std::string& body) {
     UsageData data;
 
-    SaveDebugDump(body);
+    if (saveDebugDump) SaveDebugDump(body);
 
     if (body.empty()) {
         data.error = L"Empty response";
@@ -167,7 +116,7 @@ UsageData UsageParser::Parse(const std::string& body) {
     if (!fiveHour.empty()) {
         data.sessionPercent = GetJsonFloat(fiveHour, "utilization");
         std::string resetAt = GetJsonValue(fiveHour, "resets_at");
-        data.sessionResetText = FormatResetTime(resetAt);
+        data.sessionResetText = FormatResetTime(resetAt, data.sessionResetMs);
         data.sessionLimit = 100; // Percentage-based
         data.sessionUsed = (int)data.sessionPercent;
     }
@@ -177,7 +126,7 @@ UsageData UsageParser::Parse(const std::string& body) {
     if (!sevenDay.empty()) {
         data.periodPercent = GetJsonFloat(sevenDay, "utilization");
         std::string resetAt = GetJsonValue(sevenDay, "resets_at");
-        data.periodResetText = FormatResetTime(resetAt);
+        data.periodResetText = FormatResetTime(resetAt, data.periodResetMs);
         data.periodLimit = 100; // Percentage-based
         data.periodUsed = (int)data.periodPercent;
     }
@@ -1,8 +1,7 @@
 #pragma once
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
 #include <string>
+#include <cstdint>
 
 struct UsageData {
     bool valid = false;
@@ -13,17 +12,22 @@ struct UsageData {
     int sessionUsed = 0;    // For display as "93%"
     int sessionLimit = 100;
     std::wstring sessionResetText;
+    int64_t sessionResetMs = 0;     // Unix ms, 0 if unknown
 
     // Period (7-day) - percentage based
     float periodPercent = 0.0f;
     int periodUsed = 0;
     int periodLimit = 100;
     std::wstring periodResetText;
+    int64_t periodResetMs = 0;
     std::wstring periodLabel = L"Weekly";
 
     // Combined reset text for footer
     std::wstring resetText;
 
+    // Percentages extrapolated from local session logs since the last fetch
+    bool estimated = false;
+
     float SessionPercent() const { return sessionPercent; }
     float PeriodPercent() const { return periodPercent; }
 
@@ -50,14 +54,15 @@ struct UsageData {
 
 class UsageParser {
 public:
+    bool saveDebugDump = true;  // Keep the last body in debug_response.txt
+
     UsageData Parse(const std::string& body);
     void SaveDebugDump(const std::string& body);
 
 private:
-    std::wstring ToWide(const std::string& s);
     std::string GetJsonValue(const std::string& json, const std::string& key);
     int GetJsonInt(const std::string& json, const std::string& key);
     float GetJsonFloat(const std::string& json, const std::string& key);
     std::string GetNestedBlock(const std::string& json, const std::string& key);
-    std::wstring FormatResetTime(const std::string& isoTime);
+    std::wstring FormatResetTime(const std::string& isoTime, int64_t& resetMs);
 };
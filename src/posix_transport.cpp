@@ -0,0 +1,352 @@
+#include "http_client.h"
+#include "socket_util.h"
+#include "text_util.h"
+#include "trace.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+#ifdef CLAUDEWATCH_TLS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+namespace {
+
+// Every phase is bounded the same as the WinHTTP transport's receive timeout
+constexpr uint32_t SOCKET_TIMEOUT_MS = 15000;
+constexpr size_t MAX_HEADER_BYTES = 64 * 1024;
+constexpr size_t MAX_BODY_BYTES = 8 * 1024 * 1024;
+// How often a blocked read looks at the cancel flag
+constexpr int CANCEL_POLL_MS = 100;
+
+struct ParsedUrl {
+    bool secure = false;
+    std::string host;
+    uint16_t port = 0;
+    std::string path;
+};
+
+bool ParseUrl(const std::string& url, ParsedUrl& out) {
+    size_t rest;
+    if (url.compare(0, 8, "https://") == 0) {
+        out.secure = true;
+        out.port = 443;
+        rest = 8;
+    } else if (url.compare(0, 7, "http://") == 0) {
+        out.port = 80;
+        rest = 7;
+    } else {
+        return false;
+    }
+
+    size_t slash = url.find('/', rest);
+    std::string authority = url.substr(rest, slash == std::string::npos ? std::string::npos : slash - rest);
+    out.path = slash == std::string::npos ? "/" : url.substr(slash);
+
+    // "host:port" or "[v6]:port"; a bare host keeps the scheme's port
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        if (!ParseHostPort(authority, out.host, out.port)) return false;
+    } else if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']') {
+        out.host = authority.substr(1, authority.size() - 2);
+    } else {
+        out.host = authority;
+    }
+    return !out.host.empty();
+}
+
+// A blocking socket, optionally wrapped in TLS
+class Connection {
+public:
+    ~Connection() {
+#ifdef CLAUDEWATCH_TLS
+        if (m_ssl) {
+            SSL_shutdown(m_ssl);
+            SSL_free(m_ssl);
+        }
+#endif
+        CloseSocket(m_socket);
+    }
+
+    bool Open(const ParsedUrl& url, void* tlsContext, std::wstring& error) {
+        std::string message;
+        m_socket = ConnectTcp(url.host, url.port, message, SOCKET_TIMEOUT_MS);
+        if (m_socket == INVALID_SOCKET_HANDLE) {
+            error = L"Failed to connect: " + Utf8ToWide(message);
+            return false;
+        }
+        if (!url.secure) return true;
+
+#ifdef CLAUDEWATCH_TLS
+        m_ssl = SSL_new((SSL_CTX*)tlsContext);
+        if (!m_ssl) {
+            error = L"Failed to create TLS session";
+            return false;
+        }
+        SSL_set_fd(m_ssl, m_socket);
+        SSL_set_tlsext_host_name(m_ssl, url.host.c_str());
+        SSL_set1_host(m_ssl, url.host.c_str());
+        if (SSL_connect(m_ssl) != 1) {
+            char reason[256];
+            ERR_error_string_n(ERR_get_error(), reason, sizeof(reason));
+            error = L"TLS handshake failed: " + Utf8ToWide(reason);
+            return false;
+        }
+        return true;
+#else
+        (void)tlsContext;
+        error = L"Built without TLS support";
+        return false;
+#endif
+    }
+
+    bool Write(const std::string& data) {
+#ifdef CLAUDEWATCH_TLS
+        if (m_ssl) {
+            size_t written = 0;
+            return SSL_write_ex(m_ssl, data.data(), data.size(), &written) == 1 && written == data.size();
+        }
+#endif
+        return SendAll(m_socket, data.data(), data.size());
+    }
+
+    // Bytes read, 0 at end of stream, -1 on error, timeout or cancel. Waits in
+    // short slices so a cancelled run gives up its thread promptly.
+    int Read(char* buf, size_t size, const std::atomic<bool>* cancel) {
+        bool buffered = false;
+#ifdef CLAUDEWATCH_TLS
+        buffered = m_ssl && SSL_pending(m_ssl) > 0;
+#endif
+        for (uint32_t waited = 0; !buffered;) {
+            if (cancel && cancel->load()) return -1;
+            pollfd pfd = { m_socket, POLLIN, 0 };
+            int ready = poll(&pfd, 1, CANCEL_POLL_MS);
+            if (ready > 0) break;
+            if (ready < 0 && errno != EINTR) return -1;
+            waited += CANCEL_POLL_MS;
+            if (waited >= SOCKET_TIMEOUT_MS) return -1;
+        }
+#ifdef CLAUDEWATCH_TLS
+        if (m_ssl) {
+            size_t n = 0;
+            if (SSL_read_ex(m_ssl, buf, size, &n) == 1) return (int)n;
+            return SSL_get_error(m_ssl, 0) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+        }
+#endif
+        return (int)recv(m_socket, buf, size, 0);
+    }
+
+private:
+    SocketHandle m_socket = INVALID_SOCKET_HANDLE;
+#ifdef CLAUDEWATCH_TLS
+    SSL* m_ssl = nullptr;
+#endif
+};
+
+// Value of a header in a raw header block, case-insensitive name
+bool FindHeader(const std::string& headers, const char* name, std::string& value) {
+    size_t len = strlen(name);
+    for (size_t pos = headers.find("\r\n"); pos != std::string::npos; pos = headers.find("\r\n", pos + 2)) {
+        size_t line = pos + 2;
+        if (headers.size() - line > len && strncasecmp(headers.c_str() + line, name, len) == 0 &&
+            headers[line + len] == ':') {
+            size_t start = headers.find_first_not_of(" \t", line + len + 1);
+            size_t end = headers.find("\r\n", line);
+            if (start == std::string::npos || start > end) start = end;
+            value = headers.substr(start, end - start);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Chunked transfer decoding that resumes where the previous read stopped,
+// so a multi-megabyte body costs one pass however it's split up
+class ChunkedDecoder {
+public:
+    // `raw` is everything received so far; complete chunks past the last call
+    // are appended to `out`. True once the terminating chunk has arrived.
+    bool Feed(const std::string& raw, std::string& out) {
+        for (;;) {
+            size_t lineEnd = raw.find("\r\n", m_pos);
+            if (lineEnd == std::string::npos) return false;
+            size_t size = strtoul(raw.c_str() + m_pos, nullptr, 16);
+            size_t data = lineEnd + 2;
+            if (size == 0) return true;     // Trailers aren't wanted
+            if (raw.size() < data + size + 2) return false;
+            out.append(raw, data, size);
+            m_pos = data + size + 2;
+        }
+    }
+
+private:
+    size_t m_pos = 0;   // Start of the next chunk-size line
+};
+
+class PosixHttpTransport : public HttpTransport {
+public:
+    PosixHttpTransport();
+    ~PosixHttpTransport() override;
+
+    HttpResponse Send(const wchar_t* verb, const std::wstring& url, const std::wstring& cookie,
+                      const std::string* body, const wchar_t* contentType,
+                      const std::atomic<bool>* cancel) override;
+
+private:
+    void* m_tls = nullptr;  // SSL_CTX, shared by every connection
+};
+
+bool IsCancelled(const std::atomic<bool>* cancel) {
+    return cancel && cancel->load();
+}
+
+} // namespace
+
+std::unique_ptr<HttpTransport> CreatePosixHttpTransport() {
+    return std::make_unique<PosixHttpTransport>();
+}
+
+PosixHttpTransport::PosixHttpTransport() {
+    InitSockets();
+#ifdef CLAUDEWATCH_TLS
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    if (ctx) {
+        SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+        SSL_CTX_set_default_verify_paths(ctx);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+        // Servers that just close after Connection: close are fine
+        SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+    }
+    m_tls = ctx;
+#endif
+}
+
+PosixHttpTransport::~PosixHttpTransport() {
+#ifdef CLAUDEWATCH_TLS
+    SSL_CTX_free((SSL_CTX*)m_tls);
+#endif
+}
+
+HttpResponse PosixHttpTransport::Send(const wchar_t* verb, const std::wstring& url, const std::wstring& cookie,
+                                      const std::string* body, const wchar_t* contentType,
+                                      const std::atomic<bool>* cancel) {
+    HttpResponse response;
+    response.status = HttpStatus::NetworkError;
+    response.statusCode = 0;
+
+    ParsedUrl target;
+    if (!ParseUrl(WideToUtf8(url), target)) {
+        response.error = L"Failed to parse URL";
+        return response;
+    }
+#ifdef CLAUDEWATCH_TLS
+    if (target.secure && !m_tls) {
+        response.error = L"Failed to initialize TLS";
+        return response;
+    }
+#endif
+
+    // Connect
+    TraceSpan phase(TraceEvent::HttpConnect);
+    Connection conn;
+    if (IsCancelled(cancel) || !conn.Open(target, m_tls, response.error)) {
+        return response;
+    }
+
+    // One request per connection; polls are minutes apart
+    phase.Next(TraceEvent::HttpSend);
+    std::string request = WideToUtf8(verb) + " " + target.path + " HTTP/1.1\r\nHost: " + target.host;
+    if (target.port != (target.secure ? 443 : 80)) request += ":" + std::to_string(target.port);
+    request += "\r\nUser-Agent: ClaudeWatch/1.0\r\nAccept: */*\r\nAccept-Encoding: identity\r\n"
+               "Connection: close\r\n";
+    if (!cookie.empty()) request += "Cookie: sessionKey=" + WideToUtf8(cookie) + "\r\n";
+    if (body) {
+        if (contentType) request += "Content-Type: " + WideToUtf8(contentType) + "\r\n";
+        request += "Content-Length: " + std::to_string(body->size()) + "\r\n";
+    }
+    request += "\r\n";
+    if (body) request += *body;
+    if (!conn.Write(request)) {
+        response.error = L"Failed to send request";
+        return response;
+    }
+
+    // Receive response headers
+    phase.Next(TraceEvent::HttpReceive);
+    std::string raw;
+    char chunk[16 * 1024];
+    size_t headerEnd;
+    while ((headerEnd = raw.find("\r\n\r\n")) == std::string::npos) {
+        int n = conn.Read(chunk, sizeof(chunk), cancel);
+        if (n <= 0 || raw.size() > MAX_HEADER_BYTES) {
+            response.error = L"Failed to receive response";
+            return response;
+        }
+        raw.append(chunk, (size_t)n);
+    }
+
+    // "HTTP/1.1 200 OK"
+    int statusCode = 0;
+    if (sscanf(raw.c_str(), "HTTP/%*d.%*d %d", &statusCode) != 1) {
+        response.error = L"Malformed response";
+        return response;
+    }
+    response.statusCode = statusCode;
+    TraceInstant(TraceEvent::HttpStatus, (uint32_t)statusCode);
+
+    // Error bodies aren't wanted
+    response.status = HttpStatus::Success;
+    if (statusCode == 401 || statusCode == 403 || statusCode >= 500) {
+        return response;
+    }
+
+    // Read body: by length, chunked, or until the server closes
+    phase.Next(TraceEvent::HttpRead);
+    std::string headers = raw.substr(0, headerEnd + 2);
+    std::string content = raw.substr(headerEnd + 4);
+    std::string value;
+    bool chunked = FindHeader(headers, "Transfer-Encoding", value) && strcasestr(value.c_str(), "chunked");
+    size_t length = SIZE_MAX;
+    if (!chunked && FindHeader(headers, "Content-Length", value)) length = strtoull(value.c_str(), nullptr, 10);
+
+    ChunkedDecoder decoder;
+    bool complete = false;
+    for (;;) {
+        if (chunked ? decoder.Feed(content, response.body) : content.size() >= length) {
+            complete = true;
+            break;
+        }
+        if (IsCancelled(cancel)) {
+            response.status = HttpStatus::NetworkError;
+            response.error = L"Cancelled";
+            response.body.clear();
+            return response;
+        }
+        int n = content.size() > MAX_BODY_BYTES ? -1 : conn.Read(chunk, sizeof(chunk), cancel);
+        if (n <= 0) {
+            complete = n == 0 && !chunked && length == SIZE_MAX;
+            break;
+        }
+        content.append(chunk, (size_t)n);
+    }
+
+    if (!chunked) {
+        if (content.size() > length) content.resize(length);
+        response.body = std::move(content);
+    }
+    if (!complete) {
+        response.status = HttpStatus::NetworkError;
+        response.error = L"Connection closed mid-response";
+        response.body.clear();
+        return response;
+    }
+    phase.SetResult((uint32_t)response.body.size());
+    return response;
+}
@@ -0,0 +1,110 @@
+#include "refresh.h"
+#include "text_util.h"
+#include "trace.h"
+#include <ctime>
+
+const wchar_t* const DEFAULT_API_BASE = L"https://claude.ai";
+
+bool RefreshFlight::Request() {
+    if (m_inFlight == m_generation) {
+        m_joined++;
+        return false;
+    }
+
+    // Nothing in flight, or only a stale run that's already been cancelled
+    m_inFlight = m_generation;
+    m_cancel = std::make_shared<std::atomic<bool>>(false);
+    m_started++;
+    return true;
+}
+
+void RefreshFlight::Invalidate() {
+    m_generation++;
+    if (m_cancel) m_cancel->store(true);
+}
+
+bool RefreshFlight::Complete(uint64_t generation) {
+    if (generation == m_inFlight) m_inFlight = 0;
+    return generation == m_generation;
+}
+
+uint32_t SmartRefreshIntervalMs(float maxPercent, uint32_t minIntervalMs, uint32_t maxIntervalMs) {
+    if (maxPercent >= 80.0f) return minIntervalMs;     // 1 min
+    if (maxPercent >= 50.0f) return 5 * 60 * 1000;     // 5 min
+    return maxIntervalMs;                               // 10 min
+}
+
+// Download the org listing and pick one; false (with the outcome set) if
+// that didn't work out
+static bool ListOrganizations(HttpClient& http, const std::wstring& cookie, const std::string& pin,
+                              const CancelToken& cancel, const std::wstring& apiBase, RefreshResult& result) {
+    HttpResponse orgResp = http.Get(apiBase + L"/api/organizations", cookie, cancel.get());
+    if (cancel->load()) return false;
+
+    if (orgResp.status == HttpStatus::AuthError) {
+        result.outcome = RefreshOutcome::AuthError;
+        return false;
+    }
+    if (orgResp.status != HttpStatus::Success) {
+        result.outcome = RefreshOutcome::Offline;
+        result.error = orgResp.error;
+        return false;
+    }
+
+    TraceSpan parse(TraceEvent::Parse);
+    const OrgEntry* org = nullptr;
+    if (result.orgs.Parse(orgResp.body, (int64_t)time(nullptr))) org = result.orgs.Select(pin);
+    if (!org) {
+        result.outcome = RefreshOutcome::NoOrg;
+        return false;
+    }
+    result.orgId = Utf8ToWide(org->uuid);
+    return true;
+}
+
+RefreshResult RunRefreshPipeline(HttpClient& http, UsageParser& parser, const std::wstring& cookie,
+                                 const OrgChoice& org, const CancelToken& cancel, uint64_t generation,
+                                 const std::wstring& apiBase) {
+    RefreshResult result;
+    result.generation = generation;
+    result.orgId = org.orgId;
+
+    TraceSpan span(TraceEvent::Refresh, (uint32_t)generation);
+
+    // Step 1: Get organization ID if we don't have it
+    if (result.orgId.empty()) {
+        if (cancel->load()) return result;
+        if (!ListOrganizations(http, cookie, org.pin, cancel, apiBase, result)) return result;
+    }
+
+    // Step 2: Fetch usage data
+    if (cancel->load()) return result;
+    std::wstring usageUrl = apiBase + L"/api/organizations/" + result.orgId + L"/usage";
+    HttpResponse resp = http.Get(usageUrl, cookie, cancel.get());
+    if (cancel->load()) return result;
+
+    // A cached org may not belong to this cookie (or may be gone): re-list once
+    bool refused = resp.status == HttpStatus::AuthError ||
+                   (resp.status == HttpStatus::Success && resp.statusCode == 404);
+    if (refused && org.cached && result.orgs.FetchedAt() == 0) {
+        std::wstring previous = result.orgId;
+        if (!ListOrganizations(http, cookie, org.pin, cancel, apiBase, result)) return result;
+        if (result.orgId != previous) {
+            usageUrl = apiBase + L"/api/organizations/" + result.orgId + L"/usage";
+            resp = http.Get(usageUrl, cookie, cancel.get());
+            if (cancel->load()) return result;
+        }
+    }
+
+    if (resp.status == HttpStatus::Success) {
+        TraceSpan parse(TraceEvent::Parse);
+        result.usage = parser.Parse(resp.body);
+        result.outcome = RefreshOutcome::Success;
+    } else if (resp.status == HttpStatus::AuthError) {
+        result.outcome = RefreshOutcome::AuthError;
+    } else {
+        result.outcome = RefreshOutcome::Offline;
+        result.error = resp.error;
+    }
+    return result;
+}
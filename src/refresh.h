@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "http_client.h"
+#include "org_directory.h"
+#include "parser.h"
+
+// Set to true to abandon a pipeline run; checked between and during requests
+typedef std::shared_ptr<std::atomic<bool>> CancelToken;
+
+enum class RefreshOutcome {
+    Success,
+    AuthError,
+    Offline,
+    NoOrg,
+    Cancelled
+};
+
+struct RefreshResult {
+    uint64_t generation = 0;
+    RefreshOutcome outcome = RefreshOutcome::Cancelled;
+    std::wstring orgId;     // Org this run used, possibly just discovered
+    OrgDirectory orgs;      // The listing, if this run downloaded it (FetchedAt() != 0)
+    UsageData usage;        // Valid on Success
+    std::wstring error;     // What failed, for Offline
+};
+
+// Which org a run polls. One taken from the cached directory hasn't been
+// confirmed for this cookie; if the usage call is refused, the pipeline
+// re-lists the orgs before reporting an auth error.
+struct OrgChoice {
+    std::wstring orgId;     // Empty: list the orgs and pick
+    std::string pin;        // Pinned org, uuid or name (UTF-8)
+    bool cached = false;
+};
+
+// Single-flight gate for refreshes. Every trigger (timer, menu, cookie change,
+// startup, reconnect) goes through Request(); while a run for the current
+// generation is in flight, further requests join it instead of issuing their
+// own org+usage calls. Invalidate() is for cookie/org changes: it bumps the
+// generation and cancels the run in flight, whose result is then discarded.
+// UI-thread only; only the cancel token is shared with the worker.
+class RefreshFlight {
+public:
+    // True if the caller should start a pipeline, false if it joined one
+    bool Request();
+
+    void Invalidate();
+
+    // The run for `generation` finished; true if its result is still current
+    bool Complete(uint64_t generation);
+
+    bool InFlight() const { return m_inFlight != 0; }
+    uint64_t Generation() const { return m_generation; }
+    CancelToken Token() const { return m_cancel; }
+
+    uint64_t Started() const { return m_started; }
+    uint64_t Joined() const { return m_joined; }
+
+private:
+    uint64_t m_generation = 1;
+    uint64_t m_inFlight = 0;    // Generation of the run in flight, 0 if none
+    CancelToken m_cancel;
+    uint64_t m_started = 0;
+    uint64_t m_joined = 0;
+};
+
+// "https://claude.ai"; the headless daemon can point elsewhere
+extern const wchar_t* const DEFAULT_API_BASE;
+
+// Resolve the org (if none was chosen) then fetch and parse usage. Blocking;
+// meant for a worker thread.
+RefreshResult RunRefreshPipeline(HttpClient& http, UsageParser& parser, const std::wstring& cookie,
+                                 const OrgChoice& org, const CancelToken& cancel, uint64_t generation,
+                                 const std::wstring& apiBase = DEFAULT_API_BASE);
+
+// Smart-refresh cadence: poll faster as the busier limit fills up
+uint32_t SmartRefreshIntervalMs(float maxPercent, uint32_t minIntervalMs, uint32_t maxIntervalMs);
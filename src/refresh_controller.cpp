@@ -0,0 +1,252 @@
+#include "refresh_controller.h"
+#include "text_util.h"
+
+ClockSample RefreshController::Now() const {
+    return hooks.clock ? hooks.clock() : SampleClocks();
+}
+
+void RefreshController::Rearm() {
+    if (hooks.rearm) hooks.rearm();
+}
+
+bool RefreshController::Refresh() {
+    if (hooks.canFetch && !hooks.canFetch()) return false;
+    if (!m_flight.Request()) return true;
+
+    // Keep the regular cadence going even if this run never reports back
+    ScheduleRefresh();
+
+    // A fresh cached listing stands in for the org lookup
+    OrgChoice org;
+    org.orgId = m_orgId;
+    org.pin = pin;
+    org.cached = !m_orgConfirmed;
+    if (org.orgId.empty() && m_orgs.IsFresh(Now().wallMs / 1000)) {
+        if (const OrgEntry* entry = m_orgs.Select(pin)) org.orgId = Utf8ToWide(entry->uuid);
+    }
+    hooks.fetch(org, m_flight.Generation(), m_flight.Token());
+    return true;
+}
+
+bool RefreshController::ApplyResult(const RefreshResult& result) {
+    // A cookie or org change while this was in flight makes it someone else's data
+    if (!m_flight.Complete(result.generation)) return false;
+    if (result.outcome == RefreshOutcome::Cancelled) return false;
+
+    if (result.orgs.FetchedAt() != 0) m_orgs = result.orgs;
+
+    switch (result.outcome) {
+    case RefreshOutcome::Success:
+        m_orgId = result.orgId;
+        m_orgConfirmed = true;
+        m_valid = result.usage.valid;
+        m_offline = false;
+        m_reconnect.Cancel();
+        break;
+
+    case RefreshOutcome::AuthError:
+        // Nothing to do until someone updates the cookie
+        m_valid = false;
+        m_offline = false;
+        m_orgId.clear();
+        m_orgConfirmed = false;
+        break;
+
+    case RefreshOutcome::NoOrg:
+        m_valid = false;
+        break;
+
+    default:
+        // Network error - keep old data, mark offline
+        m_offline = true;
+        break;
+    }
+
+    if (m_probing && !hooks.probe) {
+        m_probing = false;
+        m_reconnect.OnProbeResult(Now().bootMs, result.outcome != RefreshOutcome::Offline);
+    }
+    if (hooks.onResult) hooks.onResult(result);
+    ScheduleProbe();
+
+    if (result.outcome == RefreshOutcome::Success) {
+        // Countdowns run off the boot clock from here on. Fresh data needs no
+        // re-anchoring, so any jump seen here just moves the baseline.
+        ClockSample clocks = Now();
+        m_clockMonitor.Observe(clocks);
+        m_sessionReset.Clear();
+        m_periodReset.Clear();
+        if (result.usage.sessionResetMs) m_sessionReset.Anchor(result.usage.sessionResetMs, clocks);
+        if (result.usage.periodResetMs) m_periodReset.Anchor(result.usage.periodResetMs, clocks);
+        UpdateCountdown();
+    }
+
+    // The interval follows the new usage
+    ScheduleRefresh();
+    return true;
+}
+
+void RefreshController::ScheduleRefresh() {
+    uint32_t interval = m_activity.NextIntervalMs(hooks.intervalMs());
+    if (interval == 0) {
+        // Parked - an activity event will reschedule us
+        m_scheduler.Cancel(TASK_REFRESH);
+    } else {
+        m_scheduler.Schedule(TASK_REFRESH, Now().bootMs + interval, m_activity.ToleranceMs(interval));
+    }
+    Rearm();
+}
+
+bool RefreshController::RunTask(DeadlineScheduler::TaskId task) {
+    switch (task) {
+    case TASK_REFRESH:
+        m_activity.OnIdle(hooks.idleSeconds ? hooks.idleSeconds() : 0);
+        if (m_activity.OnTick()) {
+            Refresh();
+        } else {
+            ScheduleRefresh();
+        }
+        return true;
+
+    case TASK_NETPROBE:
+        RunReconnectProbe();
+        return true;
+
+    case TASK_COUNTDOWN:
+        UpdateCountdown();
+        return true;
+    }
+    return false;
+}
+
+// Feed an activity event to the policy; refresh immediately if we just woke up,
+// then re-arm (or park) the timer for the new state
+void RefreshController::OnActivityEvent(ActivityEvent ev) {
+    if (m_activity.OnEvent(ev)) Refresh();
+    ScheduleRefresh();
+    UpdateCountdown();
+}
+
+// Re-derive the reset countdowns from their anchored deadlines and tick again
+// when the displayed minute changes (if anyone displays it). A window that has run out gets a fresh
+// fetch a few seconds later, once the server has rolled it over.
+void RefreshController::UpdateCountdown() {
+    m_scheduler.Cancel(TASK_COUNTDOWN);
+    if (!m_valid) {
+        Rearm();
+        return;
+    }
+
+    ClockSample now = Now();
+    bool expired = false;
+    int64_t nextMs = 0;
+    for (ResetDeadline* deadline : { &m_sessionReset, &m_periodReset }) {
+        if (!deadline->IsSet()) continue;
+        int64_t remaining = deadline->RemainingMs(now);
+        if (remaining <= -RESET_GRACE_MS) {
+            expired = true;
+            deadline->Clear();
+            continue;
+        }
+        // Without a countdown on screen, only the deadline itself matters
+        int64_t delay = hooks.onCountdown ? CountdownDelayMs(remaining, RESET_GRACE_MS)
+                                          : remaining + RESET_GRACE_MS;
+        if (nextMs == 0 || delay < nextMs) nextMs = delay;
+    }
+    if (hooks.onCountdown) hooks.onCountdown(m_sessionReset, m_periodReset, now);
+
+    if (m_activity.IsParked()) {
+        // An activity event refreshes and restarts the countdown
+    } else if (expired) {
+        Refresh();
+    } else if (nextMs > 0) {
+        m_scheduler.Schedule(TASK_COUNTDOWN, now.bootMs + (uint64_t)nextMs, 1000);
+    }
+    Rearm();
+}
+
+// The wall clock was set or the machine slept without us hearing about it:
+// re-pin the deadlines to the new wall time and get fresh numbers
+void RefreshController::CheckClocks() {
+    ClockSample now = Now();
+    switch (m_clockMonitor.Observe(now)) {
+    case ClockEvent::WallJump:
+        if (m_sessionReset.IsSet()) m_sessionReset.Anchor(m_sessionReset.WallMs(), now);
+        if (m_periodReset.IsSet()) m_periodReset.Anchor(m_periodReset.WallMs(), now);
+        if (!m_activity.IsParked()) Refresh();
+        UpdateCountdown();
+        break;
+
+    case ClockEvent::Resumed:
+        // Boot-clock deadlines are still right; the usage numbers aren't
+        if (!m_activity.IsParked()) Refresh();
+        UpdateCountdown();
+        break;
+
+    default:
+        break;
+    }
+}
+
+// The network changed - if we're offline, probe the API host shortly instead
+// of waiting out the refresh interval
+void RefreshController::OnNetworkChanged() {
+    m_reconnect.OnNetworkChanged(Now().bootMs, m_offline);
+    ScheduleProbe();
+}
+
+void RefreshController::ScheduleProbe() {
+    uint64_t deadline = m_reconnect.Deadline();
+    if (deadline == 0 || m_probing) {
+        m_scheduler.Cancel(TASK_NETPROBE);
+    } else {
+        m_scheduler.Schedule(TASK_NETPROBE, deadline, 250);
+    }
+    Rearm();
+}
+
+void RefreshController::RunReconnectProbe() {
+    if (m_probing) return;  // The result reschedules
+    if (!m_reconnect.ProbeDue(Now().bootMs)) {
+        ScheduleProbe();
+        return;
+    }
+    m_probing = true;
+    m_scheduler.Cancel(TASK_NETPROBE);
+    if (hooks.probe) {
+        hooks.probe();
+    } else if (!Refresh()) {
+        m_probing = false;
+        ScheduleProbe();
+    }
+}
+
+void RefreshController::ApplyProbeResult(bool reachable) {
+    m_probing = false;
+    if (m_reconnect.OnProbeResult(Now().bootMs, reachable) && !m_activity.IsParked()) {
+        Refresh();
+    }
+    ScheduleProbe();
+}
+
+void RefreshController::ForgetOrg() {
+    m_orgId.clear();
+    m_orgConfirmed = false;
+}
+
+void RefreshController::Cancel() {
+    m_flight.Invalidate();
+    if (!hooks.probe) m_probing = false;    // Its result won't be applied
+}
+
+void RefreshController::Restart() {
+    Cancel();
+    m_offline = false;
+    Refresh();
+}
+
+void RefreshController::ReloadOrgs() {
+    m_orgs.Expire();
+    ForgetOrg();
+    Restart();
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "activity.h"
+#include "net_watch.h"
+#include "org_directory.h"
+#include "refresh.h"
+#include "scheduler.h"
+#include "timeutil.h"
+
+// What a RefreshController needs from its host. fetch and intervalMs are
+// required; the rest may be left empty.
+struct RefreshHooks {
+    // Wall, boot and active time now; SampleClocks() if unset
+    std::function<ClockSample()> clock;
+
+    // Whether a run can start at all (there is a cookie)
+    std::function<bool()> canFetch;
+
+    // Start a pipeline run and hand its result to ApplyResult() later, on
+    // the controller's thread
+    std::function<void(const OrgChoice& org, uint64_t generation, const CancelToken& cancel)> fetch;
+
+    // Check the API host is reachable and report to ApplyProbeResult(). If
+    // unset, a poll is the probe: it fails as fast as a bare connect would,
+    // and once the network is back it's the request we wanted anyway.
+    std::function<void()> probe;
+
+    // Poll interval before the activity policy stretches it
+    std::function<uint32_t()> intervalMs;
+
+    // Seconds since the last user input
+    std::function<uint32_t()> idleSeconds;
+
+    // A result was accepted; controller state (org, Offline()) is already
+    // updated, countdowns and the next poll not yet
+    std::function<void(const RefreshResult& result)> onResult;
+
+    // The countdowns were re-derived; an expired deadline is already cleared.
+    // Set, it ticks every minute; unset, the controller only wakes at resets.
+    std::function<void(const ResetDeadline& session, const ResetDeadline& period, const ClockSample& now)>
+        onCountdown;
+
+    // The scheduler's next wakeup may have moved
+    std::function<void()> rearm;
+};
+
+// The glue between the refresh pieces, shared by the widget, claudewatchd
+// and the simulator: when to poll (DeadlineScheduler, ActivityPolicy), one
+// run at a time (RefreshFlight), which org to ask for (OrgDirectory),
+// recovering from outages (ReconnectTracker), fetching again when a reset
+// deadline passes (ResetDeadline) and after wall-clock jumps or unnoticed
+// sleeps (ClockMonitor). Time and I/O come in through RefreshHooks, so a
+// virtual clock and a fault model can drive the same code. Not thread-safe:
+// everything, results included, goes through the owner's thread.
+class RefreshController {
+public:
+    // Scheduler tasks the controller owns; hosts number theirs from FIRST_HOST_TASK
+    enum : DeadlineScheduler::TaskId {
+        TASK_REFRESH,
+        TASK_NETPROBE,
+        TASK_COUNTDOWN,
+        FIRST_HOST_TASK,
+    };
+
+    // How long after a reset deadline before asking the server for the new window
+    static constexpr int64_t RESET_GRACE_MS = 5000;
+
+    explicit RefreshController(DeadlineScheduler& scheduler) : m_scheduler(scheduler) {}
+
+    RefreshHooks hooks;
+    std::string pin;    // Pinned org, uuid or name (UTF-8); empty picks one
+
+    // Start a run, or join the one in flight. False if none is running
+    // (canFetch said no).
+    bool Refresh();
+
+    // Apply a finished run; false if it was cancelled or belongs to an
+    // earlier generation and was discarded
+    bool ApplyResult(const RefreshResult& result);
+
+    void ApplyProbeResult(bool reachable);
+
+    // Run one of the controller's tasks; false if `task` is the host's
+    bool RunTask(DeadlineScheduler::TaskId task);
+
+    // Call before running due tasks, and when the OS says the time changed
+    void CheckClocks();
+
+    void OnActivityEvent(ActivityEvent ev);
+    void OnNetworkChanged();
+
+    // Rearm the poll timer, e.g. at startup or after the interval changed
+    void ScheduleRefresh();
+
+    // The cookie or pinned org changed: look the org up again
+    void ForgetOrg();
+
+    // Cancel the run in flight; its result will be discarded
+    void Cancel();
+
+    // Cancel, then poll now
+    void Restart();
+
+    // Orgs added or renamed since the last listing
+    void ReloadOrgs();
+
+    bool Offline() const { return m_offline; }
+    const std::wstring& OrgId() const { return m_orgId; }
+    OrgDirectory& Orgs() { return m_orgs; }
+    const OrgDirectory& Orgs() const { return m_orgs; }
+    ActivityPolicy& Activity() { return m_activity; }
+    const RefreshFlight& Flight() const { return m_flight; }
+    uint64_t ProbeDeadline() const { return m_reconnect.Deadline(); }
+
+private:
+    DeadlineScheduler& m_scheduler;
+    ActivityPolicy m_activity;
+    RefreshFlight m_flight;
+    ReconnectTracker m_reconnect;
+    ResetDeadline m_sessionReset;
+    ResetDeadline m_periodReset;
+    ClockMonitor m_clockMonitor;
+
+    std::wstring m_orgId;
+    bool m_orgConfirmed = false;    // m_orgId worked with the current cookie
+    OrgDirectory m_orgs;
+    bool m_valid = false;           // The last accepted result had usage
+    bool m_offline = false;
+    bool m_probing = false;         // A probe (or a poll standing in for one) is out
+
+    ClockSample Now() const;
+    void UpdateCountdown();
+    void ScheduleProbe();
+    void RunReconnectProbe();
+    void Rearm();
+};
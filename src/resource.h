@@ -8,3 +8,10 @@
 #define ID_MENU_ONTOP       1003
 #define ID_MENU_OPENSITE    1004
 #define ID_MENU_EXIT        1005
+#define ID_MENU_TRAYMODE    1006
+#define ID_MENU_DIAGNOSTICS 1007
+#define ID_MENU_SAVETRACE   1008
+#define ID_MENU_ORG_AUTO    1009
+#define ID_MENU_ORG_RELOAD  1010
+#define ID_MENU_ORG_FIRST   1100    // + index into the org directory
+#define ID_MENU_ORG_LAST    1163
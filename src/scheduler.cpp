@@ -0,0 +1,117 @@
+#include "scheduler.h"
+#include <algorithm>
+
+// std heaps are max-heaps; invert the comparison to get the earliest on top
+namespace {
+struct EntryLater {
+    template <typename E>
+    bool operator()(const E& a, const E& b) const { return a.key > b.key; }
+};
+}
+
+void DeadlineScheduler::Schedule(TaskId id, uint64_t dueMs, uint32_t toleranceMs) {
+    if (id >= m_slots.size()) m_slots.resize(id + 1);
+
+    Slot& slot = m_slots[id];
+    if (!slot.scheduled) m_live++;
+    slot.due = dueMs;
+    slot.tolerance = toleranceMs;
+    slot.scheduled = true;
+    slot.gen++;
+
+    m_byDue.push_back({ dueMs, id, slot.gen });
+    std::push_heap(m_byDue.begin(), m_byDue.end(), EntryLater());
+
+    // Rescheduling leaves stale entries behind; don't let them pile up
+    if (m_byDue.size() > 4 * m_live + 16) Compact();
+}
+
+void DeadlineScheduler::Cancel(TaskId id) {
+    if (id >= m_slots.size() || !m_slots[id].scheduled) return;
+    m_slots[id].scheduled = false;
+    m_slots[id].gen++;
+    m_live--;
+}
+
+bool DeadlineScheduler::IsScheduled(TaskId id) const {
+    return id < m_slots.size() && m_slots[id].scheduled;
+}
+
+uint64_t DeadlineScheduler::DueTime(TaskId id) const {
+    return IsScheduled(id) ? m_slots[id].due : 0;
+}
+
+bool DeadlineScheduler::IsLive(const Entry& e) const {
+    const Slot& slot = m_slots[e.id];
+    return slot.scheduled && slot.gen == e.gen;
+}
+
+void DeadlineScheduler::DropStale(std::vector<Entry>& heap) {
+    while (!heap.empty() && !IsLive(heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), EntryLater());
+        heap.pop_back();
+    }
+}
+
+void DeadlineScheduler::Compact() {
+    auto stale = [this](const Entry& e) { return !IsLive(e); };
+    m_byDue.erase(std::remove_if(m_byDue.begin(), m_byDue.end(), stale), m_byDue.end());
+    std::make_heap(m_byDue.begin(), m_byDue.end(), EntryLater());
+}
+
+uint64_t DeadlineScheduler::NextWake() {
+    // Start at the earliest due time and only slide later to pick up the
+    // next task, as long as nothing already in the batch runs past its
+    // tolerance. A lone task fires on time. The batch is popped off in due
+    // order and pushed back; it rarely gets past the first two entries.
+    uint64_t wake = 0;
+    uint64_t latest = UINT64_MAX;
+    for (;;) {
+        DropStale(m_byDue);
+        if (m_byDue.empty()) break;
+        const Entry& e = m_byDue.front();
+        if (wake && e.key > latest) break;
+        wake = e.key;
+        latest = std::min(latest, e.key + m_slots[e.id].tolerance);
+        m_walk.push_back(e);
+        std::pop_heap(m_byDue.begin(), m_byDue.end(), EntryLater());
+        m_byDue.pop_back();
+    }
+    for (const Entry& e : m_walk) {
+        m_byDue.push_back(e);
+        std::push_heap(m_byDue.begin(), m_byDue.end(), EntryLater());
+    }
+    m_walk.clear();
+    return wake;
+}
+
+std::vector<DeadlineScheduler::TaskId> DeadlineScheduler::PopDue(uint64_t nowMs) {
+    std::vector<TaskId> due;
+    m_wakeups++;
+
+    for (;;) {
+        DropStale(m_byDue);
+        if (m_byDue.empty() || m_byDue.front().key > nowMs) break;
+
+        TaskId id = m_byDue.front().id;
+        std::pop_heap(m_byDue.begin(), m_byDue.end(), EntryLater());
+        m_byDue.pop_back();
+
+        Cancel(id);
+        due.push_back(id);
+    }
+
+    m_tasksRun += due.size();
+    return due;
+}
+
+void DeadlineScheduler::ResetStats(uint64_t nowMs) {
+    m_statsSince = nowMs;
+    m_wakeups = 0;
+    m_tasksRun = 0;
+}
+
+double DeadlineScheduler::WakeupsPerHour(uint64_t nowMs) const {
+    if (nowMs <= m_statsSince) return 0.0;
+    return m_wakeups * 3600000.0 / (double)(nowMs - m_statsSince);
+}
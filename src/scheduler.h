@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// All timed work in one place: tasks register deadlines here and the message
+// loop arms exactly one OS timer, for NextWake(). Tasks run at their due time
+// unless a later one falls inside their tolerance window, in which case both
+// are served by a single wakeup. Clock-free: callers pass monotonic
+// milliseconds.
+class DeadlineScheduler {
+public:
+    typedef uint32_t TaskId;
+
+    // Schedule (or move) a task. A task is either pending once or not at all.
+    void Schedule(TaskId id, uint64_t dueMs, uint32_t toleranceMs = 0);
+    void Cancel(TaskId id);
+
+    bool IsScheduled(TaskId id) const;
+    uint64_t DueTime(TaskId id) const;  // 0 if not scheduled
+
+    // When the OS timer should fire: the earliest due time, or a later due
+    // time that every task before it can wait for within its tolerance;
+    // 0 if nothing is pending
+    uint64_t NextWake();
+
+    // Remove and return every task that is due at nowMs, earliest first.
+    // Counts as one wakeup.
+    std::vector<TaskId> PopDue(uint64_t nowMs);
+
+    // Wakeup accounting, measured from the last ResetStats()
+    void ResetStats(uint64_t nowMs);
+    uint64_t Wakeups() const { return m_wakeups; }
+    uint64_t TasksRun() const { return m_tasksRun; }
+    double WakeupsPerHour(uint64_t nowMs) const;
+
+private:
+    struct Slot {
+        uint64_t due = 0;
+        uint32_t tolerance = 0;
+        uint32_t gen = 0;
+        bool scheduled = false;
+    };
+
+    // Heap entries are never removed in place; stale ones (gen mismatch) are
+    // skipped when they reach the top
+    struct Entry {
+        uint64_t key;
+        TaskId id;
+        uint32_t gen;
+    };
+
+    std::vector<Slot> m_slots;
+    std::vector<Entry> m_byDue;      // min-heap on due time
+    std::vector<Entry> m_walk;       // NextWake() scratch
+    size_t m_live = 0;
+
+    uint64_t m_statsSince = 0;
+    uint64_t m_wakeups = 0;
+    uint64_t m_tasksRun = 0;
+
+    bool IsLive(const Entry& e) const;
+    void DropStale(std::vector<Entry>& heap);
+    void Compact();
+};
@@ -0,0 +1,737 @@
+#include "session_logs.h"
+#include "timeutil.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <thread>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t LOGS_MAGIC = 0x314C5743;   // "CWL1"
+constexpr size_t READ_CHUNK = 64 * 1024;
+
+// Fixed search string with a Horspool skip table. Transcript lines are long
+// and full of quotes, so a plain first-byte memchr scan keeps stopping.
+class Needle {
+public:
+    template <size_t N>
+    explicit Needle(const char (&text)[N]) : m_text(text), m_len(N - 1) {
+        for (size_t& s : m_skip) s = m_len;
+        for (size_t i = 0; i + 1 < m_len; i++) m_skip[(uint8_t)text[i]] = m_len - 1 - i;
+    }
+
+    size_t Length() const { return m_len; }
+
+    const char* Find(const char* p, const char* end) const {
+        if ((size_t)(end - p) < m_len) return nullptr;
+        const char* last = end - m_len;
+        uint8_t tail = (uint8_t)m_text[m_len - 1];
+        while (p <= last) {
+            uint8_t c = (uint8_t)p[m_len - 1];
+            if (c == tail && memcmp(p, m_text, m_len - 1) == 0) return p;
+            p += m_skip[c];
+        }
+        return nullptr;
+    }
+
+private:
+    const char* m_text;
+    size_t m_len;
+    size_t m_skip[256];
+};
+
+const Needle USAGE_KEY("\"usage\":{");
+const Needle ASSISTANT_TYPE("\"type\":\"assistant\"");
+const Needle TIMESTAMP_KEY("\"timestamp\":\"");
+const Needle MESSAGE_ID_KEY("\"id\":\"msg_");
+const Needle INPUT_KEY("\"input_tokens\"");
+const Needle OUTPUT_KEY("\"output_tokens\"");
+const Needle CACHE_WRITE_KEY("\"cache_creation_input_tokens\"");
+const Needle CACHE_READ_KEY("\"cache_read_input_tokens\"");
+
+// Unsigned integer following a "key": inside [p, end), 0 if absent
+uint64_t FieldU64(const char* p, const char* end, const Needle& key) {
+    const char* k = key.Find(p, end);
+    if (!k) return 0;
+    k += key.Length();
+    while (k < end && (*k == ' ' || *k == ':')) k++;
+    uint64_t v = 0;
+    while (k < end && *k >= '0' && *k <= '9') v = v * 10 + (uint64_t)(*k++ - '0');
+    return v;
+}
+
+uint64_t HashId(const char* p, const char* end) {
+    uint64_t h = 1469598103934665603ull;
+    for (; p < end && *p != '"'; p++) {
+        h ^= (uint8_t)*p;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (i * 8)));
+}
+
+void PutU64(std::vector<uint8_t>& out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back((uint8_t)(v >> (i * 8)));
+}
+
+bool GetU32(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    if (end - p < 4) return false;
+    v = 0;
+    for (int i = 0; i < 4; i++) v |= (uint32_t)*p++ << (i * 8);
+    return true;
+}
+
+bool GetU64(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    if (end - p < 8) return false;
+    v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)*p++ << (i * 8);
+    return true;
+}
+
+bool IsTranscript(const fs::path& path) {
+    return path.extension() == ".jsonl";
+}
+
+// The deepest directory on the way down to `path` that exists (possibly
+// `path` itself), or empty if none does
+fs::path NearestExistingDir(const fs::path& path) {
+    std::error_code ec;
+    for (fs::path dir = path; !dir.empty(); dir = dir.parent_path()) {
+        if (fs::is_directory(dir, ec)) return dir;
+        if (dir == dir.parent_path()) break;
+    }
+    return fs::path();
+}
+
+} // namespace
+
+bool ParseLogLine(const char* line, size_t len, LogRecord& out) {
+    const char* end = line + len;
+
+    // Cheapest rejection first: most lines are user turns and tool output
+    const char* usage = USAGE_KEY.Find(line, end);
+    if (!usage) return false;
+    if (!ASSISTANT_TYPE.Find(line, end)) return false;
+
+    // Bound the usage object so nested fields elsewhere can't match
+    const char* body = usage + USAGE_KEY.Length() - 1;
+    const char* close = body;
+    int depth = 0;
+    for (; close < end; close++) {
+        if (*close == '{') depth++;
+        else if (*close == '}' && --depth == 0) break;
+    }
+
+    uint64_t input = FieldU64(body, close, INPUT_KEY);
+    uint64_t output = FieldU64(body, close, OUTPUT_KEY);
+    uint64_t cacheWrite = FieldU64(body, close, CACHE_WRITE_KEY);
+    uint64_t cacheRead = FieldU64(body, close, CACHE_READ_KEY);
+    out.tokens = input + output + cacheWrite + cacheRead / 10;
+    if (out.tokens == 0) return false;
+
+    const char* ts = TIMESTAMP_KEY.Find(line, end);
+    if (!ts) return false;
+    ts += TIMESTAMP_KEY.Length();
+    const char* tsEnd = (const char*)memchr(ts, '"', (size_t)(end - ts));
+    int64_t ms;
+    if (!tsEnd || !ParseIso8601(ts, (size_t)(tsEnd - ts), ms)) return false;
+    out.time = ms / 1000;
+
+    const char* id = MESSAGE_ID_KEY.Find(line, end);
+    out.messageId = id ? HashId(id + MESSAGE_ID_KEY.Length() - 4, end) : 0;
+    return true;
+}
+
+// TokenWindows
+
+TokenWindows::TokenWindows() : m_buckets(LONG_MINUTES, 0) {}
+
+void TokenWindows::AdvanceTo(int64_t nowSec) {
+    int64_t minute = nowSec / 60;
+    if (minute <= m_head) return;
+
+    if (m_head == 0 || minute - m_head >= LONG_MINUTES) {
+        std::fill(m_buckets.begin(), m_buckets.end(), 0);
+        m_sumShort = m_sumLong = 0;
+        m_head = minute;
+        return;
+    }
+
+    // Each new minute pushes one bucket out of each window; the 7-day one
+    // leaves from the slot the new minute is about to reuse
+    for (int64_t m = m_head + 1; m <= minute; m++) {
+        m_sumShort -= m_buckets[(size_t)((m - SHORT_MINUTES) % LONG_MINUTES)];
+        uint64_t& slot = m_buckets[(size_t)(m % LONG_MINUTES)];
+        m_sumLong -= slot;
+        slot = 0;
+    }
+    m_head = minute;
+}
+
+void TokenWindows::Add(int64_t timeSec, uint64_t tokens) {
+    int64_t minute = timeSec / 60;
+    if (minute > m_head) AdvanceTo(timeSec);
+    if (minute <= m_head - LONG_MINUTES) return;
+
+    m_buckets[(size_t)(minute % LONG_MINUTES)] += tokens;
+    m_sumLong += tokens;
+    if (minute > m_head - SHORT_MINUTES) m_sumShort += tokens;
+}
+
+void TokenWindows::Serialize(std::vector<uint8_t>& out) const {
+    // Sparse: a quiet week is a handful of bytes
+    uint32_t used = 0;
+    for (uint64_t b : m_buckets) used += b != 0;
+
+    PutU64(out, (uint64_t)m_head);
+    PutU32(out, used);
+    for (int64_t m = m_head - LONG_MINUTES + 1; m <= m_head && used; m++) {
+        uint64_t b = m_buckets[(size_t)(((m % LONG_MINUTES) + LONG_MINUTES) % LONG_MINUTES)];
+        if (b == 0) continue;
+        PutU32(out, (uint32_t)(m_head - m));
+        PutU64(out, b);
+    }
+}
+
+bool TokenWindows::Deserialize(const uint8_t*& p, const uint8_t* end) {
+    uint64_t head;
+    uint32_t used;
+    if (!GetU64(p, end, head) || !GetU32(p, end, used)) return false;
+
+    TokenWindows loaded;
+    loaded.m_head = (int64_t)head;
+    for (uint32_t i = 0; i < used; i++) {
+        uint32_t age;
+        uint64_t tokens;
+        if (!GetU32(p, end, age) || !GetU64(p, end, tokens)) return false;
+        if (age >= (uint32_t)LONG_MINUTES) return false;
+        loaded.Add((loaded.m_head - age) * 60, tokens);
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+// SessionLogTailer
+
+size_t SessionLogTailer::ReadAppended(const fs::path& path, FileState& state, int64_t nowSec, bool known) {
+    std::error_code ec;
+    uint64_t size = fs::file_size(path, ec);
+    if (ec) return 0;
+
+    // Rewritten or truncated - start over
+    if (size < state.offset) {
+        state.offset = 0;
+        state.lastMessage = 0;
+        m_dirty = true;
+    }
+
+    // First sighting of an old transcript: nothing in it can still count
+    if (!known) {
+        m_dirty = true;
+        fs::file_time_type mtime = fs::last_write_time(path, ec);
+        if (!ec && fs::file_time_type::clock::now() - mtime > std::chrono::hours(24 * 7)) {
+            state.offset = size;
+            return 0;
+        }
+    }
+    if (size == state.offset) return 0;
+
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return 0;
+    f.seekg((std::streamoff)state.offset);
+
+    size_t records = 0;
+    std::vector<char> buf;
+    uint64_t pos = state.offset;
+    while (pos < size) {
+        // Carry any partial line over into the next chunk
+        size_t keep = buf.size();
+        size_t want = (size_t)std::min<uint64_t>(READ_CHUNK, size - pos);
+        buf.resize(keep + want);
+        f.read(buf.data() + keep, (std::streamsize)want);
+        size_t got = (size_t)f.gcount();
+        buf.resize(keep + got);
+        if (got == 0) break;
+        pos += got;
+
+        const char* start = buf.data();
+        const char* end = buf.data() + buf.size();
+        for (;;) {
+            const char* nl = (const char*)memchr(start, '\n', (size_t)(end - start));
+            if (!nl) break;
+
+            LogRecord rec;
+            if (ParseLogLine(start, (size_t)(nl - start), rec) &&
+                (rec.messageId == 0 || rec.messageId != state.lastMessage)) {
+                // A record stamped ahead of the clock would drag the windows'
+                // head forward and push everything after it out of the 5h sum
+                m_windows.Add(std::min(rec.time, nowSec), rec.tokens);
+                state.lastMessage = rec.messageId;
+                records++;
+            }
+            state.offset += (uint64_t)(nl + 1 - start);
+            start = nl + 1;
+        }
+        buf.erase(buf.begin(), buf.begin() + (start - buf.data()));
+    }
+
+    // A line still being written stays unread until its newline lands
+    m_windows.AdvanceTo(nowSec);
+    m_dirty = true;
+    return records;
+}
+
+size_t SessionLogTailer::ScanAll(int64_t nowSec) {
+    std::error_code ec;
+    if (m_root.empty() || !fs::is_directory(m_root, ec)) return 0;
+
+    for (auto& entry : m_files) entry.second.seen = false;
+
+    size_t records = 0;
+    fs::recursive_directory_iterator it(m_root, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file(ec) || !IsTranscript(it->path())) continue;
+
+        std::string key = it->path().lexically_relative(m_root).generic_u8string();
+        auto found = m_files.find(key);
+        bool known = found != m_files.end();
+        FileState& state = known ? found->second : m_files[key];
+        state.seen = true;
+        records += ReadAppended(it->path(), state, nowSec, known);
+    }
+
+    // Forget transcripts that were deleted
+    for (auto i = m_files.begin(); i != m_files.end();) {
+        if (!i->second.seen) {
+            i = m_files.erase(i);
+            m_dirty = true;
+        } else {
+            ++i;
+        }
+    }
+
+    m_windows.AdvanceTo(nowSec);
+    return records;
+}
+
+size_t SessionLogTailer::Poll(const std::vector<fs::path>& files, int64_t nowSec) {
+    size_t records = 0;
+    for (const fs::path& path : files) {
+        std::string key = path.lexically_relative(m_root).generic_u8string();
+        if (key.empty() || key.compare(0, 2, "..") == 0) continue;
+
+        auto found = m_files.find(key);
+        bool known = found != m_files.end();
+        FileState& state = known ? found->second : m_files[key];
+
+        // A brand new file the watcher told us about is live by definition
+        records += ReadAppended(path, state, nowSec, true);
+        if (!known) m_dirty = true;
+    }
+    m_windows.AdvanceTo(nowSec);
+    return records;
+}
+
+std::vector<uint8_t> SessionLogTailer::Serialize() const {
+    std::vector<uint8_t> out;
+    PutU32(out, LOGS_MAGIC);
+    m_windows.Serialize(out);
+
+    PutU32(out, (uint32_t)m_files.size());
+    for (const auto& entry : m_files) {
+        PutU32(out, (uint32_t)entry.first.size());
+        out.insert(out.end(), entry.first.begin(), entry.first.end());
+        PutU64(out, entry.second.offset);
+        PutU64(out, entry.second.lastMessage);
+    }
+    return out;
+}
+
+bool SessionLogTailer::Deserialize(const std::vector<uint8_t>& data) {
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+
+    uint32_t magic, count;
+    if (!GetU32(p, end, magic) || magic != LOGS_MAGIC) return false;
+
+    TokenWindows windows;
+    if (!windows.Deserialize(p, end) || !GetU32(p, end, count)) return false;
+
+    std::unordered_map<std::string, FileState> files;
+    files.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t len;
+        if (!GetU32(p, end, len) || (size_t)(end - p) < len) return false;
+        FileState& state = files[std::string((const char*)p, len)];
+        p += len;
+        if (!GetU64(p, end, state.offset) || !GetU64(p, end, state.lastMessage)) return false;
+    }
+
+    m_windows = std::move(windows);
+    m_files = std::move(files);
+    m_dirty = false;
+    return true;
+}
+
+// UsageEstimator
+
+void UsageEstimator::Series::Calibrate(float percent, uint64_t tokens, uint64_t minTokens,
+                                       float smoothing, bool first) {
+    // Learn from the movement since the last fetch, unless the server window
+    // reset in between (percent dropped) or too little happened locally
+    if (!first && percent >= basePercent && tokens >= baseTokens + minTokens) {
+        double sample = (percent - basePercent) / (double)(tokens - baseTokens);
+        rate = rate > 0.0 ? rate + smoothing * (sample - rate) : sample;
+    } else if (rate == 0.0 && tokens >= minTokens && percent > 0.0f) {
+        // Nothing learned yet: assume everything the server counted came from here
+        rate = percent / (double)tokens;
+    }
+    basePercent = percent;
+    baseTokens = tokens;
+}
+
+float UsageEstimator::Series::Estimate(uint64_t tokens) const {
+    if (rate <= 0.0 || tokens <= baseTokens) return basePercent;
+    double est = basePercent + (tokens - baseTokens) * rate;
+    return (float)std::min(est, 100.0);
+}
+
+void UsageEstimator::Calibrate(float sessionPercent, float periodPercent, uint64_t tokens5h, uint64_t tokens7d) {
+    m_session.Calibrate(sessionPercent, tokens5h, minCalibrationTokens, smoothing, !m_calibrated);
+    m_period.Calibrate(periodPercent, tokens7d, minCalibrationTokens, smoothing, !m_calibrated);
+    m_calibrated = true;
+}
+
+float UsageEstimator::EstimateSession(uint64_t tokens5h) const {
+    return m_session.Estimate(tokens5h);
+}
+
+float UsageEstimator::EstimatePeriod(uint64_t tokens7d) const {
+    return m_period.Estimate(tokens7d);
+}
+
+// LogWatcher
+
+#ifdef _WIN32
+
+struct LogWatcher::Impl {
+    fs::path root;
+    HANDLE dir = INVALID_HANDLE_VALUE;
+    HANDLE stopEvent = nullptr;
+    std::thread thread;
+
+    std::mutex lock;
+    std::set<fs::path> changed;
+    bool overflow = false;
+
+    void OpenRoot() {
+        dir = CreateFileW(root.c_str(), FILE_LIST_DIRECTORY,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                          OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    }
+
+    // Before Claude Code's first run there's no tree to watch: wait on the
+    // nearest directory above it until it's created, one level at a time.
+    // False if stopped first or it can't be watched.
+    bool WaitForRoot() {
+        for (;;) {
+            fs::path parent = NearestExistingDir(root);
+            if (parent.empty()) return false;
+            if (parent == root) return true;
+
+            HANDLE change = FindFirstChangeNotificationW(parent.c_str(), FALSE, FILE_NOTIFY_CHANGE_DIR_NAME);
+            if (change == INVALID_HANDLE_VALUE) return false;
+            // Created before the notification was armed: go again from there
+            if (NearestExistingDir(root) != parent) {
+                FindCloseChangeNotification(change);
+                continue;
+            }
+            HANDLE waits[] = { change, stopEvent };
+            DWORD which = WaitForMultipleObjects(2, waits, FALSE, INFINITE);
+            FindCloseChangeNotification(change);
+            if (which != WAIT_OBJECT_0) return false;
+        }
+    }
+};
+
+LogWatcher::LogWatcher() : m_impl(new Impl) {}
+
+LogWatcher::~LogWatcher() {
+    Stop();
+    delete m_impl;
+}
+
+bool LogWatcher::Start(const fs::path& root, std::function<void()> onChange) {
+    Stop();
+    m_onChange = std::move(onChange);
+    m_impl->root = root;
+
+    // A missing tree is waited for on the thread; one that's there but won't
+    // open is an error now
+    fs::path parent = NearestExistingDir(root);
+    if (parent.empty()) return false;
+    if (parent == root) {
+        m_impl->OpenRoot();
+        if (m_impl->dir == INVALID_HANDLE_VALUE) return false;
+    }
+    m_impl->stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    Impl* impl = m_impl;
+    std::function<void()>* onChangeFn = &m_onChange;
+    m_impl->thread = std::thread([impl, onChangeFn]() {
+        if (impl->dir == INVALID_HANDLE_VALUE) {
+            if (!impl->WaitForRoot()) return;
+            impl->OpenRoot();
+            if (impl->dir == INVALID_HANDLE_VALUE) return;
+
+            // Whatever was written before the handle opened needs a full scan
+            {
+                std::lock_guard<std::mutex> guard(impl->lock);
+                impl->overflow = true;
+            }
+            if (*onChangeFn) (*onChangeFn)();
+        }
+
+        OVERLAPPED ov = {};
+        ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        std::vector<DWORD> storage(16 * 1024);
+        BYTE* buffer = (BYTE*)storage.data();
+        DWORD bufferBytes = (DWORD)(storage.size() * sizeof(DWORD));
+
+        for (;;) {
+            ResetEvent(ov.hEvent);
+            if (!ReadDirectoryChangesW(impl->dir, buffer, bufferBytes, TRUE,
+                                       FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE |
+                                       FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_DIR_NAME,
+                                       nullptr, &ov, nullptr)) {
+                break;
+            }
+
+            HANDLE waits[] = { ov.hEvent, impl->stopEvent };
+            DWORD which = WaitForMultipleObjects(2, waits, FALSE, INFINITE);
+            if (which != WAIT_OBJECT_0) {
+                CancelIoEx(impl->dir, &ov);
+                DWORD ignored;
+                GetOverlappedResult(impl->dir, &ov, &ignored, TRUE);
+                break;
+            }
+
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(impl->dir, &ov, &bytes, FALSE)) break;
+
+            {
+                std::lock_guard<std::mutex> guard(impl->lock);
+                if (bytes == 0) {
+                    // Buffer overflowed - the individual events are gone
+                    impl->overflow = true;
+                } else {
+                    for (BYTE* p = buffer;;) {
+                        FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*)p;
+                        fs::path path = impl->root / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                        if (info->Action != FILE_ACTION_REMOVED && IsTranscript(path)) {
+                            impl->changed.insert(path);
+                        } else if (info->Action == FILE_ACTION_RENAMED_NEW_NAME && !path.has_extension()) {
+                            // A directory moved in: let a full scan pick up its contents
+                            impl->overflow = true;
+                        }
+                        if (info->NextEntryOffset == 0) break;
+                        p += info->NextEntryOffset;
+                    }
+                }
+            }
+            if (*onChangeFn) (*onChangeFn)();
+        }
+        CloseHandle(ov.hEvent);
+    });
+    return true;
+}
+
+void LogWatcher::Stop() {
+    if (m_impl->thread.joinable()) {
+        SetEvent(m_impl->stopEvent);
+        m_impl->thread.join();
+    }
+    if (m_impl->dir != INVALID_HANDLE_VALUE) CloseHandle(m_impl->dir);
+    if (m_impl->stopEvent) CloseHandle(m_impl->stopEvent);
+    m_impl->dir = INVALID_HANDLE_VALUE;
+    m_impl->stopEvent = nullptr;
+    m_impl->changed.clear();
+    m_impl->overflow = false;
+}
+
+bool LogWatcher::TakeChanged(std::vector<fs::path>& out) {
+    std::lock_guard<std::mutex> guard(m_impl->lock);
+    out.assign(m_impl->changed.begin(), m_impl->changed.end());
+    m_impl->changed.clear();
+    bool complete = !m_impl->overflow;
+    m_impl->overflow = false;
+    return complete;
+}
+
+#else
+
+struct LogWatcher::Impl {
+    int fd = -1;
+    fs::path root;
+    int ancestorWd = -1;        // Waiting for root to be created under it
+    std::unordered_map<int, fs::path> dirs;
+    std::set<fs::path> changed;
+    bool overflow = false;
+
+    // Watch the tree, or before Claude Code's first run, the nearest
+    // directory above it until the next level down is created
+    bool Arm() {
+        for (;;) {
+            fs::path parent = NearestExistingDir(root);
+            if (parent.empty()) return false;
+            if (parent == root) {
+                WatchTree(root, false);
+                return !dirs.empty();
+            }
+
+            ancestorWd = inotify_add_watch(fd, parent.c_str(), IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+            if (ancestorWd < 0) return false;
+            // Created before the watch was in place: go again from there
+            if (NearestExistingDir(root) == parent) return true;
+            inotify_rm_watch(fd, ancestorWd);
+            ancestorWd = -1;
+        }
+    }
+
+    void WatchTree(const fs::path& dir, bool collect) {
+        AddWatch(dir);
+        std::error_code ec;
+        fs::recursive_directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_directory(ec)) {
+                AddWatch(it->path());
+            } else if (collect && IsTranscript(it->path())) {
+                // Written before the watch existed
+                changed.insert(it->path());
+            }
+        }
+    }
+
+    void AddWatch(const fs::path& dir) {
+        int wd = inotify_add_watch(fd, dir.c_str(),
+                                   IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+        if (wd >= 0) dirs[wd] = dir;
+    }
+};
+
+LogWatcher::LogWatcher() : m_impl(new Impl) {}
+
+LogWatcher::~LogWatcher() {
+    Stop();
+    delete m_impl;
+}
+
+bool LogWatcher::Start(const fs::path& root, std::function<void()> onChange) {
+    Stop();
+    m_onChange = std::move(onChange);
+
+    m_impl->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_impl->fd < 0) return false;
+
+    m_impl->root = root;
+    if (!m_impl->Arm()) {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void LogWatcher::Stop() {
+    if (m_impl->fd >= 0) close(m_impl->fd);
+    *m_impl = Impl();
+}
+
+int LogWatcher::Fd() const {
+    return m_impl->fd;
+}
+
+void LogWatcher::Drain() {
+    if (m_impl->fd < 0) return;
+
+    bool any = false;
+    alignas(inotify_event) char buf[16 * 1024];
+    for (;;) {
+        ssize_t n = read(m_impl->fd, buf, sizeof(buf));
+        if (n <= 0) break;
+
+        for (char* p = buf; p < buf + n;) {
+            inotify_event* ev = (inotify_event*)p;
+            p += sizeof(inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                m_impl->overflow = true;
+                any = true;
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                m_impl->dirs.erase(ev->wd);
+                if (ev->wd == m_impl->ancestorWd) {
+                    // The directory we were waiting in went away
+                    m_impl->ancestorWd = -1;
+                    m_impl->Arm();
+                }
+                continue;
+            }
+
+            if (ev->wd == m_impl->ancestorWd) {
+                if (!(ev->mask & IN_ISDIR)) continue;
+                inotify_rm_watch(m_impl->fd, m_impl->ancestorWd);
+                m_impl->ancestorWd = -1;
+                m_impl->Arm();
+                if (!m_impl->dirs.empty()) {
+                    // The tree is here; what was written before the watch
+                    // needs a full scan
+                    m_impl->overflow = true;
+                    any = true;
+                }
+                continue;
+            }
+
+            auto dir = m_impl->dirs.find(ev->wd);
+            if (dir == m_impl->dirs.end() || ev->len == 0) continue;
+            fs::path path = dir->second / ev->name;
+
+            if (ev->mask & IN_ISDIR) {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) m_impl->WatchTree(path, true);
+            } else if (IsTranscript(path)) {
+                m_impl->changed.insert(path);
+            }
+            any = true;
+        }
+    }
+
+    if (any && m_onChange) m_onChange();
+}
+
+bool LogWatcher::TakeChanged(std::vector<fs::path>& out) {
+    out.assign(m_impl->changed.begin(), m_impl->changed.end());
+    m_impl->changed.clear();
+    bool complete = !m_impl->overflow;
+    m_impl->overflow = false;
+    return complete;
+}
+
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One assistant turn from a Claude Code transcript line
+struct LogRecord {
+    int64_t time = 0;           // Unix seconds
+    uint64_t tokens = 0;        // Weighted: input + output + cache writes + cache reads / 10
+    uint64_t messageId = 0;     // Hash of message.id, 0 if absent
+};
+
+// Pull the usage block out of one JSONL line without building a DOM. Returns
+// false for lines that carry no usage (user turns, summaries, tool results).
+bool ParseLogLine(const char* line, size_t len, LogRecord& out);
+
+// Rolling 5-hour and 7-day token sums over one-minute buckets. Adding a record
+// and advancing time are O(1) amortized; late records inside the window land
+// in their own minute. Clock-free: callers pass Unix seconds.
+class TokenWindows {
+public:
+    static constexpr int SHORT_MINUTES = 5 * 60;
+    static constexpr int LONG_MINUTES = 7 * 24 * 60;
+
+    TokenWindows();
+
+    void Add(int64_t timeSec, uint64_t tokens);
+    void AdvanceTo(int64_t nowSec);
+
+    uint64_t Sum5h() const { return m_sumShort; }
+    uint64_t Sum7d() const { return m_sumLong; }
+
+    void Serialize(std::vector<uint8_t>& out) const;
+    bool Deserialize(const uint8_t*& p, const uint8_t* end);
+
+private:
+    std::vector<uint64_t> m_buckets;    // LONG_MINUTES ring, indexed by minute
+    int64_t m_head = 0;                 // Newest minute covered, 0 before first use
+    uint64_t m_sumShort = 0;
+    uint64_t m_sumLong = 0;
+};
+
+// Incremental reader for ~/.claude/projects/**/*.jsonl. Each file's read
+// offset is remembered (and persisted), so only appended bytes are ever
+// parsed - a startup pass over thousands of transcripts is a stat per file.
+// Files untouched for longer than the 7-day window are skipped to their end
+// the first time they're seen.
+class SessionLogTailer {
+public:
+    void SetRoot(const std::filesystem::path& root) { m_root = root; }
+    const std::filesystem::path& Root() const { return m_root; }
+
+    // Walk the whole tree. Used at startup and after the watcher overflows.
+    size_t ScanAll(int64_t nowSec);
+
+    // Read just these files (absolute paths from LogWatcher)
+    size_t Poll(const std::vector<std::filesystem::path>& files, int64_t nowSec);
+
+    TokenWindows& Windows() { return m_windows; }
+    const TokenWindows& Windows() const { return m_windows; }
+    size_t FileCount() const { return m_files.size(); }
+    bool IsDirty() const { return m_dirty; }
+    void MarkClean() { m_dirty = false; }
+
+    std::vector<uint8_t> Serialize() const;
+    bool Deserialize(const std::vector<uint8_t>& data);
+
+private:
+    struct FileState {
+        uint64_t offset = 0;
+        uint64_t lastMessage = 0;   // Transcripts repeat a turn's usage once per content block
+        bool seen = false;
+    };
+
+    std::filesystem::path m_root;
+    std::unordered_map<std::string, FileState> m_files;    // Keyed by path relative to root
+    TokenWindows m_windows;
+    bool m_dirty = false;
+
+    size_t ReadAppended(const std::filesystem::path& path, FileState& state, int64_t nowSec, bool known);
+};
+
+// Change notifications for the transcript tree. On Windows a thread blocks in
+// ReadDirectoryChangesW and onChange runs on that thread - post to the UI
+// thread from it. On Linux it's inotify (one watch per directory): poll Fd()
+// and call Drain(), which invokes onChange on the caller's thread.
+class LogWatcher {
+public:
+    LogWatcher();
+    ~LogWatcher();
+
+    // If root doesn't exist yet (Claude Code never ran), waits for it to be
+    // created and then reports lost events, so the caller's full scan picks
+    // up the new tree. False if it can't watch root or anything above it.
+    bool Start(const std::filesystem::path& root, std::function<void()> onChange);
+    void Stop();
+
+    // Changed .jsonl files since the last call. Returns false if events were
+    // lost and the caller should fall back to SessionLogTailer::ScanAll().
+    bool TakeChanged(std::vector<std::filesystem::path>& out);
+
+#ifndef _WIN32
+    int Fd() const;
+    void Drain();
+#endif
+
+private:
+    struct Impl;
+    Impl* m_impl;
+    std::function<void()> m_onChange;
+};
+
+// Turns local token counts into a between-polls utilization estimate. Each
+// real fetch recalibrates: the percent-per-token rate is learned from how
+// much the server's numbers moved against how many tokens the logs saw, so
+// usage from other clients (web, mobile) just shows up as drift that the next
+// fetch corrects.
+class UsageEstimator {
+public:
+    uint64_t minCalibrationTokens = 20000;  // Smaller deltas are mostly rounding
+    float smoothing = 0.3f;                 // Weight of the newest rate sample
+
+    void Calibrate(float sessionPercent, float periodPercent, uint64_t tokens5h, uint64_t tokens7d);
+    void Reset() { *this = UsageEstimator(); }
+
+    bool IsCalibrated() const { return m_calibrated; }
+
+    // Server value plus whatever the logs saw since; never below the last fetch
+    float EstimateSession(uint64_t tokens5h) const;
+    float EstimatePeriod(uint64_t tokens7d) const;
+
+private:
+    struct Series {
+        float basePercent = 0.0f;
+        uint64_t baseTokens = 0;
+        double rate = 0.0;          // Percent per token, 0 until learned
+        void Calibrate(float percent, uint64_t tokens, uint64_t minTokens, float smoothing, bool first);
+        float Estimate(uint64_t tokens) const;
+    };
+
+    Series m_session;
+    Series m_period;
+    bool m_calibrated = false;
+};
@@ -0,0 +1,589 @@
+#include "simulate.h"
+#include "refresh_controller.h"
+#include "text_util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+constexpr float RESET_DROP = 5.0f;      // Same rule as the history store
+
+// The one org every listing returns, unless the fault model says otherwise
+const char* const SIM_LISTING = "[{\"uuid\":\"sim-org\",\"name\":\"Simulated\",\"capabilities\":[\"chat\"]}]";
+
+// xorshift64*: repeatable across platforms, unlike <random> distributions
+class Rng {
+public:
+    explicit Rng(uint64_t seed) : m_state(seed * 0x9e3779b97f4a7c15ull + 1) {}
+
+    uint64_t Next() {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545f4914f6cdd1dull;
+    }
+
+    // [0, 1)
+    double Uniform() { return (double)(Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    uint64_t m_state;
+};
+
+int64_t FloorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+float Percentile(std::vector<float>& values, double p) {
+    if (values.empty()) return 0.0f;
+    size_t rank = (size_t)std::ceil(p * (double)values.size());
+    size_t index = rank > 0 ? rank - 1 : 0;
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+struct Window {
+    uint64_t startMs;
+    uint64_t endMs;
+};
+
+// Non-overlapping windows of `minutes` at exponential gaps, from their own
+// generator so every policy sees the same ones
+std::vector<Window> DrawWindows(uint64_t start, uint64_t end, double perDay, uint32_t minutes, uint64_t seed) {
+    std::vector<Window> windows;
+    if (perDay <= 0) return windows;
+    Rng rng(seed);
+    double meanGapMs = 86400000.0 / perDay;
+    uint64_t t = start;
+    for (;;) {
+        t += (uint64_t)(-std::log(1.0 - rng.Uniform()) * meanGapMs);
+        if (t >= end) break;
+        uint64_t length = (uint64_t)minutes * 60000;
+        windows.push_back({ t, t + length });
+        t += length;
+    }
+    return windows;
+}
+
+struct Observation {
+    uint64_t timeMs;
+    float session;
+    float period;
+};
+
+// A RefreshController, the one main.cpp and claudewatchd drive, over a
+// virtual clock. The clock is Unix milliseconds and doubles as the boot
+// clock; the wall clock is off by the current step, and the active clock
+// stops while asleep. Requests and probes land after their modelled latency.
+class Simulator {
+public:
+    Simulator(const UsageTrace& trace, const RefreshPolicy& policy, const FaultModel& faults);
+
+    void Run();
+
+    const std::vector<Observation>& Seen() const { return m_seen; }
+    uint64_t Requests() const { return m_requests; }
+    uint64_t Failures() const { return m_failures; }
+    uint64_t Wakeups() const { return m_scheduler.Wakeups(); }
+
+private:
+    const UsageTrace& m_trace;
+    const RefreshPolicy& m_policy;
+    const FaultModel& m_faults;
+    Rng m_rng;
+
+    DeadlineScheduler m_scheduler;
+    RefreshController m_refresh;
+    uint64_t m_now = 0;
+    int64_t m_skewMs = 0;       // Wall clock minus true time
+    uint64_t m_sleptMs = 0;
+    float m_shown = 0.0f;       // Busier limit on screen, for the smart interval
+
+    // The run in flight (the flight gate allows one) and when it lands
+    uint64_t m_doneAt = 0;
+    RefreshResult m_done;
+    uint64_t m_probeAt = 0;
+    bool m_reachable = false;
+
+    // Each a cursor into its time-ordered windows; outages and clock steps
+    // have an edge at both ends
+    std::vector<Window> m_outages;
+    size_t m_nextEdge = 0;
+    std::vector<Window> m_steps;
+    size_t m_nextStep = 0;
+    std::vector<Window> m_sleeps;
+    size_t m_nextSleep = 0;
+    size_t m_truth = 0;
+
+    std::vector<Observation> m_seen;
+    uint64_t m_requests = 0;
+    uint64_t m_failures = 0;
+
+    const UsagePoint& TruthAt(uint64_t ms);
+    bool InOutage(uint64_t ms) const;
+    static uint64_t NextEdge(const std::vector<Window>& windows, size_t edge);
+    uint32_t IdleSeconds() const;
+    void AdvanceTo(uint64_t ms);
+
+    RefreshOutcome Request(uint64_t& elapsed);
+    bool ListOrgs(RefreshResult& result, uint64_t& elapsed);
+    void StartFetch(const OrgChoice& org, uint64_t generation);
+    void Deliver();
+    void OnResult(const RefreshResult& result);
+};
+
+Simulator::Simulator(const UsageTrace& trace, const RefreshPolicy& policy, const FaultModel& faults)
+    : m_trace(trace), m_policy(policy), m_faults(faults), m_rng(faults.seed), m_refresh(m_scheduler) {
+    RefreshHooks& hooks = m_refresh.hooks;
+    hooks.clock = [this]() {
+        ClockSample s;
+        s.wallMs = (int64_t)m_now + m_skewMs;
+        s.bootMs = m_now;
+        s.activeMs = m_now - m_sleptMs;
+        return s;
+    };
+    hooks.fetch = [this](const OrgChoice& org, uint64_t generation, const CancelToken&) {
+        StartFetch(org, generation);
+    };
+    hooks.probe = [this]() {
+        m_reachable = !InOutage(m_now);
+        m_probeAt = m_now + m_faults.latencyMs;
+    };
+    hooks.intervalMs = [this]() {
+        uint32_t maxMs = m_policy.maxIntervalSec * 1000;
+        return m_policy.smart ? SmartRefreshIntervalMs(m_shown, m_policy.minIntervalSec * 1000, maxMs) : maxMs;
+    };
+    hooks.idleSeconds = [this]() { return IdleSeconds(); };
+    hooks.onResult = [this](const RefreshResult& result) { OnResult(result); };
+    // The widget redraws its countdown every minute; those ticks are wakeups too
+    hooks.onCountdown = [](const ResetDeadline&, const ResetDeadline&, const ClockSample&) {};
+}
+
+const UsagePoint& Simulator::TruthAt(uint64_t ms) {
+    // Queries only move forward, so a cursor beats a search
+    int64_t sec = (int64_t)(ms / 1000);
+    while (m_truth + 1 < m_trace.points.size() && m_trace.points[m_truth + 1].time <= sec) m_truth++;
+    return m_trace.points[m_truth];
+}
+
+bool Simulator::InOutage(uint64_t ms) const {
+    for (size_t i = m_nextEdge / 2; i < m_outages.size() && m_outages[i].startMs <= ms; i++) {
+        if (ms < m_outages[i].endMs) return true;
+    }
+    return false;
+}
+
+// Time of edge number `edge` (starts even, ends odd), 0 past the last
+uint64_t Simulator::NextEdge(const std::vector<Window>& windows, size_t edge) {
+    size_t i = edge / 2;
+    if (i >= windows.size()) return 0;
+    return edge % 2 == 0 ? windows[i].startMs : windows[i].endMs;
+}
+
+uint32_t Simulator::IdleSeconds() const {
+    if (m_faults.awayFrom < 0) return 0;
+    int64_t local = (int64_t)(m_now / 1000) + m_faults.utcOffsetSec;
+    int64_t secOfDay = local - FloorDiv(local, 86400) * 86400;
+    int64_t from = m_faults.awayFrom * 3600;
+    int64_t to = m_faults.awayTo * 3600;
+    int64_t since = secOfDay - from;
+    if (since < 0) since += 86400;
+    int64_t length = to - from;
+    if (length <= 0) length += 86400;
+    return since < length ? (uint32_t)since : 0;
+}
+
+// Move the clock to ms, or to the end of a sleep that ms falls in: nothing
+// runs while the machine is asleep
+void Simulator::AdvanceTo(uint64_t ms) {
+    while (m_nextSleep < m_sleeps.size() && m_sleeps[m_nextSleep].startMs <= ms) {
+        const Window& sleep = m_sleeps[m_nextSleep++];
+        m_sleptMs += sleep.endMs - sleep.startMs;
+        if (ms < sleep.endMs) ms = sleep.endMs;
+    }
+    if (ms > m_now) m_now = ms;
+}
+
+// One HTTP request and its chance of failing
+RefreshOutcome Simulator::Request(uint64_t& elapsed) {
+    m_requests++;
+    double r = m_rng.Uniform();
+    if (InOutage(m_now + elapsed) || r < m_faults.offline) {
+        elapsed += m_faults.timeoutMs;
+        return RefreshOutcome::Offline;
+    }
+    elapsed += m_faults.latencyMs;
+    if ((r -= m_faults.offline) < m_faults.serverError) return RefreshOutcome::Offline;
+    if ((r -= m_faults.serverError) < m_faults.authError) return RefreshOutcome::AuthError;
+    return RefreshOutcome::Success;
+}
+
+// RunRefreshPipeline's org lookup: the listing, then picking from it
+bool Simulator::ListOrgs(RefreshResult& result, uint64_t& elapsed) {
+    result.outcome = Request(elapsed);
+    if (result.outcome != RefreshOutcome::Success) return false;
+
+    int64_t wallSec = ((int64_t)(m_now + elapsed) + m_skewMs) / 1000;
+    bool noOrg = m_rng.Uniform() < m_faults.noOrg;
+    result.orgs.Parse(noOrg ? "[]" : SIM_LISTING, wallSec);
+    const OrgEntry* org = result.orgs.Select(m_refresh.pin);
+    if (!org) {
+        result.outcome = RefreshOutcome::NoOrg;
+        return false;
+    }
+    result.orgId = Utf8ToWide(org->uuid);
+    return true;
+}
+
+// The requests RunRefreshPipeline would make for this org choice: a lookup
+// unless the org is known, the usage call, and one re-list if a cached org
+// is refused. The usage numbers are read when the run lands.
+void Simulator::StartFetch(const OrgChoice& org, uint64_t generation) {
+    m_done = RefreshResult();
+    m_done.generation = generation;
+    m_done.orgId = org.orgId;
+
+    uint64_t elapsed = 0;
+    if (!m_done.orgId.empty() || ListOrgs(m_done, elapsed)) {
+        m_done.outcome = Request(elapsed);
+        if (m_done.outcome == RefreshOutcome::AuthError && org.cached && m_done.orgs.FetchedAt() == 0) {
+            std::wstring previous = m_done.orgId;
+            if (ListOrgs(m_done, elapsed)) {
+                m_done.outcome = m_done.orgId != previous ? Request(elapsed) : RefreshOutcome::AuthError;
+            }
+        }
+    }
+    if (m_done.outcome != RefreshOutcome::Success) m_failures++;
+    m_doneAt = m_now + (elapsed ? elapsed : 1);
+}
+
+void Simulator::Deliver() {
+    // Applying it can start the next run, which reuses m_done
+    RefreshResult result = std::move(m_done);
+    m_doneAt = 0;
+    if (result.outcome == RefreshOutcome::Success) {
+        const UsagePoint& truth = TruthAt(m_now);
+        UsageData& usage = result.usage;
+        usage.valid = true;
+        usage.sessionPercent = truth.session;
+        usage.periodPercent = truth.period;
+        usage.sessionResetMs = truth.sessionResetSec * 1000;
+        usage.periodResetMs = truth.periodResetSec * 1000;
+    }
+    m_refresh.ApplyResult(result);
+}
+
+void Simulator::OnResult(const RefreshResult& result) {
+    if (result.outcome != RefreshOutcome::Success) return;
+    m_shown = result.usage.MaxPercent();
+    m_seen.push_back({ m_now, result.usage.sessionPercent, result.usage.periodPercent });
+}
+
+void Simulator::Run() {
+    if (m_trace.points.empty()) return;
+    uint64_t start = (uint64_t)m_trace.Start() * 1000;
+    uint64_t end = (uint64_t)m_trace.End() * 1000;
+
+    m_outages = DrawWindows(start, end, m_faults.outagesPerDay, m_faults.outageMinutes, m_faults.seed ^ 0x5bd1e995u);
+    m_steps = DrawWindows(start, end, m_faults.clockStepsPerDay, m_faults.clockStepMinutes,
+                          m_faults.seed ^ 0x27d4eb2fu);
+    m_sleeps = DrawWindows(start, end, m_faults.sleepsPerDay, m_faults.sleepMinutes, m_faults.seed ^ 0x165667b1u);
+
+    // Startup: first fetch right away, then the regular cadence
+    m_now = start;
+    m_scheduler.ResetStats(start);
+    m_refresh.Refresh();
+    m_refresh.ScheduleRefresh();
+
+    for (;;) {
+        uint64_t edge = NextEdge(m_outages, m_nextEdge);
+        uint64_t step = NextEdge(m_steps, m_nextStep);
+        uint64_t next = m_scheduler.NextWake();
+        for (uint64_t t : { m_doneAt, m_probeAt, edge, step }) {
+            if (t && (next == 0 || t < next)) next = t;
+        }
+        if (next == 0 || next > end) break;
+        AdvanceTo(next);
+
+        if (m_doneAt && m_doneAt <= m_now) {
+            Deliver();
+        } else if (m_probeAt && m_probeAt <= m_now) {
+            m_probeAt = 0;
+            m_refresh.ApplyProbeResult(m_reachable);
+        } else if (edge && edge <= m_now) {
+            // NLM reports both the drop and the return
+            m_nextEdge++;
+            m_refresh.OnNetworkChanged();
+        } else if (step && step <= m_now) {
+            // Set wrong, then put right; WM_TIMECHANGE either way
+            m_skewMs = m_nextStep++ % 2 == 0 ? (int64_t)m_faults.clockStepMinutes * 60000 : 0;
+            m_refresh.CheckClocks();
+        } else {
+            m_refresh.CheckClocks();
+            for (DeadlineScheduler::TaskId task : m_scheduler.PopDue(m_now)) m_refresh.RunTask(task);
+        }
+    }
+}
+
+// Index of the first observation at or after ms
+size_t FirstSeenFrom(const std::vector<Observation>& seen, uint64_t ms) {
+    return (size_t)(std::lower_bound(seen.begin(), seen.end(), ms,
+                                     [](const Observation& o, uint64_t t) { return o.timeMs < t; }) -
+                    seen.begin());
+}
+
+} // namespace
+
+UsageTrace UsageTrace::Synthetic(int days, uint32_t seed, int32_t utcOffsetSec) {
+    UsageTrace trace;
+    Rng rng(seed);
+
+    // Local Monday 2025-01-06 00:00, so weekdays fall where they should
+    const int64_t start = 1736121600 - utcOffsetSec;
+    int64_t periodReset = start + (int64_t)(rng.Next() % 168) * 3600;
+
+    float session = 0.0f, period = 0.0f;
+    int64_t sessionReset = 0;
+    trace.points.push_back({ start, 0.0f, 0.0f, 0, periodReset });
+
+    for (int day = 0; day < days; day++) {
+        int64_t dayStart = start + (int64_t)day * 86400;
+        bool weekend = day % 7 >= 5;
+
+        // How hard today goes, and when the work blocks fall
+        double u = rng.Uniform();
+        double intensity = weekend ? (rng.Uniform() < 0.3 ? 0.3 : 0.0) : 0.3 + 1.7 * u * u;
+        int blocks[3][2] = {
+            { 9 * 60 + (int)(rng.Next() % 90) - 30, 12 * 60 + 30 },
+            { 13 * 60 + 30, 17 * 60 + 30 + (int)(rng.Next() % 90) },
+            { 20 * 60, rng.Uniform() < 0.25 ? 22 * 60 + 30 : 20 * 60 },
+        };
+
+        for (int minute = 0; minute < 1440; minute++) {
+            int64_t t = dayStart + minute * 60;
+            bool changed = false;
+
+            if (t >= periodReset) {
+                period = 0.0f;
+                periodReset += 7 * 86400;
+                changed = true;
+            }
+            if (sessionReset && t >= sessionReset) {
+                session = 0.0f;
+                sessionReset = 0;
+                changed = true;
+            }
+
+            bool active = false;
+            for (const auto& b : blocks) active = active || (minute >= b[0] && minute < b[1]);
+            if (active && intensity > 0.0 && rng.Uniform() < 0.7) {
+                // Windows open on first use and end on the hour, five hours on
+                if (!sessionReset) sessionReset = (t + 5 * 3600 + 3599) / 3600 * 3600;
+                float burn = (float)(0.45 * intensity * (0.25 + 1.5 * rng.Uniform()));
+                float room = std::min(100.0f - session, (100.0f - period) / 0.12f);
+                burn = std::max(0.0f, std::min(burn, room));
+                if (burn > 0.0f) {
+                    session += burn;
+                    period = std::min(100.0f, period + burn * 0.12f);
+                    changed = true;
+                }
+            }
+
+            if (changed) trace.points.push_back({ t, session, period, sessionReset, periodReset });
+        }
+    }
+    trace.points.push_back({ start + (int64_t)days * 86400, session, period, sessionReset, periodReset });
+    return trace;
+}
+
+UsageTrace UsageTrace::FromHistory(const HistoryStore& store) {
+    UsageTrace trace;
+    HistoryTable sessions = HistoryTable::FromStore(store, HistorySeries::Session);
+    HistoryTable periods = HistoryTable::FromStore(store, HistorySeries::Period);
+
+    // Both tables come from the same rows, so they line up
+    const std::vector<ColumnBlock>& sb = sessions.Blocks();
+    const std::vector<ColumnBlock>& pb = periods.Blocks();
+    for (size_t b = 0; b < sb.size() && b < pb.size(); b++) {
+        size_t rows = std::min(sb[b].time.size(), pb[b].time.size());
+        for (size_t i = 0; i < rows; i++) {
+            trace.points.push_back({ sb[b].time[i], sb[b].value[i], pb[b].value[i], 0, 0 });
+        }
+    }
+
+    // The server would have said when each window ends: at the next drop
+    int64_t nextSession = 0, nextPeriod = 0;
+    for (size_t i = trace.points.size(); i-- > 0;) {
+        UsagePoint& p = trace.points[i];
+        p.sessionResetSec = nextSession;
+        p.periodResetSec = nextPeriod;
+        if (i > 0) {
+            const UsagePoint& prev = trace.points[i - 1];
+            if (prev.session - p.session > RESET_DROP) nextSession = p.time;
+            if (prev.period - p.period > RESET_DROP) nextPeriod = p.time;
+        }
+    }
+    return trace;
+}
+
+bool RefreshPolicy::Parse(const std::string& text, RefreshPolicy& out) {
+    out = RefreshPolicy();
+    out.name = text;
+    unsigned a = 0, b = 0;
+    char extra;
+    if (text == "smart") return true;
+    if (sscanf(text.c_str(), "smart:%u:%u%c", &a, &b, &extra) == 2) {
+        out.minIntervalSec = a;
+        out.maxIntervalSec = b;
+        return a > 0 && a <= b;
+    }
+    if (sscanf(text.c_str(), "fixed:%u%c", &a, &extra) == 1) {
+        out.smart = false;
+        out.minIntervalSec = out.maxIntervalSec = a;
+        return a > 0;
+    }
+    return false;
+}
+
+SimulationReport RunSimulation(const UsageTrace& trace, const RefreshPolicy& policy, const FaultModel& faults,
+                               float threshold) {
+    SimulationReport report;
+    report.policy = policy.name;
+    if (trace.points.size() < 2) return report;
+
+    Simulator sim(trace, policy, faults);
+    sim.Run();
+    const std::vector<Observation>& seen = sim.Seen();
+    report.days = (double)(trace.End() - trace.Start()) / 86400.0;
+    report.requests = sim.Requests();
+    report.failures = sim.Failures();
+    report.wakeups = sim.Wakeups();
+
+    // Threshold crossings: seen if any fetch lands before the trace drops back
+    std::vector<float> crossing, reset;
+    const std::vector<UsagePoint>& pts = trace.points;
+    for (size_t i = 1; i < pts.size(); i++) {
+        float before = std::max(pts[i - 1].session, pts[i - 1].period);
+        float after = std::max(pts[i].session, pts[i].period);
+        if (before < threshold && after >= threshold) {
+            report.crossings++;
+            size_t j = i + 1;
+            while (j < pts.size() && std::max(pts[j].session, pts[j].period) >= threshold) j++;
+            uint64_t from = (uint64_t)pts[i].time * 1000;
+            uint64_t until = j < pts.size() ? (uint64_t)pts[j].time * 1000 : UINT64_MAX;
+            size_t k = FirstSeenFrom(seen, from);
+            if (k < seen.size() && seen[k].timeMs < until) {
+                crossing.push_back((float)(seen[k].timeMs - from) / 1000.0f);
+            } else {
+                report.missed++;
+            }
+        }
+
+        // Resets: how long the widget kept showing the old numbers
+        if (pts[i - 1].session - pts[i].session > RESET_DROP || pts[i - 1].period - pts[i].period > RESET_DROP) {
+            uint64_t at = (uint64_t)pts[i].time * 1000;
+            size_t k = FirstSeenFrom(seen, at);
+            if (k < seen.size()) {
+                report.resets++;
+                reset.push_back((float)(seen[k].timeMs - at) / 1000.0f);
+            }
+        }
+    }
+
+    // Age of the data on screen, sampled every minute once there is any
+    std::vector<float> stale;
+    if (!seen.empty()) {
+        size_t k = 0;
+        uint64_t end = (uint64_t)trace.End() * 1000;
+        stale.reserve((size_t)((end - seen[0].timeMs) / 60000 + 1));
+        for (uint64_t t = seen[0].timeMs; t < end; t += 60000) {
+            while (k + 1 < seen.size() && seen[k + 1].timeMs <= t) k++;
+            stale.push_back((float)(t - seen[k].timeMs) / 1000.0f);
+        }
+    }
+
+    report.crossingP50 = Percentile(crossing, 0.5);
+    report.crossingP90 = Percentile(crossing, 0.9);
+    report.crossingMax = crossing.empty() ? 0.0f : *std::max_element(crossing.begin(), crossing.end());
+    report.resetP50 = Percentile(reset, 0.5);
+    report.resetP90 = Percentile(reset, 0.9);
+    report.resetMax = reset.empty() ? 0.0f : *std::max_element(reset.begin(), reset.end());
+    report.staleP50 = Percentile(stale, 0.5);
+    report.staleP90 = Percentile(stale, 0.9);
+    report.staleP99 = Percentile(stale, 0.99);
+    return report;
+}
+
+// Seconds as "45s" / "12.5m" / "3.2h", for the table
+static std::string FormatSeconds(float sec) {
+    char buf[32];
+    if (sec < 120.0f) snprintf(buf, sizeof(buf), "%.0fs", sec);
+    else if (sec < 7200.0f) snprintf(buf, sizeof(buf), "%.1fm", sec / 60.0f);
+    else snprintf(buf, sizeof(buf), "%.1fh", sec / 3600.0f);
+    return buf;
+}
+
+std::string FormatSimulationReport(const std::vector<SimulationReport>& reports, float threshold,
+                                   QueryFormat format) {
+    std::string out;
+    char buf[512];
+
+    switch (format) {
+    case QueryFormat::Table:
+        snprintf(buf, sizeof(buf), "%-16s %8s %8s %6s | %13s %7s %7s %7s | %6s %7s %7s %7s | %7s %7s %7s\n",
+                 "policy", "req/day", "wake/day", "fail%", "crossings", "p50", "p90", "max",
+                 "resets", "p50", "p90", "max", "stale50", "stale90", "stale99");
+        out += buf;
+        for (const SimulationReport& r : reports) {
+            double days = r.days > 0 ? r.days : 1.0;
+            char crossings[32];
+            snprintf(crossings, sizeof(crossings), "%u (%u missed)", r.crossings, r.missed);
+            snprintf(buf, sizeof(buf), "%-16s %8.1f %8.1f %6.2f | %13s %7s %7s %7s | %6u %7s %7s %7s | %7s %7s %7s\n",
+                     r.policy.c_str(), r.requests / days, r.wakeups / days,
+                     r.requests ? 100.0 * r.failures / r.requests : 0.0, crossings,
+                     FormatSeconds(r.crossingP50).c_str(), FormatSeconds(r.crossingP90).c_str(),
+                     FormatSeconds(r.crossingMax).c_str(), r.resets, FormatSeconds(r.resetP50).c_str(),
+                     FormatSeconds(r.resetP90).c_str(), FormatSeconds(r.resetMax).c_str(),
+                     FormatSeconds(r.staleP50).c_str(), FormatSeconds(r.staleP90).c_str(),
+                     FormatSeconds(r.staleP99).c_str());
+            out += buf;
+        }
+        break;
+
+    case QueryFormat::Csv:
+        out += "policy,days,requests,failures,wakeups,crossings,missed,crossing_p50,crossing_p90,crossing_max,"
+               "resets,reset_p50,reset_p90,reset_max,stale_p50,stale_p90,stale_p99\n";
+        for (const SimulationReport& r : reports) {
+            snprintf(buf, sizeof(buf), "%s,%.2f,%llu,%llu,%llu,%u,%u,%.1f,%.1f,%.1f,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                     r.policy.c_str(), r.days, (unsigned long long)r.requests, (unsigned long long)r.failures,
+                     (unsigned long long)r.wakeups, r.crossings, r.missed, r.crossingP50, r.crossingP90,
+                     r.crossingMax, r.resets, r.resetP50, r.resetP90, r.resetMax, r.staleP50, r.staleP90,
+                     r.staleP99);
+            out += buf;
+        }
+        break;
+
+    case QueryFormat::Json:
+        snprintf(buf, sizeof(buf), "{\"threshold\":%g,\"policies\":[", threshold);
+        out += buf;
+        for (size_t i = 0; i < reports.size(); i++) {
+            const SimulationReport& r = reports[i];
+            snprintf(buf, sizeof(buf),
+                     "%s{\"policy\":\"%s\",\"days\":%.2f,\"requests\":%llu,\"failures\":%llu,\"wakeups\":%llu,"
+                     "\"crossings\":%u,\"missed\":%u,\"crossingSec\":{\"p50\":%.1f,\"p90\":%.1f,\"max\":%.1f},"
+                     "\"resets\":%u,\"resetSec\":{\"p50\":%.1f,\"p90\":%.1f,\"max\":%.1f},"
+                     "\"staleSec\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f}}",
+                     i ? "," : "", r.policy.c_str(), r.days, (unsigned long long)r.requests,
+                     (unsigned long long)r.failures, (unsigned long long)r.wakeups, r.crossings, r.missed,
+                     r.crossingP50, r.crossingP90, r.crossingMax, r.resets, r.resetP50, r.resetP90, r.resetMax,
+                     r.staleP50, r.staleP90, r.staleP99);
+            out += buf;
+        }
+        out += "]}\n";
+        break;
+    }
+    return out;
+}
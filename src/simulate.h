@@ -0,0 +1,88 @@
+#pragma once
+
+#include "history.h"
+#include "history_query.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the server would report at one moment; holds until the next point
+struct UsagePoint {
+    int64_t time;               // Unix seconds
+    float session;
+    float period;
+    int64_t sessionResetSec;    // 0 = unknown / no window open
+    int64_t periodResetSec;
+};
+
+// The account's true utilization over time, time ordered
+struct UsageTrace {
+    std::vector<UsagePoint> points;
+
+    // A seeded, repeatable user: bursty weekday work with some evenings and
+    // weekends, 5-hour windows that open on first use, a weekly reset
+    static UsageTrace Synthetic(int days, uint32_t seed, int32_t utcOffsetSec);
+
+    // Replay recorded history (raw samples, then rollup averages). Reset
+    // times come from the drops that follow.
+    static UsageTrace FromHistory(const HistoryStore& store);
+
+    int64_t Start() const { return points.empty() ? 0 : points.front().time; }
+    int64_t End() const { return points.empty() ? 0 : points.back().time; }
+};
+
+// The knobs GetRefreshInterval() reads
+struct RefreshPolicy {
+    std::string name;
+    bool smart = true;
+    uint32_t minIntervalSec = 60;
+    uint32_t maxIntervalSec = 600;
+
+    // "smart", "smart:MIN:MAX" or "fixed:SEC"
+    static bool Parse(const std::string& text, RefreshPolicy& out);
+};
+
+// Injected trouble, and the user's presence. Per-request faults draw from a
+// seeded generator; outages, clock steps and sleeps are time windows shared
+// by every policy.
+struct FaultModel {
+    double offline = 0.0;           // Chance a request times out
+    double serverError = 0.0;       // ... gets a 5xx
+    double authError = 0.0;         // ... gets a 401
+    double noOrg = 0.0;             // Chance an org listing has no org to pick
+    double outagesPerDay = 0.0;     // Network down, then a change event
+    uint32_t outageMinutes = 30;
+    double clockStepsPerDay = 0.0;  // Wall clock set ahead, then put right
+    uint32_t clockStepMinutes = 60;
+    double sleepsPerDay = 0.0;      // Suspends nobody announced; the clocks tell
+    uint32_t sleepMinutes = 60;
+    uint32_t latencyMs = 400;       // Per request
+    uint32_t timeoutMs = 15000;     // What a dead network costs
+    int awayFrom = -1;              // Local hours with no input, e.g. 22..7
+    int awayTo = -1;
+    int32_t utcOffsetSec = 0;
+    uint32_t seed = 1;
+};
+
+struct SimulationReport {
+    std::string policy;
+    double days = 0;
+    uint64_t requests = 0;          // HTTP requests, org lookups included
+    uint64_t failures = 0;
+    uint64_t wakeups = 0;           // Scheduler timer firings
+    uint32_t crossings = 0;         // Upward threshold crossings in the trace
+    uint32_t missed = 0;            // ... that fell back before being seen
+    float crossingP50 = 0, crossingP90 = 0, crossingMax = 0;   // Seconds
+    uint32_t resets = 0;
+    float resetP50 = 0, resetP90 = 0, resetMax = 0;
+    float staleP50 = 0, staleP90 = 0, staleP99 = 0;           // Data age, minute samples
+};
+
+// Drive a RefreshController over the trace on a virtual clock,
+// with RunRefreshPipeline's requests modelled against the faults.
+// Deterministic for a given trace and faults.
+SimulationReport RunSimulation(const UsageTrace& trace, const RefreshPolicy& policy, const FaultModel& faults,
+                               float threshold);
+
+std::string FormatSimulationReport(const std::vector<SimulationReport>& reports, float threshold,
+                                   QueryFormat format);
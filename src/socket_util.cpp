@@ -0,0 +1,247 @@
+#include "socket_util.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+const SocketHandle INVALID_SOCKET_HANDLE = (SocketHandle)INVALID_SOCKET;
+#else
+const SocketHandle INVALID_SOCKET_HANDLE = -1;
+#endif
+
+bool InitSockets() {
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA wsa;
+        started = WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+    }
+    return started;
+#else
+    // A peer hanging up mid-write should be an error return, not a signal
+    signal(SIGPIPE, SIG_IGN);
+    return true;
+#endif
+}
+
+void CloseSocket(SocketHandle s) {
+    if (s == INVALID_SOCKET_HANDLE) return;
+#ifdef _WIN32
+    closesocket((SOCKET)s);
+#else
+    close(s);
+#endif
+}
+
+bool SetNonBlocking(SocketHandle s) {
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket((SOCKET)s, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+void SetNoDelay(SocketHandle s) {
+    int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+}
+
+int LastSocketError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+bool SocketWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+bool ParseHostPort(const std::string& text, std::string& host, uint16_t& port) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos) return false;
+    host = text.substr(0, colon);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    std::string digits = text.substr(colon + 1);
+    if (digits.empty() || digits.size() > 5) return false;
+    unsigned long value = 0;
+    for (char c : digits) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (unsigned long)(c - '0');
+    }
+    if (value == 0 || value > 65535) return false;
+    port = (uint16_t)value;
+    return true;
+}
+
+static addrinfo* Resolve(const std::string& host, uint16_t port, bool passive, std::string& error) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    addrinfo* result = nullptr;
+    int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), service, &hints, &result);
+    if (rc != 0) {
+        error = "can't resolve " + host + " (error " + std::to_string(rc) + ")";
+        return nullptr;
+    }
+    return result;
+}
+
+SocketHandle ListenTcp(const std::string& host, uint16_t port, std::string& error) {
+    addrinfo* addrs = Resolve(host, port, true, error);
+    if (!addrs) return INVALID_SOCKET_HANDLE;
+
+    SocketHandle s = INVALID_SOCKET_HANDLE;
+    for (addrinfo* a = addrs; a; a = a->ai_next) {
+        s = (SocketHandle)socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == INVALID_SOCKET_HANDLE) continue;
+
+        int on = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+        if (bind(s, a->ai_addr, (int)a->ai_addrlen) == 0 && listen(s, SOMAXCONN) == 0 && SetNonBlocking(s)) {
+            break;
+        }
+        CloseSocket(s);
+        s = INVALID_SOCKET_HANDLE;
+    }
+    freeaddrinfo(addrs);
+
+    if (s == INVALID_SOCKET_HANDLE) {
+        error = "can't listen on " + host + ":" + std::to_string(port) + " (error " +
+                std::to_string(LastSocketError()) + ")";
+    }
+    return s;
+}
+
+static void SetTimeouts(SocketHandle s, uint32_t timeoutMs) {
+#ifdef _WIN32
+    DWORD tv = timeoutMs;
+#else
+    timeval tv = { (time_t)(timeoutMs / 1000), (suseconds_t)(timeoutMs % 1000 * 1000) };
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof(tv));
+}
+
+SocketHandle ConnectTcp(const std::string& host, uint16_t port, std::string& error, uint32_t timeoutMs) {
+    addrinfo* addrs = Resolve(host, port, false, error);
+    if (!addrs) return INVALID_SOCKET_HANDLE;
+
+    SocketHandle s = INVALID_SOCKET_HANDLE;
+    for (addrinfo* a = addrs; a; a = a->ai_next) {
+        s = (SocketHandle)socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == INVALID_SOCKET_HANDLE) continue;
+        // Linux applies SO_SNDTIMEO to connect() too
+        if (timeoutMs) SetTimeouts(s, timeoutMs);
+        if (connect(s, a->ai_addr, (int)a->ai_addrlen) == 0) break;
+        CloseSocket(s);
+        s = INVALID_SOCKET_HANDLE;
+    }
+    freeaddrinfo(addrs);
+
+    if (s == INVALID_SOCKET_HANDLE) {
+        error = "can't connect to " + host + ":" + std::to_string(port) + " (error " +
+                std::to_string(LastSocketError()) + ")";
+    }
+    return s;
+}
+
+static bool UnixAddress(const std::string& path, sockaddr_un& addr, std::string& error) {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        error = "socket path too long: " + path;
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+SocketHandle ConnectUnix(const std::string& path, std::string& error) {
+    sockaddr_un addr;
+    if (!UnixAddress(path, addr, error)) return INVALID_SOCKET_HANDLE;
+    SocketHandle s = (SocketHandle)socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s != INVALID_SOCKET_HANDLE && connect(s, (const sockaddr*)&addr, (int)sizeof(addr)) == 0) return s;
+
+    error = "can't connect to " + path + " (error " + std::to_string(LastSocketError()) + ")";
+    CloseSocket(s);
+    return INVALID_SOCKET_HANDLE;
+}
+
+SocketHandle ListenUnix(const std::string& path, std::string& error) {
+    sockaddr_un addr;
+    if (!UnixAddress(path, addr, error)) return INVALID_SOCKET_HANDLE;
+
+    // Someone answering means it's in use; otherwise it's left over
+    std::string ignored;
+    SocketHandle probe = ConnectUnix(path, ignored);
+    if (probe != INVALID_SOCKET_HANDLE) {
+        CloseSocket(probe);
+        error = path + " is already being served";
+        return INVALID_SOCKET_HANDLE;
+    }
+    remove(path.c_str());
+
+    SocketHandle s = (SocketHandle)socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET_HANDLE) {
+        error = "can't create socket (error " + std::to_string(LastSocketError()) + ")";
+        return s;
+    }
+#ifndef _WIN32
+    // Created owner-only from the start, not chmod'ed after the fact
+    mode_t mask = umask(0077);
+#endif
+    bool ok = bind(s, (const sockaddr*)&addr, (int)sizeof(addr)) == 0;
+#ifndef _WIN32
+    umask(mask);
+#endif
+    if (!ok || listen(s, SOMAXCONN) != 0 || !SetNonBlocking(s)) {
+        error = "can't listen on " + path + " (error " + std::to_string(LastSocketError()) + ")";
+        CloseSocket(s);
+        return INVALID_SOCKET_HANDLE;
+    }
+    return s;
+}
+
+bool SendAll(SocketHandle s, const char* data, size_t size) {
+    while (size > 0) {
+        int n = (int)send(s, data, (int)(size > 1 << 30 ? 1 << 30 : size), 0);
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
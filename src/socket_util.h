@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Thin layer over Winsock / BSD sockets - just enough for the aggregator
+// service and its clients to share code between platforms
+#ifdef _WIN32
+using SocketHandle = uintptr_t;     // SOCKET
+#else
+using SocketHandle = int;
+#endif
+
+extern const SocketHandle INVALID_SOCKET_HANDLE;
+
+// WSAStartup on Windows, SIGPIPE off elsewhere. Safe to call repeatedly.
+bool InitSockets();
+
+void CloseSocket(SocketHandle s);
+bool SetNonBlocking(SocketHandle s);
+void SetNoDelay(SocketHandle s);
+
+// Last send/recv failed only because it would have blocked
+bool SocketWouldBlock();
+int LastSocketError();
+
+// "host:port", "[v6]:port" or ":port"; an empty host means all interfaces
+bool ParseHostPort(const std::string& text, std::string& host, uint16_t& port);
+
+// Non-blocking listening socket, SO_REUSEADDR set
+SocketHandle ListenTcp(const std::string& host, uint16_t port, std::string& error);
+
+// Blocking connected socket. A timeout bounds the connect and every later
+// send/recv on the socket (SO_SNDTIMEO/SO_RCVTIMEO; 0 = the OS default).
+SocketHandle ConnectTcp(const std::string& host, uint16_t port, std::string& error, uint32_t timeoutMs = 0);
+
+// Local stream sockets (AF_UNIX; Winsock has them since Windows 10 1803).
+// Listening fails if another process is already serving the path; a stale
+// socket file left by a crash is replaced. Only the owner may connect.
+SocketHandle ListenUnix(const std::string& path, std::string& error);
+SocketHandle ConnectUnix(const std::string& path, std::string& error);
+
+// Loop until everything is written or the socket fails (blocking sockets)
+bool SendAll(SocketHandle s, const char* data, size_t size);
@@ -0,0 +1,60 @@
+#include "sparkline.h"
+
+Sparkline::Sparkline(int64_t windowSec, int buckets) {
+    Reset(windowSec, buckets);
+}
+
+void Sparkline::Reset(int64_t windowSec, int buckets) {
+    if (buckets < 1) buckets = 1;
+    m_windowSec = windowSec;
+    m_bucketSec = windowSec / buckets;
+    if (m_bucketSec < 1) m_bucketSec = 1;
+    m_head = -1;
+    m_slots.assign((size_t)buckets, Slot{ 0.0f, 0.0f, false });
+}
+
+void Sparkline::AdvanceTo(int64_t timeSec) {
+    int64_t bucket = timeSec / m_bucketSec;
+    if (m_head < 0) {
+        m_head = bucket;
+        return;
+    }
+    if (bucket <= m_head) return;
+
+    // Clear the columns we slid past; never more than one full sweep
+    int64_t n = (int64_t)m_slots.size();
+    int64_t from = bucket - m_head >= n ? bucket - n + 1 : m_head + 1;
+    for (int64_t b = from; b <= bucket; b++) {
+        SlotFor(b).used = false;
+    }
+    m_head = bucket;
+}
+
+void Sparkline::Add(int64_t timeSec, float value) {
+    AdvanceTo(timeSec);
+
+    int64_t bucket = timeSec / m_bucketSec;
+    if (bucket <= m_head - (int64_t)m_slots.size()) return;  // Already off the left edge
+
+    Slot& slot = SlotFor(bucket);
+    if (!slot.used) {
+        slot.min = slot.max = value;
+        slot.used = true;
+    } else {
+        if (value < slot.min) slot.min = value;
+        if (value > slot.max) slot.max = value;
+    }
+}
+
+bool Sparkline::Get(int i, float& min, float& max) const {
+    if (m_head < 0 || i < 0 || i >= Buckets()) return false;
+
+    int64_t bucket = m_head - (Buckets() - 1 - i);
+    if (bucket < 0) return false;
+
+    const Slot& slot = m_slots[(size_t)(bucket % (int64_t)m_slots.size())];
+    if (!slot.used) return false;
+    min = slot.min;
+    max = slot.max;
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Trend line for one progress bar: a sliding time window split into one
+// min/max bucket per pixel column. Adding a sample touches one bucket (plus
+// any buckets the window slid past), so it's O(1) amortized, and drawing
+// costs the same no matter how much history fed it.
+class Sparkline {
+public:
+    Sparkline(int64_t windowSec, int buckets);
+
+    // Change the window or pixel width; drops what was collected
+    void Reset(int64_t windowSec, int buckets);
+
+    void Add(int64_t timeSec, float value);
+
+    // Slide the window forward to now so old buckets fall off the left edge
+    void AdvanceTo(int64_t timeSec);
+
+    int Buckets() const { return (int)m_slots.size(); }
+    int64_t WindowSec() const { return m_windowSec; }
+
+    // Column i, 0 = oldest (left) .. Buckets()-1 = newest (right).
+    // False if nothing was sampled in that column.
+    bool Get(int i, float& min, float& max) const;
+
+private:
+    struct Slot {
+        float min;
+        float max;
+        bool used;
+    };
+
+    int64_t m_windowSec;
+    int64_t m_bucketSec;
+    int64_t m_head = -1;        // Absolute bucket number of the newest column
+    std::vector<Slot> m_slots;  // Ring indexed by absolute bucket % size
+
+    Slot& SlotFor(int64_t bucket) { return m_slots[(size_t)(bucket % (int64_t)m_slots.size())]; }
+};
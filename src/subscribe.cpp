@@ -0,0 +1,311 @@
+#include "subscribe.h"
+#include "file_util.h"
+#include "trace.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+namespace {
+
+int64_t WallMs() {
+    return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Percentages go out with one decimal; smaller wiggles aren't news
+bool SamePercent(float a, float b) {
+    return std::lround(a * 10.0f) == std::lround(b * 10.0f);
+}
+
+void AppendEscaped(std::string& out, const std::string& s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c >= 0x20) out += c;
+    }
+}
+
+void AppendField(std::string& out, const char* name, bool value) {
+    out += ",\"";
+    out += name;
+    out += value ? "\":true" : "\":false";
+}
+
+void AppendField(std::string& out, const char* name, float value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), ",\"%s\":%.1f", name, value);
+    out += buf;
+}
+
+void AppendField(std::string& out, const char* name, int64_t value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), ",\"%s\":%lld", name, (long long)value);
+    out += buf;
+}
+
+void AppendField(std::string& out, const char* name, const std::string& value) {
+    out += ",\"";
+    out += name;
+    out += "\":\"";
+    AppendEscaped(out, value);
+    out += '"';
+}
+
+std::string Header(uint64_t seq, const char* type, int64_t nowMs) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "{\"seq\":%llu,\"type\":\"%s\",\"time\":%lld", (unsigned long long)seq, type,
+             (long long)nowMs);
+    return buf;
+}
+
+} // namespace
+
+SubscriptionHub::SubscriptionHub() : m_listener(INVALID_SOCKET_HANDLE) {}
+
+SubscriptionHub::~SubscriptionHub() {
+    Stop();
+}
+
+std::string SubscriptionHub::DefaultPath() {
+    std::filesystem::path dir = GetDataDir();
+    return dir.empty() ? "" : (dir / "claudewatch.sock").u8string();
+}
+
+bool SubscriptionHub::Start(const std::string& path, std::string& error) {
+    InitSockets();
+    if (!m_loop.Ok()) {
+        error = "can't create event loop";
+        return false;
+    }
+    m_listener = ListenUnix(path, error);
+    if (m_listener == INVALID_SOCKET_HANDLE) return false;
+    m_path = path;
+    m_loop.Add(m_listener, EventLoop::READ, [this](uint32_t) { OnAccept(); });
+    m_thread = std::thread([this]() { Run(); });
+    return true;
+}
+
+void SubscriptionHub::Stop() {
+    if (!m_thread.joinable()) return;
+    m_stop.store(true);
+    m_loop.Wake();
+    m_thread.join();
+
+    for (auto& entry : m_subscribers) CloseSocket(entry.first);
+    m_subscribers.clear();
+    CloseSocket(m_listener);
+    m_listener = INVALID_SOCKET_HANDLE;
+    remove(m_path.c_str());
+}
+
+void SubscriptionHub::Publish(const UsageState& state) {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_pending = state;
+        m_hasPending = true;
+        m_stats.published++;
+    }
+    m_loop.Wake();
+}
+
+SubscriptionHub::Stats SubscriptionHub::GetStats() const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_stats;
+}
+
+void SubscriptionHub::Run() {
+    TraceSetThreadName("Subscriptions");
+    while (!m_stop.load()) {
+        int64_t now = WallMs();
+        ApplyPending(now);
+        int timeoutMs = CheckResets(now);
+        m_loop.RunOnce(timeoutMs);
+    }
+}
+
+void SubscriptionHub::OnAccept() {
+    for (;;) {
+        SocketHandle s = (SocketHandle)accept(m_listener, nullptr, nullptr);
+        if (s == INVALID_SOCKET_HANDLE) return;
+        if (m_subscribers.size() >= maxSubscribers || !SetNonBlocking(s)) {
+            CloseSocket(s);
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_stats.rejected++;
+            continue;
+        }
+
+        std::unique_ptr<Subscriber> sub(new Subscriber());
+        sub->socket = s;
+        Subscriber& ref = *sub;
+        m_subscribers[s] = std::move(sub);
+        m_loop.Add(s, EventLoop::READ, [this, s](uint32_t events) { OnEvents(s, events); });
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_stats.subscribers++;
+            m_stats.open = m_subscribers.size();
+        }
+
+        // Late joiners start from the current state
+        if (m_hasState && (!Queue(ref, Snapshot(WallMs())) || !Flush(ref))) Close(s);
+    }
+}
+
+void SubscriptionHub::OnEvents(SocketHandle s, uint32_t events) {
+    auto it = m_subscribers.find(s);
+    if (it == m_subscribers.end()) return;
+
+    if ((events & EventLoop::WRITE) && !Flush(*it->second)) {
+        Close(s);
+        return;
+    }
+    if (!(events & EventLoop::READ)) return;
+
+    // Clients have nothing to say; read only to notice them hanging up
+    char buf[512];
+    for (;;) {
+        int n = (int)recv(s, buf, sizeof(buf), 0);
+        if (n > 0) continue;
+        if (n < 0 && SocketWouldBlock()) return;
+        Close(s);
+        return;
+    }
+}
+
+bool SubscriptionHub::Queue(Subscriber& sub, const std::string& message) {
+    if (sub.out.size() - sub.outSent + message.size() > maxQueuedBytes) return false;
+    if (sub.outSent == sub.out.size()) {
+        sub.out.clear();
+        sub.outSent = 0;
+    }
+    sub.out += message;
+    return true;
+}
+
+bool SubscriptionHub::Flush(Subscriber& sub) {
+    while (sub.outSent < sub.out.size()) {
+        int n = (int)send(sub.socket, sub.out.data() + sub.outSent, (int)(sub.out.size() - sub.outSent), 0);
+        if (n > 0) {
+            sub.outSent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && SocketWouldBlock()) {
+            if (!sub.writing) m_loop.Modify(sub.socket, EventLoop::READ | EventLoop::WRITE);
+            sub.writing = true;
+            return true;
+        }
+        return false;
+    }
+    sub.out.clear();
+    sub.outSent = 0;
+    if (sub.writing) m_loop.Modify(sub.socket, EventLoop::READ);
+    sub.writing = false;
+    return true;
+}
+
+void SubscriptionHub::Broadcast(const std::string& message) {
+    std::vector<SocketHandle> slow, failed;
+    for (auto& entry : m_subscribers) {
+        Subscriber& sub = *entry.second;
+        // Already backed up: just add to the queue, the WRITE event will send it
+        bool backlog = sub.outSent < sub.out.size();
+        if (!Queue(sub, message)) slow.push_back(entry.first);
+        else if (!backlog && !Flush(sub)) failed.push_back(entry.first);
+    }
+    for (SocketHandle s : slow) Close(s);
+    for (SocketHandle s : failed) Close(s);
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stats.messages++;
+    m_stats.delivered += m_subscribers.size();
+    m_stats.dropped += slow.size();
+}
+
+void SubscriptionHub::Close(SocketHandle s) {
+    m_loop.Remove(s);
+    m_subscribers.erase(s);
+    CloseSocket(s);
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stats.open = m_subscribers.size();
+}
+
+std::string SubscriptionHub::Snapshot(int64_t nowMs) {
+    std::string out = Header(m_seq, "snapshot", nowMs);
+    AppendField(out, "valid", m_state.valid);
+    AppendField(out, "offline", m_state.offline);
+    AppendField(out, "estimated", m_state.estimated);
+    AppendField(out, "session", m_state.session);
+    AppendField(out, "period", m_state.period);
+    AppendField(out, "sessionResetMs", m_state.sessionResetMs);
+    AppendField(out, "periodResetMs", m_state.periodResetMs);
+    AppendField(out, "error", m_state.error);
+    out += "}\n";
+    return out;
+}
+
+void SubscriptionHub::ApplyPending(int64_t nowMs) {
+    UsageState next;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (!m_hasPending) return;
+        next = m_pending;
+        m_hasPending = false;
+    }
+
+    if (!m_hasState) {
+        m_state = next;
+        m_hasState = true;
+        m_seq++;
+        Broadcast(Snapshot(nowMs));
+        return;
+    }
+
+    // Only what changed; nothing at all if nothing did
+    std::string fields;
+    if (next.valid != m_state.valid) AppendField(fields, "valid", next.valid);
+    if (next.offline != m_state.offline) AppendField(fields, "offline", next.offline);
+    if (next.estimated != m_state.estimated) AppendField(fields, "estimated", next.estimated);
+    if (!SamePercent(next.session, m_state.session)) AppendField(fields, "session", next.session);
+    if (!SamePercent(next.period, m_state.period)) AppendField(fields, "period", next.period);
+    if (next.sessionResetMs != m_state.sessionResetMs) AppendField(fields, "sessionResetMs", next.sessionResetMs);
+    if (next.periodResetMs != m_state.periodResetMs) AppendField(fields, "periodResetMs", next.periodResetMs);
+    if (next.error != m_state.error) AppendField(fields, "error", next.error);
+    m_state = next;
+    if (fields.empty()) return;
+
+    std::string message = Header(++m_seq, "delta", nowMs);
+    message += fields;
+    message += "}\n";
+    Broadcast(message);
+}
+
+// Announces reset times that have passed; returns how long until the next
+// one (-1 if none is pending)
+int SubscriptionHub::CheckResets(int64_t nowMs) {
+    int64_t nextMs = -1;
+    auto check = [&](int64_t resetMs, int64_t& announced, const char* window) {
+        if (!m_hasState || !resetMs || resetMs == announced) return;
+        if (nowMs < resetMs) {
+            if (nextMs < 0 || resetMs - nowMs < nextMs) nextMs = resetMs - nowMs;
+            return;
+        }
+        announced = resetMs;
+        std::string message = Header(++m_seq, "reset", nowMs);
+        message += ",\"window\":\"";
+        message += window;
+        message += "\"}\n";
+        Broadcast(message);
+    };
+    check(m_state.sessionResetMs, m_announcedSession, "session");
+    check(m_state.periodResetMs, m_announcedPeriod, "period");
+
+    // Wall-clock deadlines; re-check at least hourly in case the clock moves
+    if (nextMs < 0) return -1;
+    return (int)(nextMs < 3600 * 1000 ? nextMs : 3600 * 1000);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "event_loop.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// What a subscriber sees of UsageData. Reset times are Unix ms, 0 if unknown.
+struct UsageState {
+    bool valid = false;
+    bool offline = false;
+    bool estimated = false;
+    float session = 0.0f;
+    float period = 0.0f;
+    int64_t sessionResetMs = 0;
+    int64_t periodResetMs = 0;
+    std::string error;
+};
+
+// Live usage for local tools (status bars, tmux, editor plugins) over a
+// local stream socket. A client connects and reads one JSON object per line:
+//   {"seq":1,"type":"snapshot","time":...,"valid":true,...}   on connect
+//   {"seq":2,"type":"delta","time":...,"session":43.0}        changed fields only
+//   {"seq":3,"type":"reset","time":...,"window":"session"}   a reset time passed
+// Publish() is all the caller's thread pays: a copy under a lock and a
+// wakeup. The hub's own thread diffs, encodes each message once and fans it
+// out with non-blocking sends. A subscriber whose backlog passes
+// maxQueuedBytes is disconnected rather than allowed to hold things up; it
+// gets a fresh snapshot when it reconnects.
+class SubscriptionHub {
+public:
+    size_t maxSubscribers = 1024;
+    size_t maxQueuedBytes = 16 * 1024;     // Per subscriber, unsent
+
+    struct Stats {
+        uint64_t subscribers = 0;       // Accepted, total
+        uint64_t open = 0;
+        uint64_t published = 0;         // Publish() calls
+        uint64_t messages = 0;          // Deltas and resets encoded
+        uint64_t delivered = 0;         // Message copies queued to subscribers
+        uint64_t dropped = 0;           // Slow subscribers disconnected
+        uint64_t rejected = 0;          // Over maxSubscribers
+    };
+
+    SubscriptionHub();
+    ~SubscriptionHub();
+
+    // Listen on `path` and start the hub thread
+    bool Start(const std::string& path, std::string& error);
+    void Stop();
+
+    // Any thread. Publishes that arrive faster than the hub runs coalesce
+    // into one delta.
+    void Publish(const UsageState& state);
+
+    Stats GetStats() const;
+
+    // claudewatch.sock in the data folder; empty if there isn't one
+    static std::string DefaultPath();
+
+    SubscriptionHub(const SubscriptionHub&) = delete;
+    SubscriptionHub& operator=(const SubscriptionHub&) = delete;
+
+private:
+    struct Subscriber {
+        SocketHandle socket;
+        std::string out;
+        size_t outSent = 0;
+        bool writing = false;   // Waiting for WRITE readiness
+    };
+
+    void Run();
+    void OnAccept();
+    void OnEvents(SocketHandle s, uint32_t events);
+    void Broadcast(const std::string& message);
+    bool Queue(Subscriber& sub, const std::string& message);
+    bool Flush(Subscriber& sub);
+    void Close(SocketHandle s);
+    void ApplyPending(int64_t nowMs);
+    int CheckResets(int64_t nowMs);
+    std::string Snapshot(int64_t nowMs);
+
+    EventLoop m_loop;
+    SocketHandle m_listener;
+    std::string m_path;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{ false };
+
+    // Publish() -> hub thread
+    mutable std::mutex m_lock;
+    UsageState m_pending;
+    bool m_hasPending = false;
+    Stats m_stats;
+
+    // Hub thread only
+    std::unordered_map<SocketHandle, std::unique_ptr<Subscriber>> m_subscribers;
+    UsageState m_state;
+    bool m_hasState = false;
+    uint64_t m_seq = 0;
+    int64_t m_announcedSession = 0;     // Reset times already reported as passed
+    int64_t m_announcedPeriod = 0;
+};
@@ -0,0 +1,83 @@
+#include "text_util.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+std::wstring Utf8ToWide(const std::string& s) {
+    if (s.empty()) return L"";
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), nullptr, 0);
+    if (len == 0) return L"";
+    std::wstring w(len, 0);
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), &w[0], len);
+    return w;
+}
+
+std::string WideToUtf8(const std::wstring& w) {
+    if (w.empty()) return "";
+    int len = WideCharToMultiByte(CP_UTF8, 0, w.c_str(), (int)w.length(), nullptr, 0, nullptr, nullptr);
+    std::string s(len > 0 ? len : 0, '\0');
+    if (len > 0) WideCharToMultiByte(CP_UTF8, 0, w.c_str(), (int)w.length(), &s[0], len, nullptr, nullptr);
+    return s;
+}
+
+#else
+#include <cstdint>
+
+std::wstring Utf8ToWide(const std::string& s) {
+    std::wstring w;
+    w.reserve(s.size());
+    for (size_t i = 0; i < s.size();) {
+        unsigned char c = (unsigned char)s[i];
+        int extra = c < 0x80 ? 0 : (c >> 5) == 0x6 ? 1 : (c >> 4) == 0xe ? 2 : (c >> 3) == 0x1e ? 3 : -1;
+        if (extra < 0 || i + extra >= s.size()) {
+            w.push_back(0xfffd);
+            i++;
+            continue;
+        }
+        uint32_t cp = extra ? c & (0x3f >> extra) : c;
+        bool ok = true;
+        for (int k = 1; k <= extra; k++) {
+            unsigned char cc = (unsigned char)s[i + k];
+            if ((cc & 0xc0) != 0x80) {
+                ok = false;
+                break;
+            }
+            cp = (cp << 6) | (cc & 0x3f);
+        }
+        if (!ok) {
+            w.push_back(0xfffd);
+            i++;
+            continue;
+        }
+        w.push_back((wchar_t)cp);
+        i += (size_t)extra + 1;
+    }
+    return w;
+}
+
+std::string WideToUtf8(const std::wstring& w) {
+    std::string s;
+    s.reserve(w.size());
+    for (wchar_t wc : w) {
+        uint32_t cp = (uint32_t)wc;
+        if (cp > 0x10ffff || (cp >= 0xd800 && cp < 0xe000)) cp = 0xfffd;
+        if (cp < 0x80) {
+            s.push_back((char)cp);
+        } else if (cp < 0x800) {
+            s.push_back((char)(0xc0 | cp >> 6));
+            s.push_back((char)(0x80 | (cp & 0x3f)));
+        } else if (cp < 0x10000) {
+            s.push_back((char)(0xe0 | cp >> 12));
+            s.push_back((char)(0x80 | (cp >> 6 & 0x3f)));
+            s.push_back((char)(0x80 | (cp & 0x3f)));
+        } else {
+            s.push_back((char)(0xf0 | cp >> 18));
+            s.push_back((char)(0x80 | (cp >> 12 & 0x3f)));
+            s.push_back((char)(0x80 | (cp >> 6 & 0x3f)));
+            s.push_back((char)(0x80 | (cp & 0x3f)));
+        }
+    }
+    return s;
+}
+
+#endif
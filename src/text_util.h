@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// UTF-8 <-> wchar_t (UTF-16 on Windows, UTF-32 elsewhere). Invalid input
+// becomes U+FFFD rather than failing.
+std::wstring Utf8ToWide(const std::string& s);
+std::string WideToUtf8(const std::wstring& w);
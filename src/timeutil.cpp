@@ -0,0 +1,236 @@
+#include "timeutil.h"
+#include <ctime>
+#include <cwchar>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+
+// Fixed-width run of digits, -1 if any isn't one
+int Digits(const char* p, int n) {
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned d = (unsigned)(p[i] - '0');
+        if (d > 9) return -1;
+        v = v * 10 + (int)d;
+    }
+    return v;
+}
+
+bool IsLeap(int y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+int DaysInMonth(int y, int m) {
+    static const int DAYS[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return m == 2 && IsLeap(y) ? 29 : DAYS[m - 1];
+}
+
+} // namespace
+
+int64_t DaysFromCivil(int year, int month, int day) {
+    int64_t y = year - (month <= 2);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void CivilFromDays(int64_t days, int& year, int& month, int& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    year = (int)(yoe + era * 400 + (month <= 2));
+}
+
+bool ParseIso8601(const char* p, size_t len, int64_t& unixMs) {
+    // Date and time are fixed width: "2026-02-04T21:00:00" is 19 characters
+    if (len < 19) return false;
+    if (p[4] != '-' || p[7] != '-' || (p[10] != 'T' && p[10] != 't' && p[10] != ' ') ||
+        p[13] != ':' || p[16] != ':') {
+        return false;
+    }
+
+    int year = Digits(p, 4);
+    int month = Digits(p + 5, 2);
+    int day = Digits(p + 8, 2);
+    int hour = Digits(p + 11, 2);
+    int minute = Digits(p + 14, 2);
+    int second = Digits(p + 17, 2);
+    if (year < 0 || month < 1 || month > 12 || day < 1 || day > DaysInMonth(year, month) ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) {
+        return false;
+    }
+
+    const char* end = p + len;
+    const char* c = p + 19;
+
+    // Fraction: keep milliseconds, consume (and validate) the rest
+    int ms = 0;
+    if (c < end && (*c == '.' || *c == ',')) {
+        c++;
+        int digits = 0;
+        while (c < end && (unsigned)(*c - '0') <= 9) {
+            if (digits < 3) ms = ms * 10 + (*c - '0');
+            digits++;
+            c++;
+        }
+        if (digits == 0) return false;
+        for (; digits < 3; digits++) ms *= 10;
+    }
+
+    // Offset: local time = UTC + offset, so subtract it
+    int offsetMin = 0;
+    if (c < end) {
+        if (*c == 'Z' || *c == 'z') {
+            c++;
+        } else if (*c == '+' || *c == '-') {
+            int sign = *c == '-' ? -1 : 1;
+            c++;
+            if (end - c < 2) return false;
+            int oh = Digits(c, 2);
+            c += 2;
+            int om = 0;
+            if (c < end && *c == ':') c++;
+            if (end - c >= 2) {
+                om = Digits(c, 2);
+                c += 2;
+            }
+            if (oh < 0 || oh > 23 || om < 0 || om > 59) return false;
+            offsetMin = sign * (oh * 60 + om);
+        } else {
+            return false;
+        }
+    }
+    if (c != end) return false;
+
+    // A leap second is folded into the next second rather than rejected
+    int64_t secs = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    unixMs = (secs - (int64_t)offsetMin * 60) * 1000 + ms;
+    return true;
+}
+
+int32_t LocalUtcOffset(int64_t unixSec) {
+    time_t t = (time_t)unixSec;
+    tm local, utc;
+#ifdef _WIN32
+    localtime_s(&local, &t);
+    gmtime_s(&utc, &t);
+#else
+    localtime_r(&t, &local);
+    gmtime_r(&t, &utc);
+#endif
+    int64_t l = DaysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * 86400 +
+                local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+    int64_t u = DaysFromCivil(utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday) * 86400 +
+                utc.tm_hour * 3600 + utc.tm_min * 60 + utc.tm_sec;
+    return (int32_t)(l - u);
+}
+
+#ifdef _WIN32
+
+ClockSample SampleClocks() {
+    ClockSample s;
+    FILETIME ft;
+    GetSystemTimePreciseAsFileTime(&ft);
+    uint64_t ticks = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    s.wallMs = (int64_t)(ticks / 10000) - 11644473600000LL;     // 1601 -> 1970
+
+    s.bootMs = GetTickCount64();
+    ULONGLONG unbiased = 0;
+    QueryUnbiasedInterruptTime(&unbiased);
+    s.activeMs = unbiased / 10000;
+    return s;
+}
+
+#else
+
+static uint64_t ClockMs(clockid_t id) {
+    timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+ClockSample SampleClocks() {
+    ClockSample s;
+    s.wallMs = (int64_t)ClockMs(CLOCK_REALTIME);
+    s.bootMs = ClockMs(CLOCK_BOOTTIME);
+    s.activeMs = ClockMs(CLOCK_MONOTONIC);
+    return s;
+}
+
+#endif
+
+int64_t CountdownDelayMs(int64_t remainingMs, int64_t graceMs) {
+    return remainingMs > 0 ? (remainingMs - 1) % 60000 + 1 : remainingMs + graceMs;
+}
+
+std::wstring FormatCountdown(int64_t remainingMs) {
+    if (remainingMs <= 0) return L"Resetting...";
+
+    int64_t totalMin = (remainingMs + 59999) / 60000;
+    int64_t hours = totalMin / 60;
+    int64_t mins = totalMin % 60;
+
+    wchar_t buf[64];
+    if (hours >= 24) {
+        std::swprintf(buf, 64, L"Resets in %dd %dh", (int)(hours / 24), (int)(hours % 24));
+    } else if (hours > 0) {
+        std::swprintf(buf, 64, L"Resets in %dh %dm", (int)hours, (int)mins);
+    } else {
+        std::swprintf(buf, 64, L"Resets in %dm", (int)mins);
+    }
+    return buf;
+}
+
+bool ResetDeadline::Anchor(int64_t resetWallMs, const ClockSample& now) {
+    int64_t remaining = resetWallMs - now.wallMs;
+    if (remaining <= 0) {
+        Clear();
+        return false;
+    }
+    m_wallMs = resetWallMs;
+    m_dueBootMs = now.bootMs + (uint64_t)remaining;
+    return true;
+}
+
+int64_t ResetDeadline::RemainingMs(const ClockSample& now) const {
+    if (!IsSet()) return 0;
+    return (int64_t)(m_dueBootMs - now.bootMs);
+}
+
+ClockEvent ClockMonitor::Observe(const ClockSample& now) {
+    if (!m_haveLast) {
+        m_last = now;
+        m_haveLast = true;
+        return ClockEvent::None;
+    }
+
+    int64_t wallDelta = now.wallMs - m_last.wallMs;
+    int64_t bootDelta = (int64_t)(now.bootMs - m_last.bootMs);
+    int64_t activeDelta = (int64_t)(now.activeMs - m_last.activeMs);
+    m_last = now;
+
+    // Sleep first: the wall clock legitimately moves with the boot clock there
+    if (bootDelta - activeDelta > (int64_t)suspendThresholdMs) {
+        return ClockEvent::Resumed;
+    }
+
+    int64_t skew = wallDelta - bootDelta;
+    if (skew > (int64_t)jumpToleranceMs || skew < -(int64_t)jumpToleranceMs) {
+        m_lastJumpMs = skew;
+        return ClockEvent::WallJump;
+    }
+    return ClockEvent::None;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+int64_t DaysFromCivil(int year, int month, int day);
+
+// Inverse of DaysFromCivil
+void CivilFromDays(int64_t days, int& year, int& month, int& day);
+
+// "YYYY-MM-DDTHH:MM:SS[.frac][Z|+HH:MM|-HH:MM|+HHMM]" to Unix milliseconds.
+// A space may replace the T; no offset means UTC. Fractions of any length
+// are accepted and truncated to milliseconds. Never allocates; rejects
+// out-of-range fields (Feb 30, hour 24, ...) instead of normalizing them.
+bool ParseIso8601(const char* text, size_t len, int64_t& unixMs);
+
+inline bool ParseIso8601(const std::string& text, int64_t& unixMs) {
+    return ParseIso8601(text.data(), text.size(), unixMs);
+}
+
+// Seconds east of UTC for local time at the given instant
+int32_t LocalUtcOffset(int64_t unixSec);
+
+// One reading of every clock we care about, taken together
+struct ClockSample {
+    int64_t wallMs = 0;     // Unix time - can be set, stepped by NTP, wrong
+    uint64_t bootMs = 0;    // Monotonic, keeps counting through suspend
+    uint64_t activeMs = 0;  // Monotonic, stops while suspended
+};
+
+ClockSample SampleClocks();
+
+// "Resets in 4h 23m" / "Resets in 2d 5h" / "Resets in 7m" / "Resetting...".
+// Partial minutes round up so the last minute shows as 1m, not 0m.
+std::wstring FormatCountdown(int64_t remainingMs);
+
+// When the countdown text next changes (the next minute boundary), or once
+// the deadline has passed, when the grace period after it runs out
+int64_t CountdownDelayMs(int64_t remainingMs, int64_t graceMs);
+
+// A reset time from the server, pinned to the boot clock when it was
+// received so the countdown is immune to later wall-clock changes and keeps
+// running correctly across sleep.
+class ResetDeadline {
+public:
+    bool IsSet() const { return m_wallMs != 0; }
+    int64_t WallMs() const { return m_wallMs; }
+
+    // Pin a server wall time against the clocks as they are right now. A
+    // time that has already passed leaves the deadline clear: the server is
+    // still reporting the old window, and refreshing at it again would only
+    // get the same answer back.
+    bool Anchor(int64_t resetWallMs, const ClockSample& now);
+    void Clear() { *this = ResetDeadline(); }
+
+    int64_t RemainingMs(const ClockSample& now) const;
+
+    // Boot-clock time it's due, for scheduling
+    uint64_t DueBootMs() const { return m_dueBootMs; }
+
+private:
+    int64_t m_wallMs = 0;
+    uint64_t m_dueBootMs = 0;
+};
+
+enum class ClockEvent {
+    None,
+    WallJump,       // Wall clock moved relative to the monotonic clocks
+    Resumed,        // A suspend gap: boot clock advanced, active clock didn't
+};
+
+// Compares successive clock samples. Between two observations every clock
+// should advance by the same amount; when they don't, either the wall clock
+// was set or the machine slept. Either way anchored deadlines may be stale
+// and the server data certainly is.
+class ClockMonitor {
+public:
+    uint32_t jumpToleranceMs = 5000;
+    uint32_t suspendThresholdMs = 10000;
+
+    ClockEvent Observe(const ClockSample& now);
+
+    // Signed size of the last wall jump (positive = clock moved forward)
+    int64_t LastJumpMs() const { return m_lastJumpMs; }
+
+private:
+    ClockSample m_last;
+    bool m_haveLast = false;
+    int64_t m_lastJumpMs = 0;
+};
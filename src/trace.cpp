@@ -0,0 +1,174 @@
+#include "trace.h"
+#include "file_util.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceRecord {
+    uint64_t timeNs;
+    uint32_t arg;
+    uint16_t event;
+    uint8_t phase;
+    uint8_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord should stay one quarter of a cache line");
+
+constexpr size_t RING_SIZE = 4096;      // Power of two; 64 KB per thread
+constexpr size_t RING_MASK = RING_SIZE - 1;
+
+// Single writer (the owning thread), any number of snapshot readers. The
+// writer fills a slot and then publishes it by bumping head with release
+// order; readers re-check head after copying to discard overwritten slots.
+struct TraceRing {
+    std::atomic<uint64_t> head{ 0 };
+    std::atomic<bool> inUse{ true };
+    std::atomic<const char*> name{ nullptr };
+    uint32_t lane = 0;
+    TraceRecord records[RING_SIZE];
+};
+
+const char* const EVENT_NAMES[] = {
+    "Refresh",
+    "HTTP connect",
+    "HTTP send",
+    "HTTP receive",
+    "HTTP status",
+    "HTTP read",
+    "Parse",
+    "Paint",
+    "Config save",
+    "History save",
+    "Log scan",
+    "Timer fire",
+};
+static_assert(sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) == (size_t)TraceEvent::Count,
+              "EVENT_NAMES out of step with TraceEvent");
+
+std::mutex g_ringsLock;
+std::vector<std::unique_ptr<TraceRing>> g_rings;
+
+TraceRing* AcquireRing() {
+    std::lock_guard<std::mutex> guard(g_ringsLock);
+    for (auto& ring : g_rings) {
+        bool free = false;
+        if (ring->inUse.compare_exchange_strong(free, true)) return ring.get();
+    }
+    g_rings.emplace_back(new TraceRing());
+    g_rings.back()->lane = (uint32_t)g_rings.size();
+    return g_rings.back().get();
+}
+
+// Hands the ring back when the thread exits; its events stay for export
+struct RingHolder {
+    TraceRing* ring = nullptr;
+    ~RingHolder() {
+        if (ring) ring->inUse.store(false);
+    }
+};
+
+thread_local RingHolder t_ring;
+
+uint64_t NowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AppendEscaped(std::string& out, const char* s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') out += '\\';
+        if ((unsigned char)*s >= 0x20) out += *s;
+    }
+}
+
+} // namespace
+
+void TraceEmit(TraceEvent event, TracePhase phase, uint32_t arg) {
+    TraceRing* ring = t_ring.ring;
+    if (!ring) ring = t_ring.ring = AcquireRing();
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceRecord& r = ring->records[head & RING_MASK];
+    r.timeNs = NowNs();
+    r.arg = arg;
+    r.event = (uint16_t)event;
+    r.phase = (uint8_t)phase;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void TraceSetThreadName(const char* name) {
+    if (!t_ring.ring) t_ring.ring = AcquireRing();
+    t_ring.ring->name.store(name, std::memory_order_relaxed);
+}
+
+std::string TraceExportJson() {
+    struct Lane {
+        uint32_t id;
+        const char* name;
+        std::vector<TraceRecord> records;
+    };
+    std::vector<Lane> lanes;
+
+    {
+        std::lock_guard<std::mutex> guard(g_ringsLock);
+        for (auto& ring : g_rings) {
+            Lane lane = { ring->lane, ring->name.load(std::memory_order_relaxed), {} };
+
+            uint64_t before = ring->head.load(std::memory_order_acquire);
+            std::vector<TraceRecord> copy(ring->records, ring->records + RING_SIZE);
+            uint64_t after = ring->head.load(std::memory_order_acquire);
+
+            // Slots the writer reached during the copy (plus the one it may be
+            // in the middle of) can't be trusted
+            uint64_t first = after >= RING_SIZE ? after - RING_SIZE + 1 : 0;
+            for (uint64_t i = first; i < before; i++) {
+                lane.records.push_back(copy[i & RING_MASK]);
+            }
+            lanes.push_back(std::move(lane));
+        }
+    }
+
+    uint64_t origin = UINT64_MAX;
+    for (const Lane& lane : lanes) {
+        if (!lane.records.empty() && lane.records.front().timeNs < origin) origin = lane.records.front().timeNs;
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char buf[256];
+    for (const Lane& lane : lanes) {
+        if (lane.name) {
+            out += first ? "" : ",";
+            first = false;
+            snprintf(buf, sizeof(buf),
+                     "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", lane.id);
+            out += buf;
+            AppendEscaped(out, lane.name);
+            out += "\"}}";
+        }
+
+        for (const TraceRecord& r : lane.records) {
+            if (r.event >= (uint16_t)TraceEvent::Count) continue;
+            static const char PHASES[] = { 'B', 'E', 'i' };
+            uint64_t ns = r.timeNs - origin;
+            snprintf(buf, sizeof(buf),
+                     "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%u%s,\"args\":{\"arg\":%u}}",
+                     first ? "" : ",", EVENT_NAMES[r.event], PHASES[r.phase % 3],
+                     (unsigned long long)(ns / 1000), (unsigned)(ns % 1000), lane.id,
+                     r.phase == (uint8_t)TracePhase::Instant ? ",\"s\":\"t\"" : "", r.arg);
+            out += buf;
+            first = false;
+        }
+    }
+    out += "]}\n";
+    return out;
+}
+
+bool TraceWriteFile(const std::filesystem::path& path) {
+    std::string json = TraceExportJson();
+    return WriteFileAtomic(path, std::vector<uint8_t>(json.begin(), json.end()));
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+// What happened. Names for the Chrome export live in trace.cpp; keep the two
+// in step.
+enum class TraceEvent : uint16_t {
+    Refresh,        // arg: flight generation
+    HttpConnect,
+    HttpSend,
+    HttpReceive,
+    HttpStatus,     // instant, arg: status code
+    HttpRead,       // arg: body bytes
+    Parse,
+    Paint,
+    ConfigSave,
+    HistorySave,
+    LogScan,        // arg: files tracked
+    TimerFire,      // instant, arg: scheduler task id
+    Count
+};
+
+enum class TracePhase : uint8_t {
+    Begin,
+    End,
+    Instant,
+};
+
+// Always-on event tracing. Each thread writes fixed-size records into its
+// own ring (no locks, no allocation after the thread's first event); when a
+// ring wraps, the oldest events go. Rings of exited threads are handed to
+// the next new thread, so short-lived refresh workers share one lane and
+// memory stays bounded. Timestamps are steady_clock nanoseconds.
+void TraceEmit(TraceEvent event, TracePhase phase, uint32_t arg = 0);
+
+inline void TraceInstant(TraceEvent event, uint32_t arg = 0) {
+    TraceEmit(event, TracePhase::Instant, arg);
+}
+
+// Label this thread's lane in the export (string literal, kept by pointer)
+void TraceSetThreadName(const char* name);
+
+// Begin on construction, End (with an optional result arg) on destruction.
+// Next() closes the current phase and opens another, for sequential phases
+// of one operation with early returns in between.
+class TraceSpan {
+public:
+    explicit TraceSpan(TraceEvent event, uint32_t arg = 0) : m_event(event), m_endArg(0) {
+        TraceEmit(event, TracePhase::Begin, arg);
+    }
+    ~TraceSpan() { TraceEmit(m_event, TracePhase::End, m_endArg); }
+
+    void SetResult(uint32_t arg) { m_endArg = arg; }
+
+    void Next(TraceEvent event, uint32_t arg = 0) {
+        TraceEmit(m_event, TracePhase::End, m_endArg);
+        m_event = event;
+        m_endArg = 0;
+        TraceEmit(event, TracePhase::Begin, arg);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    TraceEvent m_event;
+    uint32_t m_endArg;
+};
+
+// Snapshot every ring as Chrome trace_event JSON (chrome://tracing, Perfetto).
+// Safe to call from any thread while others keep tracing; events overwritten
+// mid-copy are dropped rather than shown torn.
+std::string TraceExportJson();
+bool TraceWriteFile(const std::filesystem::path& path);
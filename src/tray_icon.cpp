@@ -0,0 +1,83 @@
+#include "tray_icon.h"
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+static const uint32_t DISC_COLOR = 0x1E1E23;   // Matches the widget background
+static const uint32_t TRACK_COLOR = 0x3C3C41;
+
+IconImage RenderUsageIcon(int percent, int size, uint32_t color) {
+    if (percent < 0) percent = 0;
+    if (percent > 100) percent = 100;
+
+    IconImage img;
+    img.size = size;
+    img.pixels.assign((size_t)size * size, 0);
+
+    double center = size / 2.0;
+    double outer = size / 2.0 - 0.5;
+    double inner = outer * 0.55;
+    double sweep = 2.0 * PI * percent / 100.0;
+
+    const int ss = 4;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            double r = 0, g = 0, b = 0;
+            int covered = 0;
+
+            for (int sy = 0; sy < ss; sy++) {
+                for (int sx = 0; sx < ss; sx++) {
+                    double dx = x + (sx + 0.5) / ss - center;
+                    double dy = y + (sy + 0.5) / ss - center;
+                    double dist = std::sqrt(dx * dx + dy * dy);
+                    if (dist > outer) continue;
+
+                    uint32_t c = DISC_COLOR;
+                    if (dist >= inner) {
+                        // Angle clockwise from 12 o'clock, 0..2pi
+                        double angle = std::atan2(dx, -dy);
+                        if (angle < 0) angle += 2.0 * PI;
+                        c = angle < sweep ? color : TRACK_COLOR;
+                    }
+                    r += (c >> 16) & 0xFF;
+                    g += (c >> 8) & 0xFF;
+                    b += c & 0xFF;
+                    covered++;
+                }
+            }
+
+            if (covered == 0) continue;
+            uint32_t a = (uint32_t)(covered * 255 / (ss * ss));
+            uint32_t pr = (uint32_t)(r / covered + 0.5);
+            uint32_t pg = (uint32_t)(g / covered + 0.5);
+            uint32_t pb = (uint32_t)(b / covered + 0.5);
+            img.pixels[(size_t)y * size + x] = (a << 24) | (pr << 16) | (pg << 8) | pb;
+        }
+    }
+    return img;
+}
+
+UsageIconCache::UsageIconCache(int size, CreateFn create, DestroyFn destroy)
+    : m_size(size), m_create(std::move(create)), m_destroy(std::move(destroy)) {}
+
+UsageIconCache::~UsageIconCache() {
+    Clear();
+}
+
+void* UsageIconCache::Get(int percent, uint32_t color) {
+    if (percent < 0) percent = 0;
+    if (percent > 100) percent = 100;
+
+    uint32_t key = ((color & 0xFFFFFF) << 8) | (uint32_t)percent;
+    auto it = m_icons.find(key);
+    if (it != m_icons.end()) return it->second;
+
+    void* handle = m_create(RenderUsageIcon(percent, m_size, color));
+    if (handle) m_icons[key] = handle;
+    return handle;
+}
+
+void UsageIconCache::Clear() {
+    for (auto& entry : m_icons) m_destroy(entry.second);
+    m_icons.clear();
+}
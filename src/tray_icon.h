@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+// Square BGRA image with straight (non-premultiplied) alpha, rows top-down
+struct IconImage {
+    int size = 0;
+    std::vector<uint32_t> pixels;
+};
+
+// Tray icon for a utilization: dark disc, grey track ring and an arc from
+// 12 o'clock clockwise covering `percent` of the ring in `color` (0xRRGGBB).
+// Anti-aliased by 4x4 supersampling.
+IconImage RenderUsageIcon(int percent, int size, uint32_t color);
+
+// Memoized platform icon handles of one size keyed by (percent, color), so a
+// tray update is a lookup and a handle swap. The color band is a function of
+// the percentage, but keying on the color keeps "no data" grey icons apart.
+class UsageIconCache {
+public:
+    typedef std::function<void*(const IconImage&)> CreateFn;
+    typedef std::function<void(void*)> DestroyFn;
+
+    UsageIconCache(int size, CreateFn create, DestroyFn destroy);
+    ~UsageIconCache();
+
+    void* Get(int percent, uint32_t color);
+
+    // Drop every handle
+    void Clear();
+
+    size_t Count() const { return m_icons.size(); }
+
+private:
+    int m_size;
+    CreateFn m_create;
+    DestroyFn m_destroy;
+    std::map<uint32_t, void*> m_icons;
+};
@@ -1,8 +1,75 @@
 #include "ui.h"
 #include <string>
+#include <vector>
+#include <cmath>
 
 using namespace Gdiplus;
 
+static const wchar_t* SMALL_FONT_FACE = L"Segoe UI";
+static const float SMALL_FONT_SIZE = 9.0f;
+
+// Everything the bars and footer ever print in the small font
+static const wchar_t* ATLAS_GLYPHS = L"0123456789%hmd :-.~";
+static const wchar_t* ATLAS_LABELS[] = {
+    L"5 Hour", L"Weekly", L"Updated ", L"Resets in ", L"Resetting...", L"Offline", L"Demo mode"
+};
+
+// Typographic format (no GDI+ padding) that still counts trailing spaces
+static void GetAtlasFormat(StringFormat& sf) {
+    sf.SetFormatFlags(StringFormat::GenericTypographic()->GetFormatFlags() |
+                      StringFormatFlagsMeasureTrailingSpaces);
+    sf.SetTrimming(StringTrimmingNone);
+}
+
+static float MeasureAdvance(Font* font, int dpi, const std::wstring& text) {
+    Bitmap bmp(1, 1, PixelFormat32bppARGB);
+    bmp.SetResolution((REAL)dpi, (REAL)dpi);
+    Graphics g(&bmp);
+    g.SetTextRenderingHint(TextRenderingHintAntiAliasGridFit);
+
+    StringFormat sf(StringFormat::GenericTypographic());
+    GetAtlasFormat(sf);
+    RectF bounds;
+    g.MeasureString(text.c_str(), (INT)text.size(), font, PointF(0, 0), &sf, &bounds);
+    return bounds.Width;
+}
+
+static bool RasterizeText(Font* font, int dpi, const std::wstring& text, GlyphBitmap& out) {
+    const int pad = 2;  // Room for overhang either side of the advance box
+
+    out.advance = MeasureAdvance(font, dpi, text);
+    out.width = (int)std::ceil(out.advance) + pad * 2;
+    out.height = (int)std::ceil(font->GetHeight((REAL)dpi));
+    out.offsetX = -pad;
+
+    Bitmap bmp(out.width, out.height, PixelFormat32bppARGB);
+    bmp.SetResolution((REAL)dpi, (REAL)dpi);
+    {
+        Graphics g(&bmp);
+        g.SetTextRenderingHint(TextRenderingHintAntiAliasGridFit);
+        g.Clear(Color(0, 0, 0, 0));
+
+        StringFormat sf(StringFormat::GenericTypographic());
+        GetAtlasFormat(sf);
+        SolidBrush white(Color(255, 255, 255, 255));
+        g.DrawString(text.c_str(), (INT)text.size(), font, PointF((REAL)pad, 0), &sf, &white);
+    }
+
+    // White text on transparent: alpha is the coverage
+    Rect rect(0, 0, out.width, out.height);
+    BitmapData data;
+    if (bmp.LockBits(&rect, ImageLockModeRead, PixelFormat32bppARGB, &data) != Ok) return false;
+    out.alpha.resize((size_t)out.width * out.height);
+    for (int y = 0; y < out.height; y++) {
+        const UINT32* row = (const UINT32*)((const BYTE*)data.Scan0 + y * data.Stride);
+        for (int x = 0; x < out.width; x++) {
+            out.alpha[(size_t)y * out.width + x] = (uint8_t)(row[x] >> 24);
+        }
+    }
+    bmp.UnlockBits(&data);
+    return true;
+}
+
 WidgetUI::WidgetUI() {}
 
 WidgetUI::~WidgetUI() {
@@ -15,13 +82,17 @@ bool WidgetUI::Init() {
         return false;
     }
 
-    m_fontSmall = new Font(L"Segoe UI", 9);
+    m_fontSmall = new Font(SMALL_FONT_FACE, SMALL_FONT_SIZE);
     m_fontNormal = new Font(L"Segoe UI", 10);
 
     return true;
 }
 
 void WidgetUI::Shutdown() {
+    // Atlases were rasterized from these fonts
+    m_atlasCache.Clear();
+    m_atlas = nullptr;
+
     delete m_fontSmall;
     delete m_fontNormal;
     m_fontSmall = nullptr;
@@ -33,14 +104,94 @@ void WidgetUI::Shutdown() {
     }
 }
 
+void WidgetUI::PrepareTextAtlas(HDC hdc, int width, int height) {
+    m_atlas = nullptr;
+    m_pixels = nullptr;
+
+    // Only a top-down 32bpp DIB gives us pixels we can blit into directly
+    DIBSECTION dib;
+    HGDIOBJ bmp = GetCurrentObject(hdc, OBJ_BITMAP);
+    if (!bmp || GetObject(bmp, sizeof(dib), &dib) != sizeof(dib)) return;
+    if (dib.dsBm.bmBitsPixel != 32 || !dib.dsBm.bmBits || dib.dsBmih.biHeight >= 0) return;
+
+    int dpi = GetDeviceCaps(hdc, LOGPIXELSY);
+    GlyphAtlas& atlas = m_atlasCache.Get(SMALL_FONT_FACE, SMALL_FONT_SIZE, dpi);
+    if (!atlas.IsBuilt()) {
+        std::vector<std::wstring> labels(std::begin(ATLAS_LABELS), std::end(ATLAS_LABELS));
+        Font* font = m_fontSmall;
+        bool built = atlas.Build(ATLAS_GLYPHS, labels,
+            [font, dpi](const std::wstring& text, GlyphBitmap& out) { return RasterizeText(font, dpi, text, out); },
+            [font, dpi](const std::wstring& text) { return MeasureAdvance(font, dpi, text); });
+        if (!built) return;
+    }
+
+    m_atlas = &atlas;
+    m_pixels = (uint32_t*)dib.dsBm.bmBits;
+    m_stride = dib.dsBm.bmWidthBytes;
+    m_surfaceWidth = width;
+    m_surfaceHeight = height;
+}
+
+void WidgetUI::DrawSmallText(Graphics& g, const wchar_t* text, const RectF& rect,
+                             StringAlignment align, StringAlignment lineAlign, const Color& color) {
+    if (m_atlas) {
+        int textWidth = m_atlas->Measure(text);
+        if (textWidth >= 0) {
+            float x = rect.X;
+            if (align == StringAlignmentFar) x = rect.X + rect.Width - textWidth;
+            else if (align == StringAlignmentCenter) x = rect.X + (rect.Width - textWidth) / 2;
+            float y = rect.Y;
+            if (lineAlign == StringAlignmentCenter) y = rect.Y + (rect.Height - m_atlas->LineHeight()) / 2;
+
+            // GDI+ may still be holding fills for these pixels
+            g.Flush(FlushIntentionSync);
+            GdiFlush();
+            m_atlas->Draw(m_pixels, m_stride, m_surfaceWidth, m_surfaceHeight,
+                          (int)std::lround(x), (int)std::lround(y), text,
+                          ((uint32_t)color.GetR() << 16) | ((uint32_t)color.GetG() << 8) | color.GetB());
+            return;
+        }
+    }
+
+    // Not in the atlas (or no DIB) - full layout
+    SolidBrush brush(color);
+    StringFormat sf;
+    sf.SetAlignment(align);
+    sf.SetLineAlignment(lineAlign);
+    g.DrawString(text, -1, m_fontSmall, rect, &sf, &brush);
+}
+
 COLORREF WidgetUI::GetBarColor(float percent) {
     if (percent >= 80.0f) return RGB(220, 53, 69);   // Red
     if (percent >= 50.0f) return RGB(255, 193, 7);   // Yellow
     return RGB(40, 167, 69);                          // Green
 }
 
+void WidgetUI::DrawSparkline(Graphics& g, int x, int y, int w, int h, const Sparkline& trend) {
+    // Each column is a vertical min..max stroke; consecutive columns are joined
+    // across gaps so sparse polling still reads as a line
+    int n = trend.Buckets();
+    float top = (float)y + 2;
+    float span = (float)h - 4;
+
+    std::vector<PointF> points;
+    points.reserve(n * 2);
+    for (int i = 0; i < n; i++) {
+        float lo, hi;
+        if (!trend.Get(i, lo, hi)) continue;
+        float px = (float)x + (float)i * w / n;
+        points.push_back(PointF(px, top + span * (1.0f - hi / 100.0f)));
+        points.push_back(PointF(px, top + span * (1.0f - lo / 100.0f)));
+    }
+    if (points.size() < 2) return;
+
+    Pen trendPen(Color(90, 255, 255, 255), 1);
+    g.DrawLines(&trendPen, points.data(), (INT)points.size());
+}
+
 void WidgetUI::DrawProgressBar(Graphics& g, int x, int y, int w, int h,
-                                float percent, const wchar_t* label, int used, int limit) {
+                                float percent, const wchar_t* label, int used, int limit,
+                                bool estimated, const Sparkline* trend) {
     // Background
     SolidBrush bgBrush(Color(40, 40, 45));
     g.FillRectangle(&bgBrush, x, y, w, h);
@@ -55,33 +206,36 @@ void WidgetUI::DrawProgressBar(Graphics& g, int x, int y, int w, int h,
         g.FillRectangle(&fillBrush, x, y, fillW, h);
     }
 
+    // Trend behind the text
+    if (trend) {
+        DrawSparkline(g, x, y, w, h, *trend);
+    }
+
     // Border
     Pen borderPen(Color(60, 60, 65), 1);
     g.DrawRectangle(&borderPen, x, y, w, h);
 
     // Label on left
-    SolidBrush textBrush(Color(220, 220, 220));
-    StringFormat sf;
-    sf.SetAlignment(StringAlignmentNear);
-    sf.SetLineAlignment(StringAlignmentCenter);
-
+    Color textColor(220, 220, 220);
     RectF labelRect((float)x + 6, (float)y, (float)w / 2, (float)h);
-    g.DrawString(label, -1, m_fontSmall, labelRect, &sf, &textBrush);
+    DrawSmallText(g, label, labelRect, StringAlignmentNear, StringAlignmentCenter, textColor);
 
     // Percentage on right
     wchar_t numBuf[32];
     if (percent > 0 || limit > 0) {
-        swprintf_s(numBuf, L"%.0f%%", percent);
+        swprintf_s(numBuf, estimated ? L"~%.0f%%" : L"%.0f%%", percent);
     } else {
         swprintf_s(numBuf, L"--");
     }
 
-    sf.SetAlignment(StringAlignmentFar);
     RectF numRect((float)x + w / 2, (float)y, (float)w / 2 - 6, (float)h);
-    g.DrawString(numBuf, -1, m_fontSmall, numRect, &sf, &textBrush);
+    DrawSmallText(g, numBuf, numRect, StringAlignmentFar, StringAlignmentCenter, textColor);
 }
 
-void WidgetUI::Render(HDC hdc, int width, int height, const UsageData& data, bool offline, const wchar_t* lastUpdate) {
+void WidgetUI::Render(HDC hdc, int width, int height, const UsageData& data, bool offline, const wchar_t* lastUpdate,
+                      const Sparkline* sessionTrend, const Sparkline* periodTrend) {
+    PrepareTextAtlas(hdc, width, height);
+
     Graphics g(hdc);
     g.SetSmoothingMode(SmoothingModeAntiAlias);
     g.SetTextRenderingHint(TextRenderingHintClearTypeGridFit);
@@ -122,30 +276,29 @@ void WidgetUI::Render(HDC hdc, int width, int height, const UsageData& data, boo
 
     // Session bar (5-hour limit)
     DrawProgressBar(g, margin, margin, barWidth, barHeight,
-                    data.SessionPercent(), L"5 Hour", data.sessionUsed, data.sessionLimit);
+                    data.SessionPercent(), L"5 Hour", data.sessionUsed, data.sessionLimit,
+                    data.estimated, sessionTrend);
 
     // Period bar
     std::wstring periodLabel = data.periodLabel;
     DrawProgressBar(g, margin, margin + barHeight + 6, barWidth, barHeight,
-                    data.PeriodPercent(), periodLabel.c_str(), data.periodUsed, data.periodLimit);
+                    data.PeriodPercent(), periodLabel.c_str(), data.periodUsed, data.periodLimit,
+                    data.estimated, periodTrend);
 
     // Footer text
-    SolidBrush footerBrush(Color(120, 120, 125));
-    StringFormat sfLeft, sfRight;
-    sfLeft.SetAlignment(StringAlignmentNear);
-    sfRight.SetAlignment(StringAlignmentFar);
+    Color footerColor(120, 120, 125);
 
     int footerY = margin + (barHeight + 6) * 2 + 4;
 
     // Last update on left
     std::wstring updateText = offline ? L"Offline" : (lastUpdate ? lastUpdate : L"");
     RectF leftRect((float)margin, (float)footerY, (float)barWidth / 2, 16);
-    g.DrawString(updateText.c_str(), -1, m_fontSmall, leftRect, &sfLeft, &footerBrush);
+    DrawSmallText(g, updateText.c_str(), leftRect, StringAlignmentNear, StringAlignmentNear, footerColor);
 
     // Reset time on right
     if (!data.resetText.empty()) {
         RectF rightRect((float)width / 2, (float)footerY, (float)barWidth / 2, 16);
-        g.DrawString(data.resetText.c_str(), -1, m_fontSmall, rightRect, &sfRight, &footerBrush);
+        DrawSmallText(g, data.resetText.c_str(), rightRect, StringAlignmentFar, StringAlignmentNear, footerColor);
     }
 
     // Offline indicator
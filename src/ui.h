@@ -4,6 +4,8 @@
 #include <objidl.h>
 #include <gdiplus.h>
 #include "parser.h"
+#include "sparkline.h"
+#include "glyph_atlas.h"
 
 #pragma comment(lib, "gdiplus.lib")
 
@@ -15,7 +17,8 @@ public:
     bool Init();
     void Shutdown();
 
-    void Render(HDC hdc, int width, int height, const UsageData& data, bool offline, const wchar_t* lastUpdate);
+    void Render(HDC hdc, int width, int height, const UsageData& data, bool offline, const wchar_t* lastUpdate,
+                const Sparkline* sessionTrend = nullptr, const Sparkline* periodTrend = nullptr);
 
     // Colors based on usage percentage
     static COLORREF GetBarColor(float percent);
@@ -25,10 +28,29 @@ private:
     Gdiplus::Font* m_fontSmall = nullptr;
     Gdiplus::Font* m_fontNormal = nullptr;
 
+    // Small-font text is blitted from a pre-rasterized atlas straight into the
+    // back buffer's DIB bits when Render() gets a top-down 32bpp DIB
+    GlyphAtlasCache m_atlasCache;
+    const GlyphAtlas* m_atlas = nullptr;
+    uint32_t* m_pixels = nullptr;
+    int m_stride = 0;
+    int m_surfaceWidth = 0;
+    int m_surfaceHeight = 0;
+
+    void PrepareTextAtlas(HDC hdc, int width, int height);
+    void DrawSmallText(Gdiplus::Graphics& g, const wchar_t* text, const Gdiplus::RectF& rect,
+                       Gdiplus::StringAlignment align, Gdiplus::StringAlignment lineAlign,
+                       const Gdiplus::Color& color);
     void DrawProgressBar(Gdiplus::Graphics& g, int x, int y, int w, int h,
-                         float percent, const wchar_t* label, int used, int limit);
+                         float percent, const wchar_t* label, int used, int limit,
+                         bool estimated, const Sparkline* trend);
+    void DrawSparkline(Gdiplus::Graphics& g, int x, int y, int w, int h, const Sparkline& trend);
 };
 
 // Widget window dimensions
 constexpr int WIDGET_WIDTH = 260;
 constexpr int WIDGET_HEIGHT = 95;
+
+// Progress bars span the widget minus a 10px margin each side; sparklines get
+// one bucket per pixel column
+constexpr int SPARKLINE_COLUMNS = WIDGET_WIDTH - 20;
@@ -0,0 +1,227 @@
+#include "watchdog.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+StallMonitor::StallMonitor() {}
+
+StallMonitor::~StallMonitor() {
+    Stop();
+}
+
+uint64_t StallMonitor::NowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool StallMonitor::Start(std::function<void()> postPing) {
+    Stop();
+    m_postPing = std::move(postPing);
+    m_stop = false;
+    m_idle.store(false);
+    m_thread = std::thread(&StallMonitor::WatchdogLoop, this);
+    return true;
+}
+
+void StallMonitor::Stop() {
+    if (!m_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void StallMonitor::SetPaused(bool paused) {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (m_paused == paused) return;
+        m_paused = paused;
+    }
+    if (paused) {
+        m_pingSentNs.store(0, std::memory_order_relaxed);
+    } else {
+        m_wake.notify_all();
+    }
+}
+
+void StallMonitor::WatchdogLoop() {
+    std::unique_lock<std::mutex> guard(m_lock);
+    uint64_t thresholdNs = (uint64_t)stallThresholdMs * 1000000;
+    uint64_t intervalNs = (uint64_t)pingIntervalMs * 1000000;
+
+    // Wake a few times per ping interval so an overrunning handler is
+    // sampled while it's still running
+    std::chrono::milliseconds tick(std::max<uint32_t>(stallThresholdMs / 2, 10));
+    uint64_t nextPingNs = NowNs();
+    uint64_t pinged = m_dispatches.load();      // Dispatch count at the last ping
+    uint64_t seen = pinged;                     // ... and at the last sign of life
+    uint64_t lastActiveNs = nextPingNs;
+
+    while (!m_stop) {
+        if (m_paused) {
+            m_wake.wait(guard, [this]() { return m_stop || !m_paused; });
+            lastActiveNs = NowNs();
+            continue;
+        }
+        m_wake.wait_for(guard, tick);
+        if (m_stop) break;
+        uint64_t now = NowNs();
+
+        uint64_t started = m_dispatchStartNs.load(std::memory_order_relaxed);
+        if (started != 0 && now - started > thresholdNs) {
+            const char* label = m_label.load(std::memory_order_relaxed);
+            if (label) m_sampledLabel.store(label, std::memory_order_relaxed);
+        }
+
+        // One ping in flight at a time, and only into a loop that's doing
+        // something; a late one is measured when it lands
+        uint64_t dispatches = m_dispatches.load(std::memory_order_relaxed);
+        bool pingOut = m_pingSentNs.load(std::memory_order_relaxed) != 0;
+        if (now >= nextPingNs && !pingOut && dispatches != pinged) {
+            m_pingSentNs.store(now, std::memory_order_relaxed);
+            nextPingNs = now + intervalNs;
+            pinged = dispatches;
+            pingOut = true;
+            if (m_postPing) m_postPing();
+        }
+
+        if (started != 0 || pingOut || dispatches != seen) {
+            seen = dispatches;
+            lastActiveNs = now;
+            continue;
+        }
+        if (now - lastActiveNs < intervalNs) continue;
+
+        // Quiet for a whole interval: sleep until BeginDispatch wakes us.
+        // Announce it first, then look once more, so a dispatch starting in
+        // between either sees m_idle or is seen here.
+        m_idle.store(true);
+        if (m_dispatchStartNs.load() == 0 && m_dispatches.load() == seen) {
+            m_wake.wait(guard, [this]() { return m_stop || m_paused || !m_idle.load(); });
+        }
+        m_idle.store(false);
+        lastActiveNs = NowNs();
+    }
+}
+
+void StallMonitor::BeginDispatch(uint32_t message) {
+    m_dispatchMessage = message;
+    m_dispatching = true;
+    m_lastPushed = nullptr;
+    m_pingDispatch = false;
+    m_sampledLabel.store(nullptr, std::memory_order_relaxed);
+    m_dispatchStartNs.store(NowNs());
+    if (m_idle.load()) {
+        // First message after a quiet spell; rare, so the lock is fine
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_idle.store(false);
+        m_wake.notify_all();
+    }
+}
+
+void StallMonitor::FinishSegment(uint64_t nowNs) {
+    uint64_t started = m_dispatchStartNs.exchange(0, std::memory_order_relaxed);
+    if (started == 0) return;
+    uint64_t elapsed = nowNs - started;
+
+    if (DispatchStats* stats = Slot(m_dispatchMessage)) {
+        stats->count++;
+        stats->totalNs += elapsed;
+        stats->maxNs = std::max(stats->maxNs, elapsed);
+    } else {
+        m_untracked++;
+    }
+
+    if (elapsed > (uint64_t)stallThresholdMs * 1000000) {
+        // Prefer what the watchdog saw running over the last scope entered
+        const char* label = m_sampledLabel.load(std::memory_order_relaxed);
+        if (!label) label = m_lastPushed;
+        Record(m_dispatchMessage, label, elapsed);
+        m_lastStallEndNs = nowNs;
+    }
+}
+
+void StallMonitor::EndDispatch() {
+    FinishSegment(NowNs());
+    m_dispatching = false;
+    if (!m_pingDispatch) m_dispatches.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StallMonitor::BeginModal() {
+    FinishSegment(NowNs());
+}
+
+void StallMonitor::EndModal() {
+    if (m_dispatching) {
+        m_lastPushed = nullptr;
+        m_sampledLabel.store(nullptr, std::memory_order_relaxed);
+        m_dispatchStartNs.store(NowNs(), std::memory_order_relaxed);
+    }
+}
+
+void StallMonitor::OnPing() {
+    m_pingDispatch = true;
+    uint64_t sent = m_pingSentNs.load(std::memory_order_relaxed);
+    if (sent == 0) return;
+    uint64_t now = NowNs();
+    uint64_t latency = now - sent;
+    m_pingSentNs.store(0, std::memory_order_relaxed);
+
+    m_pings++;
+    m_pingTotalNs += latency;
+    m_pingMaxNs = std::max(m_pingMaxNs, latency);
+
+    // Late with no slow handler to blame: the loop itself was blocked
+    // (a flood of small messages, a modal loop that doesn't pump, ...)
+    if (latency > (uint64_t)stallThresholdMs * 1000000 && m_lastStallEndNs < sent) {
+        Record(0, nullptr, latency);
+        m_lastStallEndNs = now;
+    }
+}
+
+void StallMonitor::Record(uint32_t message, const char* label, uint64_t durationNs) {
+    StallRecord& r = m_ring[m_stallTotal % RING_SIZE];
+    r.wallSec = (int64_t)std::time(nullptr);
+    r.message = message;
+    r.label = label;
+    r.durationMs = (uint32_t)std::min<uint64_t>(durationNs / 1000000, UINT32_MAX);
+    m_stallTotal++;
+}
+
+DispatchStats* StallMonitor::Slot(uint32_t message) {
+    // Open addressing; a loop only ever sees a few dozen distinct messages.
+    // When full, the rest go uncounted rather than into someone else's row.
+    size_t i = (message * 2654435761u) % STATS_SLOTS;
+    for (size_t probe = 0; probe < STATS_SLOTS; probe++) {
+        DispatchStats& s = m_stats[i];
+        if (s.message == message && s.count != 0) return &s;
+        if (s.count == 0) {
+            s.message = message;
+            return &s;
+        }
+        i = (i + 1) % STATS_SLOTS;
+    }
+    return nullptr;
+}
+
+std::vector<StallRecord> StallMonitor::Stalls() const {
+    std::vector<StallRecord> out;
+    uint64_t first = m_stallTotal > RING_SIZE ? m_stallTotal - RING_SIZE : 0;
+    for (uint64_t i = first; i < m_stallTotal; i++) {
+        out.push_back(m_ring[i % RING_SIZE]);
+    }
+    return out;
+}
+
+std::vector<DispatchStats> StallMonitor::SlowestHandlers(size_t limit) const {
+    std::vector<DispatchStats> out;
+    for (const DispatchStats& s : m_stats) {
+        if (s.count) out.push_back(s);
+    }
+    std::sort(out.begin(), out.end(),
+              [](const DispatchStats& a, const DispatchStats& b) { return a.maxNs > b.maxNs; });
+    if (out.size() > limit) out.resize(limit);
+    return out;
+}
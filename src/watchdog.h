@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One message-loop hiccup: a handler that ran too long, or a ping that sat
+// in the queue too long without any single handler to blame
+struct StallRecord {
+    int64_t wallSec = 0;            // When it ended, Unix seconds
+    uint32_t message = 0;           // Message being dispatched, 0 for a late ping
+    const char* label = nullptr;    // Innermost StallScope seen running, if any
+    uint32_t durationMs = 0;
+};
+
+// Per-message dispatch timing
+struct DispatchStats {
+    uint32_t message = 0;
+    uint64_t count = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+};
+
+// Measures how responsive a single-threaded event loop is. The loop brackets
+// each dispatch with BeginDispatch/EndDispatch (two clock reads and a few
+// relaxed stores) and labels slow work with StallScope. A watchdog thread
+// posts a ping into the loop every pingIntervalMs through postPing; the loop
+// answers with OnPing, giving queueing latency even when no one handler is
+// slow. While a dispatch is overrunning, the watchdog samples the active
+// label, so the record names what was actually running rather than whatever
+// label was set last. Everything but the watchdog thread's sampling happens
+// on the loop thread, so records and stats need no locks.
+//
+// The watchdog only runs while there's something to watch: pings go out
+// only if the loop dispatched something other than a ping since the last
+// one, and once a ping interval passes with nothing dispatched the thread
+// sleeps until the next BeginDispatch. SetPaused() stops it outright.
+class StallMonitor {
+public:
+    uint32_t stallThresholdMs = 200;
+    uint32_t pingIntervalMs = 1000;
+
+    static constexpr size_t RING_SIZE = 64;
+    static constexpr size_t STATS_SLOTS = 64;
+
+    StallMonitor();
+    ~StallMonitor();
+
+    // postPing runs on the watchdog thread and must be thread-safe
+    bool Start(std::function<void()> postPing);
+    void Stop();
+
+    // Nobody is looking (locked, asleep, display off). An outstanding ping
+    // is forgotten so the wait isn't counted as latency.
+    void SetPaused(bool paused);
+
+    // Loop thread
+    void BeginDispatch(uint32_t message);
+    void EndDispatch();
+    void OnPing();
+
+    // A handler entering a modal loop (menu, message box) keeps dispatching
+    // through that loop; its own time up to here counts, the wait doesn't
+    void BeginModal();
+    void EndModal();
+
+    // Innermost label is what a stall gets attributed to; see StallScope
+    const char* PushLabel(const char* label) {
+        m_lastPushed = label;
+        return m_label.exchange(label, std::memory_order_relaxed);
+    }
+    void PopLabel(const char* previous) { m_label.store(previous, std::memory_order_relaxed); }
+
+    // Oldest first
+    std::vector<StallRecord> Stalls() const;
+    uint64_t StallCount() const { return m_stallTotal; }
+
+    // Busiest handlers by worst-case time, at most `limit`
+    std::vector<DispatchStats> SlowestHandlers(size_t limit) const;
+
+    // Dispatches of messages that found the stats table full
+    uint64_t UntrackedDispatches() const { return m_untracked; }
+
+    uint64_t Pings() const { return m_pings; }
+    uint64_t PingAvgUs() const { return m_pings ? m_pingTotalNs / m_pings / 1000 : 0; }
+    uint64_t PingMaxUs() const { return m_pingMaxNs / 1000; }
+
+private:
+    static uint64_t NowNs();
+    void Record(uint32_t message, const char* label, uint64_t durationNs);
+    void FinishSegment(uint64_t nowNs);
+    DispatchStats* Slot(uint32_t message);
+    void WatchdogLoop();
+
+    // Current dispatch, shared with the watchdog
+    std::atomic<uint64_t> m_dispatchStartNs{ 0 };   // 0 = idle
+    std::atomic<const char*> m_label{ nullptr };
+    std::atomic<const char*> m_sampledLabel{ nullptr };
+    uint32_t m_dispatchMessage = 0;
+    bool m_dispatching = false;
+    bool m_pingDispatch = false;            // OnPing ran in this dispatch
+    const char* m_lastPushed = nullptr;     // Scopes close before EndDispatch
+    std::atomic<uint64_t> m_dispatches{ 0 };        // Finished, pings excluded
+    std::atomic<bool> m_idle{ false };              // Watchdog asleep until the next dispatch
+
+    // Ping round trip
+    std::atomic<uint64_t> m_pingSentNs{ 0 };        // 0 = none outstanding
+    uint64_t m_pings = 0;
+    uint64_t m_pingTotalNs = 0;
+    uint64_t m_pingMaxNs = 0;
+    uint64_t m_lastStallEndNs = 0;
+
+    StallRecord m_ring[RING_SIZE];
+    uint64_t m_stallTotal = 0;
+    DispatchStats m_stats[STATS_SLOTS];
+    uint64_t m_untracked = 0;
+
+    std::thread m_thread;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+    bool m_paused = false;
+    std::function<void()> m_postPing;
+};
+
+// Names the work in progress for stall attribution:
+//   StallScope scope(g_stallMonitor, "ConfigManager::Save");
+// Labels must be string literals (they're kept by pointer).
+class StallScope {
+public:
+    StallScope(StallMonitor& monitor, const char* label)
+        : m_monitor(monitor), m_previous(monitor.PushLabel(label)) {}
+    ~StallScope() { m_monitor.PopLabel(m_previous); }
+
+    StallScope(const StallScope&) = delete;
+    StallScope& operator=(const StallScope&) = delete;
+
+private:
+    StallMonitor& m_monitor;
+    const char* m_previous;
+};
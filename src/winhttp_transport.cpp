@@ -0,0 +1,204 @@
+#include "http_client.h"
+#include "trace.h"
+#include <windows.h>
+#include <winhttp.h>
+#include <vector>
+
+#pragma comment(lib, "winhttp.lib")
+
+namespace {
+
+class WinHttpTransport : public HttpTransport {
+public:
+    WinHttpTransport();
+    ~WinHttpTransport() override;
+
+    HttpResponse Send(const wchar_t* verb, const std::wstring& url, const std::wstring& cookie,
+                      const std::string* body, const wchar_t* contentType,
+                      const std::atomic<bool>* cancel) override;
+
+private:
+    HINTERNET m_session;
+};
+
+} // namespace
+
+std::unique_ptr<HttpTransport> CreateWinHttpTransport() {
+    return std::make_unique<WinHttpTransport>();
+}
+
+WinHttpTransport::WinHttpTransport() {
+    m_session = WinHttpOpen(
+        L"ClaudeWatch/1.0",
+        WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+        WINHTTP_NO_PROXY_NAME,
+        WINHTTP_NO_PROXY_BYPASS,
+        0
+    );
+
+    // Bound every phase so a cancelled or hung request can't pin a worker for long
+    if (m_session) {
+        WinHttpSetTimeouts(m_session, 5000, 5000, 10000, 15000);
+    }
+}
+
+WinHttpTransport::~WinHttpTransport() {
+    if (m_session) {
+        WinHttpCloseHandle(m_session);
+    }
+}
+
+static bool IsCancelled(const std::atomic<bool>* cancel) {
+    return cancel && cancel->load();
+}
+
+HttpResponse WinHttpTransport::Send(const wchar_t* verb, const std::wstring& url, const std::wstring& cookie,
+                                    const std::string* body, const wchar_t* contentType,
+                                    const std::atomic<bool>* cancel) {
+    HttpResponse response;
+    response.status = HttpStatus::NetworkError;
+    response.statusCode = 0;
+
+    if (!m_session) {
+        response.error = L"Failed to initialize WinHTTP";
+        return response;
+    }
+
+    // Parse URL
+    URL_COMPONENTS urlComp = { 0 };
+    urlComp.dwStructSize = sizeof(urlComp);
+
+    wchar_t hostName[256] = { 0 };
+    wchar_t urlPath[2048] = { 0 };
+
+    urlComp.lpszHostName = hostName;
+    urlComp.dwHostNameLength = _countof(hostName);
+    urlComp.lpszUrlPath = urlPath;
+    urlComp.dwUrlPathLength = _countof(urlPath);
+
+    if (!WinHttpCrackUrl(url.c_str(), 0, 0, &urlComp)) {
+        response.error = L"Failed to parse URL";
+        return response;
+    }
+
+    // Connect
+    TraceSpan phase(TraceEvent::HttpConnect);
+    HINTERNET hConnect = WinHttpConnect(
+        m_session,
+        hostName,
+        urlComp.nPort,
+        0
+    );
+
+    if (!hConnect) {
+        response.error = L"Failed to connect";
+        return response;
+    }
+
+    // Create request
+    DWORD flags = (urlComp.nScheme == INTERNET_SCHEME_HTTPS) ? WINHTTP_FLAG_SECURE : 0;
+    HINTERNET hRequest = WinHttpOpenRequest(
+        hConnect,
+        verb,
+        urlPath,
+        NULL,
+        WINHTTP_NO_REFERER,
+        WINHTTP_DEFAULT_ACCEPT_TYPES,
+        flags
+    );
+
+    if (!hRequest) {
+        WinHttpCloseHandle(hConnect);
+        response.error = L"Failed to create request";
+        return response;
+    }
+
+    // Add cookie header
+    if (!cookie.empty()) {
+        std::wstring cookieHeader = L"Cookie: sessionKey=" + cookie;
+        WinHttpAddRequestHeaders(hRequest, cookieHeader.c_str(), -1, WINHTTP_ADDREQ_FLAG_ADD);
+    }
+
+    // Send request
+    phase.Next(TraceEvent::HttpSend);
+    std::wstring contentHeader;
+    if (contentType) contentHeader = std::wstring(L"Content-Type: ") + contentType;
+    LPVOID data = body ? (LPVOID)body->data() : WINHTTP_NO_REQUEST_DATA;
+    DWORD dataSize = body ? (DWORD)body->size() : 0;
+    if (!WinHttpSendRequest(hRequest, contentType ? contentHeader.c_str() : WINHTTP_NO_ADDITIONAL_HEADERS,
+                            contentType ? (DWORD)-1L : 0, data, dataSize, dataSize, 0)) {
+        WinHttpCloseHandle(hRequest);
+        WinHttpCloseHandle(hConnect);
+        response.error = L"Failed to send request";
+        return response;
+    }
+
+    // Receive response
+    phase.Next(TraceEvent::HttpReceive);
+    if (IsCancelled(cancel) || !WinHttpReceiveResponse(hRequest, NULL)) {
+        WinHttpCloseHandle(hRequest);
+        WinHttpCloseHandle(hConnect);
+        response.error = L"Failed to receive response";
+        return response;
+    }
+
+    // Get status code
+    DWORD statusCode = 0;
+    DWORD statusCodeSize = sizeof(statusCode);
+    WinHttpQueryHeaders(
+        hRequest,
+        WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+        WINHTTP_HEADER_NAME_BY_INDEX,
+        &statusCode,
+        &statusCodeSize,
+        WINHTTP_NO_HEADER_INDEX
+    );
+    response.statusCode = statusCode;
+    TraceInstant(TraceEvent::HttpStatus, statusCode);
+
+    // Error bodies aren't wanted
+    if (statusCode == 401 || statusCode == 403 || statusCode >= 500) {
+        response.status = HttpStatus::Success;
+        WinHttpCloseHandle(hRequest);
+        WinHttpCloseHandle(hConnect);
+        return response;
+    }
+
+    // Read body
+    phase.Next(TraceEvent::HttpRead);
+    std::vector<char> buffer;
+    DWORD bytesAvailable = 0;
+    DWORD bytesRead = 0;
+
+    do {
+        if (IsCancelled(cancel)) {
+            WinHttpCloseHandle(hRequest);
+            WinHttpCloseHandle(hConnect);
+            response.error = L"Cancelled";
+            return response;
+        }
+
+        bytesAvailable = 0;
+        if (!WinHttpQueryDataAvailable(hRequest, &bytesAvailable)) {
+            break;
+        }
+
+        if (bytesAvailable == 0) {
+            break;
+        }
+
+        std::vector<char> chunk(bytesAvailable + 1);
+        if (WinHttpReadData(hRequest, chunk.data(), bytesAvailable, &bytesRead)) {
+            buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + bytesRead);
+        }
+    } while (bytesAvailable > 0);
+
+    response.body = std::string(buffer.begin(), buffer.end());
+    phase.SetResult((uint32_t)buffer.size());
+    response.status = HttpStatus::Success;
+
+    WinHttpCloseHandle(hRequest);
+    WinHttpCloseHandle(hConnect);
+
+    return response;
+}
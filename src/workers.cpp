@@ -0,0 +1,40 @@
+#include "workers.h"
+#include "trace.h"
+
+void WorkerGroup::Start(const char* name, std::function<void()> job) {
+    Reap();
+    Worker worker;
+    worker.done = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> done = worker.done;
+    worker.thread = std::thread([name, job = std::move(job), done]() {
+        TraceSetThreadName(name);
+        job();
+        done->store(true);
+    });
+    m_workers.push_back(std::move(worker));
+}
+
+void WorkerGroup::JoinAll() {
+    for (Worker& worker : m_workers) worker.thread.join();
+    m_workers.clear();
+}
+
+size_t WorkerGroup::Running() const {
+    size_t running = 0;
+    for (const Worker& worker : m_workers) {
+        if (!worker.done->load()) running++;
+    }
+    return running;
+}
+
+void WorkerGroup::Reap() {
+    for (size_t i = 0; i < m_workers.size();) {
+        if (m_workers[i].done->load()) {
+            m_workers[i].thread.join();
+            m_workers[i] = std::move(m_workers.back());
+            m_workers.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Short-lived background jobs (refresh runs, pushes, probes) that must not
+// outlive the process's globals. Each job gets its own thread; finished ones
+// are joined on the next Start(). At shutdown, cancel what the jobs are
+// waiting on and JoinAll() before returning from main(), so no job is still
+// running when static destructors do. Jobs should own their inputs (copies,
+// shared_ptrs) rather than reach for globals. Owner thread only.
+class WorkerGroup {
+public:
+    ~WorkerGroup() { JoinAll(); }
+
+    // name is a string literal, for the trace lane
+    void Start(const char* name, std::function<void()> job);
+
+    // Wait for every job started so far
+    void JoinAll();
+
+    size_t Running() const;
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    std::vector<Worker> m_workers;
+
+    void Reap();
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+// Just enough of a test harness for the Linux targets: a failed CHECK prints
+// where and what, and the test exits with the number of failures.
+#include <cstdio>
+#include <type_traits>
+
+inline int g_checkFailures = 0;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            g_checkFailures++;                                                  \
+        }                                                                       \
+    } while (0)
+
+// a == b without -Wsign-compare noise: a negative signed value never equals
+// an unsigned one, otherwise both sides compare as unsigned
+template <typename A, typename B>
+inline bool CheckEqual(const A& a, const B& b) {
+    if constexpr (std::is_integral_v<A> && std::is_integral_v<B> && std::is_signed_v<A> != std::is_signed_v<B>) {
+        if constexpr (std::is_signed_v<A>) {
+            return a >= 0 && (std::make_unsigned_t<A>)a == b;
+        } else {
+            return b >= 0 && a == (std::make_unsigned_t<B>)b;
+        }
+    } else {
+        return a == b;
+    }
+}
+
+#define CHECK_EQ(a, b)                                                          \
+    do {                                                                        \
+        auto checkA_ = (a);                                                     \
+        auto checkB_ = (b);                                                     \
+        if (!CheckEqual(checkA_, checkB_)) {                                    \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld vs %lld\n", __FILE__, __LINE__, #a, #b, \
+                    (long long)checkA_, (long long)checkB_);                    \
+            g_checkFailures++;                                                  \
+        }                                                                       \
+    } while (0)
+
+inline int CheckResult() {
+    if (g_checkFailures) fprintf(stderr, "%d check(s) failed\n", g_checkFailures);
+    return g_checkFailures ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+// ActivityPolicy driven by injected events, the way main.cpp feeds it from
+// WTS and power broadcasts
+#include "activity.h"
+#include "check.h"
+
+static void ResumeRefreshesOnce() {
+    ActivityPolicy policy;
+    CHECK(policy.OnTick());
+    CHECK(!policy.OnEvent(ActivityEvent::Suspending));
+    CHECK(policy.IsParked());
+    CHECK_EQ(policy.NextIntervalMs(60000), 0u);
+
+    // One wake delivers RESUMEAUTOMATIC and then RESUMESUSPEND
+    int refreshes = 0;
+    refreshes += policy.OnEvent(ActivityEvent::Resumed);
+    refreshes += policy.OnEvent(ActivityEvent::Resumed);
+    CHECK_EQ(refreshes, 1);
+    CHECK(!policy.IsParked());
+
+    // A stray resume with no suspend before it is not a wake
+    CHECK(!policy.OnEvent(ActivityEvent::Resumed));
+}
+
+static void LockedTicksAreMissedThenMadeUp() {
+    ActivityPolicy policy;
+    policy.OnEvent(ActivityEvent::SessionLocked);
+    CHECK(!policy.OnTick());
+    CHECK(!policy.OnTick());
+    CHECK(policy.OnEvent(ActivityEvent::SessionUnlocked));
+    CHECK(policy.OnTick());
+
+    // Unlock with nothing missed doesn't add a fetch
+    ActivityPolicy quiet;
+    CHECK(!quiet.OnEvent(ActivityEvent::SessionUnlocked));
+}
+
+static void StaysParkedUntilEverythingClears() {
+    ActivityPolicy policy;
+    policy.OnEvent(ActivityEvent::SessionLocked);
+    policy.OnEvent(ActivityEvent::DisplayOff);
+    CHECK(!policy.OnEvent(ActivityEvent::DisplayOn));
+    CHECK(policy.IsParked());
+    CHECK(policy.OnEvent(ActivityEvent::SessionUnlocked));
+    CHECK(!policy.IsParked());
+}
+
+static void IdleAndBatteryStretchIntervals() {
+    ActivityPolicy policy;
+    CHECK_EQ(policy.NextIntervalMs(60000), 60000u);
+    policy.OnEvent(ActivityEvent::OnBattery);
+    CHECK_EQ(policy.NextIntervalMs(60000), 120000u);
+    policy.OnEvent(ActivityEvent::OnAC);
+
+    CHECK(!policy.OnIdle(policy.idleParkSec));
+    CHECK(policy.IsIdle());
+    CHECK_EQ(policy.NextIntervalMs(60000), policy.idleProbeMs);
+    CHECK(!policy.OnTick());
+    CHECK(policy.OnIdle(0));
+    CHECK(!policy.OnIdle(0));
+}
+
+int main() {
+    ResumeRefreshesOnce();
+    LockedTicksAreMissedThenMadeUp();
+    StaysParkedUntilEverythingClears();
+    IdleAndBatteryStretchIntervals();
+    return CheckResult();
+}
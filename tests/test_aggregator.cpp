@@ -0,0 +1,304 @@
+// The snapshot wire format and what the decoder refuses, TeamState's member
+// table and hourly ring, and the HTTP server over loopback: pipelining, a
+// body split across reads and an oversized request
+#include "check.h"
+#include "aggregator.h"
+#include "socket_util.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const int64_t NOW = 1770238800;      // 2026-02-04 21:00 UTC, on the hour
+
+static UsageSnapshot Snapshot(const char* user, int64_t time, float session) {
+    UsageSnapshot s;
+    s.user = user;
+    s.host = "box";
+    s.time = time;
+    s.session = session;
+    s.period = session / 2;
+    s.sessionResetMs = (time + 3600) * 1000;
+    return s;
+}
+
+static std::vector<uint8_t> Encode(const std::vector<UsageSnapshot>& snapshots) {
+    std::vector<uint8_t> bytes;
+    for (const UsageSnapshot& s : snapshots) EncodeSnapshot(s, bytes);
+    return bytes;
+}
+
+static void SetF32(std::vector<uint8_t>& bytes, size_t at, float f) {
+    memcpy(bytes.data() + at, &f, 4);
+}
+
+static size_t Decoded(const std::vector<uint8_t>& bytes, bool& ok) {
+    std::vector<UsageSnapshot> out;
+    ok = DecodeSnapshots(bytes.data(), bytes.size(), out);
+    return out.size();
+}
+
+static void DecodeRefusesDamage() {
+    std::vector<uint8_t> two = Encode({ Snapshot("ann", NOW, 12.5f), Snapshot("bob", NOW, 40.0f) });
+    size_t first = two.size() / 2;      // Same-length names, so same-length records
+
+    std::vector<UsageSnapshot> out;
+    CHECK(DecodeSnapshots(two.data(), two.size(), out));
+    CHECK_EQ(out.size(), 2u);
+    if (out.size() == 2) {
+        CHECK(out[1].user == "bob" && out[1].host == "box");
+        CHECK_EQ(out[1].session, 40.0f);
+        CHECK_EQ(out[1].period, 20.0f);
+        CHECK_EQ(out[1].sessionResetMs, (NOW + 3600) * 1000);
+    }
+
+    // A longer record from a newer client: the extra bytes are skipped
+    std::vector<uint8_t> longer = Encode({ Snapshot("ann", NOW, 1.0f) });
+    longer.insert(longer.end(), { 0xAA, 0xBB });
+    longer[4] += 2;
+    longer.insert(longer.end(), two.begin(), two.end());
+    bool ok;
+    CHECK_EQ(Decoded(longer, ok), 3u);
+    CHECK(ok);
+
+    // Each kind of damage in the second record; the first is still kept
+    std::vector<uint8_t> bad = two;
+    bad[first] ^= 0xFF;
+    CHECK_EQ(Decoded(bad, ok), 1u);
+    CHECK(!ok);
+
+    bad.assign(two.begin(), two.end() - 1);
+    CHECK_EQ(Decoded(bad, ok), 1u);
+    CHECK(!ok);
+    bad.assign(two.begin(), two.begin() + first + 20);
+    CHECK_EQ(Decoded(bad, ok), 1u);
+    CHECK(!ok);
+
+    bad = two;
+    bad[first + 4] = 41;                // Header only, but names follow
+    bad[first + 5] = 0;
+    CHECK_EQ(Decoded(bad, ok), 1u);
+    CHECK(!ok);
+
+    for (float f : { NAN, -1.0f, 1000.5f, INFINITY }) {
+        bad = two;
+        SetF32(bad, first + 17, f);
+        CHECK_EQ(Decoded(bad, ok), 1u);
+        CHECK(!ok);
+        bad = two;
+        SetF32(bad, first + 21, f);
+        CHECK_EQ(Decoded(bad, ok), 1u);
+        CHECK(!ok);
+    }
+
+    std::vector<uint8_t> nameless = Encode({ Snapshot("", NOW, 1.0f) });
+    CHECK_EQ(Decoded(nameless, ok), 0u);
+    CHECK(!ok);
+}
+
+static const TeamState::Member* Find(const TeamState& state, const char* user) {
+    auto it = state.Members().find(std::string(user) + "\nbox");
+    return it == state.Members().end() ? nullptr : &it->second;
+}
+
+static void IngestOrdersAndRollsUp() {
+    TeamState state;
+    std::vector<UsageSnapshot> batch = { Snapshot("ann", NOW + 10, 10.0f), Snapshot("ann", NOW + 5, 90.0f),
+                                         Snapshot("bob", NOW + 10, 30.0f), Snapshot("ann", NOW + 20, 20.0f) };
+    CHECK_EQ(state.Ingest(batch.data(), batch.size(), NOW + 30), 0u);
+
+    // The late snapshot is dropped, the newer one kept
+    const TeamState::Member* ann = Find(state, "ann");
+    CHECK(ann != nullptr);
+    if (ann) {
+        CHECK_EQ(ann->pushes, 2u);
+        CHECK_EQ(ann->latest.session, 20.0f);
+        CHECK_EQ(ann->receivedSec, NOW + 30);
+    }
+
+    // Members count once per hour however often they push
+    state.Ingest(batch.data() + 3, 1, NOW + 60);
+    std::vector<TeamState::HourRollup> hours = state.Hours(NOW + 60);
+    CHECK_EQ(hours.size(), 1u);
+    if (hours.size() == 1) {
+        CHECK_EQ(hours[0].hour, NOW / 3600);
+        CHECK_EQ(hours[0].pushes, 4u);
+        CHECK_EQ(hours[0].members, 2u);
+        CHECK_EQ(hours[0].sessionMax, 30.0f);
+    }
+
+    UsageSnapshot later = Snapshot("ann", NOW + 3700, 25.0f);
+    state.Ingest(&later, 1, NOW + 3700);
+    hours = state.Hours(NOW + 3700);
+    CHECK_EQ(hours.size(), 2u);
+    if (hours.size() == 2) {
+        CHECK_EQ(hours[1].members, 1u);
+        CHECK_EQ(hours[1].pushes, 1u);
+    }
+
+    // A week on, the first hour's slot is reused and starts from nothing
+    int64_t week = NOW + (int64_t)TeamState::HOURS * 3600;
+    later = Snapshot("bob", week, 5.0f);
+    state.Ingest(&later, 1, week);
+    hours = state.Hours(week);
+    CHECK_EQ(hours.size(), 2u);
+    if (hours.size() == 2) {
+        CHECK_EQ(hours[0].hour, NOW / 3600 + 1);
+        CHECK_EQ(hours[1].hour, week / 3600);
+        CHECK_EQ(hours[1].pushes, 1u);
+        CHECK_EQ(hours[1].members, 1u);
+        CHECK_EQ(hours[1].sessionMax, 5.0f);
+    }
+
+    // Members gone longer than the ring covers are forgotten
+    CHECK_EQ(state.Forget(week), 0u);
+    CHECK_EQ(state.Forget(NOW + 3700 + (int64_t)TeamState::HOURS * 3600 + 1), 1u);
+    CHECK(Find(state, "ann") == nullptr);
+    CHECK(Find(state, "bob") != nullptr);
+}
+
+static void MemberTableIsCapped() {
+    TeamState state;
+    state.maxMembers = 2;
+    std::vector<UsageSnapshot> batch = { Snapshot("ann", NOW, 1.0f), Snapshot("bob", NOW, 2.0f),
+                                         Snapshot("eve", NOW, 3.0f), Snapshot("ann", NOW + 1, 4.0f) };
+    CHECK_EQ(state.Ingest(batch.data(), batch.size(), NOW), 1u);
+    CHECK_EQ(state.MemberCount(), 2u);
+    CHECK(Find(state, "eve") == nullptr);
+    CHECK(Find(state, "ann") != nullptr && Find(state, "ann")->latest.session == 4.0f);
+
+    // Room frees up once someone is forgotten
+    int64_t gone = NOW + (int64_t)TeamState::HOURS * 3600 + 1;
+    UsageSnapshot bob = Snapshot("bob", gone, 2.0f);
+    state.Ingest(&bob, 1, gone - 1);
+    CHECK_EQ(state.Forget(gone), 1u);
+    CHECK_EQ(state.Ingest(batch.data() + 2, 1, gone), 0u);
+    CHECK(Find(state, "eve") != nullptr);
+}
+
+// Reads one response off a blocking socket; the status code, or -1
+static int ReadResponse(SocketHandle s, std::string& buffer, std::string* body = nullptr) {
+    for (;;) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd != std::string::npos) {
+            size_t length = 0;
+            size_t cl = buffer.find("Content-Length:");
+            if (cl != std::string::npos && cl < headerEnd) length = strtoul(buffer.c_str() + cl + 15, nullptr, 10);
+            size_t total = headerEnd + 4 + length;
+            if (buffer.size() >= total) {
+                int status = atoi(buffer.c_str() + 9);
+                if (body) body->assign(buffer, headerEnd + 4, length);
+                buffer.erase(0, total);
+                return status;
+            }
+        }
+        char chunk[4096];
+        int n = (int)recv(s, chunk, sizeof(chunk), 0);
+        if (n <= 0) return -1;
+        buffer.append(chunk, (size_t)n);
+    }
+}
+
+static std::string Push(const std::vector<uint8_t>& body, const char* extraHeader = "") {
+    return "POST /push HTTP/1.1\r\nHost: t\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" +
+           extraHeader + "\r\n" + std::string(body.begin(), body.end());
+}
+
+static bool Send(SocketHandle s, const std::string& data) {
+    return SendAll(s, data.data(), data.size());
+}
+
+static void ServesOverLoopback() {
+    InitSockets();
+    AggregatorServer server;
+    server.maxRequestBytes = 4096;
+    std::string error;
+    uint16_t port = 0;
+    for (int attempt = 0; attempt < 20 && !port; attempt++) {
+        uint16_t candidate = (uint16_t)(30000 + (getpid() * 31 + attempt * 997) % 30000);
+        if (server.Listen("127.0.0.1:" + std::to_string(candidate), error)) port = candidate;
+    }
+    CHECK(port != 0);
+    if (!port) return;
+    std::thread loop([&server]() { server.Run(); });
+
+    SocketHandle s = ConnectTcp("127.0.0.1", port, error, 5000);
+    CHECK(s != INVALID_SOCKET_HANDLE);
+    std::string in, body;
+
+    // Three requests in one write, answered in order; the GETs see the push
+    std::vector<uint8_t> two = Encode({ Snapshot("ann", NOW, 12.5f), Snapshot("bob", NOW, 40.0f) });
+    CHECK(Send(s, Push(two) + "GET /api/team HTTP/1.1\r\n\r\nGET /nowhere HTTP/1.1\r\n\r\n"));
+    CHECK_EQ(ReadResponse(s, in), 204);
+    CHECK_EQ(ReadResponse(s, in, &body), 200);
+    CHECK(body.find("\"members\":2,") != std::string::npos);
+    CHECK(body.find("\"user\":\"bob\"") != std::string::npos);
+    CHECK_EQ(ReadResponse(s, in), 404);
+
+    // A body that arrives in pieces, the split inside a record
+    std::string split = Push(Encode({ Snapshot("cat", NOW, 5.0f) }));
+    CHECK(Send(s, split.substr(0, split.size() - 10)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(Send(s, split.substr(split.size() - 10)));
+    CHECK_EQ(ReadResponse(s, in), 204);
+
+    // A bad record, then the stats over the same connection
+    std::vector<uint8_t> damaged = Encode({ Snapshot("dan", NOW, 5.0f) });
+    damaged[0] ^= 0xFF;
+    CHECK(Send(s, Push(damaged) + "GET /api/stats HTTP/1.1\r\n\r\n"));
+    CHECK_EQ(ReadResponse(s, in), 400);
+    CHECK_EQ(ReadResponse(s, in, &body), 200);
+    CHECK(body.find("\"snapshots\":3,") != std::string::npos);
+    CHECK(body.find("\"members\":3}") != std::string::npos);
+    CloseSocket(s);
+
+    // Too large: refused from the headers alone, then the connection closes
+    s = ConnectTcp("127.0.0.1", port, error, 5000);
+    in.clear();
+    CHECK(Send(s, "POST /push HTTP/1.1\r\nContent-Length: 1000000\r\n\r\nxxxx"));
+    CHECK_EQ(ReadResponse(s, in), 413);
+    CHECK_EQ(ReadResponse(s, in), -1);
+    CloseSocket(s);
+
+    server.Stop();
+    loop.join();
+    CHECK_EQ(server.GetStats().pushes, 3u);
+    CHECK_EQ(server.GetStats().requests, 6u);
+    CHECK_EQ(server.GetStats().rejected, 1u);
+    CHECK_EQ(server.State().MemberCount(), 3u);
+}
+
+static void IngestCost() {
+    std::vector<UsageSnapshot> batch;
+    char name[16];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "user%d", i);
+        batch.push_back(Snapshot(name, NOW, (float)(i % 100)));
+    }
+    TeamState state;
+    const int runs = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        for (UsageSnapshot& s : batch) s.time = NOW + i;
+        state.Ingest(batch.data(), batch.size(), NOW + i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                ((double)runs * batch.size());
+    printf("aggregator: %.0f ns per snapshot ingested, 1000 members\n", ns);
+    CHECK_EQ(state.MemberCount(), 1000u);
+}
+
+int main() {
+    DecodeRefusesDamage();
+    IngestOrdersAndRollsUp();
+    MemberTableIsCapped();
+    ServesOverLoopback();
+    IngestCost();
+    return CheckResult();
+}
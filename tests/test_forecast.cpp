@@ -0,0 +1,196 @@
+// P-squared sketches against exact quantiles, BurnForecaster replaying
+// synthetic working weeks, persistence mid-hour, and the tray text
+#include "check.h"
+#include "forecast.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const int32_t OFFSET = 3600;                    // UTC+1
+static const int64_t MONDAY = 1767571200 - OFFSET;      // 2026-01-05 00:00 local
+
+// xorshift64*, repeatable
+static uint64_t Next(uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+static float Uniform(uint64_t& rng, float lo, float hi) {
+    return lo + (hi - lo) * (float)(Next(rng) % 10001) / 10000.0f;
+}
+
+static void SketchTracksQuantiles() {
+    uint64_t rng = 40;
+    P2Quantile p10(0.1), p50(0.5), p90(0.9);
+    std::vector<float> values;
+    for (int i = 0; i < 100000; i++) {
+        // Skewed, like hourly burn: mostly small, now and then a lot
+        float x = Uniform(rng, 0.0f, 1.0f);
+        x = x * x * 10.0f;
+        p10.Add(x);
+        p50.Add(x);
+        p90.Add(x);
+        values.push_back(x);
+    }
+    std::sort(values.begin(), values.end());
+    CHECK(std::fabs(p10.Value() - values[10000]) < 0.05f);
+    CHECK(std::fabs(p50.Value() - values[50000]) < 0.05f);
+    CHECK(std::fabs(p90.Value() - values[90000]) < 0.05f);
+
+    // Under five values it's the nearest rank
+    P2Quantile few(0.5);
+    CHECK_EQ(few.Value(), 0.0f);
+    few.Add(3.0f);
+    few.Add(1.0f);
+    few.Add(2.0f);
+    CHECK_EQ(few.Value(), 2.0f);
+
+    std::vector<uint8_t> bytes;
+    p90.Serialize(bytes);
+    P2Quantile loaded(0.9);
+    const uint8_t* p = bytes.data();
+    CHECK(loaded.Deserialize(p, bytes.data() + bytes.size()));
+    CHECK(p == bytes.data() + bytes.size());
+    CHECK_EQ(loaded.Value(), p90.Value());
+    CHECK_EQ(loaded.Count(), p90.Count());
+}
+
+// Five-minute polls. Weekdays burn 1.5-2.5% in each hour from 09:00 to 17:00
+// local, nothing otherwise, and the limit resets Monday 00:00.
+struct Sample {
+    int64_t time;
+    float percent;
+};
+
+static std::vector<Sample> Weeks(int weeks, uint64_t seed) {
+    std::vector<Sample> samples;
+    float percent = 0.0f, rate = 0.0f;
+    for (int64_t t = MONDAY; t < MONDAY + (int64_t)weeks * 7 * 86400; t += 300) {
+        int64_t local = t - MONDAY;
+        int day = (int)(local / 86400 % 7);
+        int hour = (int)(local / 3600 % 24);
+        if (local % (7 * 86400) == 0) percent = 0.0f;
+        if (local % 3600 == 0) rate = day < 5 && hour >= 9 && hour < 17 ? Uniform(seed, 1.5f, 2.5f) : 0.0f;
+        samples.push_back({ t, percent });
+        percent += rate / 12.0f;
+    }
+    return samples;
+}
+
+static BurnForecaster Make() {
+    BurnForecaster f;
+    f.utcOffsetSec = OFFSET;
+    return f;
+}
+
+static int64_t At(int week, int day, int hour, int minute = 0) {
+    return MONDAY + (int64_t)week * 7 * 86400 + (int64_t)day * 86400 + hour * 3600 + minute * 60;
+}
+
+static void ForecastsAWorkingWeek() {
+    BurnForecaster f = Make();
+    CHECK(!f.Forecast(At(0, 0, 9), 0.0f, At(1, 0, 0)).valid);
+
+    const int weeks = 26;
+    for (const Sample& s : Weeks(weeks, 7)) f.AddSample(s.time, s.percent);
+    CHECK_EQ(f.Observations(), (uint32_t)(weeks * 7 * 24 - 1));
+
+    // Monday 09:00 at 40%: the median week burns 16% a day, so the 60% left
+    // lasts into Thursday afternoon; a heavy week runs out Thursday morning,
+    // a light one Friday
+    int64_t now = At(weeks, 0, 9);
+    ExhaustionForecast fc = f.Forecast(now, 40.0f, At(weeks + 1, 0, 0));
+    CHECK(fc.valid);
+    CHECK(fc.early >= At(weeks, 3, 9) && fc.early <= At(weeks, 3, 12));
+    CHECK(fc.likely >= At(weeks, 3, 13) && fc.likely <= At(weeks, 3, 17));
+    CHECK(fc.late >= At(weeks, 4, 10) && fc.late <= At(weeks, 4, 17));
+    CHECK(fc.early <= fc.likely && fc.likely <= fc.late);
+
+    // Nights and weekends burn nothing: from Friday evening it lasts
+    fc = f.Forecast(At(weeks, 4, 18), 90.0f, At(weeks + 1, 0, 0));
+    CHECK(fc.valid);
+    CHECK_EQ(fc.early, 0);
+    CHECK_EQ(fc.likely, 0);
+
+    // Used up is now
+    fc = f.Forecast(now, 100.0f, At(weeks + 1, 0, 0));
+    CHECK_EQ(fc.likely, now);
+}
+
+// Saved mid-hour and reloaded, a forecaster carries on exactly as one that
+// never stopped
+static void PersistsMidHour() {
+    std::vector<Sample> samples = Weeks(6, 11);
+    size_t split = samples.size() / 2 + 5;
+    CHECK(samples[split].time % 3600 != 0);
+
+    BurnForecaster straight = Make();
+    BurnForecaster before = Make();
+    for (size_t i = 0; i < samples.size(); i++) {
+        straight.AddSample(samples[i].time, samples[i].percent);
+        if (i < split) before.AddSample(samples[i].time, samples[i].percent);
+    }
+
+    std::vector<uint8_t> saved = before.Serialize();
+    BurnForecaster after = Make();
+    CHECK(after.Deserialize(saved));
+    CHECK(after.Serialize() == saved);
+    for (size_t i = split; i < samples.size(); i++) after.AddSample(samples[i].time, samples[i].percent);
+    CHECK(after.Serialize() == straight.Serialize());
+
+    // Damaged files are refused and leave the forecaster as it was
+    std::vector<uint8_t> current = after.Serialize();
+    std::vector<uint8_t> bad(saved.begin(), saved.begin() + saved.size() / 2);
+    CHECK(!after.Deserialize(bad));
+    bad = saved;
+    bad[0] ^= 0xFF;
+    CHECK(!after.Deserialize(bad));
+    CHECK(!after.Deserialize({}));
+    CHECK(after.Serialize() == current);
+}
+
+static void FormatsForTray() {
+    ExhaustionForecast fc;
+    CHECK(FormatForecast(fc, OFFSET).empty());
+
+    fc.valid = true;
+    CHECK(FormatForecast(fc, OFFSET) == L"Weekly limit should last until reset");
+    fc.early = At(0, 2, 20);
+    CHECK(FormatForecast(fc, OFFSET) == L"Weekly limit should last (heavy use: Wed 20:00)");
+    fc.likely = At(0, 3, 14);
+    CHECK(FormatForecast(fc, OFFSET) == L"Weekly limit ~Thu 14:00 (Wed 20:00 - after reset)");
+    fc.late = At(0, 4, 9, 30);
+    CHECK(FormatForecast(fc, OFFSET) == L"Weekly limit ~Thu 14:00 (Wed 20:00 - Fri 09:30)");
+    CHECK(FormatForecast(fc, 0) == L"Weekly limit ~Thu 13:00 (Wed 19:00 - Fri 08:30)");
+}
+
+static void ReplayCost() {
+    std::vector<Sample> samples = Weeks(52, 3);
+    BurnForecaster f = Make();
+    auto start = std::chrono::steady_clock::now();
+    for (const Sample& s : samples) f.AddSample(s.time, s.percent);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                (double)samples.size();
+
+    const int runs = 1000;
+    int valid = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) valid += f.Forecast(At(52, 0, 9) + i * 60, 10.0f, At(53, 0, 0)).valid;
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+    printf("forecast: a year of polls at %.1f ns each, forecast in %.1f us, %zu bytes saved\n", ns, us,
+           f.Serialize().size());
+    CHECK_EQ(valid, runs);
+}
+
+int main() {
+    SketchTracksQuantiles();
+    ForecastsAWorkingWeek();
+    PersistsMidHour();
+    FormatsForTray();
+    ReplayCost();
+    return CheckResult();
+}
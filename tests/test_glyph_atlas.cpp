@@ -0,0 +1,148 @@
+// GlyphAtlas with a synthetic rasterizer standing in for GDI+: layout,
+// kerning, blending, clipping, the layout fallback and per-string cost
+#include "check.h"
+#include "glyph_atlas.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Every glyph is a solid box as wide as its digit value (letters 3 px),
+// 10 px tall, advancing one pixel past its box. "7%" kerns in by 2 px.
+static int BoxWidth(wchar_t c) {
+    return c >= L'0' && c <= L'9' ? 1 + (c - L'0') % 4 : 3;
+}
+
+static int g_rasterized = 0;
+
+static bool Rasterize(const std::wstring& text, GlyphBitmap& out) {
+    g_rasterized++;
+    out.width = 0;
+    for (wchar_t c : text) out.width += BoxWidth(c) + 1;
+    out.width -= 1;
+    out.height = 10;
+    out.offsetX = 0;
+    out.advance = (float)out.width + 1.0f;
+    out.alpha.assign((size_t)out.width * out.height, 255);
+    // Labels get a transparent first column so they're told apart from glyphs
+    if (text.size() > 1) {
+        for (int row = 0; row < out.height; row++) out.alpha[(size_t)row * out.width] = 0;
+    }
+    return true;
+}
+
+static float Advance(const std::wstring& text) {
+    float width = 0;
+    for (wchar_t c : text) width += (float)BoxWidth(c) + 1.0f;
+    return text == L"7%" ? width - 2.0f : width;
+}
+
+static GlyphAtlas Build() {
+    GlyphAtlas atlas;
+    CHECK(atlas.Build(L"0123456789%hmd ", { L"Resets in", L"Weekly" }, Rasterize, Advance));
+    return atlas;
+}
+
+static void MeasuresWithKerning() {
+    GlyphAtlas atlas = Build();
+    CHECK(atlas.IsBuilt());
+    CHECK_EQ(atlas.LineHeight(), 10);
+
+    // 4 (1 px + 1) + 2 (3 + 1) + % (3 + 1)
+    CHECK_EQ(atlas.Measure(L"42%"), 10);
+    // 7 (4 + 1) + % (3 + 1), kerned 2 px tighter
+    CHECK_EQ(atlas.Measure(L"7%"), 7);
+    CHECK_EQ(atlas.Measure(L""), 0);
+}
+
+static void LabelsAreWholeRuns() {
+    g_rasterized = 0;
+    GlyphAtlas atlas = Build();
+    int built = g_rasterized;
+    CHECK_EQ(built, 15 + 2);
+
+    // Drawing never calls the rasterizer again
+    std::vector<uint32_t> pixels(200 * 12, 0);
+    CHECK(atlas.Draw(pixels.data(), 200 * 4, 200, 12, 0, 0, L"Resets in 4h", 0xFFFFFF));
+    CHECK_EQ(g_rasterized, built);
+
+    // The label's own bitmap was used: its transparent first column
+    CHECK_EQ(pixels[0], 0u);
+    CHECK_EQ(pixels[1], 0xFFFFFFFFu);
+}
+
+static void FallsBackOutsideTheAlphabet() {
+    GlyphAtlas atlas = Build();
+    std::vector<uint32_t> pixels(100 * 12, 0x11223344);
+    CHECK_EQ(atlas.Measure(L"Auth expired"), -1);
+    CHECK(!atlas.Draw(pixels.data(), 100 * 4, 100, 12, 0, 0, L"Error 42", 0xFFFFFF));
+    for (uint32_t p : pixels) {
+        if (p != 0x11223344) {
+            CHECK(p == 0x11223344);
+            break;
+        }
+    }
+
+    GlyphAtlas empty;
+    CHECK(!empty.IsBuilt());
+    CHECK_EQ(empty.Measure(L"42"), -1);
+}
+
+static void BlendsAndClips() {
+    GlyphAtlas atlas;
+    atlas.Build(L"8", {}, [](const std::wstring&, GlyphBitmap& out) {
+        out.width = 2;
+        out.height = 2;
+        out.advance = 3.0f;
+        out.alpha = { 255, 128, 0, 255 };
+        return true;
+    }, [](const std::wstring& text) { return 3.0f * (float)text.size(); });
+
+    // A 4x4 surface inside a wider buffer; the guard columns must survive
+    const int stride = 8;
+    std::vector<uint32_t> pixels(stride * 4, 0xFF000000);
+    CHECK(atlas.Draw(pixels.data(), stride * 4, 4, 4, 1, 1, L"8", 0xFF8040));
+    CHECK_EQ(pixels[1 * stride + 1], 0xFFFF8040u);
+    CHECK_EQ(pixels[1 * stride + 2], 0xFF804020u);     // Half coverage over black
+    CHECK_EQ(pixels[2 * stride + 1], 0xFF000000u);
+    CHECK_EQ(pixels[2 * stride + 2], 0xFFFF8040u);
+
+    // Hanging off every edge: only the surface is touched
+    std::fill(pixels.begin(), pixels.end(), 0);
+    CHECK(atlas.Draw(pixels.data(), stride * 4, 4, 4, -1, -1, L"8888", 0xFFFFFF));
+    CHECK(atlas.Draw(pixels.data(), stride * 4, 4, 4, 3, 3, L"88", 0xFFFFFF));
+    for (int row = 0; row < 4; row++) {
+        for (int col = 4; col < stride; col++) CHECK_EQ(pixels[row * stride + col], 0u);
+    }
+    CHECK_EQ(pixels[3 * stride + 3], 0xFFFFFFFFu);
+}
+
+static void CacheKeysOnFaceSizeAndDpi() {
+    GlyphAtlasCache cache;
+    GlyphAtlas& a = cache.Get(L"Segoe UI", 9.0f, 96);
+    CHECK(&cache.Get(L"Segoe UI", 9.0f, 96) == &a);
+    CHECK(&cache.Get(L"Segoe UI", 9.0f, 144) != &a);
+    CHECK(&cache.Get(L"Segoe UI", 10.0f, 96) != &a);
+    CHECK(&cache.Get(L"Consolas", 9.0f, 96) != &a);
+}
+
+static void DrawCost() {
+    GlyphAtlas atlas = Build();
+    const int width = 240, height = 60, runs = 200000;
+    std::vector<uint32_t> pixels((size_t)width * height, 0xFF202020);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        atlas.Draw(pixels.data(), width * 4, width, height, i % 40, i % 50, L"Resets in 4h 23m", 0xE0E0E0);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+    printf("glyph atlas: \"Resets in 4h 23m\" drawn in %.0f ns, atlas %zu bytes\n", ns, atlas.Bytes());
+}
+
+int main() {
+    MeasuresWithKerning();
+    LabelsAreWholeRuns();
+    FallsBackOutsideTheAlphabet();
+    BlendsAndClips();
+    CacheKeysOnFaceSizeAndDpi();
+    DrawCost();
+    return CheckResult();
+}
@@ -0,0 +1,179 @@
+// HistoryStore over generated multi-year data: tier boundaries, rollup
+// contents, size on disk, round trips and corrupt files
+#include "check.h"
+#include "history.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const int64_t START = 1704067200;    // 2024-01-01 00:00 UTC
+
+// xorshift64*, repeatable
+static uint64_t Next(uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+// One-minute polls: session climbs while working and resets every 5 hours,
+// period climbs with it and resets weekly. Nights are idle.
+static std::vector<UsageSample> Generate(int days, uint64_t seed) {
+    std::vector<UsageSample> samples;
+    samples.reserve((size_t)days * 1440);
+    float session = 0.0f, period = 0.0f;
+    for (int64_t t = START; t < START + (int64_t)days * 86400; t += 60) {
+        if ((t - START) % (5 * 3600) == 0) session = 0.0f;
+        if ((t - START) % (7 * 86400) == 0) period = 0.0f;
+        int hour = (int)((t / 3600) % 24);
+        if (hour >= 8 && hour < 20 && Next(seed) % 4 == 0) {
+            float burn = (float)(Next(seed) % 100) / 100.0f;
+            session = std::fmin(100.0f, session + burn);
+            period = std::fmin(100.0f, period + burn / 10.0f);
+        }
+        samples.push_back({ t, session, period });
+    }
+    return samples;
+}
+
+// Feed the samples a day at a time, compacting after each day like the widget
+static void Load(HistoryStore& store, const std::vector<UsageSample>& samples) {
+    size_t i = 0;
+    while (i < samples.size()) {
+        int64_t dayEnd = (samples[i].time / 86400 + 1) * 86400;
+        while (i < samples.size() && samples[i].time < dayEnd) store.Append(samples[i++]);
+        store.Compact(dayEnd);
+    }
+}
+
+static uint32_t CountResets(const std::vector<UsageSample>& samples, int64_t before) {
+    uint32_t resets = 0;
+    for (size_t i = 1; i < samples.size() && samples[i].time < before; i++) {
+        if (samples[i].session + 5.0f < samples[i - 1].session) resets++;
+    }
+    return resets;
+}
+
+static void ThreeYearsOfMinutes() {
+    const int days = 3 * 365;
+    std::vector<UsageSample> samples = Generate(days, 1);
+    HistoryStore store;
+    auto start = std::chrono::steady_clock::now();
+    Load(store, samples);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    int64_t end = START + (int64_t)days * 86400;
+    int64_t hourCutoff = (end - store.rawWindowSec) / 3600 * 3600;
+    int64_t dayCutoff = (end - store.hourlyWindowSec) / 86400 * 86400;
+
+    // Raw keeps a week, hourly ~13 months, daily the rest
+    CHECK(!store.Raw().empty());
+    CHECK(store.Raw().front().time >= hourCutoff);
+    std::vector<RollupRow> hourly = store.Rollups(HistoryTier::Hourly);
+    std::vector<RollupRow> daily = store.Rollups(HistoryTier::Daily);
+    CHECK_EQ(hourly.size(), (size_t)((hourCutoff - dayCutoff) / 3600));
+    CHECK_EQ(daily.size(), (size_t)((dayCutoff - START) / 86400));
+    CHECK_EQ(hourly.front().start, dayCutoff);
+    CHECK_EQ(daily.front().start, START);
+
+    // Nothing lost on the way down the tiers
+    uint64_t count = store.Raw().size();
+    uint32_t resets = 0;
+    for (const RollupRow& row : hourly) {
+        count += row.count;
+        resets += row.session.resets;
+    }
+    for (const RollupRow& row : daily) {
+        count += row.count;
+        resets += row.session.resets;
+    }
+    CHECK_EQ(count, samples.size());
+    CHECK_EQ(resets, CountResets(samples, hourCutoff));
+
+    // A day's rollup against the samples it came from
+    const RollupRow& day = daily[100];
+    float lo = 100.0f, hi = 0.0f, last = 0.0f;
+    for (const UsageSample& s : samples) {
+        if (s.time < day.start || s.time >= day.start + 86400) continue;
+        lo = std::fmin(lo, s.session);
+        hi = std::fmax(hi, s.session);
+        last = s.session;
+    }
+    CHECK_EQ(day.count, 1440u);
+    CHECK(std::fabs(day.session.min - lo) < 0.01f);
+    CHECK(std::fabs(day.session.max - hi) < 0.01f);
+    CHECK(std::fabs(day.session.last - last) < 0.01f);
+
+    std::vector<uint8_t> file = store.Serialize();
+    printf("%d days: %zu samples, compacted in %.0f ms, %zu KB rollups, %zu KB history.bin\n", days,
+           samples.size(), ms, store.CompressedBytes() / 1024, file.size() / 1024);
+    CHECK(file.size() < 512 * 1024);
+
+    HistoryStore loaded;
+    CHECK(loaded.Deserialize(file));
+    CHECK_EQ(loaded.Raw().size(), store.Raw().size());
+    CHECK_EQ(loaded.Rollups(HistoryTier::Hourly).size(), hourly.size());
+    CHECK_EQ(loaded.Rollups(HistoryTier::Daily).size(), daily.size());
+    CHECK(loaded.Serialize() == file);
+}
+
+// The day that fills a daily block keeps all its hours, with or without a
+// restart after it
+static void FullDailyBlock() {
+    std::vector<UsageSample> samples = Generate(300, 3);
+    HistoryStore straight;
+    straight.hourlyWindowSec = 2 * 86400;
+    Load(straight, samples);
+
+    size_t split = 258 * 1440 + 600;
+    HistoryStore before;
+    before.hourlyWindowSec = 2 * 86400;
+    Load(before, std::vector<UsageSample>(samples.begin(), samples.begin() + split));
+    HistoryStore after;
+    after.hourlyWindowSec = 2 * 86400;
+    CHECK(after.Deserialize(before.Serialize()));
+    Load(after, std::vector<UsageSample>(samples.begin() + split, samples.end()));
+
+    std::vector<RollupRow> a = straight.Rollups(HistoryTier::Daily);
+    std::vector<RollupRow> b = after.Rollups(HistoryTier::Daily);
+    CHECK_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+        if (a[i].count != 1440 || b[i].count != 1440) {
+            CHECK_EQ(a[i].count, 1440u);
+            CHECK_EQ(b[i].count, 1440u);
+            break;
+        }
+    }
+}
+
+static void CorruptFilesAreRejected() {
+    HistoryStore store;
+    Load(store, Generate(30, 2));
+    std::vector<uint8_t> file = store.Serialize();
+
+    // Raw block header: magic, first and last time, then the row count
+    std::vector<uint8_t> bad = file;
+    for (size_t i = 20; i < 24; i++) bad[i] = 0xFF;
+    HistoryStore loaded;
+    CHECK(!loaded.Deserialize(bad));
+
+    // A huge row count that agrees with itself is refused before decoding
+    // allocates for it
+    HistoryBlock block = HistoryStore::EncodeSamples(store.Raw().data(), 4);
+    block.rows = 0x10000000;
+    for (size_t i = 0; i < 4; i++) block.bytes[i] = (uint8_t)(block.rows >> (i * 8));
+    std::vector<UsageSample> out;
+    CHECK(!HistoryStore::DecodeSamples(block, out));
+
+    bad.assign(file.begin(), file.begin() + file.size() / 2);
+    CHECK(!loaded.Deserialize(bad));
+    CHECK(loaded.Raw().empty());
+}
+
+int main() {
+    ThreeYearsOfMinutes();
+    FullDailyBlock();
+    CorruptFilesAreRejected();
+    return CheckResult();
+}
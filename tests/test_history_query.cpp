@@ -0,0 +1,243 @@
+// History queries: group keys under offsets that aren't whole hours or are
+// west of UTC, range edges across column blocks, the weighted p95 against a
+// brute-force sort, threshold crossings, and the scan cost
+#include "check.h"
+#include "history_query.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const int64_t MONDAY = 1767571200;      // 2026-01-05 00:00 UTC
+static const int64_t BLOCK = (int64_t)HistoryTable::BLOCK_ROWS;
+
+// xorshift64*, repeatable
+static uint64_t Next(uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+static void Sample(HistoryTable& table, int64_t time, float value) {
+    table.Append(time, value, value, value, 1.0f);
+}
+
+static std::vector<QueryRow> Run(const HistoryTable& table, QueryGroup group, int32_t offset,
+                                 int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+    HistoryQuery q;
+    q.group = group;
+    q.utcOffsetSec = offset;
+    q.from = from;
+    q.to = to;
+    return RunHistoryQuery(table, q);
+}
+
+static void KeysFollowOffset() {
+    HistoryTable table;
+    Sample(table, -1800, 10.0f);                // 1969-12-31 23:30 UTC, a Wednesday
+    Sample(table, MONDAY + 1799, 20.0f);        // 00:29:59 UTC
+    Sample(table, MONDAY + 1800, 30.0f);
+
+    // UTC: the pre-epoch row floors into the day before, not toward zero
+    std::vector<QueryRow> rows = Run(table, QueryGroup::Hour, 0);
+    CHECK_EQ(rows.size(), 2u);
+    CHECK_EQ(rows[0].key, 0);
+    CHECK_EQ(rows[0].samples, 2.0);
+    CHECK_EQ(rows[1].key, 23);
+    rows = Run(table, QueryGroup::Day, 0);
+    CHECK_EQ(rows.size(), 2u);
+    CHECK_EQ(rows[0].key, -1);
+    CHECK_EQ(rows[1].key, MONDAY / 86400);
+    rows = Run(table, QueryGroup::Weekday, 0);
+    CHECK_EQ(rows.size(), 2u);
+    CHECK_EQ(rows[0].key, 0);
+    CHECK_EQ(rows[1].key, 2);
+
+    // UTC+5:30: an hour boundary falls at 00:30 UTC, between the Monday rows;
+    // the pre-epoch row is 05:00 local
+    rows = Run(table, QueryGroup::Hour, 19800);
+    CHECK_EQ(rows.size(), 2u);
+    CHECK_EQ(rows[0].key, 5);
+    CHECK_EQ(rows[0].samples, 2.0);
+    CHECK_EQ(rows[1].key, 6);
+    CHECK_EQ(rows[1].max, 30.0f);
+
+    // UTC-2:30: Monday morning is still Sunday night, split at 22:00 local,
+    // and the pre-epoch row lands on Wednesday 21:00
+    rows = Run(table, QueryGroup::Hour, -9000);
+    CHECK_EQ(rows.size(), 2u);
+    CHECK_EQ(rows[0].key, 21);
+    CHECK_EQ(rows[0].samples, 2.0);
+    CHECK_EQ(rows[1].key, 22);
+    rows = Run(table, QueryGroup::Weekday, -9000);
+    CHECK_EQ(rows.size(), 2u);
+    CHECK_EQ(rows[0].key, 2);
+    CHECK_EQ(rows[1].key, 6);
+    rows = Run(table, QueryGroup::Day, -9000);
+    CHECK_EQ(rows.size(), 2u);
+    CHECK_EQ(rows[0].key, -1);
+    CHECK_EQ(rows[1].key, MONDAY / 86400 - 1);
+}
+
+// Minute samples over two and a bit blocks; the value is the row index mod 1000
+static HistoryTable Minutes(int64_t count) {
+    HistoryTable table;
+    for (int64_t i = 0; i < count; i++) Sample(table, MONDAY + i * 60, (float)(i % 1000) / 10.0f);
+    return table;
+}
+
+static void RangeEdgesAcrossBlocks() {
+    HistoryTable table = Minutes(2 * BLOCK + 10);
+    CHECK_EQ(table.Blocks().size(), 3u);
+    CHECK_EQ(table.Rows(), (size_t)(2 * BLOCK + 10));
+    auto at = [](int64_t row) { return MONDAY + row * 60; };
+
+    // From the last row of the first block up to, not including, the first
+    // row of the third
+    std::vector<QueryRow> rows = Run(table, QueryGroup::None, 0, at(BLOCK - 1), at(2 * BLOCK));
+    CHECK_EQ(rows.size(), 1u);
+    CHECK_EQ(rows[0].samples, (double)(BLOCK + 1));
+
+    // Exactly one row, the first of a block
+    rows = Run(table, QueryGroup::None, 0, at(BLOCK), at(BLOCK) + 1);
+    CHECK_EQ(rows[0].samples, 1.0);
+    CHECK_EQ(rows[0].min, (float)(BLOCK % 1000) / 10.0f);
+
+    // Bounds between rows; an empty range has no groups
+    rows = Run(table, QueryGroup::None, 0, at(BLOCK - 1) + 30, at(BLOCK + 1) + 30);
+    CHECK_EQ(rows[0].samples, 2.0);
+    CHECK(Run(table, QueryGroup::None, 0, at(5), at(5)).empty());
+    CHECK(Run(table, QueryGroup::None, 0, at(2 * BLOCK + 10)).empty());
+    CHECK_EQ(Run(table, QueryGroup::None, 0)[0].samples, (double)(2 * BLOCK + 10));
+}
+
+// Rollup-like rows with random weights, p95 against every sample written out
+// and sorted
+static void PercentileMatchesSort() {
+    uint64_t rng = 38;
+    HistoryTable table;
+    std::vector<std::vector<float>> expanded(3);
+    std::vector<double> sums(3);
+    for (int64_t i = 0; i < 3 * 24 * 12; i++) {
+        int64_t t = MONDAY + i * 300;
+        float value = (float)(Next(rng) % 1001) / 10.0f;
+        uint32_t weight = 1 + (uint32_t)(Next(rng) % 60);
+        table.Append(t, value, value, value, (float)weight);
+        int day = (int)((t - MONDAY) / 86400);
+        expanded[day].insert(expanded[day].end(), weight, value);
+        sums[day] += (double)value * weight;
+    }
+
+    std::vector<QueryRow> rows = Run(table, QueryGroup::Day, 0);
+    CHECK_EQ(rows.size(), 3u);
+    for (size_t d = 0; d < rows.size() && d < 3; d++) {
+        std::vector<float>& v = expanded[d];
+        std::sort(v.begin(), v.end());
+        size_t rank = (v.size() * 95 + 99) / 100;
+        CHECK_EQ(rows[d].samples, (double)v.size());
+        CHECK(std::fabs(rows[d].p95 - v[rank - 1]) < 0.01f);
+        CHECK(std::fabs(rows[d].avg - sums[d] / v.size()) < 0.01);
+    }
+
+    // One heavy rollup outweighs many light polls
+    HistoryTable mixed;
+    mixed.Append(MONDAY, 90.0f, 80.0f, 100.0f, 60.0f);
+    for (int i = 1; i <= 10; i++) Sample(mixed, MONDAY + 3600 + i * 60, 10.0f);
+    CHECK_EQ(Run(mixed, QueryGroup::None, 0)[0].p95, 90.0f);
+}
+
+static uint64_t Over(const HistoryTable& table, float threshold, int64_t from = INT64_MIN) {
+    HistoryQuery q;
+    q.useThreshold = true;
+    q.threshold = threshold;
+    q.from = from;
+    std::vector<QueryRow> rows = RunHistoryQuery(table, q);
+    return rows.empty() ? 0 : rows[0].over;
+}
+
+static void CountsCrossings() {
+    HistoryTable table;
+    table.Append(MONDAY, 50.0f, 20.0f, 100.0f, 12.0f);              // Climbed within the hour
+    table.Append(MONDAY + 3600, 100.0f, 100.0f, 100.0f, 12.0f);     // Stayed there
+    table.Append(MONDAY + 7200, 80.0f, 40.0f, 90.0f, 12.0f);
+    Sample(table, MONDAY + 10800, 100.0f);                          // Climbed
+    Sample(table, MONDAY + 11100, 100.0f);
+    Sample(table, MONDAY + 11400, 60.0f);
+    Sample(table, MONDAY + 11700, 100.0f);                          // Climbed again
+    CHECK_EQ(Over(table, 100.0f), 3u);
+    CHECK_EQ(Over(table, 95.0f), 3u);
+    CHECK_EQ(Over(table, 85.0f), 3u);           // The 40-90 hour dipped and came back
+    CHECK_EQ(Over(table, 95.0f, MONDAY + 7200), 2u);
+    CHECK_EQ(Over(table, 101.0f), 0u);
+
+    // The row before the range decides whether its first row climbed
+    CHECK_EQ(Over(table, 100.0f, MONDAY + 3600), 2u);
+    CHECK_EQ(Over(table, 100.0f, MONDAY + 11100), 1u);
+
+    // A stretch that spans a block boundary counts once, in the block it began
+    HistoryTable blocks;
+    for (int64_t i = 0; i < BLOCK + 5; i++) Sample(blocks, MONDAY + i * 60, i >= BLOCK - 3 ? 100.0f : 10.0f);
+    CHECK_EQ(blocks.Blocks().size(), 2u);
+    CHECK_EQ(Over(blocks, 100.0f), 1u);
+    CHECK_EQ(Over(blocks, 100.0f, MONDAY + BLOCK * 60), 0u);
+
+    // Without --threshold nothing is counted
+    CHECK_EQ(Run(table, QueryGroup::None, 0)[0].over, 0u);
+}
+
+// A retained store reads back through FromStore with every sample accounted
+// for, whichever tier it ended up in
+static void StoreTiersKeepWeight() {
+    HistoryStore store;
+    store.rawWindowSec = 86400;
+    store.hourlyWindowSec = 3 * 86400;
+    int64_t count = 0;
+    for (int64_t t = MONDAY; t < MONDAY + 6 * 86400; t += 300, count++) {
+        UsageSample s;
+        s.time = t;
+        s.session = (float)(count % 48);
+        s.period = 50.0f;
+        store.Append(s);
+    }
+    store.Compact(MONDAY + 6 * 86400);
+    CHECK(!store.Rollups(HistoryTier::Daily).empty());
+    CHECK(!store.Rollups(HistoryTier::Hourly).empty());
+
+    HistoryTable table = HistoryTable::FromStore(store, HistorySeries::Session);
+    std::vector<QueryRow> rows = Run(table, QueryGroup::None, 0);
+    CHECK_EQ(rows.size(), 1u);
+    CHECK_EQ(rows[0].samples, (double)count);
+    CHECK(std::fabs(rows[0].avg - 23.5f) < 0.1f);
+    CHECK_EQ(Run(HistoryTable::FromStore(store, HistorySeries::Period), QueryGroup::None, 0)[0].p95, 50.0f);
+}
+
+static void ScanCost() {
+    HistoryTable table = Minutes(4 * BLOCK);
+    HistoryQuery q;
+    q.group = QueryGroup::Hour;
+    q.useThreshold = true;
+    q.threshold = 80.0f;
+
+    const int runs = 20;
+    uint64_t over = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        for (const QueryRow& row : RunHistoryQuery(table, q)) over += row.over;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                ((double)runs * table.Rows());
+    printf("history query: %.2f ns per row grouped by hour\n", ns);
+    CHECK(over > 0);
+}
+
+int main() {
+    KeysFollowOffset();
+    RangeEdgesAcrossBlocks();
+    PercentileMatchesSort();
+    CountsCrossings();
+    StoreTiersKeepWeight();
+    ScanCost();
+    return CheckResult();
+}
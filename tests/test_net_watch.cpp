@@ -0,0 +1,120 @@
+// Reconnect handling: the tracker against injected network events, the
+// reachability probe against loopback, and the rtnetlink watcher against a
+// link brought up in a private network namespace
+#include "check.h"
+#include "net_watch.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static void ChangeWhileOnlineIsIgnored() {
+    ReconnectTracker t;
+    t.OnNetworkChanged(1000, false);
+    CHECK_EQ(t.Deadline(), 0);
+    CHECK(!t.ProbeDue(100000));
+}
+
+static void BurstIsDebounced() {
+    ReconnectTracker t;
+    t.OnNetworkChanged(1000, true);
+    t.OnNetworkChanged(1500, true);
+    t.OnNetworkChanged(2200, true);
+    CHECK_EQ(t.Deadline(), 2200 + t.debounceMs);
+    CHECK(!t.ProbeDue(2200 + t.debounceMs - 1));
+    CHECK(t.ProbeDue(2200 + t.debounceMs));
+    CHECK(t.OnProbeResult(4200, true));
+    CHECK_EQ(t.Deadline(), 0);
+}
+
+static void FailedProbesBackOffThenGiveUp() {
+    ReconnectTracker t;
+    t.OnNetworkChanged(0, true);
+    uint64_t now = t.Deadline();
+    for (int i = 0; i < t.maxRetries; i++) {
+        CHECK(!t.OnProbeResult(now, false));
+        CHECK_EQ(t.Deadline() - now, (uint64_t)t.retryMs << i);
+        now = t.Deadline();
+    }
+    CHECK(!t.OnProbeResult(now, false));
+    CHECK_EQ(t.Deadline(), 0);
+
+    // A new change starts over with a full budget
+    t.OnNetworkChanged(now, true);
+    CHECK(!t.OnProbeResult(t.Deadline(), false));
+    CHECK_EQ(t.Deadline() - (now + t.debounceMs), t.retryMs);
+}
+
+static void SuccessfulRefreshCancels() {
+    ReconnectTracker t;
+    t.OnNetworkChanged(0, true);
+    t.Cancel();
+    CHECK_EQ(t.Deadline(), 0);
+    CHECK(!t.ProbeDue(t.debounceMs));
+}
+
+static void ProbeConnectsToLoopback() {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(listener, (sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(listener, (sockaddr*)&addr, &len);
+    listen(listener, 1);
+    uint16_t port = ntohs(addr.sin_port);
+
+    CHECK(ProbeReachable("127.0.0.1", port, 1000));
+    close(listener);
+
+    // A refusal comes back as soon as it's known, not at the timeout
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!ProbeReachable("127.0.0.1", port, 5000));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+}
+
+// Needs CAP_SYS_ADMIN for the namespace; skipped without it
+static void WatcherSeesLinkComingUp() {
+    if (unshare(CLONE_NEWNET) != 0) {
+        printf("netns unavailable, skipping watcher test\n");
+        return;
+    }
+    int changes = 0;
+    NetworkWatcher watcher;
+    CHECK(watcher.Start([&changes]() { changes++; }));
+
+    // Loopback starts down in a fresh namespace
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    ifreq ifr = {};
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "lo");
+    CHECK(ioctl(s, SIOCGIFFLAGS, &ifr) == 0);
+    ifr.ifr_flags |= IFF_UP;
+    CHECK(ioctl(s, SIOCSIFFLAGS, &ifr) == 0);
+    close(s);
+
+    pollfd pfd = { watcher.Fd(), POLLIN, 0 };
+    CHECK(poll(&pfd, 1, 2000) == 1);
+    watcher.Drain();
+    CHECK_EQ(changes, 1);
+
+    // Nothing further happened, so another drain is silent
+    watcher.Drain();
+    CHECK_EQ(changes, 1);
+    CHECK(ProbeReachable("127.0.0.1", 9, 500) == false);
+}
+
+int main() {
+    ChangeWhileOnlineIsIgnored();
+    BurstIsDebounced();
+    FailedProbesBackOffThenGiveUp();
+    SuccessfulRefreshCancels();
+    ProbeConnectsToLoopback();
+    WatcherSeesLinkComingUp();     // Last: moves the process into its own namespace
+    return CheckResult();
+}
@@ -0,0 +1,159 @@
+// Org listing parsing past nested uuids and escaped names, picking an org,
+// the cache's TTL edges, the orgs.bin round trip, and the parse cost of a
+// large listing
+#include "check.h"
+#include "org_directory.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const int64_t NOW = 1770238800;      // 2026-02-04 21:00 UTC
+
+// Members and their uuids come before the org's own, as the API sends them
+static const char* const LISTING = R"([
+  {"id": 1, "members": [{"uuid": "member-1", "name": "Not an org"}, {"uuid": "member-2"}],
+   "uuid": "AAAA-1111", "name": "Quote \"Q\" and C:\\dir\\",
+   "settings": {"uuid": "settings-uuid", "nested": [[{"uuid": "deep"}]]},
+   "capabilities": ["api", 7, "api_individual"], "billing_type": "api_evaluation"},
+  {"name": "No uuid, dropped", "capabilities": ["chat"]},
+  "not an object",
+  {"uuid": "bbbb-2222", "name": "Team \u00e9\ud83d\ude00", "capabilities": ["chat", "claude_pro"],
+   "billing_type": "stripe_subscription", "rate_limit_tier": null, "active": true}
+])";
+
+static void ParsesListing() {
+    OrgDirectory dir;
+    CHECK(dir.Parse(LISTING, NOW));
+    CHECK_EQ(dir.FetchedAt(), NOW);
+    CHECK_EQ(dir.Orgs().size(), 2u);
+    if (dir.Orgs().size() != 2) return;
+
+    const OrgEntry& api = dir.Orgs()[0];
+    CHECK(api.uuid == "AAAA-1111");
+    CHECK(api.name == "Quote \"Q\" and C:\\dir\\");
+    CHECK(api.billingType == "api_evaluation");
+    CHECK_EQ(api.capabilities.size(), 2u);
+    CHECK(api.Has("api_individual") && !api.Has("chat"));
+
+    const OrgEntry& team = dir.Orgs()[1];
+    CHECK(team.uuid == "bbbb-2222");
+    CHECK(team.name == "Team \xc3\xa9\xf0\x9f\x98\x80");
+    CHECK(team.Has("claude_pro"));
+
+    // Anything that isn't a complete array is refused and keeps what was there
+    const char* bad[] = { "", "{}", "[", "[{\"uuid\": \"x\"", "[{\"uuid\": \"x\"}", "[{\"uuid\": \"x}]",
+                          "[{\"uuid\" \"x\"}]" };
+    for (const char* json : bad) {
+        CHECK(!dir.Parse(json, NOW + 1));
+        CHECK_EQ(dir.Orgs().size(), 2u);
+        CHECK_EQ(dir.FetchedAt(), NOW);
+    }
+    CHECK(dir.Parse(" [ ] ", NOW + 1));
+    CHECK(dir.Empty());
+}
+
+static void Selects() {
+    OrgDirectory dir;
+    CHECK(dir.Select("") == nullptr);
+    CHECK(dir.Parse(LISTING, NOW));
+
+    // By uuid or name, either ignoring ASCII case
+    CHECK(dir.Select("aaaa-1111") == &dir.Orgs()[0]);
+    CHECK(dir.Select("BBBB-2222") == &dir.Orgs()[1]);
+    CHECK(dir.Select("quote \"q\" AND c:\\DIR\\") == &dir.Orgs()[0]);
+    CHECK(dir.FindByName("Team") == nullptr);
+    CHECK(dir.FindByUuid("member-1") == nullptr);
+
+    // Unknown or no pin: the first with chat, ahead of an earlier API org
+    CHECK(dir.Select("") == &dir.Orgs()[1]);
+    CHECK(dir.Select("gone-uuid") == &dir.Orgs()[1]);
+
+    // No chat org at all: the first
+    OrgDirectory apiOnly;
+    CHECK(apiOnly.Parse(R"([{"uuid": "one", "capabilities": ["api"]}, {"uuid": "two"}])", NOW));
+    CHECK(apiOnly.Select("") == &apiOnly.Orgs()[0]);
+}
+
+static void FreshnessEdges() {
+    OrgDirectory dir;
+    CHECK(!dir.IsFresh(NOW));
+    CHECK(dir.Parse(LISTING, NOW));
+    CHECK(dir.IsFresh(NOW));
+    CHECK(dir.IsFresh(NOW + OrgDirectory::DEFAULT_TTL_SEC - 1));
+    CHECK(!dir.IsFresh(NOW + OrgDirectory::DEFAULT_TTL_SEC));
+    CHECK(dir.IsFresh(NOW + 59, 60));
+    CHECK(!dir.IsFresh(NOW + 60, 60));
+
+    // A clock set back before the download doesn't make it fresh forever
+    CHECK(!dir.IsFresh(NOW - 1));
+
+    // Expired keeps the entries for menus
+    dir.Expire();
+    CHECK(!dir.IsFresh(NOW));
+    CHECK_EQ(dir.FetchedAt(), 0);
+    CHECK_EQ(dir.Orgs().size(), 2u);
+}
+
+static void RoundTrips() {
+    OrgDirectory dir;
+    CHECK(dir.Parse(LISTING, NOW));
+    std::vector<uint8_t> bytes = dir.Serialize();
+
+    OrgDirectory loaded;
+    CHECK(loaded.Deserialize(bytes));
+    CHECK(loaded.Serialize() == bytes);
+    CHECK_EQ(loaded.FetchedAt(), NOW);
+    CHECK_EQ(loaded.Orgs().size(), 2u);
+    if (loaded.Orgs().size() == 2) {
+        CHECK(loaded.Orgs()[0].name == dir.Orgs()[0].name);
+        CHECK(loaded.Orgs()[1].capabilities == dir.Orgs()[1].capabilities);
+        CHECK(loaded.Orgs()[1].billingType == "stripe_subscription");
+    }
+
+    // Every truncation is refused and leaves the directory as it was
+    for (size_t size = 0; size < bytes.size(); size++) {
+        std::vector<uint8_t> cut(bytes.begin(), bytes.begin() + size);
+        CHECK(!loaded.Deserialize(cut));
+    }
+    std::vector<uint8_t> bad = bytes;
+    bad[0] ^= 0xFF;
+    CHECK(!loaded.Deserialize(bad));
+    CHECK(loaded.Serialize() == bytes);
+
+    OrgDirectory empty;
+    CHECK(loaded.Deserialize(empty.Serialize()));
+    CHECK(loaded.Empty());
+}
+
+// An account in a few hundred orgs, each listing its members: a couple of MB
+static void ParseCost() {
+    std::string json = "[";
+    for (int org = 0; org < 300; org++) {
+        json += org ? ",{\"members\":[" : "{\"members\":[";
+        for (int m = 0; m < 40; m++) {
+            json += m ? ",{\"uuid\":\"" : "{\"uuid\":\"";
+            json += std::to_string(org * 1000 + m) + "\",\"name\":\"Member " + std::to_string(m) +
+                    "\",\"bio\":\"" + std::string(100, 'x') + "\"}";
+        }
+        json += "],\"uuid\":\"org-" + std::to_string(org) + "\",\"name\":\"Org\",\"capabilities\":[\"chat\"]}";
+    }
+    json += "]";
+
+    const int runs = 20;
+    OrgDirectory dir;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) dir.Parse(json, NOW);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+    printf("org directory: %zu KB listing parsed in %.2f ms\n", json.size() / 1024, ms);
+    CHECK_EQ(dir.Orgs().size(), 300u);
+}
+
+int main() {
+    ParsesListing();
+    Selects();
+    FreshnessEdges();
+    RoundTrips();
+    ParseCost();
+    return CheckResult();
+}
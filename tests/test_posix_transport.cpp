@@ -0,0 +1,156 @@
+// The POSIX transport against a scripted local server: body framing,
+// status classification and cancellation of a request that never gets an answer
+#include "check.h"
+#include "http_client.h"
+#include "socket_util.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// Serves one connection with `response`, written in pieces of `piece` bytes;
+// an empty response means accept and never answer
+class OneShotServer {
+public:
+    OneShotServer(std::string response, size_t piece) : m_response(std::move(response)), m_piece(piece) {
+        m_listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(m_listener, (sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(m_listener, (sockaddr*)&addr, &len);
+        m_port = ntohs(addr.sin_port);
+        listen(m_listener, 1);
+        m_thread = std::thread([this]() { Serve(); });
+    }
+
+    ~OneShotServer() {
+        m_thread.join();
+        close(m_listener);
+    }
+
+    std::wstring Url(const char* path) const { return L"http://127.0.0.1:" + std::to_wstring(m_port) + L"/" +
+                                                      std::wstring(path, path + strlen(path)); }
+
+private:
+    int m_listener;
+    uint16_t m_port = 0;
+    std::string m_response;
+    size_t m_piece;
+    std::thread m_thread;
+
+    void Serve() {
+        int s = accept(m_listener, nullptr, nullptr);
+        std::string request;
+        char buf[4096];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(s, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            request.append(buf, (size_t)n);
+        }
+        if (m_response.empty()) {
+            // Hold the connection until the client gives up
+            while (recv(s, buf, sizeof(buf), 0) > 0) {}
+        } else {
+            for (size_t pos = 0; pos < m_response.size(); pos += m_piece) {
+                size_t n = std::min(m_piece, m_response.size() - pos);
+                if (!SendAll(s, m_response.data() + pos, n)) break;
+            }
+        }
+        close(s);
+    }
+};
+
+static std::string MakeBody(size_t size) {
+    std::string body;
+    body.reserve(size);
+    for (size_t i = 0; body.size() < size; i++) body += "{\"uuid\":\"" + std::to_string(i) + "\"},";
+    body.resize(size);
+    return body;
+}
+
+static void ChunkedBodyIsReassembled() {
+    // An org listing the size user-043 was tuned for, in small chunks
+    std::string body = MakeBody(4500 * 1000);
+    std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+    char line[32];
+    for (size_t pos = 0; pos < body.size(); pos += 1000) {
+        size_t n = std::min<size_t>(1000, body.size() - pos);
+        snprintf(line, sizeof(line), "%zx\r\n", n);
+        response += line;
+        response.append(body, pos, n);
+        response += "\r\n";
+    }
+    response += "0\r\n\r\n";
+
+    OneShotServer server(response, 7000);
+    HttpClient http;
+    auto start = std::chrono::steady_clock::now();
+    HttpResponse resp = http.Get(server.Url("api/organizations"), L"cookie");
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    CHECK(resp.status == HttpStatus::Success);
+    CHECK_EQ(resp.statusCode, 200);
+    CHECK_EQ(resp.body.size(), body.size());
+    CHECK(resp.body == body);
+    printf("chunked: %zu bytes in %.1f ms\n", resp.body.size(), ms);
+}
+
+static void LengthDelimitedBody() {
+    std::string body = MakeBody(100 * 1000);
+    OneShotServer server("HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body,
+                         333);
+    HttpClient http;
+    HttpResponse resp = http.Get(server.Url("usage"), L"cookie");
+    CHECK(resp.status == HttpStatus::Success);
+    CHECK(resp.body == body);
+}
+
+static void TruncatedChunkedBodyFails() {
+    OneShotServer server("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n10\r\nonly part", 64);
+    HttpClient http;
+    HttpResponse resp = http.Get(server.Url("usage"), L"cookie");
+    CHECK(resp.status == HttpStatus::NetworkError);
+    CHECK(resp.body.empty());
+}
+
+static void AuthStatusIsClassified() {
+    OneShotServer server("HTTP/1.1 401 Unauthorized\r\nContent-Length: 5\r\n\r\nnope!", 64);
+    HttpClient http;
+    HttpResponse resp = http.Get(server.Url("usage"), L"cookie");
+    CHECK(resp.status == HttpStatus::AuthError);
+    CHECK_EQ(resp.statusCode, 401);
+    CHECK(resp.body.empty());
+}
+
+static void CancelInterruptsAWaitingRead() {
+    OneShotServer server("", 1);
+    HttpClient http;
+    std::atomic<bool> cancel{ false };
+    std::thread canceller([&cancel]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        cancel = true;
+    });
+    auto start = std::chrono::steady_clock::now();
+    HttpResponse resp = http.Get(server.Url("usage"), L"cookie", &cancel);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    canceller.join();
+    CHECK(resp.status == HttpStatus::NetworkError);
+    CHECK(ms < 2000);   // The socket timeout is 15 s
+}
+
+int main() {
+    InitSockets();
+    ChunkedBodyIsReassembled();
+    LengthDelimitedBody();
+    TruncatedChunkedBodyFails();
+    AuthStatusIsClassified();
+    CancelInterruptsAWaitingRead();
+    return CheckResult();
+}
@@ -0,0 +1,140 @@
+// DeadlineScheduler: when it wakes, what shares a wakeup, and what a
+// wakeup costs with many tasks pending
+#include "check.h"
+#include "scheduler.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// xorshift64*, repeatable
+static uint64_t Next(uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+static void LoneTaskFiresOnTime() {
+    DeadlineScheduler s;
+    s.Schedule(0, 60000, 6000);
+    CHECK_EQ(s.NextWake(), 60000);
+    CHECK(s.PopDue(59999).empty());
+    CHECK_EQ(s.PopDue(60000).size(), 1u);
+    CHECK_EQ(s.NextWake(), 0);
+}
+
+static void TasksWithinToleranceShareAWakeup() {
+    DeadlineScheduler s;
+    s.Schedule(0, 60000, 6000);
+    s.Schedule(1, 63000, 1000);
+    s.Schedule(2, 64500, 0);     // Past task 1's window
+    CHECK_EQ(s.NextWake(), 63000);
+    std::vector<DeadlineScheduler::TaskId> due = s.PopDue(63000);
+    CHECK_EQ(due.size(), 2u);
+    CHECK_EQ(due[0], 0u);
+    CHECK_EQ(due[1], 1u);
+    CHECK_EQ(s.NextWake(), 64500);
+}
+
+static void RescheduleAndCancel() {
+    DeadlineScheduler s;
+    s.Schedule(0, 1000, 0);
+    s.Schedule(0, 5000, 0);
+    s.Schedule(1, 2000, 0);
+    s.Cancel(1);
+    CHECK_EQ(s.NextWake(), 5000);
+    CHECK_EQ(s.DueTime(0), 5000);
+    CHECK(!s.IsScheduled(1));
+    CHECK_EQ(s.PopDue(5000).size(), 1u);
+    CHECK_EQ(s.NextWake(), 0);
+}
+
+// Whatever is pending, a task never runs before its due time or later than
+// its tolerance allows
+static void NeverEarlyNeverLate() {
+    uint64_t rng = 42;
+    for (int round = 0; round < 200; round++) {
+        DeadlineScheduler s;
+        std::vector<uint64_t> due(32);
+        std::vector<uint32_t> tolerance(32);
+        for (DeadlineScheduler::TaskId id = 0; id < 32; id++) {
+            due[id] = 1000 + Next(rng) % 100000;
+            tolerance[id] = (uint32_t)(Next(rng) % 20000);
+            s.Schedule(id, due[id], tolerance[id]);
+        }
+        size_t run = 0;
+        while (uint64_t wake = s.NextWake()) {
+            for (DeadlineScheduler::TaskId id : s.PopDue(wake)) {
+                CHECK(wake >= due[id]);
+                CHECK(wake <= due[id] + tolerance[id]);
+                run++;
+            }
+        }
+        CHECK_EQ(run, 32u);
+    }
+}
+
+// The widget's steady state for a day: refresh every 60 s (10% tolerance),
+// the countdown once a minute (1 s), compaction every 10 min (a third)
+static void WidgetDayWakeups() {
+    struct Periodic {
+        uint64_t period;
+        uint32_t tolerance;
+    };
+    const Periodic tasks[] = { { 60000, 6000 }, { 60000, 1000 }, { 600000, 200000 } };
+    const uint64_t day = 24 * 3600 * 1000ull;
+
+    DeadlineScheduler s;
+    s.Schedule(0, tasks[0].period, tasks[0].tolerance);
+    s.Schedule(1, 30000, tasks[1].tolerance);    // Out of phase with the refresh
+    s.Schedule(2, tasks[2].period, tasks[2].tolerance);
+    s.ResetStats(0);
+    uint64_t refreshes = 0;
+    while (uint64_t wake = s.NextWake()) {
+        if (wake > day) break;
+        for (DeadlineScheduler::TaskId id : s.PopDue(wake)) {
+            if (id == 0) refreshes++;
+            s.Schedule(id, wake + tasks[id].period, tasks[id].tolerance);
+        }
+    }
+    printf("widget day: %llu wakeups for %llu tasks, %llu refreshes\n", (unsigned long long)s.Wakeups(),
+           (unsigned long long)s.TasksRun(), (unsigned long long)refreshes);
+
+    // Refreshes keep their nominal period, compaction rides along with them
+    CHECK_EQ(refreshes, 1440u);
+    CHECK(s.Wakeups() <= 2 * 1440);
+    CHECK(s.TasksRun() > s.Wakeups());
+}
+
+static void ManyPendingTasks() {
+    const DeadlineScheduler::TaskId tasks = 10000;
+    uint64_t rng = 7;
+    DeadlineScheduler s;
+    auto start = std::chrono::steady_clock::now();
+    for (DeadlineScheduler::TaskId id = 0; id < tasks; id++) s.Schedule(id, Next(rng) % 3600000, 250);
+    for (int i = 0; i < 5; i++) {
+        // Rescheduling everything leaves stale heap entries behind
+        for (DeadlineScheduler::TaskId id = 0; id < tasks; id++) s.Schedule(id, Next(rng) % 3600000, 250);
+    }
+    auto scheduled = std::chrono::steady_clock::now();
+    size_t run = 0;
+    while (uint64_t wake = s.NextWake()) run += s.PopDue(wake).size();
+    auto end = std::chrono::steady_clock::now();
+
+    double scheduleNs = std::chrono::duration<double, std::nano>(scheduled - start).count() / (6.0 * tasks);
+    double wakeNs = std::chrono::duration<double, std::nano>(end - scheduled).count() / (double)s.Wakeups();
+    printf("%u tasks: schedule %.0f ns, NextWake+PopDue %.0f ns per wakeup (%llu wakeups)\n", tasks,
+           scheduleNs, wakeNs, (unsigned long long)s.Wakeups());
+    CHECK_EQ(run, tasks);
+    CHECK(s.Wakeups() < tasks);
+}
+
+int main() {
+    LoneTaskFiresOnTime();
+    TasksWithinToleranceShareAWakeup();
+    RescheduleAndCancel();
+    NeverEarlyNeverLate();
+    WidgetDayWakeups();
+    ManyPendingTasks();
+    return CheckResult();
+}
@@ -0,0 +1,235 @@
+// Transcript parsing, the rolling token windows, the incremental tailer over
+// a scratch tree, and the inotify watcher including a tree that doesn't
+// exist yet when it starts
+#include "check.h"
+#include "session_logs.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static const int64_t NOW = 1770238800;      // 2026-02-04 21:00 UTC
+
+static std::string Stamp(int64_t unixSec) {
+    time_t t = (time_t)unixSec;
+    tm utc;
+    gmtime_r(&t, &utc);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S.000Z", &utc);
+    return buf;
+}
+
+// An assistant turn worth input + output + cacheRead / 10 tokens
+static std::string Turn(const char* id, int64_t time, int input, int output, int cacheRead = 0) {
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\"type\":\"assistant\",\"timestamp\":\"%s\",\"message\":{\"id\":\"%s\",\"content\":[{\"type\":\"text\","
+             "\"text\":\"{\\\"usage\\\":{}}\"}],\"usage\":{\"input_tokens\":%d,\"cache_creation_input_tokens\":0,"
+             "\"cache_read_input_tokens\":%d,\"output_tokens\":%d}}}\n",
+             Stamp(time).c_str(), id, input, cacheRead, output);
+    return buf;
+}
+
+static void Append(const fs::path& path, const std::string& text) {
+    std::ofstream f(path, std::ios::binary | std::ios::app);
+    f << text;
+}
+
+static void ParsesTurns() {
+    std::string line = Turn("msg_01", NOW, 120, 30, 5000);
+    LogRecord rec;
+    CHECK(ParseLogLine(line.data(), line.size() - 1, rec));
+    CHECK_EQ(rec.time, NOW);
+    CHECK_EQ(rec.tokens, 120u + 30u + 500u);
+    CHECK(rec.messageId != 0);
+
+    LogRecord other;
+    std::string again = Turn("msg_02", NOW, 120, 30, 5000);
+    CHECK(ParseLogLine(again.data(), again.size() - 1, other));
+    CHECK(other.messageId != rec.messageId);
+
+    const char* user = "{\"type\":\"user\",\"timestamp\":\"2026-02-04T21:00:00Z\",\"message\":{\"usage\":{\"input_tokens\":9}}}";
+    CHECK(!ParseLogLine(user, strlen(user), rec));
+    std::string empty = Turn("msg_03", NOW, 0, 0);
+    CHECK(!ParseLogLine(empty.data(), empty.size() - 1, rec));
+}
+
+static void WindowsRoll() {
+    TokenWindows w;
+    w.Add(NOW, 100);
+    w.Add(NOW - 3 * 3600, 10);                  // Late, still inside both
+    w.Add(NOW - 8 * 86400, 1000);               // Older than the week
+    CHECK_EQ(w.Sum5h(), 110u);
+    CHECK_EQ(w.Sum7d(), 110u);
+
+    w.AdvanceTo(NOW + 2 * 3600);
+    CHECK_EQ(w.Sum5h(), 100u);
+    w.AdvanceTo(NOW + 5 * 3600);
+    CHECK_EQ(w.Sum5h(), 0u);
+    CHECK_EQ(w.Sum7d(), 110u);
+
+    std::vector<uint8_t> bytes;
+    w.Serialize(bytes);
+    TokenWindows loaded;
+    const uint8_t* p = bytes.data();
+    CHECK(loaded.Deserialize(p, bytes.data() + bytes.size()));
+    CHECK_EQ(loaded.Sum7d(), 110u);
+    loaded.AdvanceTo(NOW + 7 * 86400);
+    CHECK_EQ(loaded.Sum7d(), 0u);
+}
+
+static fs::path Scratch(const char* name) {
+    fs::path dir = fs::temp_directory_path() / ("claudewatch-" + std::string(name) + "-" + std::to_string(getpid()));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    return dir;
+}
+
+static void TailsAppendedBytes() {
+    fs::path root = Scratch("logs");
+    fs::create_directories(root / "project");
+    fs::path session = root / "project" / "session.jsonl";
+
+    // A turn repeated once per content block, and a line still being written
+    std::string partial = Turn("msg_b", NOW - 3600, 40, 2);
+    Append(session, Turn("msg_a", NOW - 7200, 100, 10) + Turn("msg_a", NOW - 7200, 100, 10) +
+                    partial.substr(0, partial.size() / 2));
+
+    SessionLogTailer tailer;
+    tailer.SetRoot(root);
+    CHECK_EQ(tailer.ScanAll(NOW), 1u);
+    CHECK_EQ(tailer.Windows().Sum5h(), 110u);
+
+    Append(session, partial.substr(partial.size() / 2));
+    CHECK_EQ(tailer.Poll({ session }, NOW), 1u);
+    CHECK_EQ(tailer.Windows().Sum5h(), 152u);
+
+    // A record stamped days ahead counts as now and doesn't push the rest
+    // out of the 5-hour window
+    Append(session, Turn("msg_f", NOW + 3 * 86400, 1000, 0) + Turn("msg_g", NOW, 7, 0));
+    CHECK_EQ(tailer.Poll({ session }, NOW), 2u);
+    CHECK_EQ(tailer.Windows().Sum5h(), 1159u);
+    tailer.Windows().AdvanceTo(NOW + 60);
+    CHECK_EQ(tailer.Windows().Sum5h(), 1159u);
+
+    // Reloaded, nothing is read twice
+    SessionLogTailer loaded;
+    CHECK(loaded.Deserialize(tailer.Serialize()));
+    loaded.SetRoot(root);
+    CHECK_EQ(loaded.ScanAll(NOW + 60), 0u);
+    CHECK_EQ(loaded.Windows().Sum5h(), 1159u);
+    CHECK_EQ(loaded.FileCount(), 1u);
+
+    // A transcript untouched for over a week is skipped to its end; a
+    // deleted one is forgotten
+    fs::path old = root / "project" / "old.jsonl";
+    Append(old, Turn("msg_o", NOW, 5000, 0));
+    fs::last_write_time(old, fs::file_time_type::clock::now() - std::chrono::hours(24 * 8));
+    CHECK_EQ(loaded.ScanAll(NOW + 60), 0u);
+    CHECK_EQ(loaded.FileCount(), 2u);
+    fs::remove(session);
+    loaded.ScanAll(NOW + 60);
+    CHECK_EQ(loaded.FileCount(), 1u);
+
+    fs::remove_all(root);
+}
+
+// Drain until `done` holds or a second passes with nothing new
+template <typename Done>
+static bool Wait(LogWatcher& watcher, Done done) {
+    for (;;) {
+        watcher.Drain();
+        if (done()) return true;
+        pollfd pfd = { watcher.Fd(), POLLIN, 0 };
+        if (poll(&pfd, 1, 1000) <= 0) return false;
+    }
+}
+
+static void WatchesTree() {
+    fs::path root = Scratch("watch");
+    int changes = 0;
+    LogWatcher watcher;
+    CHECK(watcher.Start(root, [&changes]() { changes++; }));
+
+    fs::create_directories(root / "project");
+    Append(root / "project" / "a.jsonl", "{}\n");
+    std::vector<fs::path> changed;
+    bool complete = true;
+    CHECK(Wait(watcher, [&]() {
+        complete = watcher.TakeChanged(changed);
+        return !changed.empty();
+    }));
+    CHECK(complete);
+    CHECK(changed.size() == 1 && changed[0] == root / "project" / "a.jsonl");
+    CHECK(changes > 0);
+
+    watcher.Stop();
+    fs::remove_all(root);
+}
+
+// Before Claude Code's first run: nothing under the home directory yet. Each
+// level appearing is noticed, and the tree arriving asks for a full scan.
+static void WaitsForMissingTree() {
+    fs::path home = Scratch("home");
+    fs::path root = home / ".claude" / "projects";
+    LogWatcher watcher;
+    CHECK(watcher.Start(root, nullptr));
+    std::vector<fs::path> changed;
+    CHECK(watcher.TakeChanged(changed));
+
+    fs::create_directory(home / ".claude");
+    watcher.Drain();
+    CHECK(watcher.TakeChanged(changed));
+
+    fs::create_directory(root);
+    CHECK(Wait(watcher, [&]() { return !watcher.TakeChanged(changed); }));
+
+    // From here it's an ordinary watched tree
+    fs::create_directories(root / "project");
+    Append(root / "project" / "b.jsonl", "{}\n");
+    CHECK(Wait(watcher, [&]() { return watcher.TakeChanged(changed) && !changed.empty(); }));
+    CHECK(changed.size() == 1 && changed[0] == root / "project" / "b.jsonl");
+
+    // Nothing at all on the way down is an error
+    LogWatcher nowhere;
+    CHECK(!nowhere.Start("no-such-dir/.claude/projects", nullptr));
+
+    watcher.Stop();
+    fs::remove_all(home);
+}
+
+static void ParseCost() {
+    // Real assistant lines carry the whole reply; most lines aren't turns
+    std::string turn = Turn("msg_x", NOW, 1200, 800, 40000);
+    turn.insert(turn.find("\"text\":\"") + 8, std::string(4000, 'x'));
+    std::string user = "{\"type\":\"user\",\"message\":{\"content\":\"" + std::string(2000, 'y') + "\"}}";
+
+    const int runs = 200000;
+    uint64_t tokens = 0;
+    LogRecord rec;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        const std::string& line = i % 4 ? user : turn;
+        if (ParseLogLine(line.data(), line.size(), rec)) tokens += rec.tokens;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+    size_t bytes = (turn.size() + 3 * user.size()) / 4;
+    printf("ParseLogLine: %.0f ns per line, %.2f GB/s\n", ns, bytes / ns);
+    CHECK_EQ(tokens, (uint64_t)runs / 4 * 6000);
+}
+
+int main() {
+    ParsesTurns();
+    WindowsRoll();
+    TailsAppendedBytes();
+    WatchesTree();
+    WaitsForMissingTree();
+    ParseCost();
+    return CheckResult();
+}
@@ -0,0 +1,93 @@
+// The refresh simulator: the same trace, seed and faults give the same report
+// every time, and a fixed 10-minute poll over a flat trace costs 144 requests
+// a day without missing a crossing
+#include "check.h"
+#include "simulate.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const int64_t START = 1770238800;    // 2026-02-04 21:00 UTC
+
+static RefreshPolicy Policy(const char* text) {
+    RefreshPolicy policy;
+    policy.name = text;
+    CHECK(RefreshPolicy::Parse(text, policy));
+    return policy;
+}
+
+// Every kind of trouble at once, at rates that land many times in two weeks
+static FaultModel Faults(uint32_t seed) {
+    FaultModel faults;
+    faults.offline = 0.02;
+    faults.serverError = 0.01;
+    faults.authError = 0.005;
+    faults.noOrg = 0.2;
+    faults.outagesPerDay = 2;
+    faults.clockStepsPerDay = 1;
+    faults.sleepsPerDay = 1;
+    faults.awayFrom = 23;
+    faults.awayTo = 7;
+    faults.seed = seed;
+    return faults;
+}
+
+static std::string Run(const UsageTrace& trace, const FaultModel& faults) {
+    std::vector<SimulationReport> reports;
+    for (const char* text : { "smart", "fixed:60" }) {
+        reports.push_back(RunSimulation(trace, Policy(text), faults, 90.0f));
+    }
+    return FormatSimulationReport(reports, 90.0f, QueryFormat::Csv);
+}
+
+static void Deterministic() {
+    UsageTrace trace = UsageTrace::Synthetic(14, 7, 3600);
+    std::string first = Run(trace, Faults(3));
+    CHECK(first == Run(trace, Faults(3)));
+
+    // Not vacuous: the faults fired, and another seed draws them differently
+    SimulationReport report = RunSimulation(trace, Policy("smart"), Faults(3), 90.0f);
+    CHECK(report.failures > 0);
+    CHECK(report.crossings > 0);
+    CHECK(first != Run(trace, Faults(4)));
+}
+
+// 50% for ten days, with one step past the threshold halfway that holds
+static void FixedCadence() {
+    const int days = 10;
+    UsageTrace trace;
+    trace.points.push_back({ START, 50.0f, 20.0f, 0, 0 });
+    trace.points.push_back({ START + days * 86400 / 2, 95.0f, 20.0f, 0, 0 });
+    trace.points.push_back({ START + days * 86400, 95.0f, 20.0f, 0, 0 });
+
+    FaultModel faults;
+    SimulationReport report = RunSimulation(trace, Policy("fixed:600"), faults, 90.0f);
+    CHECK(report.days == days);
+    CHECK_EQ((long)std::lround(report.requests / report.days), 144L);
+    CHECK_EQ(report.failures, 0u);
+    CHECK_EQ(report.crossings, 1u);
+    CHECK_EQ(report.missed, 0u);
+    CHECK(report.crossingMax <= 601.0f);
+    CHECK_EQ(report.resets, 0u);
+    CHECK(report.staleP99 <= 601.0f);
+}
+
+static void Throughput() {
+    const int days = 180;
+    UsageTrace trace = UsageTrace::Synthetic(days, 1, 0);
+    FaultModel faults = Faults(1);
+    auto start = std::chrono::steady_clock::now();
+    SimulationReport report = RunSimulation(trace, Policy("smart"), faults, 90.0f);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("simulate: %d days with faults in %.1f ms (%.0f requests)\n", days, ms, (double)report.requests);
+    CHECK(report.requests > 0);
+}
+
+int main() {
+    Deterministic();
+    FixedCadence();
+    Throughput();
+    return CheckResult();
+}
@@ -0,0 +1,105 @@
+// Sparkline against a brute-force min/max over the same samples, and the
+// per-sample cost over millions of them
+#include "check.h"
+#include "sparkline.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// xorshift64*, repeatable
+static uint64_t Next(uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+struct Sample {
+    int64_t time;
+    float value;
+};
+
+// Every column compared with the samples that fall in it
+static int CompareWithSamples(const Sparkline& line, const std::vector<Sample>& samples, int64_t head,
+                              int64_t bucketSec) {
+    int mismatches = 0;
+    for (int i = 0; i < line.Buckets(); i++) {
+        int64_t bucket = head - (line.Buckets() - 1 - i);
+        bool used = false;
+        float lo = 0, hi = 0;
+        for (const Sample& s : samples) {
+            if (s.time / bucketSec != bucket) continue;
+            lo = used && lo < s.value ? lo : s.value;
+            hi = used && hi > s.value ? hi : s.value;
+            used = true;
+        }
+        float min = 0, max = 0;
+        bool got = line.Get(i, min, max);
+        if (got != used || (got && (min != lo || max != hi))) mismatches++;
+    }
+    return mismatches;
+}
+
+static void MatchesBruteForce() {
+    uint64_t rng = 31;
+    const int64_t window = 5 * 3600;
+    const int columns = 60;
+    Sparkline line(window, columns);
+    std::vector<Sample> samples;
+    int64_t t = 1770000000;
+    for (int i = 0; i < 5000; i++) {
+        // Mostly a minute apart, sometimes a gap longer than the window,
+        // sometimes a sample that arrives late
+        uint64_t r = Next(rng) % 100;
+        t += r < 2 ? window + 600 : 60;
+        int64_t at = r >= 95 ? t - (int64_t)(Next(rng) % 3600) : t;
+        float value = (float)(Next(rng) % 10000) / 100.0f;
+        line.Add(at, value);
+        samples.push_back({ at, value });
+    }
+    CHECK_EQ(CompareWithSamples(line, samples, t / (window / columns), window / columns), 0);
+
+    // Sliding forward with no samples empties the columns it passes
+    line.AdvanceTo(t + window / 2);
+    CHECK_EQ(CompareWithSamples(line, samples, (t + window / 2) / (window / columns), window / columns), 0);
+    line.AdvanceTo(t + 2 * window);
+    float min, max;
+    for (int i = 0; i < columns; i++) CHECK(!line.Get(i, min, max));
+}
+
+static void ResetDropsHistory() {
+    Sparkline line(3600, 10);
+    line.Add(1000, 5.0f);
+    float min = 0, max = 0;
+    CHECK(line.Get(9, min, max));
+    line.Reset(7 * 86400, 80);
+    CHECK_EQ(line.Buckets(), 80);
+    CHECK(!line.Get(79, min, max));
+}
+
+static void MillionsOfSamples() {
+    const int count = 10000000;
+    Sparkline line(7 * 86400, 120);
+    uint64_t rng = 5;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) line.Add(1770000000 + i * 6, (float)(Next(rng) & 0xFFFF) / 655.35f);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+
+    // Reading the whole line is the paint cost; it doesn't grow with history
+    start = std::chrono::steady_clock::now();
+    float sum = 0, min, max;
+    for (int i = 0; i < line.Buckets(); i++) {
+        if (line.Get(i, min, max)) sum += max - min;
+    }
+    double readUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    printf("sparkline: %d samples at %.1f ns each, %d columns read in %.2f us\n", count, ns, line.Buckets(),
+           readUs);
+    CHECK(sum > 0);
+}
+
+int main() {
+    MatchesBruteForce();
+    ResetDropsHistory();
+    MillionsOfSamples();
+    return CheckResult();
+}
@@ -0,0 +1,250 @@
+// SubscriptionHub over a scratch socket: the snapshot on connect, deltas of
+// only what changed, silence for no change, coalesced publishes, one reset
+// line per deadline, and a subscriber that stops reading being dropped
+#include "check.h"
+#include "subscribe.h"
+#include "socket_util.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static int64_t WallMs() {
+    return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string SocketPath() {
+    return (fs::temp_directory_path() / ("claudewatch-subscribe-" + std::to_string(getpid()) + ".sock")).string();
+}
+
+// One subscriber's side of the socket
+class Client {
+public:
+    explicit Client(const std::string& path) {
+        std::string error;
+        m_s = ConnectUnix(path, error);
+        CHECK(m_s != INVALID_SOCKET_HANDLE);
+    }
+    ~Client() { CloseSocket(m_s); }
+
+    // The next line, or "" if none arrives within the timeout
+    std::string Line(int timeoutMs = 2000) {
+        auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        for (;;) {
+            size_t nl = m_buffer.find('\n');
+            if (nl != std::string::npos) {
+                std::string line = m_buffer.substr(0, nl);
+                m_buffer.erase(0, nl + 1);
+                return line;
+            }
+            int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                until - std::chrono::steady_clock::now()).count();
+            pollfd pfd = { m_s, POLLIN, 0 };
+            if (left <= 0 || poll(&pfd, 1, left) <= 0) return "";
+            char buf[4096];
+            ssize_t n = recv(m_s, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                m_closed = true;
+                return "";
+            }
+            m_buffer.append(buf, (size_t)n);
+        }
+    }
+
+    bool Closed() const { return m_closed; }
+
+private:
+    SocketHandle m_s;
+    std::string m_buffer;
+    bool m_closed = false;
+};
+
+static bool Has(const std::string& line, const char* text) {
+    return line.find(text) != std::string::npos;
+}
+
+// Until the hub has accepted `count` subscribers
+static void WaitOpen(const SubscriptionHub& hub, uint64_t count) {
+    while (hub.GetStats().open < count) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+static UsageState Usage(float session, float period) {
+    UsageState state;
+    state.valid = true;
+    state.session = session;
+    state.period = period;
+    return state;
+}
+
+static void SnapshotThenDeltas() {
+    SubscriptionHub hub;
+    std::string error;
+    CHECK(hub.Start(SocketPath(), error));
+
+    // Nothing to say before the first publish
+    Client early(SocketPath());
+    WaitOpen(hub, 1);
+    CHECK(early.Line(100).empty());
+    hub.Publish(Usage(42.0f, 10.0f));
+    std::string line = early.Line();
+    CHECK(Has(line, "\"seq\":1,\"type\":\"snapshot\""));
+
+    // A late joiner gets the whole state at once
+    Client late(SocketPath());
+    line = late.Line();
+    CHECK(Has(line, "\"type\":\"snapshot\""));
+    CHECK(Has(line, "\"valid\":true"));
+    CHECK(Has(line, "\"session\":42.0,\"period\":10.0"));
+    CHECK(Has(line, "\"error\":\"\"}"));
+
+    // Only the changed field, to everyone
+    hub.Publish(Usage(43.0f, 10.0f));
+    for (Client* c : { &early, &late }) {
+        line = c->Line();
+        CHECK(Has(line, "\"seq\":2,\"type\":\"delta\""));
+        CHECK(Has(line, ",\"session\":43.0}"));
+        CHECK(!Has(line, "period"));
+    }
+
+    // The same state, or a wiggle under 0.1%, sends nothing
+    hub.Publish(Usage(43.0f, 10.0f));
+    hub.Publish(Usage(43.02f, 10.04f));
+    CHECK(early.Line(200).empty());
+
+    UsageState offline = Usage(43.0f, 10.0f);
+    offline.offline = true;
+    offline.error = "No \"network\"";
+    hub.Publish(offline);
+    line = late.Line();
+    CHECK(Has(line, "\"seq\":3,\"type\":\"delta\""));
+    CHECK(Has(line, ",\"offline\":true,\"error\":\"No \\\"network\\\"\"}"));
+
+    hub.Stop();
+    CHECK(late.Line().empty() && late.Closed());
+    CHECK(!fs::exists(SocketPath()));
+}
+
+static void CoalescesBursts() {
+    SubscriptionHub hub;
+    std::string error;
+    CHECK(hub.Start(SocketPath(), error));
+    hub.Publish(Usage(0.0f, 0.0f));
+    Client c(SocketPath());
+    CHECK(Has(c.Line(), "snapshot"));
+
+    // Far faster than the hub turns around; the last value always arrives
+    const int burst = 20000;
+    int deltas = 0;
+    std::string last;
+    std::thread reader([&]() {
+        for (std::string line; !(line = c.Line(1000)).empty() && !Has(line, "\"session\":77.0");) deltas++;
+        last = "done";
+    });
+    for (int i = 1; i <= burst; i++) hub.Publish(Usage((float)(i % 2) * 50.0f, 1.0f));
+    hub.Publish(Usage(77.0f, 1.0f));
+    reader.join();
+    CHECK(last == "done" && !c.Closed());
+    SubscriptionHub::Stats stats = hub.GetStats();
+    CHECK_EQ(stats.published, (uint64_t)burst + 2);
+    CHECK(deltas < burst / 2);
+    CHECK_EQ(stats.messages, (uint64_t)deltas + 2);
+    CHECK_EQ(stats.dropped, 0u);
+    hub.Stop();
+}
+
+static void OneResetPerDeadline() {
+    SubscriptionHub hub;
+    std::string error;
+    CHECK(hub.Start(SocketPath(), error));
+    Client c(SocketPath());
+    WaitOpen(hub, 1);
+
+    UsageState state = Usage(90.0f, 50.0f);
+    int64_t deadline = WallMs() + 300;
+    state.sessionResetMs = deadline;
+    state.periodResetMs = WallMs() - 1000;      // Already passed when it's first seen
+    hub.Publish(state);
+    CHECK(Has(c.Line(), "snapshot"));
+    CHECK(Has(c.Line(), "\"type\":\"reset\",\"time\""));     // The period, at once
+
+    std::string line = c.Line();
+    CHECK(Has(line, "\"window\":\"session\""));
+    CHECK(Has(line, "\"seq\":3"));
+    CHECK(WallMs() >= deadline);
+
+    // Republishing the same deadlines announces nothing again
+    hub.Publish(state);
+    CHECK(c.Line(400).empty());
+
+    // A new deadline is its own reset
+    state.sessionResetMs = WallMs() + 100;
+    state.session = 0.0f;
+    hub.Publish(state);
+    CHECK(Has(c.Line(), "\"type\":\"delta\""));
+    CHECK(Has(c.Line(), "\"window\":\"session\""));
+    CHECK(c.Line(300).empty());
+    hub.Stop();
+}
+
+// One subscriber stops reading while another keeps up; only the stalled one
+// is cut off, once its socket buffer and queue are full
+static void DropsStalledSubscriber() {
+    SubscriptionHub hub;
+    std::string error;
+    CHECK(hub.Start(SocketPath(), error));
+    hub.Publish(Usage(0.0f, 0.0f));
+    Client stalled(SocketPath());
+
+    std::atomic<int> read{ 0 };
+    std::atomic<bool> done{ false };
+    std::thread reader([&]() {
+        Client c(SocketPath());
+        while (!done.load()) {
+            if (!c.Line(100).empty()) read++;
+        }
+        CHECK(!c.Closed());
+    });
+    WaitOpen(hub, 2);
+
+    // Big messages fill the stalled socket quickly
+    UsageState state = Usage(0.0f, 0.0f);
+    int sent = 0;
+    for (int i = 0; i < 2000 && hub.GetStats().dropped == 0; i++) {
+        state.error.assign(4000, (char)('a' + i % 26));
+        uint64_t before = hub.GetStats().messages;
+        hub.Publish(state);
+        while (hub.GetStats().messages == before) std::this_thread::yield();
+        sent++;
+    }
+    SubscriptionHub::Stats stats = hub.GetStats();
+    CHECK_EQ(stats.dropped, 1u);
+    CHECK_EQ(stats.open, 1u);
+
+    // The stalled subscriber reads what was already sent, then the hang-up
+    int backlog = 0;
+    while (!stalled.Line(1000).empty()) backlog++;
+    CHECK(stalled.Closed());
+    CHECK(backlog > 0 && backlog <= sent);
+
+    while (read.load() < sent) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    done = true;
+    reader.join();
+    hub.Stop();
+}
+
+int main() {
+    InitSockets();
+    fs::remove(SocketPath());
+    SnapshotThenDeltas();
+    CoalescesBursts();
+    OneResetPerDeadline();
+    DropsStalledSubscriber();
+    return CheckResult();
+}
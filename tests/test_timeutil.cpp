@@ -0,0 +1,150 @@
+// ISO-8601 parsing against timegm over random dates, reset deadlines and
+// clock-jump detection on injected clock samples
+#include "check.h"
+#include "timeutil.h"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+// xorshift64*, repeatable
+static uint64_t Next(uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+static void MatchesTimegm() {
+    uint64_t rng = 2026;
+    const int runs = 2000000;
+    char text[64];
+    int mismatches = 0;
+    for (int i = 0; i < runs; i++) {
+        tm t = {};
+        t.tm_year = 1970 + (int)(Next(rng) % 400) - 1900;
+        t.tm_mon = (int)(Next(rng) % 12);
+        t.tm_mday = 1 + (int)(Next(rng) % 31);
+        t.tm_hour = (int)(Next(rng) % 24);
+        t.tm_min = (int)(Next(rng) % 60);
+        t.tm_sec = (int)(Next(rng) % 60);
+        int ms = (int)(Next(rng) % 1000);
+        int offsetMin = (int)(Next(rng) % (2 * 14 * 60 + 1)) - 14 * 60;
+
+        int n = snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02d.%03d", t.tm_year + 1900,
+                         t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, ms);
+        if (i % 3 == 0) {
+            n += snprintf(text + n, sizeof(text) - n, "Z");
+            offsetMin = 0;
+        } else {
+            n += snprintf(text + n, sizeof(text) - n, "%c%02d:%02d", offsetMin < 0 ? '-' : '+',
+                          (offsetMin < 0 ? -offsetMin : offsetMin) / 60,
+                          (offsetMin < 0 ? -offsetMin : offsetMin) % 60);
+        }
+
+        // timegm normalizes Feb 30 into March; the parser must refuse it
+        int mday = t.tm_mday, mon = t.tm_mon;
+        int64_t expected = ((int64_t)timegm(&t) - offsetMin * 60) * 1000 + ms;
+        bool valid = t.tm_mday == mday && t.tm_mon == mon;
+
+        int64_t got = 0;
+        bool ok = ParseIso8601(text, (size_t)n, got);
+        if (ok != valid || (ok && got != expected)) {
+            if (mismatches++ < 5) printf("mismatch: %s -> %lld, want %lld\n", text, (long long)got,
+                                         (long long)expected);
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+static void RejectsMalformed() {
+    const char* bad[] = { "2026-02-30T00:00:00Z", "2026-01-01T24:00:00Z", "2026-01-01T00:00:00.Z",
+                          "2026-01-01T00:00:00+5", "2026-01-01T00:00:00X", "2026-1-01T00:00:00Z",
+                          "2026-01-01T00:00" };
+    int64_t ms;
+    for (const char* text : bad) CHECK(!ParseIso8601(std::string(text), ms));
+
+    CHECK(ParseIso8601(std::string("2026-02-04T21:00:00.123456+0530"), ms));
+    CHECK_EQ(ms, 1770238800123LL - 5 * 3600000LL - 30 * 60000LL);   // 21:00 UTC less 5:30
+}
+
+static void ParseSpeed() {
+    const std::string text = "2026-02-04T21:00:00.571836+00:00";
+    const int runs = 1000000;
+    int64_t sum = 0, ms = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        ParseIso8601(text.data(), text.size() - (size_t)(i & 1) * 6, ms);
+        sum += ms;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+    printf("ParseIso8601: %.1f ns per call (%lld)\n", ns, (long long)(sum & 1));
+}
+
+static void PastResetIsIgnored() {
+    ClockSample now;
+    now.wallMs = 1770219000000LL;
+    now.bootMs = 50000;
+    now.activeMs = 50000;
+
+    ResetDeadline deadline;
+    CHECK(deadline.Anchor(now.wallMs + 90000, now));
+    CHECK_EQ(deadline.RemainingMs(now), 90000);
+
+    // The server still reporting the window that just ended
+    CHECK(!deadline.Anchor(now.wallMs - 1000, now));
+    CHECK(!deadline.IsSet());
+    CHECK(!deadline.Anchor(now.wallMs, now));
+    CHECK(!deadline.IsSet());
+}
+
+static void DeadlineSurvivesWallJumpAndSleep() {
+    ClockSample now;
+    now.wallMs = 1770219000000LL;
+    now.bootMs = 50000;
+    now.activeMs = 50000;
+    ResetDeadline deadline;
+    deadline.Anchor(now.wallMs + 3600000, now);
+
+    ClockMonitor monitor;
+    CHECK(monitor.Observe(now) == ClockEvent::None);
+
+    // A minute later the wall clock is set back an hour
+    now.wallMs += 60000 - 3600000;
+    now.bootMs += 60000;
+    now.activeMs += 60000;
+    CHECK(monitor.Observe(now) == ClockEvent::WallJump);
+    CHECK_EQ(monitor.LastJumpMs(), -3600000);
+    CHECK_EQ(deadline.RemainingMs(now), 3540000);
+
+    // Twenty minutes asleep
+    now.wallMs += 1200000;
+    now.bootMs += 1200000;
+    now.activeMs += 1000;
+    CHECK(monitor.Observe(now) == ClockEvent::Resumed);
+    CHECK_EQ(deadline.RemainingMs(now), 2340000);
+
+    now.wallMs += 1000;
+    now.bootMs += 1000;
+    now.activeMs += 1000;
+    CHECK(monitor.Observe(now) == ClockEvent::None);
+}
+
+static void CountdownSteps() {
+    CHECK_EQ(CountdownDelayMs(90000, 5000), 30000);
+    CHECK_EQ(CountdownDelayMs(60000, 5000), 60000);
+    CHECK_EQ(CountdownDelayMs(0, 5000), 5000);
+    CHECK_EQ(CountdownDelayMs(-2000, 5000), 3000);
+    CHECK(FormatCountdown(1) == L"Resets in 1m");
+    CHECK(FormatCountdown(0) == L"Resetting...");
+    CHECK(FormatCountdown((26 * 60 + 1) * 60000LL) == L"Resets in 1d 2h");
+}
+
+int main() {
+    MatchesTimegm();
+    RejectsMalformed();
+    ParseSpeed();
+    PastResetIsIgnored();
+    DeadlineSurvivesWallJumpAndSleep();
+    CountdownSteps();
+    return CheckResult();
+}
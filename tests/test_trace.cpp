@@ -0,0 +1,174 @@
+// Trace rings through the Chrome export: spans and instants, wrapping, ring
+// reuse by short-lived threads, snapshots taken while writers run, and the
+// per-event cost
+#include "check.h"
+#include "file_util.h"
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct Exported {
+    std::string name;
+    char phase;
+    double ts;
+    unsigned tid;
+    unsigned arg;
+};
+
+// Just enough of a reader for the export's own fixed layout
+static std::vector<Exported> Events(const std::string& json) {
+    std::vector<Exported> events;
+    const std::string open = "{\"name\":\"";
+    for (size_t at = json.find(open); at != std::string::npos; at = json.find(open, at + 1)) {
+        size_t nameEnd = json.find('"', at + open.size());
+        Exported e;
+        e.name = json.substr(at + open.size(), nameEnd - at - open.size());
+        if (e.name == "thread_name") {
+            at = json.find("}}", at);
+            continue;
+        }
+        const char* s = json.c_str() + nameEnd;
+        e.phase = strstr(s, "\"ph\":\"")[6];
+        e.ts = strtod(strstr(s, "\"ts\":") + 5, nullptr);
+        e.tid = (unsigned)strtoul(strstr(s, "\"tid\":") + 6, nullptr, 10);
+        e.arg = (unsigned)strtoul(strstr(s, "\"arg\":") + 6, nullptr, 10);
+        events.push_back(e);
+    }
+    return events;
+}
+
+static std::vector<Exported> Named(const std::vector<Exported>& events, const char* name) {
+    std::vector<Exported> out;
+    for (const Exported& e : events) {
+        if (e.name == name) out.push_back(e);
+    }
+    return out;
+}
+
+static void SpansAndInstants() {
+    TraceSetThreadName("UI \"main\"");
+    {
+        TraceSpan span(TraceEvent::Refresh, 7);
+        TraceInstant(TraceEvent::HttpStatus, 200);
+        span.Next(TraceEvent::Parse);
+        span.SetResult(3);
+    }
+
+    std::string json = TraceExportJson();
+    CHECK(json.find("\"args\":{\"name\":\"UI \\\"main\\\"\"}") != std::string::npos);
+    CHECK(json.size() > 3 && json.compare(json.size() - 3, 3, "]}\n") == 0);
+
+    std::vector<Exported> events = Events(json);
+    CHECK_EQ(events.size(), 5u);
+    if (events.size() != 5) return;
+    const char* names[] = { "Refresh", "HTTP status", "Refresh", "Parse", "Parse" };
+    const char phases[] = { 'B', 'i', 'E', 'B', 'E' };
+    const unsigned args[] = { 7, 200, 0, 0, 3 };
+    for (size_t i = 0; i < 5; i++) {
+        CHECK(events[i].name == names[i]);
+        CHECK_EQ(events[i].phase, phases[i]);
+        CHECK_EQ(events[i].arg, args[i]);
+        CHECK_EQ(events[i].tid, events[0].tid);
+        if (i > 0) CHECK(events[i].ts >= events[i - 1].ts);
+    }
+    CHECK_EQ(events[0].ts, 0.0);
+    CHECK(json.find("\"s\":\"t\"") != std::string::npos);
+}
+
+// A wrapped ring keeps its newest events; the slot the writer may be in is
+// left out
+static void WrapKeepsNewest() {
+    std::thread([]() {
+        for (uint32_t i = 0; i < 10000; i++) TraceInstant(TraceEvent::TimerFire, i);
+    }).join();
+
+    std::vector<Exported> fired = Named(Events(TraceExportJson()), "Timer fire");
+    CHECK_EQ(fired.size(), 4095u);
+    if (fired.empty()) return;
+    CHECK_EQ(fired.front().arg, 10000u - 4095u);
+    CHECK_EQ(fired.back().arg, 9999u);
+}
+
+// Threads that come and go share the lane of one that has exited, so the
+// ring count follows the peak thread count, not the total
+static void ExitedThreadsShareALane() {
+    for (int i = 0; i < 50; i++) {
+        std::thread([]() { TraceSpan span(TraceEvent::HttpConnect); }).join();
+    }
+    std::set<unsigned> lanes;
+    for (const Exported& e : Named(Events(TraceExportJson()), "HTTP connect")) lanes.insert(e.tid);
+    CHECK_EQ(lanes.size(), 1u);
+}
+
+// Snapshots taken while four threads trace flat out: every lane comes back in
+// time order, and each writer's args run without gaps or repeats
+static void SnapshotsWhileWriting() {
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 4; w++) {
+        writers.emplace_back([&stop]() {
+            TraceSetThreadName("Writer");
+            for (uint32_t i = 0; !stop.load(std::memory_order_relaxed); i++) TraceInstant(TraceEvent::Paint, i);
+        });
+    }
+
+    int torn = 0, snapshots = 0;
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+    while (std::chrono::steady_clock::now() < until) {
+        std::vector<Exported> painted = Named(Events(TraceExportJson()), "Paint");
+        snapshots++;
+        for (size_t i = 1; i < painted.size(); i++) {
+            if (painted[i].tid != painted[i - 1].tid) continue;
+            if (painted[i].arg != painted[i - 1].arg + 1 || painted[i].ts < painted[i - 1].ts) torn++;
+        }
+    }
+    stop = true;
+    for (std::thread& t : writers) t.join();
+    CHECK(snapshots > 0);
+    CHECK_EQ(torn, 0);
+}
+
+static void WritesFile() {
+    std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / ("claudewatch-trace-" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+    CHECK(TraceWriteFile(dir / "trace.json"));
+    std::vector<uint8_t> bytes;
+    CHECK(ReadFileBytes(dir / "trace.json", bytes));
+    std::string json(bytes.begin(), bytes.end());
+    CHECK(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+    CHECK(!Events(json).empty());
+    std::filesystem::remove_all(dir);
+}
+
+static void EventCost() {
+    const int runs = 10000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs / 2; i++) {
+        TraceSpan span(TraceEvent::Paint, (uint32_t)i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+
+    start = std::chrono::steady_clock::now();
+    std::string json = TraceExportJson();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("trace: %.1f ns per event, export %zu KB in %.1f ms\n", ns, json.size() / 1024, ms);
+}
+
+int main() {
+    SpansAndInstants();
+    WrapKeepsNewest();
+    ExitedThreadsShareALane();
+    SnapshotsWhileWriting();
+    WritesFile();
+    EventCost();
+    return CheckResult();
+}
@@ -0,0 +1,99 @@
+// Usage icon rendering at fixed points on the ring, and the handle cache's
+// lifetime rules with counting create/destroy callbacks
+#include "check.h"
+#include "tray_icon.h"
+#include <chrono>
+#include <cstdio>
+#include <set>
+
+static const uint32_t ORANGE = 0xE08030;
+static const uint32_t OPAQUE = 0xFF000000;
+
+static uint32_t Pixel(const IconImage& img, int x, int y) {
+    return img.pixels[(size_t)y * img.size + x];
+}
+
+static void RingFollowsPercent() {
+    IconImage half = RenderUsageIcon(50, 32, ORANGE);
+    CHECK_EQ(half.size, 32);
+    CHECK_EQ(half.pixels.size(), 32u * 32u);
+
+    // Outside the disc, the disc itself, then the ring either side of it
+    CHECK_EQ(Pixel(half, 0, 0), 0u);
+    CHECK_EQ(Pixel(half, 16, 16), OPAQUE | 0x1E1E23);
+    CHECK_EQ(Pixel(half, 27, 15), OPAQUE | ORANGE);
+    CHECK_EQ(Pixel(half, 4, 15), OPAQUE | 0x3C3C41);
+
+    IconImage empty = RenderUsageIcon(0, 32, ORANGE);
+    IconImage full = RenderUsageIcon(100, 32, ORANGE);
+    CHECK_EQ(Pixel(empty, 27, 15), OPAQUE | 0x3C3C41);
+    CHECK_EQ(Pixel(full, 4, 15), OPAQUE | ORANGE);
+
+    // Out-of-range percentages are clamped, not wrapped
+    CHECK(RenderUsageIcon(-20, 32, ORANGE).pixels == empty.pixels);
+    CHECK(RenderUsageIcon(140, 32, ORANGE).pixels == full.pixels);
+
+    // The edge is anti-aliased: some pixels are neither clear nor opaque
+    int partial = 0;
+    for (uint32_t p : half.pixels) {
+        uint32_t a = p >> 24;
+        if (a != 0 && a != 255) partial++;
+    }
+    CHECK(partial > 0);
+}
+
+static int g_created = 0;
+static std::set<intptr_t> g_live;
+
+static UsageIconCache MakeCache() {
+    return UsageIconCache(16,
+        [](const IconImage& img) {
+            CHECK_EQ(img.size, 16);
+            g_live.insert(++g_created);
+            return (void*)(intptr_t)g_created;
+        },
+        [](void* handle) {
+            CHECK_EQ(g_live.erase((intptr_t)handle), 1u);
+        });
+}
+
+static void CacheKeysAndLifetime() {
+    g_created = 0;
+    {
+        UsageIconCache cache = MakeCache();
+        void* a = cache.Get(42, ORANGE);
+        CHECK(cache.Get(42, ORANGE) == a);
+        CHECK(cache.Get(43, ORANGE) != a);
+        CHECK(cache.Get(42, 0x787878) != a);
+        CHECK(cache.Get(150, ORANGE) == cache.Get(100, ORANGE));
+        CHECK(cache.Get(-5, ORANGE) == cache.Get(0, ORANGE));
+        CHECK_EQ(g_created, 5);
+        CHECK_EQ(cache.Count(), 5u);
+        CHECK_EQ(g_live.size(), 5u);
+
+        cache.Clear();
+        CHECK_EQ(cache.Count(), 0u);
+        CHECK(g_live.empty());
+        CHECK(cache.Get(42, ORANGE) != a);
+        cache.Get(7, ORANGE);
+    }
+    // The destructor releases what's left
+    CHECK(g_live.empty());
+}
+
+static void RenderCost() {
+    const int sizes[] = { 16, 24, 32 };
+    for (int size : sizes) {
+        auto start = std::chrono::steady_clock::now();
+        for (int percent = 0; percent <= 100; percent++) RenderUsageIcon(percent, size, ORANGE);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        printf("tray icon: %dx%d rendered in %.1f us\n", size, size, us / 101);
+    }
+}
+
+int main() {
+    RingFollowsPercent();
+    CacheKeysAndLifetime();
+    RenderCost();
+    return CheckResult();
+}
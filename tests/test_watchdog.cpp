@@ -0,0 +1,152 @@
+// StallMonitor driven by a synthetic loop on this thread: the watchdog's
+// pings land in a flag the loop checks between messages
+#include "check.h"
+#include "watchdog.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+static const uint32_t MSG_PING = 0x8004;
+static const uint32_t MSG_WORK = 0x0400;
+
+static std::atomic<int> g_posted{ 0 };
+static std::atomic<bool> g_pending{ false };
+
+static void Sleep(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static void Dispatch(StallMonitor& monitor, uint32_t message, int workMs = 0, const char* label = nullptr) {
+    monitor.BeginDispatch(message);
+    if (label) {
+        StallScope scope(monitor, label);
+        Sleep(workMs);
+    } else if (workMs) {
+        Sleep(workMs);
+    }
+    monitor.EndDispatch();
+}
+
+// Answer a posted ping the way the widget's WndProc does
+static void PumpPing(StallMonitor& monitor) {
+    if (!g_pending.exchange(false)) return;
+    monitor.BeginDispatch(MSG_PING);
+    monitor.OnPing();
+    monitor.EndDispatch();
+}
+
+static void Start(StallMonitor& monitor) {
+    monitor.stallThresholdMs = 40;
+    monitor.pingIntervalMs = 100;
+    g_posted = 0;
+    g_pending = false;
+    monitor.Start([]() {
+        g_posted++;
+        g_pending = true;
+    });
+}
+
+static void SlowHandlerIsNamed() {
+    StallMonitor monitor;
+    Start(monitor);
+    Dispatch(monitor, MSG_WORK, 150, "History compact/save");
+    monitor.Stop();
+
+    std::vector<StallRecord> stalls = monitor.Stalls();
+    CHECK_EQ(stalls.size(), 1u);
+    if (!stalls.empty()) {
+        CHECK_EQ(stalls[0].message, MSG_WORK);
+        CHECK(stalls[0].label && strcmp(stalls[0].label, "History compact/save") == 0);
+        CHECK(stalls[0].durationMs >= 150);
+    }
+}
+
+static void BusyLoopIsPinged() {
+    StallMonitor monitor;
+    Start(monitor);
+    for (int i = 0; i < 60; i++) {
+        Dispatch(monitor, MSG_WORK + 1, 10);
+        PumpPing(monitor);
+    }
+    monitor.Stop();
+    CHECK(g_posted >= 3);
+    CHECK_EQ(monitor.Pings(), (uint64_t)g_posted.load());
+    CHECK_EQ(monitor.StallCount(), 0);
+}
+
+// Nothing dispatched: no pings, and the pings' own dispatches don't keep
+// it going
+static void IdleLoopIsLeftAlone() {
+    StallMonitor monitor;
+    Start(monitor);
+    Dispatch(monitor, MSG_WORK);
+    for (int i = 0; i < 60; i++) {
+        Sleep(10);
+        PumpPing(monitor);
+    }
+    int afterWork = g_posted;
+    CHECK(afterWork <= 1);
+    for (int i = 0; i < 60; i++) {
+        Sleep(10);
+        PumpPing(monitor);
+    }
+    CHECK_EQ(g_posted.load(), afterWork);
+
+    // The first dispatch wakes it again, and a slow one is still caught
+    Dispatch(monitor, MSG_WORK + 2, 120, "Session log startup scan");
+    monitor.Stop();
+    std::vector<StallRecord> stalls = monitor.Stalls();
+    CHECK_EQ(stalls.size(), 1u);
+    if (!stalls.empty()) CHECK(stalls[0].label && strcmp(stalls[0].label, "Session log startup scan") == 0);
+}
+
+// Parked: no pings however busy, and one posted just before doesn't count
+// the parked time as latency
+static void PausedWhileParked() {
+    StallMonitor monitor;
+    Start(monitor);
+    for (int i = 0; i < 20 && !g_pending; i++) Dispatch(monitor, MSG_WORK, 10);
+    CHECK(g_pending.load());
+    monitor.SetPaused(true);
+    int posted = g_posted;
+    for (int i = 0; i < 30; i++) Dispatch(monitor, MSG_WORK, 10);
+    PumpPing(monitor);
+    CHECK_EQ(g_posted.load(), posted);
+    CHECK_EQ(monitor.Pings(), 0);
+    CHECK_EQ(monitor.StallCount(), 0);
+
+    monitor.SetPaused(false);
+    for (int i = 0; i < 30; i++) {
+        Dispatch(monitor, MSG_WORK, 10);
+        PumpPing(monitor);
+    }
+    monitor.Stop();
+    CHECK(g_posted > posted);
+}
+
+static void FullTableCountsOverflow() {
+    StallMonitor monitor;
+    const uint32_t distinct = StallMonitor::STATS_SLOTS + 36;
+    for (uint32_t m = 1; m <= distinct; m++) Dispatch(monitor, m);
+    Dispatch(monitor, 1);
+
+    std::vector<DispatchStats> stats = monitor.SlowestHandlers(StallMonitor::STATS_SLOTS);
+    CHECK_EQ(stats.size(), StallMonitor::STATS_SLOTS);
+    uint64_t counted = 0;
+    for (const DispatchStats& s : stats) {
+        counted += s.count;
+        CHECK(s.message == 1 ? s.count == 2 : s.count == 1);
+    }
+    CHECK_EQ(counted, StallMonitor::STATS_SLOTS + 1);
+    CHECK_EQ(monitor.UntrackedDispatches(), 36);
+}
+
+int main() {
+    SlowHandlerIsNamed();
+    BusyLoopIsPinged();
+    IdleLoopIsLeftAlone();
+    PausedWhileParked();
+    FullTableCountsOverflow();
+    return CheckResult();
+}
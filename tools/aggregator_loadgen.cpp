@@ -0,0 +1,179 @@
+// Load generator for `claudewatch aggregate`: N keep-alive connections,
+// each pushing batches of synthetic snapshots back to back, then a latency
+// and throughput summary. Everything runs on one box:
+//   claudewatch aggregate --listen 127.0.0.1:8787 &
+//   claudewatch-loadgen --target 127.0.0.1:8787 --clients 64 --seconds 10
+#include "aggregator.h"
+#include "socket_util.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 8787;
+    int clients = 32;
+    int batch = 1;          // Snapshots per push
+    int users = 1000;
+    double seconds = 10.0;
+};
+
+struct ClientResult {
+    uint64_t pushes = 0;
+    uint64_t failures = 0;
+    std::vector<uint32_t> latencyUs;
+};
+
+static std::atomic<bool> g_stop{ false };
+
+// Reads one response; false if the connection failed or the status wasn't 2xx
+static bool ReadResponse(SocketHandle s, std::string& buffer) {
+    for (;;) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd != std::string::npos) {
+            size_t length = 0;
+            size_t cl = buffer.find("Content-Length:");
+            if (cl != std::string::npos && cl < headerEnd) length = strtoul(buffer.c_str() + cl + 15, nullptr, 10);
+            size_t total = headerEnd + 4 + length;
+            if (buffer.size() >= total) {
+                bool ok = buffer.compare(0, 10, "HTTP/1.1 2") == 0;
+                buffer.erase(0, total);
+                return ok;
+            }
+        }
+        char chunk[4096];
+        int n = (int)recv(s, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, (size_t)n);
+    }
+}
+
+static void RunClient(const Options& opt, int index, ClientResult& result) {
+    std::string error;
+    SocketHandle s = ConnectTcp(opt.host, opt.port, error);
+    if (s == INVALID_SOCKET_HANDLE) {
+        fprintf(stderr, "client %d: %s\n", index, error.c_str());
+        result.failures++;
+        return;
+    }
+    SetNoDelay(s);
+
+    uint32_t rng = 2463534242u ^ (uint32_t)(index * 7919);
+    auto next = [&rng]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    };
+
+    char hostName[32];
+    snprintf(hostName, sizeof(hostName), "loadgen-%d", index);
+    std::vector<uint8_t> body;
+    std::string request;
+    std::string response;
+
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        body.clear();
+        for (int i = 0; i < opt.batch; i++) {
+            UsageSnapshot snap;
+            snap.user = "user" + std::to_string(next() % (uint32_t)opt.users);
+            snap.host = hostName;
+            snap.time = (int64_t)time(nullptr);
+            snap.session = (float)(next() % 1000) / 10.0f;
+            snap.period = (float)(next() % 1000) / 10.0f;
+            EncodeSnapshot(snap, body);
+        }
+
+        char head[160];
+        int n = snprintf(head, sizeof(head),
+                         "POST /push HTTP/1.1\r\nHost: %s\r\nContent-Type: application/octet-stream\r\n"
+                         "Content-Length: %zu\r\n\r\n", opt.host.c_str(), body.size());
+        request.assign(head, (size_t)n);
+        request.append((const char*)body.data(), body.size());
+
+        auto start = std::chrono::steady_clock::now();
+        if (!SendAll(s, request.data(), request.size()) || !ReadResponse(s, response)) {
+            result.failures++;
+            break;
+        }
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        result.latencyUs.push_back((uint32_t)us.count());
+        result.pushes++;
+    }
+    CloseSocket(s);
+}
+
+static bool ParseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) return false;
+        if (strcmp(arg, "--target") == 0) {
+            if (!ParseHostPort(value, opt.host, opt.port)) return false;
+        } else if (strcmp(arg, "--clients") == 0) {
+            opt.clients = atoi(value);
+        } else if (strcmp(arg, "--batch") == 0) {
+            opt.batch = atoi(value);
+        } else if (strcmp(arg, "--users") == 0) {
+            opt.users = atoi(value);
+        } else if (strcmp(arg, "--seconds") == 0) {
+            opt.seconds = atof(value);
+        } else {
+            return false;
+        }
+        i++;
+    }
+    return opt.clients > 0 && opt.batch > 0 && opt.users > 0 && opt.seconds > 0;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!ParseArgs(argc, argv, opt)) {
+        fputs("usage: claudewatch-loadgen [--target HOST:PORT] [--clients N] [--batch N]\n"
+              "                           [--users N] [--seconds S]\n", stderr);
+        return 2;
+    }
+    InitSockets();
+
+    std::vector<ClientResult> results(opt.clients);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < opt.clients; i++) {
+        threads.emplace_back(RunClient, std::cref(opt), i, std::ref(results[i]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.seconds));
+    g_stop = true;
+    for (std::thread& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t pushes = 0, failures = 0;
+    std::vector<uint32_t> latency;
+    for (const ClientResult& r : results) {
+        pushes += r.pushes;
+        failures += r.failures;
+        latency.insert(latency.end(), r.latencyUs.begin(), r.latencyUs.end());
+    }
+    std::sort(latency.begin(), latency.end());
+    auto pct = [&latency](double p) {
+        return latency.empty() ? 0u : latency[std::min(latency.size() - 1, (size_t)(p * latency.size()))];
+    };
+
+    printf("clients %d, batch %d, %.1f s\n", opt.clients, opt.batch, elapsed);
+    printf("pushes      %llu (%.0f/s)\n", (unsigned long long)pushes, pushes / elapsed);
+    printf("snapshots   %llu (%.0f/s)\n", (unsigned long long)(pushes * opt.batch), pushes * opt.batch / elapsed);
+    printf("failures    %llu\n", (unsigned long long)failures);
+    printf("latency us  p50 %u  p90 %u  p99 %u  max %u\n", pct(0.5), pct(0.9), pct(0.99),
+           latency.empty() ? 0u : latency.back());
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+// Load generator for the live subscription channel: hosts a SubscriptionHub
+// on a scratch socket, connects N subscribers (a few of which never read),
+// publishes changing usage at a fixed rate and reports what the publishing
+// thread paid, how long lines took to reach readers and who got dropped:
+//   claudewatch-subscribe-loadgen --subscribers 500 --stalled 5 --rate 1000 --seconds 10
+#include "event_loop.h"
+#include "socket_util.h"
+#include "subscribe.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct Options {
+    std::string socketPath;
+    int subscribers = 256;
+    int stalled = 4;        // Connected but never read
+    double rate = 1000.0;   // Publishes per second
+    double seconds = 10.0;
+};
+
+struct Reader {
+    SocketHandle socket = INVALID_SOCKET_HANDLE;
+    std::string buffer;
+    uint64_t lines = 0;
+    bool closed = false;    // The hub hung up on us
+};
+
+using Clock = std::chrono::steady_clock;
+
+// The publish index rides in periodResetMs, far enough out that no reset fires
+static const int64_t RESET_BASE_MS = 4102444800000LL;     // 2100-01-01
+
+static std::atomic<bool> g_stop{ false };
+static std::vector<Clock::time_point> g_published;     // By index, written before Publish()
+
+static double SinceUs(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+static void OnLine(const std::string& line, Clock::time_point now, std::vector<uint32_t>& latencyUs) {
+    size_t at = line.find("\"periodResetMs\":");
+    if (at == std::string::npos) return;
+    int64_t index = strtoll(line.c_str() + at + 16, nullptr, 10) - RESET_BASE_MS;
+    if (index < 0 || index >= (int64_t)g_published.size()) return;
+    latencyUs.push_back((uint32_t)SinceUs(g_published[(size_t)index], now));
+}
+
+static void RunReaders(std::vector<Reader>& readers, std::vector<uint32_t>& latencyUs) {
+    EventLoop loop;
+    for (Reader& r : readers) {
+        loop.Add(r.socket, EventLoop::READ, [&loop, &r, &latencyUs](uint32_t) {
+            char chunk[8192];
+            for (;;) {
+                int n = (int)recv(r.socket, chunk, sizeof(chunk), 0);
+                if (n > 0) {
+                    r.buffer.append(chunk, (size_t)n);
+                    continue;
+                }
+                if (n < 0 && SocketWouldBlock()) break;
+                r.closed = true;
+                loop.Remove(r.socket);
+                break;
+            }
+            Clock::time_point now = Clock::now();
+            size_t start = 0, nl;
+            while ((nl = r.buffer.find('\n', start)) != std::string::npos) {
+                OnLine(r.buffer.substr(start, nl - start), now, latencyUs);
+                r.lines++;
+                start = nl + 1;
+            }
+            r.buffer.erase(0, start);
+        });
+    }
+    while (!g_stop.load()) loop.RunOnce(50);
+}
+
+static bool ParseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) return false;
+        if (strcmp(arg, "--socket") == 0) {
+            opt.socketPath = value;
+        } else if (strcmp(arg, "--subscribers") == 0) {
+            opt.subscribers = atoi(value);
+        } else if (strcmp(arg, "--stalled") == 0) {
+            opt.stalled = atoi(value);
+        } else if (strcmp(arg, "--rate") == 0) {
+            opt.rate = atof(value);
+        } else if (strcmp(arg, "--seconds") == 0) {
+            opt.seconds = atof(value);
+        } else {
+            return false;
+        }
+        i++;
+    }
+    return opt.subscribers > 0 && opt.stalled >= 0 && opt.rate > 0 && opt.seconds > 0;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!ParseArgs(argc, argv, opt)) {
+        fputs("usage: claudewatch-subscribe-loadgen [--socket PATH] [--subscribers N] [--stalled N]\n"
+              "                                     [--rate N] [--seconds S]\n", stderr);
+        return 2;
+    }
+    if (opt.socketPath.empty()) opt.socketPath = "/tmp/claudewatch-loadgen-" + std::to_string(getpid()) + ".sock";
+    InitSockets();
+
+    SubscriptionHub hub;
+    hub.maxSubscribers = (size_t)(opt.subscribers + opt.stalled);
+    std::string error;
+    if (!hub.Start(opt.socketPath, error)) {
+        fprintf(stderr, "claudewatch-subscribe-loadgen: %s\n", error.c_str());
+        return 1;
+    }
+
+    std::vector<Reader> readers;
+    std::vector<SocketHandle> stalled;
+    for (int i = 0; i < opt.subscribers + opt.stalled; i++) {
+        SocketHandle s = ConnectUnix(opt.socketPath, error);
+        if (s == INVALID_SOCKET_HANDLE) {
+            fprintf(stderr, "subscriber %d: %s\n", i, error.c_str());
+            return 1;
+        }
+        if (i < opt.subscribers) {
+            SetNonBlocking(s);
+            readers.emplace_back();
+            readers.back().socket = s;
+        } else {
+            stalled.push_back(s);
+        }
+    }
+
+    size_t total = (size_t)(opt.rate * opt.seconds) + 1;
+    g_published.resize(total);
+    std::vector<uint32_t> latencyUs;
+    latencyUs.reserve(total * readers.size());
+    std::thread readerThread(RunReaders, std::ref(readers), std::ref(latencyUs));
+
+    // Publish on a fixed schedule; the caller-side cost is what the UI thread pays
+    std::vector<uint32_t> publishNs;
+    publishNs.reserve(total);
+    UsageState state;
+    state.valid = true;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < total; i++) {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                                                  std::chrono::duration<double>(i / opt.rate)));
+        state.session = (float)(i % 1000) / 10.0f;
+        state.periodResetMs = RESET_BASE_MS + (int64_t)i;
+        g_published[i] = Clock::now();
+        hub.Publish(state);
+        publishNs.push_back((uint32_t)(SinceUs(g_published[i], Clock::now()) * 1000.0));
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Let the last deltas land
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    g_stop = true;
+    readerThread.join();
+    SubscriptionHub::Stats stats = hub.GetStats();
+    hub.Stop();
+
+    uint64_t lines = 0, closed = 0;
+    for (const Reader& r : readers) {
+        lines += r.lines;
+        if (r.closed) closed++;
+        CloseSocket(r.socket);
+    }
+    for (SocketHandle s : stalled) CloseSocket(s);
+
+    auto pct = [](std::vector<uint32_t>& v, double p) {
+        return v.empty() ? 0u : v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+    };
+    std::sort(latencyUs.begin(), latencyUs.end());
+    std::sort(publishNs.begin(), publishNs.end());
+
+    printf("subscribers %d (+%d stalled), %.0f publishes/s, %.1f s\n", opt.subscribers, opt.stalled, opt.rate,
+           elapsed);
+    printf("published   %llu, messages %llu, copies %llu\n", (unsigned long long)stats.published,
+           (unsigned long long)stats.messages, (unsigned long long)stats.delivered);
+    printf("received    %llu lines (%.0f/s)\n", (unsigned long long)lines, lines / elapsed);
+    printf("dropped     %llu slow, %llu readers cut off, %llu rejected\n", (unsigned long long)stats.dropped,
+           (unsigned long long)closed, (unsigned long long)stats.rejected);
+    printf("publish ns  p50 %u  p99 %u  max %u\n", pct(publishNs, 0.5), pct(publishNs, 0.99),
+           publishNs.empty() ? 0u : publishNs.back());
+    printf("latency us  p50 %u  p90 %u  p99 %u  max %u\n", pct(latencyUs, 0.5), pct(latencyUs, 0.9),
+           pct(latencyUs, 0.99), latencyUs.empty() ? 0u : latencyUs.back());
+    return closed ? 1 : 0;
+}
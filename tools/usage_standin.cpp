@@ -0,0 +1,148 @@
+// Stand-in for the claude.ai usage endpoints, for running claudewatchd
+// without an account or network:
+//   claudewatch-standin --listen 127.0.0.1:8080 &
+//   claudewatchd --api http://127.0.0.1:8080 --state-dir /tmp/cw
+// Serves /api/organizations and /api/organizations/<org>/usage; utilization
+// climbs a little with every usage request so the smart cadence moves.
+#include "socket_util.h"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 8080;
+    double step = 0.5;      // Utilization added per usage request
+    int status = 200;       // Forced status for usage requests (401, 503 ...)
+    bool chunked = false;   // Transfer-Encoding: chunked bodies
+};
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void OnSignal(int) {
+    g_stop = 1;
+}
+
+static std::string IsoTime(time_t t) {
+    char buf[48];
+    tm utc;
+    gmtime_r(&t, &utc);
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S.000000+00:00", &utc);
+    return buf;
+}
+
+static void Respond(SocketHandle s, int status, const std::string& body, bool chunked) {
+    const char* reason = status == 200 ? "OK" : status == 404 ? "Not Found" : "Error";
+    std::string out = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+                      "\r\nContent-Type: application/json\r\nConnection: close\r\n";
+    if (chunked) {
+        // Two chunks, to exercise reassembly
+        size_t half = body.size() / 2;
+        char size[24];
+        out += "Transfer-Encoding: chunked\r\n\r\n";
+        snprintf(size, sizeof(size), "%zx\r\n", half);
+        out += size + body.substr(0, half) + "\r\n";
+        snprintf(size, sizeof(size), "%zx\r\n", body.size() - half);
+        out += size + body.substr(half) + "\r\n0\r\n\r\n";
+    } else {
+        out += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+    SendAll(s, out.data(), out.size());
+}
+
+static bool ParseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--chunked") == 0) {
+            opt.chunked = true;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) return false;
+        if (strcmp(arg, "--listen") == 0) {
+            if (!ParseHostPort(value, opt.host, opt.port)) return false;
+        } else if (strcmp(arg, "--step") == 0) {
+            opt.step = atof(value);
+        } else if (strcmp(arg, "--status") == 0) {
+            opt.status = atoi(value);
+        } else {
+            return false;
+        }
+        i++;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!ParseArgs(argc, argv, opt)) {
+        fputs("usage: claudewatch-standin [--listen HOST:PORT] [--step PCT] [--status CODE] [--chunked]\n",
+              stderr);
+        return 2;
+    }
+    InitSockets();
+
+    std::string error;
+    SocketHandle listener = ListenTcp(opt.host, opt.port, error);
+    if (listener == INVALID_SOCKET_HANDLE) {
+        fprintf(stderr, "claudewatch-standin: %s\n", error.c_str());
+        return 1;
+    }
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    fprintf(stderr, "claudewatch-standin: serving on %s:%u\n", opt.host.c_str(), opt.port);
+
+    // One request per connection, handled inline; the poller is the only client
+    double utilization = 0.0;
+    unsigned long requests = 0;
+    time_t started = time(nullptr);
+    while (!g_stop) {
+        // The listener is non-blocking; wait for a connection (or a signal)
+        pollfd pfd = { listener, POLLIN, 0 };
+        if (poll(&pfd, 1, -1) <= 0) continue;
+        SocketHandle s = (SocketHandle)accept(listener, nullptr, nullptr);
+        if (s == INVALID_SOCKET_HANDLE) continue;
+
+        std::string request;
+        char buf[4096];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 65536) {
+            int n = (int)recv(s, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            request.append(buf, (size_t)n);
+        }
+        requests++;
+
+        bool hasCookie = request.find("Cookie: sessionKey=") != std::string::npos;
+        if (request.compare(0, 25, "GET /api/organizations/st") == 0 &&
+            request.find("/usage ") != std::string::npos) {
+            if (opt.status != 200 || !hasCookie) {
+                Respond(s, hasCookie ? opt.status : 401, "{}", false);
+            } else {
+                utilization += opt.step;
+                if (utilization > 100.0) utilization = 0.0;
+                char body[512];
+                snprintf(body, sizeof(body),
+                         "{\"five_hour\":{\"utilization\":%.1f,\"resets_at\":\"%s\"},"
+                         "\"seven_day\":{\"utilization\":%.1f,\"resets_at\":\"%s\"}}",
+                         utilization, IsoTime(started + 5 * 3600).c_str(), utilization / 2,
+                         IsoTime(started + 7 * 86400).c_str());
+                Respond(s, 200, body, opt.chunked);
+            }
+        } else if (request.compare(0, 27, "GET /api/organizations HTTP") == 0) {
+            Respond(s, hasCookie ? 200 : 401, "[{\"uuid\":\"standin-org\",\"name\":\"Stand-in\"}]", opt.chunked);
+        } else {
+            Respond(s, 404, "{}", false);
+        }
+        CloseSocket(s);
+    }
+
+    CloseSocket(listener);
+    fprintf(stderr, "claudewatch-standin: %lu requests\n", requests);
+    return 0;
+}